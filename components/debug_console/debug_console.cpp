@@ -5,7 +5,14 @@
 #include "debug_console.h"
 
 #include "esp_console.h"
+#include "esp_cpu.h"
 #include "esp_log.h"
+#include "pid_gain_store.h"
+#include "freertos/task.h"
+#include "project_conf.h"
+#include <cstdint>
+#include <cstring>
+#include <new>
 
 
 struct {
@@ -19,6 +26,91 @@ struct {
 
 float *m_parm_list[5];
 
+struct {
+    struct arg_str *loop = arg_str1(nullptr, nullptr, "<velocity|position>", "整定速度环或位置环");
+    struct arg_dbl *amplitude = arg_dbl0("a", "amplitude", "<float>", "继电器幅值 (速度环: Uq, 默认 500; 位置环: rad/s, 默认 10)");
+    struct arg_dbl *hysteresis = arg_dbl0("e", "hysteresis", "<float>", "继电器滞环 (速度环: rad/s, 位置环: rad)");
+    struct arg_end *end = arg_end(20);
+} autotune_args;
+
+struct {
+    struct arg_str *name = arg_str1(nullptr, nullptr, "<name>", "调度表名称");
+    struct arg_int *velocity_index = arg_int0("v", "vel", "<int>", "速度点下标, 不填表示所有速度点");
+    struct arg_int *position_index = arg_int0("x", "pos", "<int>", "位置点下标, 不填表示所有位置点");
+    struct arg_dbl *kp = arg_dbl0("p", "kp", "<float>", "kp");
+    struct arg_dbl *ki = arg_dbl0("i", "ki", "<float>", "ki");
+    struct arg_dbl *kd = arg_dbl0("d", "kd", "<float>", "kd");
+    struct arg_int *velocity_points = arg_int0("n", "vpoints", "<int>", "速度点数");
+    struct arg_int *position_points = arg_int0("m", "ppoints", "<int>", "位置点数");
+    struct arg_dbl *max_velocity = arg_dbl0(nullptr, "vmax", "<float>", "速度轴最大转速 (rad/s)");
+    struct arg_dbl *period = arg_dbl0(nullptr, "period", "<float>", "位置轴周期 (rad)");
+    struct arg_end *end = arg_end(20);
+} gains_args;
+
+struct {
+    struct arg_str *signal = arg_str1(nullptr, nullptr, "<chirp|prbs>", "激励信号");
+    struct arg_dbl *amplitude = arg_dbl0("a", "amplitude", "<float>", "激励幅值 (Uq), 默认 150");
+    struct arg_dbl *duration = arg_dbl0("t", "time", "<float>", "激励时长 (秒), 默认 4");
+    struct arg_dbl *f0 = arg_dbl0(nullptr, "f0", "<float>", "chirp 起始频率 (Hz), 默认 1");
+    struct arg_dbl *f1 = arg_dbl0(nullptr, "f1", "<float>", "chirp 结束频率 (Hz), 默认 80");
+    struct arg_int *hold = arg_int0(nullptr, "hold", "<int>", "PRBS 码元保持周期数, 默认 8");
+    struct arg_end *end = arg_end(20);
+} sysid_args;
+
+struct {
+    struct arg_str *effect = arg_str1(nullptr, nullptr, "<click|tick|bump|buzz>", "效果");
+    struct arg_dbl *strength = arg_dbl0("s", "strength", "<float>", "峰值力矩 (Uq), 默认 PRESS_SHOCKPROOFNESS");
+    struct arg_end *end = arg_end(20);
+} effect_args;
+
+struct {
+    struct arg_dbl *time = arg_dbl0("t", "time", "<float>", "监听时长 (秒), 默认 10");
+    struct arg_end *end = arg_end(20);
+} events_args;
+
+struct {
+    struct arg_int *bench = arg_int0("b", "bench", "<int>", "在控制台任务里对一个独立的估计器连续更新 n 次, 统计每次的 CPU 周期");
+    struct arg_end *end = arg_end(20);
+} estimator_args;
+
+struct {
+    struct arg_dbl *position = arg_dbl0("p", "position", "<float>", "目标角度 (rad, 自定义坐标系)");
+    struct arg_lit *cancel = arg_lit0("c", "cancel", "取消正在进行的回位");
+    struct arg_end *end = arg_end(20);
+} servo_args;
+
+struct {
+    struct arg_str *shape = arg_str1(nullptr, nullptr, "<none|sine|ridges|sandpaper|sticky>", "纹理图案");
+    struct arg_int *cycles = arg_int0("n", "cycles", "<int>", "每圈的周期数, 默认 90");
+    struct arg_dbl *amplitude = arg_dbl0("a", "amplitude", "<float>", "力矩峰值 (Uq), sticky 为摩擦力矩, 默认 20");
+    struct arg_dbl *duty = arg_dbl0("w", "duty", "<float>", "ridges 凸起宽度 / sticky 粘滞区宽度占周期的比例, 默认 0.25");
+    struct arg_dbl *rest_scale = arg_dbl0("r", "rest", "<float>", "静止时的幅度倍率, 默认 1");
+    struct arg_dbl *full_velocity = arg_dbl0("v", "velocity", "<float>", "幅度升到 100% 的转速 (rad/s), 默认 0");
+    struct arg_int *seed = arg_int0("s", "seed", "<int>", "sandpaper 的随机种子, 默认 1");
+    struct arg_end *end = arg_end(20);
+} texture_args;
+
+#define GAIN_SCHEDULE_MAX_NUM 4
+struct {
+    const char *name;
+    GainSchedule *schedule;
+} m_gain_schedules[GAIN_SCHEDULE_MAX_NUM];
+int m_gain_schedule_num = 0;
+
+static GainSchedule *find_gain_schedule(const char *name) {
+    for (int i = 0; i < m_gain_schedule_num; i++) {
+        if (strcmp(m_gain_schedules[i].name, name) == 0) {
+            return m_gain_schedules[i].schedule;
+        }
+    }
+    return nullptr;
+}
+
+FocDriver *m_foc_driver;
+RotaryKnob *m_rotary_knob;
+PIDController *m_pid_velocity;
+PIDController *m_pid_position;
+
 DebugConsole::DebugConsole(float parm_list[5]) {
     for (int i = 0; i < 5; i++) {
         m_parm_list[i] = &parm_list[i];
@@ -85,4 +177,452 @@ int DebugConsole::set_params_cmd(int argc, char **argv) {
     ESP_LOGI("set_parm", "parm0: %f, parm1: %f, parm2: %f, parm3: %f, parm4: %f",
              *m_parm_list[0], *m_parm_list[1], *m_parm_list[2], *m_parm_list[3], *m_parm_list[4]);
     return 0;
-}
\ No newline at end of file
+}
+
+void DebugConsole::register_autotune_cmd(FocDriver *foc_driver, PIDController *pid_velocity,
+                                         PIDController *pid_position) {
+    m_foc_driver = foc_driver;
+    m_pid_velocity = pid_velocity;
+    m_pid_position = pid_position;
+
+    const esp_console_cmd_t cmd = {
+            .command = "autotune",
+            .help = "继电反馈自整定, 先整定 velocity 再整定 position",
+            .hint = nullptr,
+            .func = &DebugConsole::autotune_cmd,
+            .argtable = &autotune_args,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+int DebugConsole::autotune_cmd(int argc, char **argv) {
+    int nerrors = arg_parse(argc, argv, (void **) &autotune_args);
+    if (nerrors != 0) {
+        arg_print_errors(stdout, autotune_args.end, "autotune");
+        return 1;
+    }
+
+    bool velocity_loop = strcmp(autotune_args.loop->sval[0], "position") != 0;
+    float amplitude = velocity_loop ? 500.0f : 10.0f;   // 速度环振荡幅度要明显大于滞环, 否则 Ku 对噪声很敏感
+    float hysteresis = velocity_loop ? 2.0f : 0.02f;
+    if (autotune_args.amplitude->count > 0) {
+        amplitude = (float) autotune_args.amplitude->dval[0];
+    }
+    if (autotune_args.hysteresis->count > 0) {
+        hysteresis = (float) autotune_args.hysteresis->dval[0];
+    }
+
+    RelayAutotuner tuner(amplitude, hysteresis, FOC_CALC_PERIOD * 1e-6f);
+    bool started = velocity_loop ? m_foc_driver->start_autotune(&tuner, AutotuneLoop::Velocity)
+                                 : m_foc_driver->start_autotune(&tuner, AutotuneLoop::Position, m_pid_velocity);
+    if (!started) {
+        return 1;
+    }
+    while (m_foc_driver->is_autotune_running()) {
+        vTaskDelay(pdMS_TO_TICKS(20));
+    }
+
+    RelayAutotuneResult result = tuner.get_result();
+    if (!result.success) {
+        ESP_LOGW("autotune", "No stable oscillation, try a larger amplitude");
+        return 1;
+    }
+    PidGains gains = RelayAutotuner::compute_gains(result, velocity_loop ? TuningRule::TyreusLuyben
+                                                                         : TuningRule::IntegratingPD);
+    PIDController *pid = velocity_loop ? m_pid_velocity : m_pid_position;
+    pid->setPID(gains.kp, gains.ki, gains.kd);
+    PidGainStore::save(velocity_loop ? "velocity" : "position", gains);
+    GainSchedule *schedule = find_gain_schedule(velocity_loop ? "velocity" : "position");
+    if (schedule) {    // 调度表会覆盖 PID 自身的参数, 整定结果同样写入整张表
+        schedule->fill(gains);
+    }
+
+    ESP_LOGI("autotune", "Ku: %f, Pu: %f s, kp: %f, ki: %f, kd: %f",
+             result.ultimate_gain, result.ultimate_period, gains.kp, gains.ki, gains.kd);
+    return 0;
+}
+
+void DebugConsole::register_gain_schedule(const char *name, GainSchedule *schedule) {
+    if (m_gain_schedule_num >= GAIN_SCHEDULE_MAX_NUM) {
+        ESP_LOGE("gains", "Too many gain schedules, %s not registered", name);
+        return;
+    }
+    m_gain_schedules[m_gain_schedule_num++] = {name, schedule};
+    if (m_gain_schedule_num > 1) {
+        return;     // 命令只注册一次
+    }
+
+    const esp_console_cmd_t cmd = {
+            .command = "gains",
+            .help = "查看/修改增益调度表, 例如 gains velocity -n 3 --vmax 20 -v 2 -p 30 -i 200",
+            .hint = nullptr,
+            .func = &DebugConsole::gains_cmd,
+            .argtable = &gains_args,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+int DebugConsole::gains_cmd(int argc, char **argv) {
+    int nerrors = arg_parse(argc, argv, (void **) &gains_args);
+    if (nerrors != 0) {
+        arg_print_errors(stdout, gains_args.end, "gains");
+        return 1;
+    }
+    GainSchedule *schedule = find_gain_schedule(gains_args.name->sval[0]);
+    if (schedule == nullptr) {
+        ESP_LOGW("gains", "Unknown gain schedule %s", gains_args.name->sval[0]);
+        return 1;
+    }
+
+    bool modify = gains_args.kp->count > 0 || gains_args.ki->count > 0 || gains_args.kd->count > 0 ||
+                  gains_args.velocity_points->count > 0 || gains_args.position_points->count > 0 ||
+                  gains_args.max_velocity->count > 0 || gains_args.period->count > 0;
+    if (modify) {
+        GainTable &table = schedule->edit();
+        if (gains_args.velocity_points->count > 0) {
+            table.velocity_points = (uint8_t) gains_args.velocity_points->ival[0];
+        }
+        if (gains_args.position_points->count > 0) {
+            table.position_points = (uint8_t) gains_args.position_points->ival[0];
+        }
+        if (gains_args.max_velocity->count > 0) {
+            table.max_velocity = (float) gains_args.max_velocity->dval[0];
+        }
+        if (gains_args.period->count > 0) {
+            table.position_period = (float) gains_args.period->dval[0];
+        }
+        for (int p = 0; p < GainTable::max_position_points; p++) {
+            if (gains_args.position_index->count > 0 && gains_args.position_index->ival[0] != p) {
+                continue;
+            }
+            for (int v = 0; v < GainTable::max_velocity_points; v++) {
+                if (gains_args.velocity_index->count > 0 && gains_args.velocity_index->ival[0] != v) {
+                    continue;
+                }
+                if (gains_args.kp->count > 0) {
+                    table.gains[p][v].kp = (float) gains_args.kp->dval[0];
+                }
+                if (gains_args.ki->count > 0) {
+                    table.gains[p][v].ki = (float) gains_args.ki->dval[0];
+                }
+                if (gains_args.kd->count > 0) {
+                    table.gains[p][v].kd = (float) gains_args.kd->dval[0];
+                }
+            }
+        }
+        if (!schedule->commit()) {
+            ESP_LOGW("gains", "Invalid table (velocity points 1~%d, position points 1~%d, vmax/period > 0)",
+                     GainTable::max_velocity_points, GainTable::max_position_points);
+            return 1;
+        }
+    }
+
+    // 打印当前生效的表
+    const GainTable &table = schedule->get_table();
+    ESP_LOGI("gains", "%s: %d velocity points up to %.1f rad/s, %d position points over %.3f rad",
+             gains_args.name->sval[0], table.velocity_points, table.max_velocity, table.position_points,
+             table.position_period);
+    for (int p = 0; p < table.position_points; p++) {
+        for (int v = 0; v < table.velocity_points; v++) {
+            const PidGains &g = table.gains[p][v];
+            ESP_LOGI("gains", "[x%d v%d] kp: %f, ki: %f, kd: %f", p, v, g.kp, g.ki, g.kd);
+        }
+    }
+    return 0;
+}
+
+void DebugConsole::register_sysid_cmd(FocDriver *foc_driver) {
+    m_foc_driver = foc_driver;
+
+    const esp_console_cmd_t cmd = {
+            .command = "sysid",
+            .help = "系统辨识, 旋钮必须可以自由转动, 结果以 base64 输出, 保存日志后运行 tools/sysid_fit.py",
+            .hint = nullptr,
+            .func = &DebugConsole::sysid_cmd,
+            .argtable = &sysid_args,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+int DebugConsole::sysid_cmd(int argc, char **argv) {
+    int nerrors = arg_parse(argc, argv, (void **) &sysid_args);
+    if (nerrors != 0) {
+        arg_print_errors(stdout, sysid_args.end, "sysid");
+        return 1;
+    }
+
+    float Ts = FOC_CALC_PERIOD * 1e-6f;
+    float amplitude = sysid_args.amplitude->count > 0 ? (float) sysid_args.amplitude->dval[0] : 150.0f;
+    float duration = sysid_args.duration->count > 0 ? (float) sysid_args.duration->dval[0] : 4.0f;
+    bool chirp = strcmp(sysid_args.signal->sval[0], "prbs") != 0;
+    SysIdExcitation excitation = chirp
+            ? SysIdExcitation::chirp(amplitude,
+                                     sysid_args.f0->count > 0 ? (float) sysid_args.f0->dval[0] : 1.0f,
+                                     sysid_args.f1->count > 0 ? (float) sysid_args.f1->dval[0] : 80.0f,
+                                     duration, Ts)
+            : SysIdExcitation::prbs(amplitude, sysid_args.hold->count > 0 ? sysid_args.hold->ival[0] : 8,
+                                    duration, Ts);
+
+    // 4 秒 2000 个采样, 约 24KB, 只在命令执行期间占用
+    uint32_t capacity = excitation.get_total_ticks();
+    auto *buffer = new(std::nothrow) SysIdSample[capacity];
+    if (buffer == nullptr) {
+        ESP_LOGE("sysid", "Not enough memory for %lu samples", (unsigned long) capacity);
+        return 1;
+    }
+    SysIdRecorder recorder(buffer, capacity);
+
+    m_foc_driver->start_identification(&excitation, &recorder);
+    while (m_foc_driver->is_identification_running()) {
+        vTaskDelay(pdMS_TO_TICKS(20));
+    }
+    ESP_LOGI("sysid", "Recorded %lu samples", (unsigned long) recorder.get_count());
+    recorder.dump(stdout);
+
+    delete[] buffer;
+    return 0;
+}
+
+void DebugConsole::register_estimator_cmd(FocDriver *foc_driver) {
+    m_foc_driver = foc_driver;
+
+    const esp_console_cmd_t cmd = {
+            .command = "estimator",
+            .help = "打印卡尔曼状态估计 (角度 / 转速 / 手指力矩) 和每次更新的 CPU 周期 (最大值读取后清零)",
+            .hint = nullptr,
+            .func = &DebugConsole::estimator_cmd,
+            .argtable = &estimator_args,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+int DebugConsole::estimator_cmd(int argc, char **argv) {
+    int nerrors = arg_parse(argc, argv, (void **) &estimator_args);
+    if (nerrors != 0) {
+        arg_print_errors(stdout, estimator_args.end, "estimator");
+        return 1;
+    }
+
+    if (estimator_args.bench->count > 0) {
+        int count = estimator_args.bench->ival[0];
+        if (count < 1) {
+            ESP_LOGW("estimator", "Bench count must be at least 1");
+            return 1;
+        }
+        // 与 FocDriver 相同参数的估计器, 输入 1 rad/s 匀速转动, 不碰控制任务里的那个
+        KalmanEstimator bench(FOC_FEEDFORWARD_ACCEL, FOC_FEEDFORWARD_VELOCITY, FOC_CALC_PERIOD * 1e-6f,
+                              FOC_KALMAN_ANGLE_NOISE, FOC_KALMAN_VELOCITY_NOISE, FOC_KALMAN_TORQUE_NOISE);
+        auto step = encoder_position_t(FOC_CALC_PERIOD * 1e-6f * ENCODER_LSB_PER_RADIAN);
+        uint32_t min_cycles = UINT32_MAX, max_cycles = 0;
+        uint64_t total_cycles = 0;
+        for (int i = 0; i < count; i++) {
+            uint32_t start = esp_cpu_get_cycle_count();
+            bench.update(10.0f, 0.0f, step * i);
+            uint32_t cycles = esp_cpu_get_cycle_count() - start;
+            min_cycles = cycles < min_cycles ? cycles : min_cycles;
+            max_cycles = cycles > max_cycles ? cycles : max_cycles;
+            total_cycles += cycles;
+        }
+        ESP_LOGI("estimator", "bench %d updates: min %lu, avg %lu, max %lu cycles (max includes preemption)",
+                 count, (unsigned long) min_cycles, (unsigned long) (total_cycles / count),
+                 (unsigned long) max_cycles);
+        return 0;
+    }
+
+    const KalmanEstimator &estimator = m_foc_driver->get_state_estimator();
+    ESP_LOGI("estimator", "angle: %f rad, velocity: %f rad/s, torque: %f Uq, innovation: %f rad",
+             estimator.get_angle(), estimator.get_velocity(), estimator.get_external_torque(),
+             estimator.get_innovation());
+    ESP_LOGI("estimator", "cycles: %lu, max since last read: %lu", (unsigned long) m_foc_driver->get_estimator_cycles(),
+             (unsigned long) m_foc_driver->take_estimator_max_cycles());
+    return 0;
+}
+
+void DebugConsole::register_effect_cmd(FocDriver *foc_driver) {
+    m_foc_driver = foc_driver;
+
+    const esp_console_cmd_t cmd = {
+            .command = "effect",
+            .help = "在 FOC 周期里播放一个力矩波形效果, 叠加在当前的旋钮手感上",
+            .hint = nullptr,
+            .func = &DebugConsole::effect_cmd,
+            .argtable = &effect_args,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+int DebugConsole::effect_cmd(int argc, char **argv) {
+    int nerrors = arg_parse(argc, argv, (void **) &effect_args);
+    if (nerrors != 0) {
+        arg_print_errors(stdout, effect_args.end, "effect");
+        return 1;
+    }
+
+    static constexpr struct {
+        const char *name;
+        HapticEffect effect;
+    } effects[] = {
+            {"click", HapticEffect::Click},
+            {"tick", HapticEffect::Tick},
+            {"bump", HapticEffect::Bump},
+            {"buzz", HapticEffect::Buzz},
+    };
+    float strength = effect_args.strength->count > 0 ? (float) effect_args.strength->dval[0] : PRESS_SHOCKPROOFNESS;
+    for (const auto &entry : effects) {
+        if (strcmp(effect_args.effect->sval[0], entry.name) == 0) {
+            if (!m_foc_driver->play_effect(entry.effect, strength)) {
+                ESP_LOGW("effect", "Effect queue full");
+                return 1;
+            }
+            return 0;
+        }
+    }
+    ESP_LOGW("effect", "Unknown effect %s", effect_args.effect->sval[0]);
+    return 1;
+}
+
+void DebugConsole::register_events_cmd(RotaryKnob *rotary_knob) {
+    m_rotary_knob = rotary_knob;
+
+    const esp_console_cmd_t cmd = {
+            .command = "events",
+            .help = "打印旋钮事件 (越过吸附点 / 顶到边界 / 离开边界 / 转速阈值 / 回位伺服) 和时间戳",
+            .hint = nullptr,
+            .func = &DebugConsole::events_cmd,
+            .argtable = &events_args,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+int DebugConsole::events_cmd(int argc, char **argv) {
+    int nerrors = arg_parse(argc, argv, (void **) &events_args);
+    if (nerrors != 0) {
+        arg_print_errors(stdout, events_args.end, "events");
+        return 1;
+    }
+
+    static const char *names[] = {"detent", "boundary hit", "boundary released", "fast", "slow", "servo arrived",
+                                  "servo grabbed"};
+    float duration = events_args.time->count > 0 ? (float) events_args.time->dval[0] : 10.0f;
+    int64_t deadline = esp_timer_get_time() + int64_t(duration * 1e6f);
+
+    KnobEventReader reader;
+    KnobEvent event{};
+    m_rotary_knob->subscribe_events(reader, true);
+    while (esp_timer_get_time() < deadline) {
+        if (!m_rotary_knob->wait_event(reader, event, pdMS_TO_TICKS(100))) {
+            continue;
+        }
+        printf("%lld us  %-17s %+d  detent %ld  pos %.3f rad  vel %.2f rad/s\n", (long long) event.time_us,
+               names[static_cast<int>(event.type)], event.direction, (long) event.detent, event.position,
+               event.velocity);
+    }
+    m_rotary_knob->unsubscribe_events();
+    if (reader.dropped > 0) {
+        ESP_LOGW("events", "%lu events dropped", (unsigned long) reader.dropped);
+    }
+    return 0;
+}
+
+void DebugConsole::register_servo_cmd(RotaryKnob *rotary_knob) {
+    m_rotary_knob = rotary_knob;
+
+    const esp_console_cmd_t cmd = {
+            .command = "servo",
+            .help = "让旋钮自己转到指定角度 (回位伺服), 用手抓住即停止",
+            .hint = nullptr,
+            .func = &DebugConsole::servo_cmd,
+            .argtable = &servo_args,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+int DebugConsole::servo_cmd(int argc, char **argv) {
+    int nerrors = arg_parse(argc, argv, (void **) &servo_args);
+    if (nerrors != 0) {
+        arg_print_errors(stdout, servo_args.end, "servo");
+        return 1;
+    }
+
+    if (servo_args.cancel->count > 0) {
+        m_rotary_knob->servo_cancel();
+    } else if (servo_args.position->count > 0) {
+        m_rotary_knob->servo_to((float) servo_args.position->dval[0]);
+    } else {
+        static const char *states[] = {"idle", "moving", "arrived", "grabbed"};
+        ESP_LOGI("servo", "state: %s, pos: %.3f rad", states[static_cast<int>(m_rotary_knob->servo_get_state())],
+                 m_rotary_knob->get_current_radian());
+    }
+    return 0;
+}
+
+void DebugConsole::register_texture_cmd(RotaryKnob *rotary_knob) {
+    m_rotary_knob = rotary_knob;
+
+    const esp_console_cmd_t cmd = {
+            .command = "texture",
+            .help = "设置叠加在旋钮手感上的空间纹理, 下一次切换模式时生效",
+            .hint = nullptr,
+            .func = &DebugConsole::texture_cmd,
+            .argtable = &texture_args,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+int DebugConsole::texture_cmd(int argc, char **argv) {
+    int nerrors = arg_parse(argc, argv, (void **) &texture_args);
+    if (nerrors != 0) {
+        arg_print_errors(stdout, texture_args.end, "texture");
+        return 1;
+    }
+
+    static constexpr struct {
+        const char *name;
+        TextureShape shape;
+    } shapes[] = {
+            {"none", TextureShape::None},
+            {"sine", TextureShape::Sine},
+            {"ridges", TextureShape::Ridges},
+            {"sandpaper", TextureShape::Sandpaper},
+            {"sticky", TextureShape::Sticky},
+    };
+    TextureSpec spec;
+    bool found = false;
+    for (const auto &entry : shapes) {
+        if (strcmp(texture_args.shape->sval[0], entry.name) == 0) {
+            spec.shape = entry.shape;
+            found = true;
+        }
+    }
+    if (!found) {
+        ESP_LOGW("texture", "Unknown texture %s", texture_args.shape->sval[0]);
+        return 1;
+    }
+    int cycles = texture_args.cycles->count > 0 ? texture_args.cycles->ival[0] : 90;
+    if (cycles < 1 || cycles > UINT16_MAX) {
+        ESP_LOGW("texture", "Cycles must be in [1, %d]", UINT16_MAX);
+        return 1;
+    }
+    spec.cycles = uint16_t(cycles);
+    spec.amplitude = texture_args.amplitude->count > 0 ? (float) texture_args.amplitude->dval[0] : 20.0f;
+    if (texture_args.duty->count > 0) {
+        spec.duty = (float) texture_args.duty->dval[0];
+    }
+    if (texture_args.rest_scale->count > 0) {
+        spec.rest_scale = (float) texture_args.rest_scale->dval[0];
+    }
+    if (texture_args.full_velocity->count > 0) {
+        spec.full_velocity = (float) texture_args.full_velocity->dval[0];
+    }
+    if (texture_args.seed->count > 0) {
+        spec.seed = uint32_t(texture_args.seed->ival[0]);
+    }
+
+    if (!m_rotary_knob->set_texture(spec)) {
+        ESP_LOGW("texture", "Invalid texture parameters, texture disabled");
+        return 1;
+    }
+    ESP_LOGI("texture", "%s, %u cycles/rev, %.1f Uq; applied at the next mode change", texture_args.shape->sval[0],
+             (unsigned) spec.cycles, spec.amplitude);
+    return 0;
+}
@@ -6,14 +6,57 @@
 #define FOCKNOB_DEBUG_CONSOLE_H
 
 #include "argtable3/argtable3.h"
+#include "motor_foc_driver.h"
+#include "motor_gain_schedule.h"
+#include "motor_knob.h"
 
 
 class DebugConsole {
 public:
     explicit DebugConsole(float parm_list[5]); //需要修改的三个全局变量
 
+    // 注册 autotune 命令: 继电反馈整定速度环 / 位置环, 结果写入 PID 并保存到 NVS
+    void register_autotune_cmd(FocDriver *foc_driver, PIDController *pid_velocity, PIDController *pid_position);
+
+    // 注册一张增益调度表, 通过 gains <name> 命令查看/修改, 修改后原子切换; 与 autotune 同名的表在整定后整表刷新
+    void register_gain_schedule(const char *name, GainSchedule *schedule);
+
+    // 注册 sysid 命令: 注入 chirp / PRBS 激励, 同步记录后以 base64 输出, 用 tools/sysid_fit.py 拟合
+    void register_sysid_cmd(FocDriver *foc_driver);
+
+    // 注册 estimator 命令: 打印状态估计器的角度 / 转速 / 手指力矩, 以及每次更新耗费的 CPU 周期; -b 跑更新耗时的基准
+    void register_estimator_cmd(FocDriver *foc_driver);
+
+    // 注册 effect 命令: 播放点击 / 振动等力矩波形, 用来调整效果的强度
+    void register_effect_cmd(FocDriver *foc_driver);
+
+    // 注册 events 命令: 阻塞等待并打印旋钮事件 (吸附点 / 边界 / 转速阈值), 作为事件流的日志消费者
+    void register_events_cmd(RotaryKnob *rotary_knob);
+
+    // 注册 servo 命令: 模拟外部改了数值, 让旋钮转到指定角度; 不带参数时打印伺服状态
+    void register_servo_cmd(RotaryKnob *rotary_knob);
+
+    // 注册 texture 命令: 设置空间纹理 (细棱 / 砂纸 / 粘滞区), 下一次切换模式时生效, 用来调整纹理的参数
+    void register_texture_cmd(RotaryKnob *rotary_knob);
+
 private:
     static int set_params_cmd(int argc, char **argv); //设置参数的命令
+
+    static int autotune_cmd(int argc, char **argv); //自整定命令
+
+    static int gains_cmd(int argc, char **argv); //增益调度表命令
+
+    static int sysid_cmd(int argc, char **argv); //系统辨识命令
+
+    static int estimator_cmd(int argc, char **argv); //状态估计命令
+
+    static int effect_cmd(int argc, char **argv); //力矩波形效果命令
+
+    static int events_cmd(int argc, char **argv); //旋钮事件命令
+
+    static int servo_cmd(int argc, char **argv); //回位伺服命令
+
+    static int texture_cmd(int argc, char **argv); //空间纹理命令
 };
 
 
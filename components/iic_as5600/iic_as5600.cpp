@@ -2,113 +2,124 @@
 // Created by HAIRONG ZHU on 25-1-14.
 //
 
-#include <cmath>
 #include "iic_as5600.h"
 #include "project_conf.h"
 
 static const char *TAG = "AS5600";
 
-AS5600::AS5600(i2c_master_bus_handle_t bus_handle, uint8_t device_address) {
-    if (bus_handle == nullptr) {
-        ESP_LOGE(TAG, "I2C master bus not initialized");
-        return;
-    }
-    // 配置 I2C 设备
-    i2c_device_config_t dev_config = {
-            .dev_addr_length = I2C_ADDR_BIT_LEN_7,
-            .device_address = device_address,
-            .scl_speed_hz = IIC_MASTER_FREQ_HZ,
-    };
-    esp_err_t ret = i2c_master_bus_add_device(bus_handle, &dev_config, &dev_handle_);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to add I2C device: %s", esp_err_to_name(ret));
+AS5600::AS5600(IICBusArbiter *arbiter, uint8_t device_address) : arbiter_(arbiter) {
+    // 角度读取是控制优先级, 每个控制周期都保证有一个时隙
+    device_ = arbiter_->add_device(device_address, IICPriority::Control, IIC_AS5600_TIMEOUT_MS * 1000);
+    if (device_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to add AS5600 to I2C bus arbiter");
     }
 }
 
-uint16_t AS5600::_location_read_raw() {
-    uint8_t reg = IIC_AS5600_RAW_ANGLE_REG;
+EncoderReadStatus AS5600::_read_raw(uint16_t &raw) {
     uint8_t buffer[2] = {0};
+    esp_err_t ret = _read_angle_registers(IIC_AS5600_RAW_ANGLE_REG, buffer, 2);
 
-    esp_err_t ret = i2c_master_transmit_receive(
-            dev_handle_,
-            &reg,
-            1,
-            buffer,
-            2,
-            -1
-    );
-
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "I2C transmit/receive failed: %s", esp_err_to_name(ret));
-        return ret;
+    // 控制环中调用, 这里不能打印日志, 错误次数通过 get_stats() 读取
+    if (ret == ESP_ERR_TIMEOUT) {
+        return EncoderReadStatus::Timeout;
+    } else if (ret != ESP_OK) {
+        return EncoderReadStatus::Error;
     }
 
-    return ((uint16_t) buffer[0] << 8) | buffer[1];
-}
-
-float AS5600::read_radian_from_sensor() {
-    auto current_radian = float(_location_read_raw() * M_TWOPI / IIC_AS5600_RESOLUTION);    // 读取传感器的弧度
-    _update_total_radian_and_velocity(current_radian);   // 更新累计的总弧度和转速
-    return current_radian;
+    raw = (((uint16_t) buffer[0] << 8) | buffer[1]) & 0x0FFF;
+    return EncoderReadStatus::Ok;
 }
 
-float AS5600::read_radian_from_sensor_with_no_update() {
-    auto current_radian = float(_location_read_raw() * M_TWOPI / IIC_AS5600_RESOLUTION);
-    return current_radian;
+esp_err_t AS5600::_read_angle_registers(uint8_t reg, uint8_t *buffer, size_t len) {
+    esp_err_t ret;
+    uint32_t bits;
+    if (read_mode_ != AS5600ReadMode::Full && pointer_reg_ == reg) {
+        ret = arbiter_->transmit_receive(device_, nullptr, 0, buffer, len);   // 地址指针不变, 只发读事务
+        bits = (1 + len) * 9 + 2;
+        read_stats_.pointer_reads++;
+    } else {
+        ret = arbiter_->transmit_receive(device_, &reg, 1, buffer, len);
+        bits = (3 + len) * 9 + 3;
+        read_stats_.full_reads++;
+    }
+    read_stats_.bus_bits += bits;
+    // 出错时不确定地址指针是否已经写入, 下一次重新写
+    pointer_reg_ = (ret == ESP_OK) ? reg : pointer_unknown;
+    return ret;
 }
 
-esp_err_t AS5600::_update_total_radian_and_velocity(float currentRadian) {
-    float deltaRadian = currentRadian - previous_radian_;
-    if (fabsf(deltaRadian) > M_PI) {
-        if (deltaRadian > 0) {
-            deltaRadian -= M_TWOPI;
-        } else {
-            deltaRadian += M_TWOPI;
-        }
+/*
+ * @brief 控制读取完成后调用, 以 Diagnostic 优先级提交, 由仲裁器判断剩余时隙是否足够, 不够就推迟到下一个周期
+ *        STATUS 和 AGC/MAGNITUDE 轮流读取, 每 IIC_AS5600_DIAG_INTERVAL 个周期最多一次
+ *        budget_us 不需要, 仲裁器以控制读取的开始时间为锚点计算剩余时间
+ */
+void AS5600::service_idle_slot(int32_t /*budget_us*/) {
+    if (diag_countdown_ > 0) {
+        diag_countdown_--;
+        return;
     }
-    total_accumulated_radian_ += deltaRadian;
-    previous_radian_ = currentRadian;
-
-    // 更新速度
-    float Ts = FOC_CALC_PERIOD * 1e-6f; // 单位: 秒
-    velocity_ = deltaRadian / Ts;
 
-    // 低通滤波
-    float alpha = FOC_LOW_PASS_FILTER_ALPHA;
-    velocity_filter_ = alpha * velocity_ + (1 - alpha) * velocity_filter_;   // 一阶低通滤波
-
-    return ESP_OK;
-}
+    size_t read_bytes = (diag_step_ == DiagStep::Status) ? 1 : 3;
+    uint8_t reg = (diag_step_ == DiagStep::Status) ? IIC_AS5600_STATUS_REG : IIC_AS5600_AGC_REG;
+    uint8_t buffer[3] = {0};
+    esp_err_t ret = arbiter_->transmit_receive(device_, IICPriority::Diagnostic, &reg, 1, buffer, read_bytes);
+    if (ret == ESP_ERR_NOT_FINISHED) {
+        magnet_health_.diag_skips++;
+        return;
+    }
+    pointer_reg_ = pointer_unknown;     // 地址指针已经移走, 下一次角度读取需要重新写地址
+    diag_countdown_ = IIC_AS5600_DIAG_INTERVAL;
+    if (ret != ESP_OK) {
+        return;     // 下一次仍然读取同一个寄存器
+    }
 
-void AS5600::set_custom_total_radian(float radian) {    // 设置相对的累计弧度，将当前总累计弧度作为新的偏移 (用户自定义
-    relative_offset_radian_ = total_accumulated_radian_ - radian;
+    if (diag_step_ == DiagStep::Status) {
+        magnet_health_.magnet_detected = buffer[0] & 0x20;
+        magnet_health_.too_weak = buffer[0] & 0x10;
+        magnet_health_.too_strong = buffer[0] & 0x08;
+        diag_step_ = DiagStep::AgcMagnitude;
+        _update_magnet_event();
+    } else {
+        magnet_health_.agc = buffer[0];
+        magnet_health_.magnitude = (((uint16_t) buffer[1] << 8) | buffer[2]) & 0x0FFF;
+        diag_step_ = DiagStep::Status;
+    }
+    magnet_health_.diag_reads++;
 }
 
-void AS5600::reset_custom_total_radian() {    // 重置相对的累计弧度，将当前总累计弧度作为新的偏移 (用户自定义
-    relative_offset_radian_ = total_accumulated_radian_;
+void AS5600::set_read_mode(AS5600ReadMode mode) {
+    read_mode_ = mode;
 }
 
-float AS5600::get_radian() const {
-    return previous_radian_;
+AS5600ReadStats AS5600::get_read_stats() const {
+    return read_stats_;
 }
 
-float AS5600::get_total_radian() const {
-    return total_accumulated_radian_;
+float AS5600ReadStats::bus_time_reduction() const {
+    uint32_t samples = full_reads + pointer_reads;
+    if (samples == 0) {
+        return 0;
+    }
+    uint64_t full_bits = uint64_t(samples) * ((3 + 2) * 9 + 3);   // 全部完整读取时的总线位数
+    return 1.0f - float(bus_bits) / float(full_bits);
 }
 
-float AS5600::get_custom_total_radian() const {
-    return total_accumulated_radian_ - relative_offset_radian_;
+AS5600MagnetHealth AS5600::get_magnet_health() const {
+    return magnet_health_;
 }
 
-float AS5600::get_velocity() const {
-    return velocity_;
+void AS5600::set_magnet_event_callback(void (*callback)(const AS5600MagnetHealth &, void *), void *arg) {
+    magnet_event_arg_ = arg;
+    magnet_event_callback_ = callback;
 }
 
-float AS5600::get_velocity_filter() const {
-    return velocity_filter_;
+void AS5600::_update_magnet_event() {
+    bool in_range = magnet_health_.field_in_range();
+    if (in_range == field_in_range_reported_) {
+        return;
+    }
+    field_in_range_reported_ = in_range;
+    if (magnet_event_callback_) {
+        magnet_event_callback_(magnet_health_, magnet_event_arg_);
+    }
 }
-
-
-
-
-
@@ -5,45 +5,88 @@
 #ifndef FOCKNOB_IIC_AS5600_H
 #define FOCKNOB_IIC_AS5600_H
 
-#include "iic_master.h"
+#include "iic_bus_arbiter.h"
 #include "esp_err.h"
+#include "motor_encoder.h"
+#include "project_conf.h"
+
+/*
+ * @brief 磁铁健康状态, 由控制周期的空闲时间读取 STATUS / AGC / MAGNITUDE 寄存器得到
+ */
+struct AS5600MagnetHealth {
+    bool magnet_detected;   // MD: 检测到磁铁
+    bool too_weak;          // ML: 磁场太弱 (AGC 已到最大增益)
+    bool too_strong;        // MH: 磁场太强 (AGC 已到最小增益)
+    uint8_t agc;            // 自动增益, 5V 供电范围 0~255, 3.3V 供电范围 0~128
+    uint16_t magnitude;     // CORDIC 幅值 (12 bit)
+    uint32_t diag_reads;    // 诊断读取成功次数
+    uint32_t diag_skips;    // 因为剩余时间不足而推迟的次数
+
+    [[nodiscard]] bool field_in_range() const { return magnet_detected && !too_weak && !too_strong; }
+};
 
-class AS5600 {
-public:
-    explicit AS5600(i2c_master_bus_handle_t bus_handle, uint8_t device_address);
+/*
+ * @brief 角度读取方式
+ *        AS5600 读取 RAW ANGLE 后地址指针保持在该寄存器, 所以连续读取时可以省掉 "写寄存器地址 + 重复起始"
+ */
+enum class AS5600ReadMode : uint8_t {
+    Full = 0,       // 写寄存器地址 + 重复起始 + 读 2 字节
+    PointerCached,  // 地址指针已经指向 RAW ANGLE 时只发读事务, 读 2 字节
+};
 
-    [[nodiscard]] float read_radian_from_sensor();    // 从传感器读取弧度(并更新累计的总弧度和转速)
+struct AS5600ReadStats {
+    uint32_t full_reads;        // 带寄存器地址写的读取次数
+    uint32_t pointer_reads;     // 只读 2 字节的次数
+    uint64_t bus_bits;          // 角度读取占用的总线位数
 
-    [[nodiscard]] float read_radian_from_sensor_with_no_update();  // 获取当前弧度(不做更新)
+    // 相对于每次都完整读取, 平均每个采样节省的总线时间比例 (0 ~ 1)
+    [[nodiscard]] float bus_time_reduction() const;
+};
 
-    [[nodiscard]] float get_radian() const;  // 获取当前弧度
+class AS5600 : public MotorEncoder<AS5600, IIC_AS5600_RESOLUTION> {
+public:
+    explicit AS5600(IICBusArbiter *arbiter, uint8_t device_address);
 
-    [[nodiscard]] float get_total_radian() const; // 获取累计的总角度
+    void service_idle_slot(int32_t budget_us);    // 在控制周期的空闲时隙做诊断寄存器读取, 不会延迟角度采样
 
-    [[nodiscard]] float get_velocity() const;  // 获取当前转速
+    [[nodiscard]] AS5600MagnetHealth get_magnet_health() const;    // 获取磁铁健康状态
 
-    [[nodiscard]] float get_velocity_filter() const;  // 获取低通滤波后的转速
+    void set_read_mode(AS5600ReadMode mode);   // 设置角度读取方式
 
-    [[nodiscard]] float get_custom_total_radian() const; // 获取相对于重置时的累计总角度(自定义角度)
+    [[nodiscard]] AS5600ReadStats get_read_stats() const;    // 获取角度读取的总线占用统计
 
-    void set_custom_total_radian(float radian); // 设置相对于重置时的累计总角度(自定义角度)
+    // 磁场进入/离开正常范围时回调 (在 FOC 任务中调用, 回调里不要做耗时操作)
+    void set_magnet_event_callback(void (*callback)(const AS5600MagnetHealth &health, void *arg), void *arg);
 
-    void reset_custom_total_radian(); // 重置累计总自定义角度
+private:
+    friend class MotorEncoder<AS5600, IIC_AS5600_RESOLUTION>;
 
+    enum class DiagStep {
+        Status,         // 读取 STATUS (1 字节)
+        AgcMagnitude,   // 读取 AGC + MAGNITUDE (3 字节)
+    };
 
-private:
-    i2c_master_dev_handle_t dev_handle_{};  // I2C设备句柄
+    static constexpr uint8_t pointer_unknown = 0xFF;
+
+    IICBusArbiter *arbiter_;
+    IICArbiterDevice *device_{};    // 控制优先级设备, 诊断读取时临时降为 Diagnostic
+
+    AS5600ReadMode read_mode_ = (AS5600ReadMode) IIC_AS5600_READ_MODE;
+    uint8_t pointer_reg_ = pointer_unknown;     // 芯片当前的地址指针
+    AS5600ReadStats read_stats_{};
 
-    float previous_radian_{};   // 上一次读取的角度
-    float total_accumulated_radian_{};  // 累计的总角度(从开机开始)
-    float relative_offset_radian_{};    // 重置时的累计弧度偏移
+    AS5600MagnetHealth magnet_health_{};
+    bool field_in_range_reported_ = true;   // 上一次回调时磁场是否正常
+    DiagStep diag_step_ = DiagStep::Status;
+    int diag_countdown_ = IIC_AS5600_DIAG_INTERVAL;
+    void (*magnet_event_callback_)(const AS5600MagnetHealth &health, void *arg) = nullptr;
+    void *magnet_event_arg_ = nullptr;
 
-    float velocity_{};   // 转速 (弧度/秒)
-    float velocity_filter_{}; // 转速低通滤波
+    EncoderReadStatus _read_raw(uint16_t &raw);   // 不打印日志, 错误由基类统计
 
-    uint16_t _location_read_raw();
+    esp_err_t _read_angle_registers(uint8_t reg, uint8_t *buffer, size_t len);    // 按需写地址指针后读取
 
-    esp_err_t _update_total_radian_and_velocity(float currentRadian);    // 更新累计的总弧度
+    void _update_magnet_event();
 };
 
 
@@ -0,0 +1,205 @@
+#include "iic_bus_arbiter.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <climits>
+#include <cstdint>
+
+static const char *TAG = "IICBusArbiter";
+
+IICBusArbiter::IICBusArbiter(IICMaster *iic_master, int32_t control_period_us)
+        : iic_master_(iic_master), control_period_us_(control_period_us) {
+    bus_mutex_ = xSemaphoreCreateMutex();
+    slot_end_sem_ = xSemaphoreCreateBinary();
+}
+
+IICArbiterDevice *IICBusArbiter::add_device(uint16_t device_address, IICPriority priority, int32_t deadline_us,
+                                            uint32_t scl_speed_hz) {
+    i2c_device_config_t dev_config = {
+            .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+            .device_address = device_address,
+            .scl_speed_hz = scl_speed_hz,
+    };
+    i2c_master_dev_handle_t handle{};
+    esp_err_t ret = i2c_master_bus_add_device(iic_master_->iic_master_get_bus_handle(), &dev_config, &handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to add I2C device 0x%02x: %s", device_address, esp_err_to_name(ret));
+        return nullptr;
+    }
+    return new IICArbiterDevice{handle, scl_speed_hz, priority, deadline_us};
+}
+
+esp_err_t IICBusArbiter::transmit_receive(IICArbiterDevice *device, const uint8_t *write, size_t write_len,
+                                          uint8_t *read, size_t read_len) {
+    return transmit_receive(device, device->priority, write, write_len, read, read_len);
+}
+
+esp_err_t IICBusArbiter::transmit_receive(IICArbiterDevice *device, IICPriority priority, const uint8_t *write,
+                                          size_t write_len, uint8_t *read, size_t read_len) {
+    switch (priority) {
+        case IICPriority::Control:
+            return _control(device, write, write_len, read, read_len);
+        case IICPriority::Diagnostic:
+            return _diagnostic(device, write, write_len, read, read_len);
+        default:
+            break;
+    }
+
+    // 后台长读取拆分成多个块, 块大小取拿到总线时剩余时隙能放下的字节数
+    // 第一个块带寄存器地址, 后续块只读 (依靠设备自动递增的地址指针, 见类说明)
+    int64_t deadline = esp_timer_get_time() + device->deadline_us;
+    size_t chunk = read_len;
+    esp_err_t ret = _background(device, write, write_len, read, chunk, deadline);
+    for (size_t offset = chunk; ret == ESP_OK && offset < read_len; offset += chunk) {   // 块与块之间为抢占点
+        chunk = read_len - offset;
+        ret = _background(device, nullptr, 0, read + offset, chunk, deadline);
+    }
+    return ret;
+}
+
+int32_t IICBusArbiter::get_remaining_us() const {
+    portENTER_CRITICAL(&spinlock_);
+    int64_t control_slot_us = control_slot_us_;
+    portEXIT_CRITICAL(&spinlock_);
+
+    int64_t since = esp_timer_get_time() - control_slot_us;
+    if (since < control_period_us_) {
+        return int32_t(control_period_us_ - since);
+    }
+    if (since < 2 * (int64_t) control_period_us_) {
+        return 0;   // 控制读取随时会来
+    }
+    return INT32_MAX;   // 控制环没有运行 (例如校准期间), 总线空闲
+}
+
+IICArbiterStats IICBusArbiter::get_stats() const {
+    portENTER_CRITICAL(&spinlock_);
+    IICArbiterStats stats = stats_;
+    portEXIT_CRITICAL(&spinlock_);
+    return stats;
+}
+
+int32_t IICBusArbiter::transaction_us(const IICArbiterDevice *device, size_t write_len, size_t read_len) {
+    // 每段传输 = 地址字节 + 数据, 每字节 9 位, 再加上起始/重复起始/停止位
+    size_t bytes = (write_len ? write_len + 1 : 0) + (read_len ? read_len + 1 : 0);
+    int64_t bits = int64_t(bytes) * 9 + 3;
+    return int32_t(bits * 1000000 / device->scl_speed_hz) + IIC_ARBITER_OVERHEAD_US;
+}
+
+
+// private
+esp_err_t IICBusArbiter::_control(IICArbiterDevice *device, const uint8_t *write, size_t write_len, uint8_t *read,
+                                  size_t read_len) {
+    int64_t start_us = esp_timer_get_time();
+    // 后台事务不会跨过控制时隙, 正常情况下总线是空闲的
+    // 不能用 tick 超时 (一个 tick 就是整整几个控制周期), 总线被占用时只忙等 IIC_ARBITER_CONTROL_SPIN_US, 超时放弃本周期
+    int64_t slot_us = start_us;
+    while (xSemaphoreTake(bus_mutex_, 0) != pdTRUE) {
+        slot_us = esp_timer_get_time();
+        if (slot_us - start_us > IIC_ARBITER_CONTROL_SPIN_US) {
+            portENTER_CRITICAL(&spinlock_);
+            stats_.deadline_misses[(int) IICPriority::Control]++;
+            portEXIT_CRITICAL(&spinlock_);
+            return ESP_ERR_TIMEOUT;
+        }
+    }
+    slot_us = esp_timer_get_time();
+    portENTER_CRITICAL(&spinlock_);
+    control_slot_us_ = slot_us;
+    if (slot_us - start_us > stats_.max_control_wait_us) {
+        stats_.max_control_wait_us = int32_t(slot_us - start_us);
+    }
+    portEXIT_CRITICAL(&spinlock_);
+
+    esp_err_t ret = _execute(device, write, write_len, read, read_len);
+
+    portENTER_CRITICAL(&spinlock_);
+    stats_.transactions[(int) IICPriority::Control]++;
+    if (esp_timer_get_time() - slot_us > device->deadline_us) {
+        stats_.deadline_misses[(int) IICPriority::Control]++;
+    }
+    portEXIT_CRITICAL(&spinlock_);
+
+    xSemaphoreGive(bus_mutex_);
+    xSemaphoreGive(slot_end_sem_);  // 控制读取结束, 这时到下一个时隙的空闲时间最长
+    return ret;
+}
+
+esp_err_t IICBusArbiter::_diagnostic(IICArbiterDevice *device, const uint8_t *write, size_t write_len,
+                                     uint8_t *read, size_t read_len) {
+    int32_t cost_us = transaction_us(device, write_len, read_len) + IIC_ARBITER_GUARD_US;
+    if (get_remaining_us() < cost_us || xSemaphoreTake(bus_mutex_, 0) != pdTRUE) {
+        portENTER_CRITICAL(&spinlock_);
+        stats_.deferrals[(int) IICPriority::Diagnostic]++;
+        portEXIT_CRITICAL(&spinlock_);
+        return ESP_ERR_NOT_FINISHED;
+    }
+
+    esp_err_t ret = _execute(device, write, write_len, read, read_len);
+
+    portENTER_CRITICAL(&spinlock_);
+    stats_.transactions[(int) IICPriority::Diagnostic]++;
+    portEXIT_CRITICAL(&spinlock_);
+    xSemaphoreGive(bus_mutex_);
+    return ret;
+}
+
+esp_err_t IICBusArbiter::_background(IICArbiterDevice *device, const uint8_t *write, size_t write_len,
+                                     uint8_t *read, size_t &read_len, int64_t deadline) {
+    size_t min_len = read_len ? 1 : 0;  // 至少读 1 字节, 纯写事务必须整个放得下
+    int32_t min_cost_us = transaction_us(device, write_len, min_len) + IIC_ARBITER_GUARD_US;
+    if (min_cost_us > control_period_us_) {
+        return ESP_ERR_INVALID_SIZE;    // 无论如何都放不进一个控制周期
+    }
+
+    while (true) {
+        if (get_remaining_us() >= min_cost_us && xSemaphoreTake(bus_mutex_, 0) == pdTRUE) {
+            int32_t remaining_us = get_remaining_us();  // 拿到锁之后再确认一次, 并按这时的剩余时间决定块大小
+            if (remaining_us >= min_cost_us) {
+                size_t fit_len = _fit_read_len(device, write_len, remaining_us - IIC_ARBITER_GUARD_US);
+                if (fit_len < read_len) {
+                    read_len = fit_len;
+                }
+                esp_err_t ret = _execute(device, write, write_len, read, read_len);
+                portENTER_CRITICAL(&spinlock_);
+                stats_.transactions[(int) IICPriority::Background]++;
+                portEXIT_CRITICAL(&spinlock_);
+                xSemaphoreGive(bus_mutex_);
+                return ret;
+            }
+            xSemaphoreGive(bus_mutex_);
+        }
+
+        if (esp_timer_get_time() >= deadline) {
+            portENTER_CRITICAL(&spinlock_);
+            stats_.deadline_misses[(int) IICPriority::Background]++;
+            portEXIT_CRITICAL(&spinlock_);
+            return ESP_ERR_NOT_FINISHED;
+        }
+        portENTER_CRITICAL(&spinlock_);
+        stats_.deferrals[(int) IICPriority::Background]++;
+        portEXIT_CRITICAL(&spinlock_);
+        xSemaphoreTake(slot_end_sem_, 1);   // 等待下一次控制读取结束
+    }
+}
+
+size_t IICBusArbiter::_fit_read_len(const IICArbiterDevice *device, size_t write_len, int32_t budget_us) {
+    // transaction_us 的反函数: budget_us 之内除了写入部分之外还能读多少字节
+    if (budget_us == INT32_MAX - IIC_ARBITER_GUARD_US) {
+        return SIZE_MAX;    // 控制环没有运行, 不用拆分
+    }
+    int64_t bits = (int64_t(budget_us) - IIC_ARBITER_OVERHEAD_US) * device->scl_speed_hz / 1000000 - 3;
+    int64_t bytes = bits / 9 - (write_len ? int64_t(write_len) + 1 : 0) - 1;   // 减去写入部分和读取的地址字节
+    return bytes > 1 ? size_t(bytes) : 1;
+}
+
+esp_err_t IICBusArbiter::_execute(IICArbiterDevice *device, const uint8_t *write, size_t write_len, uint8_t *read,
+                                  size_t read_len) {
+    int timeout_ms = (device->deadline_us + 999) / 1000;
+    if (write_len && read_len) {
+        return i2c_master_transmit_receive(device->handle, write, write_len, read, read_len, timeout_ms);
+    } else if (read_len) {
+        return i2c_master_receive(device->handle, read, read_len, timeout_ms);
+    } else {
+        return i2c_master_transmit(device->handle, write, write_len, timeout_ms);
+    }
+}
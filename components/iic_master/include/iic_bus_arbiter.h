@@ -0,0 +1,92 @@
+#ifndef FOCKNOB_IIC_BUS_ARBITER_H
+#define FOCKNOB_IIC_BUS_ARBITER_H
+
+#include "iic_master.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "project_conf.h"
+
+/*
+ * @brief 总线优先级
+ */
+enum class IICPriority : uint8_t {
+    Control = 0,    // 控制环读取 (FOC 任务), 每个控制周期保证一个时隙
+    Diagnostic,     // 控制读取之后的空闲时隙 (FOC 任务), 时间不够或者总线忙时直接放弃, 不等待
+    Background,     // 其他任务的普通读写, 只在到下一个控制时隙之前剩余时间足够时占用总线
+    Count,
+};
+
+struct IICArbiterDevice {
+    i2c_master_dev_handle_t handle;
+    uint32_t scl_speed_hz;
+    IICPriority priority;   // 默认优先级
+    int32_t deadline_us;    // 控制类: 单次事务超时; 后台类: 从提交到完成的最长时间
+};
+
+struct IICArbiterStats {
+    uint32_t transactions[(int) IICPriority::Count];     // 完成的事务数
+    uint32_t deferrals[(int) IICPriority::Count];        // 因为时隙不足而推迟 / 放弃的次数
+    uint32_t deadline_misses[(int) IICPriority::Count];  // 超过截止时间的次数
+    int32_t max_control_wait_us;                         // 控制读取等待总线的最长时间
+};
+
+/*
+ * @brief 共享 I2C 总线仲裁器, 在 IICMaster 之上按优先级分配总线时间
+ *
+ *        控制读取每个周期开始时直接占用总线, 它的开始时间就是时隙的锚点
+ *        后台事务只在 "估算事务时间 + 保护时间 <= 到下一个控制时隙的剩余时间" 时执行, 否则等到下一次控制读取结束
+ *        后台长读取按当前剩余时间拆分成能放进空闲时隙的块, 块与块之间是抢占点, 控制时隙不会被长事务挡住
+ *        注意: 只有第一个块带写入的寄存器地址, 后续块是单独的只读事务, 依靠设备读取时自动递增的地址指针接着读
+ *              (AS5600 / 常见的 EEPROM 和 IMU 都是这样), 不支持自动递增的设备要自己按块发送地址, 或者用诊断优先级
+ *        控制读取不会阻塞等待: 总线被占用时最多忙等 IIC_ARBITER_CONTROL_SPIN_US, 之后放弃本周期并记为 deadline miss
+ *
+ *        返回 ESP_ERR_NOT_FINISHED 表示没有拿到时隙 (事务没有发出)
+ */
+class IICBusArbiter {
+public:
+    IICBusArbiter(IICMaster *iic_master, int32_t control_period_us);
+
+    // 添加设备, deadline_us 的含义见 IICArbiterDevice
+    IICArbiterDevice *add_device(uint16_t device_address, IICPriority priority, int32_t deadline_us,
+                                 uint32_t scl_speed_hz = IIC_MASTER_FREQ_HZ);
+
+    // 写 write_len 字节后重复起始读 read_len 字节, 任意一个长度为 0 时只读或只写
+    esp_err_t transmit_receive(IICArbiterDevice *device, const uint8_t *write, size_t write_len,
+                               uint8_t *read, size_t read_len);
+
+    esp_err_t transmit_receive(IICArbiterDevice *device, IICPriority priority, const uint8_t *write,
+                               size_t write_len, uint8_t *read, size_t read_len);   // 指定本次事务的优先级
+
+    [[nodiscard]] int32_t get_remaining_us() const;  // 距离下一个控制时隙的剩余时间, 控制环没有运行时为 INT32_MAX
+
+    [[nodiscard]] IICArbiterStats get_stats() const;
+
+    static int32_t transaction_us(const IICArbiterDevice *device, size_t write_len, size_t read_len);  // 估算一次事务的时间
+
+private:
+    IICMaster *iic_master_;
+    int32_t control_period_us_;
+
+    SemaphoreHandle_t bus_mutex_;       // 总线互斥 (带优先级继承)
+    SemaphoreHandle_t slot_end_sem_;    // 控制读取结束时释放, 唤醒等待中的后台事务
+    mutable portMUX_TYPE spinlock_ = portMUX_INITIALIZER_UNLOCKED;
+    int64_t control_slot_us_ = 0;       // 最近一次控制时隙的开始时间
+    IICArbiterStats stats_{};
+
+    esp_err_t _control(IICArbiterDevice *device, const uint8_t *write, size_t write_len, uint8_t *read, size_t read_len);
+
+    esp_err_t _diagnostic(IICArbiterDevice *device, const uint8_t *write, size_t write_len, uint8_t *read,
+                          size_t read_len);
+
+    // read_len 传入最多读取的字节数, 返回时为这一块实际读取的字节数 (按当时剩余的时隙大小截断)
+    esp_err_t _background(IICArbiterDevice *device, const uint8_t *write, size_t write_len, uint8_t *read,
+                          size_t &read_len, int64_t deadline);
+
+    static size_t _fit_read_len(const IICArbiterDevice *device, size_t write_len, int32_t budget_us);
+
+    static esp_err_t _execute(IICArbiterDevice *device, const uint8_t *write, size_t write_len, uint8_t *read,
+                              size_t read_len);
+};
+
+
+#endif //FOCKNOB_IIC_BUS_ARBITER_H
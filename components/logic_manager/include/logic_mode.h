@@ -8,6 +8,7 @@
 
 #include "watch_dials.h"
 #include "motor_knob.h"
+#include "ballistic_mapper.h"
 
 /*
  * @brief 逻辑模式基类, 表示一种操作模式, 包括显示和电机控制的逻辑
@@ -96,12 +97,15 @@ public:
 
 private:
     float current_radian_ = 0;
-    float bound_range_ = M_PI_4;
+    float left_bound_ = -M_PI_4;    // 曲线库里有 "bounded" 时按它的 left_rad / right_rad
+    float right_bound_ = M_PI_4;
     int bound_range_display_ = 11;
 
     RotaryKnob *rotary_knob_;
     PhysicalDisplay *physical_display_;
     DisplayDemo *display_demo_{};
+
+    void _start_knob(bool reset_custom_pos);   // 优先使用曲线库里的同名曲线
 };
 
 /*
@@ -125,17 +129,20 @@ public:
 
 private:
     float current_radian_ = 0;
-    float bound_range_ = M_PI / 6.0f;
+    float left_bound_ = -M_PI / 6.0f;   // 曲线库里有 "switch" 时按它的 left_rad / right_rad
+    float right_bound_ = M_PI / 6.0f;
     int bound_range_display_ = 2;
 
     RotaryKnob *rotary_knob_;
     PhysicalDisplay *physical_display_;
     DisplayDemo *display_demo_{};
+
+    void _start_knob(bool reset_custom_pos);   // 优先使用曲线库里的同名曲线
 };
 
 
 /*
- * @brief 全局棘轮模式
+ * @brief 全局棘轮模式, 显示的数值按吸附点事件加速映射: 慢拧一格一步, 甩一下一格跳很多步
  */
 class AttractorMode : public LogicMode {
 public:
@@ -159,6 +166,46 @@ private:
     PhysicalDisplay *physical_display_;
     DisplayDemo *display_demo_{};
     int attr_number_ = 8;
+
+    float value_ = 0;
+    float accel_slow_ = 3.0f;       // 低于该转速 (rad/s) 一格一步
+    float accel_fast_ = 15.0f;      // 到该转速一格 accel_max_gain_ 步
+    float accel_max_gain_ = 20.0f;
+    BallisticMapper value_mapper_;
+    KnobEventReader events_;
+
+    void _start_knob(bool reset_custom_pos);   // 优先使用曲线库里的同名曲线
+};
+
+/*
+ * @brief 飞轮模式, 甩一下旋钮后按惯性继续转, 用来快速翻动长列表
+ */
+class FlywheelMode : public LogicMode {
+public:
+    FlywheelMode(RotaryKnob *knob, PhysicalDisplay *display);
+
+    ~FlywheelMode() override;
+
+    void init() override;
+
+    void destroy() override;
+
+    void update() override;
+
+    void stop_motor() override;
+
+    void resume_motor() override;
+
+private:
+    float current_radian_ = 0;
+    float inertia_ = 3.0f;          // 虚拟惯量, 约为旋钮本身的 5 倍
+    float coulomb_ = 20.0f;         // 库仑摩擦, 决定松手后能转多久
+    float viscous_ = 0.3f;
+    int items_per_turn_ = 24;       // 每圈翻过的列表项数
+
+    RotaryKnob *rotary_knob_;
+    PhysicalDisplay *physical_display_;
+    DisplayDemo *display_demo_{};
 };
 
 
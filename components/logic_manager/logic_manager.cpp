@@ -58,14 +58,8 @@ void LogicManager::set_next_mode() {
 
 
 void LogicManager::_on_press() const {
-    // 震动反馈
-    current_mode_->stop_motor(); // 按下按钮, 停止当前电机旋钮反馈( 模拟按键按下 )
-    foc_driver_->set_dq(0, PRESS_SHOCKPROOFNESS);
-    vTaskDelay(pdMS_TO_TICKS(1));
-    foc_driver_->set_dq(0, -PRESS_SHOCKPROOFNESS);
-    vTaskDelay(pdMS_TO_TICKS(1));
-    foc_driver_->set_free();
-    current_mode_->resume_motor(); // 启动旋钮电机反馈
+    // 震动反馈 (模拟按键按下): 在 FOC 周期里播放, 叠加在当前的旋钮手感上, 不阻塞逻辑任务
+    foc_driver_->play_effect(HapticEffect::Click, PRESS_SHOCKPROOFNESS);
 }
 
 void LogicManager::_on_release() {
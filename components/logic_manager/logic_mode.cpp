@@ -100,13 +100,18 @@ void BoundedMode::init() {
     display_demo_ = new DisplayDemo(physical_display_);
     display_demo_->init();
     display_demo_->set_secondary_info_text("Bounded Mode 0-10\nNo Damping");
-    display_demo_->create_clock_ticks_manual(-bound_range_, 15, lv_color_white());
-    display_demo_->create_clock_ticks_manual(bound_range_, 15, lv_color_white());
+    const HapticProfileRecord *record = rotary_knob_->find_profile("bounded");
+    if (record && record->right_rad > record->left_rad) {    // 曲线库里的边界不一定以 0 为中心
+        left_bound_ = record->left_rad;
+        right_bound_ = record->right_rad;
+    }
+    display_demo_->create_clock_ticks_manual(left_bound_, 15, lv_color_white());
+    display_demo_->create_clock_ticks_manual(right_bound_, 15, lv_color_white());
     if (current_radian_ == 0) {
-        rotary_knob_->damping_with_rebound(0, -bound_range_, bound_range_, true, 0);
-        display_demo_->set_pointer_radian(-bound_range_);
+        _start_knob(true);
+        display_demo_->set_pointer_radian(left_bound_);
     } else {
-        rotary_knob_->damping_with_rebound(0, -bound_range_, bound_range_, false, current_radian_);
+        _start_knob(false);
         display_demo_->set_pointer_radian(current_radian_);
     }
     display_demo_->show_pointer(true);
@@ -114,18 +119,18 @@ void BoundedMode::init() {
 
 void BoundedMode::update() {
     current_radian_ = rotary_knob_->get_current_radian();
-    if (current_radian_ < -bound_range_) {
-        display_demo_->set_pointer_radian(-bound_range_);
+    if (current_radian_ < left_bound_) {
+        display_demo_->set_pointer_radian(left_bound_);
         display_demo_->set_main_info_text(0);
-        display_demo_->set_pressure_feedback_arc(-bound_range_, current_radian_);
+        display_demo_->set_pressure_feedback_arc(left_bound_, current_radian_);
         display_demo_->set_background_board_percent(0);
-    } else if (current_radian_ > bound_range_) {
-        display_demo_->set_pointer_radian(bound_range_);
+    } else if (current_radian_ > right_bound_) {
+        display_demo_->set_pointer_radian(right_bound_);
         display_demo_->set_main_info_text(bound_range_display_ - 1);
-        display_demo_->set_pressure_feedback_arc(bound_range_, current_radian_);
+        display_demo_->set_pressure_feedback_arc(right_bound_, current_radian_);
         display_demo_->set_background_board_percent(100);
     } else {
-        float current_pointer = (current_radian_ + bound_range_) / (2 * bound_range_) * static_cast<float>(
+        float current_pointer = (current_radian_ - left_bound_) / (right_bound_ - left_bound_) * static_cast<float>(
                                     bound_range_display_ - 1);
         int rounded_value = static_cast<int>(std::round(current_pointer));
         display_demo_->set_pointer_radian(current_radian_);
@@ -140,7 +145,14 @@ void BoundedMode::stop_motor() {
 }
 
 void BoundedMode::resume_motor() {
-    rotary_knob_->damping_with_rebound(0, -bound_range_, bound_range_, false, current_radian_);
+    _start_knob(false);
+}
+
+void BoundedMode::_start_knob(bool reset_custom_pos) {
+    // 曲线库里有 "bounded" 就用它, 否则用内置参数
+    if (!rotary_knob_->profile("bounded", reset_custom_pos, current_radian_)) {
+        rotary_knob_->damping_with_rebound(0, left_bound_, right_bound_, reset_custom_pos, current_radian_);
+    }
 }
 
 void BoundedMode::destroy() {
@@ -165,13 +177,18 @@ void SwitchMode::init() {
     display_demo_ = new DisplayDemo(physical_display_);
     display_demo_->init();
     display_demo_->set_secondary_info_text("On/Off");
-    display_demo_->create_clock_ticks_manual(-bound_range_, 15, lv_color_white());
-    display_demo_->create_clock_ticks_manual(bound_range_, 15, lv_color_white());
+    const HapticProfileRecord *record = rotary_knob_->find_profile("switch");
+    if (record && record->right_rad > record->left_rad) {    // 曲线库里的边界不一定以 0 为中心
+        left_bound_ = record->left_rad;
+        right_bound_ = record->right_rad;
+    }
+    display_demo_->create_clock_ticks_manual(left_bound_, 15, lv_color_white());
+    display_demo_->create_clock_ticks_manual(right_bound_, 15, lv_color_white());
     if (current_radian_ == 0) {
-        rotary_knob_->attractor_with_rebound(2, -bound_range_, bound_range_, true, 0);
-        display_demo_->set_pointer_radian(-bound_range_);
+        _start_knob(true);
+        display_demo_->set_pointer_radian(left_bound_);
     } else {
-        rotary_knob_->attractor_with_rebound(2, -bound_range_, bound_range_, false, current_radian_);
+        _start_knob(false);
         display_demo_->set_pointer_radian(current_radian_);
     }
     display_demo_->show_pointer(true);
@@ -179,18 +196,18 @@ void SwitchMode::init() {
 
 void SwitchMode::update() {
     current_radian_ = rotary_knob_->get_current_radian();
-    if (current_radian_ < -(bound_range_ + 0.05)) {
-        display_demo_->set_pointer_radian(-bound_range_);
+    if (current_radian_ < left_bound_ - 0.05f) {
+        display_demo_->set_pointer_radian(left_bound_);
         display_demo_->set_main_info_text(0);
-        display_demo_->set_pressure_feedback_arc(-bound_range_, current_radian_);
+        display_demo_->set_pressure_feedback_arc(left_bound_, current_radian_);
         display_demo_->set_background_board_percent(0);
-    } else if (current_radian_ > (bound_range_ + 0.05)) {
-        display_demo_->set_pointer_radian(bound_range_);
+    } else if (current_radian_ > right_bound_ + 0.05f) {
+        display_demo_->set_pointer_radian(right_bound_);
         display_demo_->set_main_info_text(1);
-        display_demo_->set_pressure_feedback_arc(bound_range_, current_radian_);
+        display_demo_->set_pressure_feedback_arc(right_bound_, current_radian_);
         display_demo_->set_background_board_percent(100);
     } else {
-        float current_pointer = (current_radian_ + bound_range_) / (2 * bound_range_) * static_cast<float>(
+        float current_pointer = (current_radian_ - left_bound_) / (right_bound_ - left_bound_) * static_cast<float>(
                                     bound_range_display_ - 1);
         int rounded_value = static_cast<int>(std::round(current_pointer));
 
@@ -211,7 +228,13 @@ void SwitchMode::stop_motor() {
 }
 
 void SwitchMode::resume_motor() {
-    rotary_knob_->attractor_with_rebound(2, -bound_range_, bound_range_, false, current_radian_);
+    _start_knob(false);
+}
+
+void SwitchMode::_start_knob(bool reset_custom_pos) {
+    if (!rotary_knob_->profile("switch", reset_custom_pos, current_radian_)) {
+        rotary_knob_->attractor_with_rebound(2, left_bound_, right_bound_, reset_custom_pos, current_radian_);
+    }
 }
 
 void SwitchMode::destroy() {
@@ -226,6 +249,10 @@ void SwitchMode::destroy() {
 AttractorMode::AttractorMode(RotaryKnob *knob, PhysicalDisplay *display) {
     rotary_knob_ = knob;
     physical_display_ = display;
+    BallisticCurve curve;
+    curve.make_accelerating(accel_slow_, accel_fast_, accel_max_gain_, 2.0f);
+    value_mapper_.set_curve(curve);
+    value_mapper_.set_range(-999, 999, 1);
 }
 
 AttractorMode::~AttractorMode() {
@@ -236,22 +263,33 @@ void AttractorMode::init() {
     display_demo_ = new DisplayDemo(physical_display_);
     display_demo_->init();
     display_demo_->set_secondary_info_text("Attractor Mode");
+    const HapticProfileRecord *record = rotary_knob_->find_profile("attractor");
+    if (record && record->detent_count > 0) {
+        attr_number_ = record->detent_count;    // 刻度按曲线库里的吸附点个数画
+    }
     display_demo_->create_clock_ticks_auto(attr_number_, 15, lv_color_white());
     if (current_radian_ == 0) {
-        rotary_knob_->attractor(attr_number_, true, 0);
+        _start_knob(true);
         display_demo_->set_pointer_radian(0);
     } else {
-        rotary_knob_->attractor(attr_number_, false, current_radian_);
+        _start_knob(false);
         display_demo_->set_pointer_radian(current_radian_);
     }
     display_demo_->show_pointer(true);
+    value_mapper_.reset(value_);
+    rotary_knob_->subscribe_events(events_, false);
 }
 
 void AttractorMode::update() {
-    int attr_pos = rotary_knob_->attractor_get_pos();
+    KnobEvent event;
+    while (rotary_knob_->read_event(events_, event)) {
+        if (event.type == KnobEventType::DetentCrossed) {
+            value_ = value_mapper_.on_detent(event.direction, event.velocity);
+        }
+    }
     current_radian_ = rotary_knob_->get_current_radian();
 
-    display_demo_->set_main_info_text(attr_pos);
+    display_demo_->set_main_info_text(int(value_));
     display_demo_->set_pointer_radian(current_radian_);
 }
 
@@ -261,7 +299,13 @@ void AttractorMode::stop_motor() {
 }
 
 void AttractorMode::resume_motor() {
-    rotary_knob_->attractor(attr_number_, false, current_radian_);
+    _start_knob(false);
+}
+
+void AttractorMode::_start_knob(bool reset_custom_pos) {
+    if (!rotary_knob_->profile("attractor", reset_custom_pos, current_radian_)) {
+        rotary_knob_->attractor(attr_number_, reset_custom_pos, current_radian_);
+    }
 }
 
 void AttractorMode::destroy() {
@@ -271,3 +315,51 @@ void AttractorMode::destroy() {
         delete display_demo_;
     }
 }
+
+
+FlywheelMode::FlywheelMode(RotaryKnob *knob, PhysicalDisplay *display) {
+    rotary_knob_ = knob;
+    physical_display_ = display;
+}
+
+FlywheelMode::~FlywheelMode() {
+    this->FlywheelMode::destroy();
+}
+
+void FlywheelMode::init() {
+    display_demo_ = new DisplayDemo(physical_display_);
+    display_demo_->init();
+    display_demo_->set_secondary_info_text("Flywheel Mode");
+    if (current_radian_ == 0) {
+        rotary_knob_->flywheel(inertia_, coulomb_, viscous_, true, 0);
+    } else {
+        rotary_knob_->flywheel(inertia_, coulomb_, viscous_, false, current_radian_);
+    }
+    display_demo_->set_pointer_radian(current_radian_);
+    display_demo_->show_pointer(true);
+}
+
+void FlywheelMode::update() {
+    current_radian_ = rotary_knob_->get_current_radian();
+    // 列表位置跟着飞轮走, 松手后继续滚动
+    float item_distance = float(M_TWOPI) / float(items_per_turn_);
+    int item = static_cast<int>(std::floor(rotary_knob_->flywheel_get_pos() / item_distance));
+    display_demo_->set_pointer_radian(current_radian_);
+    display_demo_->set_main_info_text(item);
+}
+
+void FlywheelMode::stop_motor() {
+    rotary_knob_->stop();
+}
+
+void FlywheelMode::resume_motor() {
+    rotary_knob_->flywheel(inertia_, coulomb_, viscous_, false, current_radian_);
+}
+
+void FlywheelMode::destroy() {
+    rotary_knob_->stop();
+    if (display_demo_) {
+        display_demo_->destroy();
+        delete display_demo_;
+    }
+}
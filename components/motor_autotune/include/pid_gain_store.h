@@ -0,0 +1,24 @@
+#ifndef FOCKNOB_PID_GAIN_STORE_H
+#define FOCKNOB_PID_GAIN_STORE_H
+
+#include "esp_err.h"
+#include "relay_autotuner.h"
+
+/*
+ * @brief 整定后的 PID 参数保存在 NVS 中, 开机时读取
+ */
+class PidGainStore {
+public:
+    static esp_err_t save(const char *key, const PidGains &gains);
+
+    // 没有保存过时返回 ESP_ERR_NVS_NOT_FOUND, 保存的参数不是有限的非负数时返回 ESP_ERR_INVALID_STATE
+    static esp_err_t load(const char *key, PidGains *gains);
+
+private:
+    static constexpr const char *NVS_NAMESPACE = "pid_gains";
+
+    static bool _valid(float gain);
+};
+
+
+#endif //FOCKNOB_PID_GAIN_STORE_H
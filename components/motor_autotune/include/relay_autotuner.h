@@ -0,0 +1,73 @@
+#ifndef FOCKNOB_RELAY_AUTOTUNER_H
+#define FOCKNOB_RELAY_AUTOTUNER_H
+
+#include <cstdint>
+#include "motor_pid_controller.h"
+
+/*
+ * @brief 由临界增益和临界周期计算 PID 参数的规则
+ */
+enum class TuningRule {
+    ZieglerNichols,     // 经典 Z-N PID, 响应快, 超调较大
+    TyreusLuyben,       // Tyreus-Luyben PI, 鲁棒, 适合速度环
+    NoOvershoot,        // Z-N 无超调 PID
+    IntegratingPD,      // 积分对象 PD (无积分项), 适合速度环闭环后的位置外环
+};
+
+struct RelayAutotuneResult {
+    bool success;
+    float ultimate_gain;    // 临界增益 Ku
+    float ultimate_period;  // 临界周期 Pu (秒)
+    float amplitude;        // 误差振荡幅值
+};
+
+/*
+ * @brief 继电反馈自整定 (Åström–Hägglund)
+ *
+ *        每个控制周期调用一次 update(error), 返回继电器输出 ±amplitude (带滞环 hysteresis)
+ *        闭环进入极限环振荡后, 跳过前 settle_cycles 个周期, 再统计 measure_cycles 个周期的振幅 a 和周期 Pu
+ *        a 取误差的基波振幅 (按上一个周期的长度做傅里叶分解), 与描述函数一致, 也不会被测量噪声的尖峰撑大
+ *        Ku = 4d / (PI * sqrt(a² - ε²)), 纯算法, 不依赖硬件, 可以在主机上配合 KnobPlant 验证
+ */
+class RelayAutotuner {
+public:
+    RelayAutotuner(float amplitude, float hysteresis, float sample_period_s, int settle_cycles = 2,
+                   int measure_cycles = 4, float timeout_s = 5.0f);
+
+    float update(float error);   // 输入误差 (设定值 - 测量值), 返回继电器输出
+
+    [[nodiscard]] bool is_done() const { return done_; }
+
+    [[nodiscard]] RelayAutotuneResult get_result() const { return result_; }
+
+    [[nodiscard]] static PidGains compute_gains(const RelayAutotuneResult &result, TuningRule rule);
+
+private:
+    float amplitude_;
+    float hysteresis_;
+    float sample_period_s_;
+    int settle_cycles_;
+    int measure_cycles_;
+    uint32_t timeout_ticks_;
+
+    float output_ = 0;
+    uint32_t tick_ = 0;
+    uint32_t last_rising_tick_ = 0;     // 上一次输出从负切到正的时刻
+    int cycles_ = 0;                    // 已完成的完整振荡周期
+    float cycle_max_ = 0;               // 当前周期内误差的最大/最小值
+    float cycle_min_ = 0;
+    uint32_t period_ticks_ = 0;         // 上一个完整周期的长度, 0 表示还没有
+    float cycle_cos_ = 0;               // 当前周期内误差与基波 cos / sin 的相关和
+    float cycle_sin_ = 0;
+    float amplitude_sum_ = 0;
+    uint32_t period_sum_ticks_ = 0;
+    int measured_ = 0;
+
+    bool done_ = false;
+    RelayAutotuneResult result_{};
+
+    void _finish();
+};
+
+
+#endif //FOCKNOB_RELAY_AUTOTUNER_H
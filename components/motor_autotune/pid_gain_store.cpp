@@ -0,0 +1,47 @@
+#include "pid_gain_store.h"
+#include "nvs.h"
+#include "esp_log.h"
+#include <cmath>
+
+static const char *TAG = "PidGainStore";
+
+esp_err_t PidGainStore::save(const char *key, const PidGains &gains) {
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    ret = nvs_set_blob(handle, key, &gains, sizeof(gains));
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save gains '%s': %s", key, esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+esp_err_t PidGainStore::load(const char *key, PidGains *gains) {
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    size_t size = sizeof(*gains);
+    ret = nvs_get_blob(handle, key, gains, &size);
+    nvs_close(handle);
+    if (ret == ESP_OK && size != sizeof(*gains)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (ret == ESP_OK && !(_valid(gains->kp) && _valid(gains->ki) && _valid(gains->kd))) {
+        ESP_LOGW(TAG, "Ignoring invalid saved gains '%s'", key);
+        return ESP_ERR_INVALID_STATE;   // 损坏的数据不能进入控制环
+    }
+    return ret;
+}
+
+bool PidGainStore::_valid(float gain) {
+    return std::isfinite(gain) && gain >= 0;
+}
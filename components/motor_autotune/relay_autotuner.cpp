@@ -0,0 +1,99 @@
+#include "relay_autotuner.h"
+#include <cmath>
+
+RelayAutotuner::RelayAutotuner(float amplitude, float hysteresis, float sample_period_s, int settle_cycles,
+                               int measure_cycles, float timeout_s)
+        : amplitude_(amplitude), hysteresis_(hysteresis), sample_period_s_(sample_period_s),
+          settle_cycles_(settle_cycles), measure_cycles_(measure_cycles),
+          timeout_ticks_(uint32_t(timeout_s / sample_period_s)) {
+    output_ = amplitude_;
+}
+
+float RelayAutotuner::update(float error) {
+    if (done_) {
+        return 0;
+    }
+    tick_++;
+    cycle_max_ = fmaxf(cycle_max_, error);
+    cycle_min_ = fminf(cycle_min_, error);
+    if (period_ticks_ > 0) {    // 按上一个周期的长度对误差做傅里叶分解, 取基波
+        float phase = 2.0f * float(M_PI) * float(tick_ - last_rising_tick_) / float(period_ticks_);
+        cycle_cos_ += error * cosf(phase);
+        cycle_sin_ += error * sinf(phase);
+    }
+
+    if (output_ < 0 && error > hysteresis_) {   // 负 -> 正, 一个完整周期结束
+        output_ = amplitude_;
+        if (last_rising_tick_ != 0) {
+            cycles_++;
+            uint32_t period = tick_ - last_rising_tick_;
+            if (cycles_ > settle_cycles_) {
+                // 描述函数对应的是基波振幅; 峰峰值会被测量噪声撑大, 只在还没有周期估计时退而求其次
+                amplitude_sum_ += period_ticks_ > 0 ? 2.0f * hypotf(cycle_cos_, cycle_sin_) / float(period)
+                                                    : (cycle_max_ - cycle_min_) / 2;
+                period_sum_ticks_ += period;
+                measured_++;
+            }
+            period_ticks_ = period;
+        }
+        last_rising_tick_ = tick_;
+        cycle_max_ = error;
+        cycle_min_ = error;
+        cycle_cos_ = error;     // 本周期的第 0 个采样, 相位为 0
+        cycle_sin_ = 0;
+        if (measured_ >= measure_cycles_) {
+            _finish();
+            return 0;
+        }
+    } else if (output_ > 0 && error < -hysteresis_) {
+        output_ = -amplitude_;
+    }
+
+    if (tick_ >= timeout_ticks_) {
+        _finish();
+        return 0;
+    }
+    return output_;
+}
+
+PidGains RelayAutotuner::compute_gains(const RelayAutotuneResult &result, TuningRule rule) {
+    float ku = result.ultimate_gain;
+    float pu = result.ultimate_period;
+    float kp, ti, td;
+    switch (rule) {
+        case TuningRule::ZieglerNichols:
+            kp = 0.6f * ku;
+            ti = 0.5f * pu;
+            td = 0.125f * pu;
+            break;
+        case TuningRule::TyreusLuyben:
+            kp = ku / 3.2f;
+            ti = 2.2f * pu;
+            td = 0;
+            break;
+        case TuningRule::IntegratingPD:   // 对象本身带积分, 外环不需要积分项
+            return {0.2f * ku, 0, 0.2f * ku * pu / 3.0f};
+        case TuningRule::NoOvershoot:
+        default:
+            kp = 0.2f * ku;
+            ti = 0.5f * pu;
+            td = pu / 3.0f;
+            break;
+    }
+    return {kp, kp / ti, kp * td};
+}
+
+
+// private
+void RelayAutotuner::_finish() {
+    done_ = true;
+    result_.success = measured_ >= measure_cycles_;
+    if (!result_.success) {
+        return;
+    }
+    float a = amplitude_sum_ / float(measured_);
+    float a2 = a * a - hysteresis_ * hysteresis_;
+    result_.amplitude = a;
+    result_.ultimate_period = float(period_sum_ticks_) / float(measured_) * sample_period_s_;
+    result_.ultimate_gain = 4.0f * amplitude_ / (float(M_PI) * sqrtf(a2 > 0 ? a2 : a * a));
+}
@@ -0,0 +1,52 @@
+#ifndef FOCKNOB_ENCODER_POSITION_H
+#define FOCKNOB_ENCODER_POSITION_H
+
+#include <cmath>
+#include <cstdint>
+
+#ifndef M_TWOPI     // newlib 提供 M_TWOPI, 主机上的 libc 不一定有
+#define M_TWOPI (M_PI * 2.0)
+#endif
+
+/*
+ * @brief 多圈位置, Q32.32 定点数: 高 32 位为圈数, 低 32 位为圈内角度 (一圈 = 2^32)
+ *
+ *        圈内角度的差值直接按 int32 相减就是 [-PI, PI) 内的最短路径, 展开(unwrap)是精确的
+ *        累计和偏移都是整数运算, 不管转了多少圈精度都不变, 只在接口处转换成 float
+ */
+typedef int64_t encoder_position_t;
+typedef uint32_t encoder_angle_t;   // 圈内角度, 一圈 = 2^32
+
+#define ENCODER_POSITION_ONE_TURN       (((encoder_position_t) 1) << 32)
+#define ENCODER_RADIAN_PER_LSB          (float(M_TWOPI) / 4294967296.0f)
+#define ENCODER_LSB_PER_RADIAN          (4294967296.0f / float(M_TWOPI))
+
+inline int32_t encoder_position_turns(encoder_position_t position) {    // 圈数 (向负无穷取整)
+    return int32_t(position >> 32);
+}
+
+inline encoder_angle_t encoder_position_angle(encoder_position_t position) {   // 圈内角度
+    return encoder_angle_t(position);
+}
+
+inline int32_t encoder_angle_delta(encoder_angle_t to, encoder_angle_t from) {    // 最短路径角度差, 范围 [-PI, PI)
+    return int32_t(to - from);
+}
+
+inline float encoder_angle_to_radian(encoder_angle_t angle) {     // 圈内角度转弧度, 范围 [0, 2PI)
+    return float(angle) * ENCODER_RADIAN_PER_LSB;
+}
+
+inline float encoder_position_to_radian(encoder_position_t position) {     // 多圈位置转弧度, 只在接口处使用
+    return float(encoder_position_turns(position)) * float(M_TWOPI) +
+           encoder_angle_to_radian(encoder_position_angle(position));
+}
+
+inline encoder_position_t encoder_position_from_radian(float radian) {
+    float turns = floorf(radian / float(M_TWOPI));
+    float angle = radian - turns * float(M_TWOPI);
+    auto angle_lsb = (int64_t) (angle * ENCODER_LSB_PER_RADIAN);
+    return (encoder_position_t) turns * ENCODER_POSITION_ONE_TURN + angle_lsb;
+}
+
+#endif //FOCKNOB_ENCODER_POSITION_H
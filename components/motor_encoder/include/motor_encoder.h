@@ -0,0 +1,321 @@
+#ifndef FOCKNOB_MOTOR_ENCODER_H
+#define FOCKNOB_MOTOR_ENCODER_H
+
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include "encoder_position.h"
+#include "project_conf.h"
+
+enum class EncoderReadStatus : uint8_t {
+    Ok,         // 读取成功
+    Error,      // 总线错误 / 校验失败
+    Timeout,    // 总线超时
+};
+
+struct EncoderStats {   // get_stats() 返回的快照
+    uint32_t samples;           // 总采样次数
+    uint32_t errors;            // 总线错误次数
+    uint32_t timeouts;          // 总线超时次数
+    uint32_t glitches;          // 被拒绝的跳变次数
+    uint32_t resyncs;           // 长时间无效后重新同步的次数
+    uint32_t consecutive_bad;   // 当前连续无效的采样数
+};
+
+/*
+ * @brief 磁编码器公共基类 (CRTP, 静态分发, 控制环热路径中没有虚函数调用)
+ *
+ *        派生类需要提供:
+ *          EncoderReadStatus _read_raw(uint16_t &raw);   // 读取一次原始角度, 范围 [0, Resolution)
+ *        并将 MotorEncoder<Derived, Resolution> 声明为友元
+ *        可选: void service_idle_slot(int32_t budget_us);     // 利用控制周期的空闲时间做诊断读取
+ *
+ *        累计角度、转速、自定义零点等逻辑全部放在基类, 不同的编码器只负责总线读取
+ *        读取失败或者出现物理上不可能的跳变时, 按上次的转速外推角度, 转速保持不变, 不会产生力矩尖峰
+ *        错误统计由 FOC 任务累加, 可以在其它任务里 get_stats() / reset_stats(); 每个计数各自是原子的,
+ *        快照里的几个计数之间不保证是同一时刻的
+ *
+ *        多任务访问: 只有 FOC 任务调用 read_radian_from_sensor(), 累计位置 / 零点 / 转速只由它修改.
+ *        每次采样后发布一份快照 (两份副本的 seqlock, 写到一半被抢占也不会让读者卡住),
+ *        get_* 在任何任务里读到的位置、零点、转速都是同一次采样的, 64 位定点数不会被撕开.
+ *        修改自定义零点只是提交请求, 由 FOC 任务在下一次采样时生效; 同一时间只能有一个任务提交
+ */
+template<typename Derived, uint32_t Resolution>
+class MotorEncoder {
+    static_assert(std::has_single_bit(Resolution) && Resolution <= 65536, "Resolution must be a power of two");
+
+public:
+    static constexpr uint32_t resolution = Resolution;  // 每圈的刻度数
+
+    [[nodiscard]] float read_radian_from_sensor() {    // 从传感器读取弧度(并更新累计的总弧度和转速), 只在 FOC 任务里调用
+        _consume_offset_request();
+        _sample();
+        _publish();
+        return encoder_angle_to_radian(encoder_position_angle(position_));
+    }
+
+    [[nodiscard]] float read_radian_from_sensor_with_no_update() {  // 获取当前弧度(不做更新), 读取失败时返回上一次的弧度
+        uint16_t raw = 0;
+        if (_derived()->_read_raw(raw) != EncoderReadStatus::Ok) {
+            return get_radian();
+        }
+        return encoder_angle_to_radian(_raw_to_angle(raw));
+    }
+
+    [[nodiscard]] float get_radian() const {   // 获取当前弧度
+        return encoder_angle_to_radian(encoder_position_angle(get_position()));
+    }
+
+    [[nodiscard]] float get_total_radian() const { return encoder_position_to_radian(get_position()); } // 获取累计的总角度
+
+    [[nodiscard]] float get_velocity() const { return _snapshot().velocity; }  // 获取当前转速
+
+    [[nodiscard]] float get_velocity_filter() const { return _snapshot().velocity_filter; }  // 获取低通滤波后的转速
+
+    [[nodiscard]] float get_custom_total_radian() const {  // 获取相对于重置时的累计总角度(自定义角度)
+        return encoder_position_to_radian(get_custom_position());
+    }
+
+    [[nodiscard]] encoder_position_t get_position() const { return _snapshot().position; }   // 累计位置(定点数, 从开机开始)
+
+    [[nodiscard]] encoder_position_t get_custom_position() const {  // 相对于自定义零点的位置(定点数)
+        Snapshot snapshot = _snapshot();
+        return snapshot.position - snapshot.offset;
+    }
+
+    [[nodiscard]] encoder_position_t get_custom_offset() const { return _snapshot().offset; }   // 已生效的自定义零点的累计位置(定点数)
+
+    [[nodiscard]] bool is_sample_valid() const { return sample_valid_; }  // 最近一次采样是否为真实读数(否则为外推值), FOC 任务用
+
+    [[nodiscard]] EncoderStats get_stats() const {  // 获取错误统计
+        return {
+                .samples = stats_.samples.load(std::memory_order_relaxed),
+                .errors = stats_.errors.load(std::memory_order_relaxed),
+                .timeouts = stats_.timeouts.load(std::memory_order_relaxed),
+                .glitches = stats_.glitches.load(std::memory_order_relaxed),
+                .resyncs = stats_.resyncs.load(std::memory_order_relaxed),
+                .consecutive_bad = stats_.consecutive_bad.load(std::memory_order_relaxed),
+        };
+    }
+
+    void reset_stats() {    // 清零累计的计数, 当前连续无效的采样数不变
+        stats_.samples.store(0, std::memory_order_relaxed);
+        stats_.errors.store(0, std::memory_order_relaxed);
+        stats_.timeouts.store(0, std::memory_order_relaxed);
+        stats_.glitches.store(0, std::memory_order_relaxed);
+        stats_.resyncs.store(0, std::memory_order_relaxed);
+    }
+
+    // 控制读取完成后由 FOC 任务调用, budget_us 为距离下一次角度采样的剩余时间
+    // 派生类可以同名覆盖, 在这段空闲时间里做低优先级的总线读取, 默认什么都不做
+    void service_idle_slot(int32_t /*budget_us*/) {}
+
+    // 设置相对的累计弧度: 以最近一次采样的位置为 radian 计算新的零点, 下一次采样时生效 (用户自定义)
+    // 返回新零点的累计位置, 调用方不用等生效就可以用它换算
+    encoder_position_t set_custom_total_radian(float radian) {
+        return _request_offset(get_position() - encoder_position_from_radian(radian));
+    }
+
+    encoder_position_t reset_custom_total_radian() {     // 以最近一次采样的位置为新的零点, 下一次采样时生效 (用户自定义)
+        return _request_offset(get_position());
+    }
+
+protected:
+    MotorEncoder() = default;
+
+private:
+    friend struct EncoderOffsetProbe;   // 主机上的并发压力测试 (tools/lockfree_stress) 直接提交零点
+
+    struct Snapshot {
+        encoder_position_t position;
+        encoder_position_t offset;
+        float velocity;
+        float velocity_filter;
+    };
+
+    struct SnapshotCopy {   // 每个字段拆成 32 位原子量, Xtensa 上 64 位原子量要加锁
+        std::atomic<uint32_t> position_low{0};
+        std::atomic<uint32_t> position_high{0};
+        std::atomic<uint32_t> offset_low{0};
+        std::atomic<uint32_t> offset_high{0};
+        std::atomic<float> velocity{0};
+        std::atomic<float> velocity_filter{0};
+    };
+
+    static constexpr float Ts = FOC_CALC_PERIOD * 1e-6f; // 单位: 秒
+    static constexpr int raw_shift = 32 - std::countr_zero(Resolution);   // 原始刻度转为一圈 2^32 的定点角度
+    static constexpr int64_t max_delta_lsb = int64_t(ENCODER_MAX_VELOCITY_RAD_S * Ts * ENCODER_LSB_PER_RADIAN);  // 相对预测值允许的最大跳变
+
+    // 以下只有 FOC 任务读写
+    encoder_position_t position_{};         // 累计位置(从开机开始)
+    encoder_position_t offset_position_{};  // 重置时的累计位置偏移
+
+    float velocity_{};   // 转速 (弧度/秒)
+    float velocity_filter_{}; // 转速低通滤波
+
+    bool has_sample_ = false;
+    bool sample_valid_ = false;
+    uint32_t consecutive_bad_ = 0;  // 当前连续无效的采样数, FOC 任务自己用
+
+    // 发布给其它任务的快照: 序号为偶数时读 copies_[0], 奇数时读 copies_[1], FOC 任务总是在改另一份
+    std::atomic<uint32_t> snapshot_sequence_{0};
+    SnapshotCopy copies_[2];
+
+    // 其它任务提交的新零点, FOC 任务在采样前取走
+    std::atomic<uint32_t> requested_offset_low_{0};
+    std::atomic<uint32_t> requested_offset_high_{0};
+    std::atomic<uint32_t> offset_request_{0};   // 每次提交加 1
+    uint32_t offset_handled_ = 0;
+
+    struct StatCounters {   // FOC 任务用 fetch_add 累加, 其它任务清零时不会丢掉或者覆盖正在进行的累加
+        std::atomic<uint32_t> samples{0};
+        std::atomic<uint32_t> errors{0};
+        std::atomic<uint32_t> timeouts{0};
+        std::atomic<uint32_t> glitches{0};
+        std::atomic<uint32_t> resyncs{0};
+        std::atomic<uint32_t> consecutive_bad{0};   // consecutive_bad_ 的副本, 给其它任务读
+    };
+    StatCounters stats_;
+
+    Derived *_derived() { return static_cast<Derived *>(this); }
+
+    static void _count(std::atomic<uint32_t> &counter) { counter.fetch_add(1, std::memory_order_relaxed); }
+
+    void _set_consecutive_bad(uint32_t count) {
+        consecutive_bad_ = count;
+        stats_.consecutive_bad.store(count, std::memory_order_relaxed);
+    }
+
+    static encoder_angle_t _raw_to_angle(uint16_t raw) {
+        return encoder_angle_t(raw) << raw_shift;
+    }
+
+    void _sample() {    // 读取一次原始角度, 更新累计位置和转速
+        uint16_t raw = 0;
+        EncoderReadStatus status = _derived()->_read_raw(raw);
+        _count(stats_.samples);
+
+        if (status == EncoderReadStatus::Ok) {
+            encoder_angle_t current_angle = _raw_to_angle(raw);
+            int32_t delta = encoder_angle_delta(current_angle, encoder_position_angle(position_));
+            if (!has_sample_) {     // 第一次采样, 没有可参考的历史
+                has_sample_ = true;
+                _accept(delta, false);
+                return;
+            }
+            if (std::abs(int64_t(delta) - _predicted_delta()) <= max_delta_lsb) {
+                _accept(delta, true);
+                return;
+            }
+            if (consecutive_bad_ >= ENCODER_RESYNC_SAMPLES) {   // 无效太久, 外推已经不可信, 直接接受新读数
+                _count(stats_.resyncs);
+                _accept(delta, false);
+                return;
+            }
+            _count(stats_.glitches);
+        } else if (status == EncoderReadStatus::Timeout) {
+            _count(stats_.timeouts);
+        } else {
+            _count(stats_.errors);
+        }
+
+        _hold_last_good();
+    }
+
+
+    void _publish() {   // 发布本次采样的快照: 先改读者不在读的那份, 换过去以后再改另一份
+        uint32_t sequence = snapshot_sequence_.load(std::memory_order_relaxed);
+        snapshot_sequence_.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        _write_copy(copies_[sequence & 1]);             // 读者现在读 copies_[(sequence + 1) & 1]
+        snapshot_sequence_.store(sequence + 2, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_release);
+        _write_copy(copies_[(sequence + 1) & 1]);       // 读者现在读刚写好的 copies_[sequence & 1]
+    }
+
+    void _write_copy(SnapshotCopy &copy) const {
+        copy.position_low.store(uint32_t(position_), std::memory_order_relaxed);
+        copy.position_high.store(uint32_t(uint64_t(position_) >> 32), std::memory_order_relaxed);
+        copy.offset_low.store(uint32_t(offset_position_), std::memory_order_relaxed);
+        copy.offset_high.store(uint32_t(uint64_t(offset_position_) >> 32), std::memory_order_relaxed);
+        copy.velocity.store(velocity_, std::memory_order_relaxed);
+        copy.velocity_filter.store(velocity_filter_, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] Snapshot _snapshot() const {
+        while (true) {
+            uint32_t sequence = snapshot_sequence_.load(std::memory_order_acquire);
+            const SnapshotCopy &copy = copies_[sequence & 1];
+            Snapshot snapshot{
+                    .position = encoder_position_t(uint64_t(copy.position_high.load(std::memory_order_relaxed)) << 32 |
+                                                   copy.position_low.load(std::memory_order_relaxed)),
+                    .offset = encoder_position_t(uint64_t(copy.offset_high.load(std::memory_order_relaxed)) << 32 |
+                                                 copy.offset_low.load(std::memory_order_relaxed)),
+                    .velocity = copy.velocity.load(std::memory_order_relaxed),
+                    .velocity_filter = copy.velocity_filter.load(std::memory_order_relaxed),
+            };
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (snapshot_sequence_.load(std::memory_order_relaxed) == sequence) {
+                return snapshot;    // 读的过程中 FOC 任务没有换过副本, 这一份是完整的
+            }
+        }
+    }
+
+    encoder_position_t _request_offset(encoder_position_t offset) {
+        requested_offset_low_.store(uint32_t(offset), std::memory_order_relaxed);
+        requested_offset_high_.store(uint32_t(uint64_t(offset) >> 32), std::memory_order_relaxed);
+        offset_request_.fetch_add(1, std::memory_order_release);
+        return offset;
+    }
+
+    void _consume_offset_request() {
+        uint32_t request = offset_request_.load(std::memory_order_acquire);
+        if (request == offset_handled_) {
+            return;
+        }
+        encoder_position_t offset = encoder_position_t(
+                uint64_t(requested_offset_high_.load(std::memory_order_relaxed)) << 32 |
+                requested_offset_low_.load(std::memory_order_relaxed));
+        if (offset_request_.load(std::memory_order_acquire) != request) {
+            return;     // 读的时候又提交了新零点, 高低两半可能不是同一次的, 下次采样再处理
+        }
+        offset_handled_ = request;
+        offset_position_ = offset;
+    }
+
+    [[nodiscard]] int64_t _predicted_delta() const {    // 按滤波后的转速预测一个周期内的角度变化
+        return int64_t(velocity_filter_ * Ts * ENCODER_LSB_PER_RADIAN);
+    }
+
+    // 接受一个有效读数, update_velocity 为 false 时 (首次采样 / 重新同步) 不根据跳变计算转速
+    void _accept(int32_t delta, bool update_velocity) {
+        position_ += delta;
+        sample_valid_ = true;
+        _set_consecutive_bad(0);
+
+        if (!update_velocity) {
+            velocity_ = velocity_filter_;
+            return;
+        }
+
+        // 更新速度
+        velocity_ = float(delta) * (ENCODER_RADIAN_PER_LSB / Ts);
+
+        // 低通滤波
+        float alpha = FOC_LOW_PASS_FILTER_ALPHA;
+        velocity_filter_ = alpha * velocity_ + (1 - alpha) * velocity_filter_;   // 一阶低通滤波
+    }
+
+    // 丢弃本次采样: 短时间内按滤波后的转速外推, 超过外推次数后保持不动
+    void _hold_last_good() {
+        sample_valid_ = false;
+        _set_consecutive_bad(consecutive_bad_ + 1);
+        if (consecutive_bad_ > ENCODER_EXTRAPOLATE_SAMPLES) {
+            return;
+        }
+        position_ += _predicted_delta();
+    }
+};
+
+#endif //FOCKNOB_MOTOR_ENCODER_H
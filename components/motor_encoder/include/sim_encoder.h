@@ -0,0 +1,51 @@
+#ifndef FOCKNOB_SIM_ENCODER_H
+#define FOCKNOB_SIM_ENCODER_H
+
+#include "motor_encoder.h"
+
+/*
+ * @brief 仿真编码器, 不依赖任何硬件, 可以在主机上配合电机模型使用
+ *        由仿真模型调用 set_mechanical_radian() 写入真实机械角度, 读取时按 AS5600 同样的分辨率量化
+ */
+class SimEncoder : public MotorEncoder<SimEncoder, IIC_AS5600_RESOLUTION> {
+public:
+    SimEncoder() = default;
+
+    void set_mechanical_radian(float radian) {   // 设置转子真实机械角度(可以是累计角度)
+        float a = fmodf(radian, float(M_TWOPI));
+        true_radian_ = a >= 0 ? a : a + float(M_TWOPI);
+    }
+
+    [[nodiscard]] float get_mechanical_radian() const { return true_radian_; }
+
+    void inject_fault(EncoderReadStatus status, int samples) {   // 接下来 samples 次读取返回 status
+        fault_status_ = status;
+        fault_samples_ = samples;
+    }
+
+    void inject_glitch(int32_t raw_offset) {   // 下一次读取的原始值叠加 raw_offset (模拟总线位翻转)
+        glitch_raw_offset_ = raw_offset;
+    }
+
+private:
+    friend class MotorEncoder<SimEncoder, IIC_AS5600_RESOLUTION>;
+
+    float true_radian_ = 0;
+    EncoderReadStatus fault_status_ = EncoderReadStatus::Ok;
+    int fault_samples_ = 0;
+    int32_t glitch_raw_offset_ = 0;
+
+    EncoderReadStatus _read_raw(uint16_t &raw) {
+        if (fault_samples_ > 0) {
+            fault_samples_--;
+            return fault_status_;
+        }
+        auto value = int32_t(true_radian_ / float(M_TWOPI) * float(resolution)) + glitch_raw_offset_;
+        glitch_raw_offset_ = 0;
+        raw = uint16_t(((value % int32_t(resolution)) + int32_t(resolution)) % int32_t(resolution));
+        return EncoderReadStatus::Ok;
+    }
+};
+
+
+#endif //FOCKNOB_SIM_ENCODER_H
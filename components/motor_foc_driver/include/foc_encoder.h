@@ -0,0 +1,23 @@
+#ifndef FOCKNOB_FOC_ENCODER_H
+#define FOCKNOB_FOC_ENCODER_H
+
+#include "project_conf.h"
+
+/*
+ * @brief 控制栈使用的编码器类型, 由 project_conf.h 中的 FOC_ENCODER_TYPE 在编译期选择
+ *        所有编码器都继承 MotorEncoder<>, 接口一致, 调用是静态分发的
+ */
+#if FOC_ENCODER_TYPE == FOC_ENCODER_AS5600
+#include "iic_as5600.h"
+using FocEncoder = AS5600;
+#elif FOC_ENCODER_TYPE == FOC_ENCODER_SPI
+#include "spi_encoder.h"
+using FocEncoder = SpiEncoder;
+#elif FOC_ENCODER_TYPE == FOC_ENCODER_SIM
+#include "sim_encoder.h"
+using FocEncoder = SimEncoder;
+#else
+#error Unsupported FOC_ENCODER_TYPE
+#endif
+
+#endif //FOCKNOB_FOC_ENCODER_H
@@ -5,21 +5,35 @@
 #ifndef FOCKNOB_MOTOR_FOC_DRIVER_H
 #define FOCKNOB_MOTOR_FOC_DRIVER_H
 
-#include "iic_as5600.h"
+#include "foc_encoder.h"
 #include "esp_foc.h"
 #include "esp_svpwm.h"
 #include <esp_timer.h>
 #include "motor_pid_controller.h"
+#include "motor_cascade_controller.h"
+#include "relay_autotuner.h"
+#include "scurve_trajectory.h"
+#include "disturbance_observer.h"
+#include "kalman_estimator.h"
+#include "sysid_excitation.h"
+#include "sysid_recorder.h"
+#include "waveform_player.h"
+#include <atomic>
 #include "freertos/FreeRTOS.h"
 
 
+enum class AutotuneLoop {
+    Velocity,   // 继电器直接输出 Uq, 振荡转速
+    Position,   // 继电器输出目标转速给已整定的速度环, 振荡位置
+};
+
 class FocDriver {
 public:
     FocDriver(gpio_num_t u_gpio,
               gpio_num_t v_gpio,
               gpio_num_t w_gpio,
               gpio_num_t en_gpio,
-              AS5600 *as5600,
+              FocEncoder *encoder,
               int pole_pairs
     );
 
@@ -29,8 +43,46 @@ public:
     void set_free();    // 设置空闲状态
     void set_dq(float Ud, float Uq);    // 设置DQ坐标 (力矩控制)
     void set_velocity(float speed_rad_s, PIDController *pid_velocity);    // 设置速度(弧度/秒)
-    void set_abs_position(float position_rad, PIDController *pid_position, PIDController *pid_position_v);    // 设置绝对位置(弧度)
-    void set_rel_position(float position_rad, PIDController *pid_position, PIDController *pid_position_v);    // 设置相对位置(弧度)
+    // 设置绝对位置(弧度) / 相对位置(弧度), 按 S 曲线轨迹平滑运动过去, 运动中再次调用会从当前参考点重新规划
+    // pid_position 为位置外环 (位置误差 → 速度), pid_velocity 为速度内环 (速度误差 → Uq)
+    // 只提交目标, 轨迹由控制任务在下一个周期开始时规划, 同一个周期里多次调用以最后一次为准
+    void set_abs_position(float position_rad, PIDController *pid_position, PIDController *pid_velocity);
+    void set_rel_position(float position_rad, PIDController *pid_position, PIDController *pid_velocity);
+    void set_trajectory_limits(float max_velocity, float max_acceleration, float max_jerk);   // 可以在其他任务里调用, 下一次规划生效
+    [[nodiscard]] bool is_trajectory_finished() const;    // 位置指令的轨迹是否已经走完
+
+    // 摩擦/扰动补偿: 闭环模式抵消观测到的全部扰动
+    void set_friction_compensation(bool enable);
+    // 力矩模式的摩擦补偿: 只抵消在线拟合出的摩擦模型 (线性区 FOC_TORQUE_FRICTION_RAMP), 默认关闭;
+    // 不管开不开, 力矩模式下电机自己在转且没有手 (外部力矩估计很小) 时都会拟合摩擦模型, 给状态估计器用
+    void set_torque_friction_compensation(bool enable);
+    [[nodiscard]] const DisturbanceObserver &get_disturbance_observer() const { return disturbance_observer_; }
+
+    // 状态估计: 融合编码器角度和输出的 Uq, 每个控制周期估计角度 / 转速 / 手指力矩 (旋钮坐标系, 与 Uq 同单位)
+    [[nodiscard]] const KalmanEstimator &get_state_estimator() const { return state_estimator_; }
+    // 最近一次更新耗费的 CPU 周期
+    [[nodiscard]] uint32_t get_estimator_cycles() const { return estimator_cycles_.load(std::memory_order_relaxed); }
+    // 上次调用以来单次更新的最大 CPU 周期, 读取后清零; 只有一个任务 (控制台) 调用
+    uint32_t take_estimator_max_cycles() { return estimator_max_cycles_.exchange(0, std::memory_order_relaxed); }
+
+    // 力矩波形效果 (点击 / 振动等): 可以在任意任务里调用, 不阻塞, 下一个控制周期开始按采样点逐周期播放,
+    // 叠加在当前模式的输出上; strength 为峰值 Uq, 队列满时返回 false; 自整定/辨识期间的效果被丢弃
+    bool play_effect(HapticEffect effect, float strength) { return waveform_player_.play(effect, strength); }
+
+    // 增益调度: 位置外环 / 速度内环的参数按转速和位置从表中插值, nullptr 表示不调度
+    // 调度表拥有绑定的 pid_position / pid_velocity 的参数, 每个周期都会覆盖; set_velocity 等传入其他 PID 时不调度
+    void set_gain_schedule(GainSchedule *position_schedule, PIDController *pid_position,
+                           GainSchedule *velocity_schedule, PIDController *pid_velocity);
+
+    // 开始继电反馈自整定, 围绕当前状态振荡, 整定期间其他 set_* 调用被忽略, 结束后回到空闲状态
+    // 位置环整定时 pid_velocity 为已经整定好的速度环; 自整定/辨识正在进行时不开始, 返回 false
+    bool start_autotune(RelayAutotuner *tuner, AutotuneLoop loop, PIDController *pid_velocity = nullptr);
+    [[nodiscard]] bool is_autotune_running() const;
+
+    // 系统辨识: 每个控制周期输出一个激励 Uq (与 set_dq 相同的力矩通路, 不加摩擦补偿), 同步记录 Uq / 角度 / 转速
+    // 激励结束或缓冲区满后回到空闲状态, 期间其他 set_* 调用被忽略
+    void start_identification(SysIdExcitation *excitation, SysIdRecorder *recorder);
+    [[nodiscard]] bool is_identification_running() const;
 
 private:
     enum class Mode {
@@ -39,23 +91,63 @@ private:
         VelocityControl,  // 速度控制模式
         AbsPositionControl,  // 绝对位置环控制模式
         RelPositionControl,  // 相对位置环控制模式
+        Autotune,           // 继电反馈自整定
+        Identify,           // 系统辨识
     };
 
     Mode current_mode_ = Mode::None;
+    Mode loop_mode_ = Mode::None;   // 控制任务上一周期运行的模式, 用来发现模式切换
     float current_ud_ = 0;
     float current_uq_ = 0;
     float target_speed_rad_s_ = 0;
     float target_position_rad_ = 0;
     // 速度环的PID控制器
     PIDController *pid_velocity_{};
-    // 位置环的PID控制器
-    PIDController *pid_position_{};
-    PIDController *pid_position_velocity_{};
+    GainSchedule *velocity_schedule_{};
+    PIDController *scheduled_pid_velocity_{};   // 速度调度表绑定的 PID
+    // 位置 → 速度 串级, 外环分频运行
+    CascadeController position_cascade_{FOC_POSITION_LOOP_DIVIDER, FOC_POSITION_VELOCITY_LIMIT, FOC_MCPWM_OUTPUT_LIMIT};
+    // 位置指令轨迹, 只有控制任务规划和推进; 其他任务通过 position_request_ 提交目标
+    SCurveTrajectory trajectory_{FOC_TRAJECTORY_MAX_VELOCITY, FOC_TRAJECTORY_MAX_ACCEL, FOC_TRAJECTORY_MAX_JERK,
+                                 FOC_CALC_PERIOD * 1e-6f};
+    std::atomic<Mode> requested_position_mode_{Mode::None};     // None 表示撤销还没处理的位置指令
+    std::atomic<float> requested_position_{0};
+    std::atomic<uint32_t> position_request_{0};     // 每次提交/撤销加 1
+    uint32_t position_handled_ = 0;                 // 控制任务已经处理的提交
+    std::atomic<uint32_t> trajectory_done_{0};      // 轨迹已经走完的提交
+    // 其他任务提交的轨迹限制, 控制任务在下一次规划时取走
+    std::atomic<float> requested_max_velocity_{FOC_TRAJECTORY_MAX_VELOCITY};
+    std::atomic<float> requested_max_acceleration_{FOC_TRAJECTORY_MAX_ACCEL};
+    std::atomic<float> requested_max_jerk_{FOC_TRAJECTORY_MAX_JERK};
+    std::atomic<uint32_t> limits_request_{0};       // 每次提交加 1
+    uint32_t limits_handled_ = 0;
+    // 自整定
+    RelayAutotuner *autotuner_{};
+    AutotuneLoop autotune_loop_ = AutotuneLoop::Velocity;
+    // 系统辨识
+    SysIdExcitation *sysid_excitation_{};
+    SysIdRecorder *sysid_recorder_{};
+    float sysid_start_position_ = 0;
+
+    // 扰动观测器, 所有量都在旋钮坐标系 (已乘 encoder_direction_ 之前)
+    DisturbanceObserver disturbance_observer_{FOC_FEEDFORWARD_ACCEL, FOC_FEEDFORWARD_VELOCITY, FOC_DOB_BANDWIDTH,
+                                              FOC_CALC_PERIOD * 1e-6f, FOC_FRICTION_ADAPT_TIME,
+                                              FOC_FRICTION_VELOCITY_DEADBAND, FOC_MCPWM_STATIC_FRIC_TORQUE};
+    bool friction_compensation_ = true;
+    bool torque_friction_compensation_ = FOC_TORQUE_FRICTION_COMPENSATION;
+    float last_uq_ = 0;     // 上一周期实际输出的 Uq
+    // 卡尔曼状态估计器, 与扰动观测器使用相同的惯量 / 阻尼参数
+    KalmanEstimator state_estimator_{FOC_FEEDFORWARD_ACCEL, FOC_FEEDFORWARD_VELOCITY, FOC_CALC_PERIOD * 1e-6f,
+                                     FOC_KALMAN_ANGLE_NOISE, FOC_KALMAN_VELOCITY_NOISE, FOC_KALMAN_TORQUE_NOISE};
+    std::atomic<uint32_t> estimator_cycles_{0};         // 控制任务写, 其它任务读
+    std::atomic<uint32_t> estimator_max_cycles_{0};     // 控制任务取最大值, 读取的任务清零
+    // 力矩波形播放器, 只在控制任务里播放
+    WaveformPlayer waveform_player_;
 
     gpio_num_t en_gpio_{};
-    AS5600 *as5600_{};
+    FocEncoder *encoder_{};
     int pole_pairs_ = 0;
-    float as5600_direction_ = -1.0;  // 1: 正转, -1: 反转
+    float encoder_direction_ = -1.0;  // 1: 正转, -1: 反转
     bool foc_is_enabled_ = false;
 
     float zero_electric_angle_ = 0;
@@ -67,12 +159,21 @@ private:
     esp_timer_handle_t foc_timer{};
     TaskHandle_t foc_task_handle_; // FOC计算任务的句柄, 用于任务通知
 
+    [[nodiscard]] bool _is_exclusive_mode() const;   // 自整定/辨识期间不接受其他指令
     static float _normalize_angle(float angle);   // 角度归一化
     float _get_electrical_angle();   // 获取电机电角度
     static void _timer_callback_static(void *args);   // 定时器回调函数
     static void _foc_task_static(void *arg);
     void _set_dq_out_loop();   // 设置DQ坐标 (力矩控制) 循环
     void _set_dq_out_exec(float Ud, float Uq, float e_theta_rad);    // 设置DQ坐标 (力矩控制) 执行
+    void _set_uq_out(float Uq, float Ud = 0);    // 输出旋钮坐标系下的 Uq, 并记录给扰动观测器
+    float _disturbance_compensation(float velocity);   // 闭环模式的扰动补偿, 同时在线拟合摩擦模型
+    float _torque_friction_compensation(float velocity);   // 力矩模式的摩擦补偿, 没有手时在线拟合摩擦模型
+    void _request_position(Mode mode, float target_position);   // 提交位置指令, mode 为 None 时撤销
+    void _consume_position_request();  // 控制任务调用, 处理新提交的位置指令
+    void _plan_trajectory(Mode mode, float measured_position, float target_position);  // 规划位置轨迹并切换到 mode
+    void _consume_limits_request();    // 控制任务调用, 把新提交的轨迹限制交给 trajectory_
+    float _position_loop(float measured_position);    // 轨迹参考 + 串级位置/速度环 + 前馈, 返回 Uq
 };
 
 
@@ -5,6 +5,7 @@
 #include "motor_foc_driver.h"
 #include "project_conf.h"
 #include "driver/gpio.h"
+#include "esp_cpu.h"
 
 
 static const char *TAG = "FocDriver";
@@ -15,10 +16,12 @@ FocDriver::FocDriver(gpio_num_t u_gpio,
                      gpio_num_t v_gpio,
                      gpio_num_t w_gpio,
                      gpio_num_t en_gpio,
-                     AS5600 *as5600,
+                     FocEncoder *encoder,
                      int pole_pairs) : en_gpio_(en_gpio),
-                                       as5600_(as5600),
+                                       encoder_(encoder),
                                        pole_pairs_(pole_pairs) {
+    disturbance_observer_.set_unattended_detection(FOC_FRICTION_ADAPT_HAND_RATIO, FOC_FRICTION_ADAPT_HAND_FILTER,
+                                                   FOC_FRICTION_ADAPT_HAND_HOLD, FOC_FRICTION_ADAPT_MIN_VELOCITY);
     // 初始化电机驱动，使能引脚, 创建逆变器
     inverter_config_t cfg = {
             .timer_config = {
@@ -104,7 +107,7 @@ void FocDriver::foc_motor_calibrate() {
     // 施加初始电压并等待稳定
     _set_dq_out_exec(0, FOC_MCPWM_CALIBRATE_VOLTAGE, 0);  // 开环运行电机到0度
     vTaskDelay(pdMS_TO_TICKS(300));  // 延时300ms
-    float initial_angle = as5600_->read_radian_from_sensor_with_no_update();  // 读取编码器角度
+    float initial_angle = encoder_->read_radian_from_sensor_with_no_update();  // 读取编码器角度
 
     for (int i = 0; i < test_steps; i++) {
         theta += delta_theta;
@@ -112,7 +115,7 @@ void FocDriver::foc_motor_calibrate() {
         vTaskDelay(pdMS_TO_TICKS(10));
     }
 
-    float final_angle = as5600_->read_radian_from_sensor_with_no_update();  // 读取最终角度
+    float final_angle = encoder_->read_radian_from_sensor_with_no_update();  // 读取最终角度
 
     // 停止电机
     _set_dq_out_exec(0, 0, theta);
@@ -124,8 +127,8 @@ void FocDriver::foc_motor_calibrate() {
     }
 
     // 判断电机旋转方向
-    as5600_direction_ = (angle_difference > 0) ? 1.0f : -1.0f;
-    ESP_LOGI(TAG, "Motor direction is %s", (as5600_direction_ > 0) ? "1" : "-1");
+    encoder_direction_ = (angle_difference > 0) ? 1.0f : -1.0f;
+    ESP_LOGI(TAG, "Motor direction is %s", (encoder_direction_ > 0) ? "1" : "-1");
     // 设置零电角度
     /*
      * @brief 如果设置 Q 的话是不是代表超前 90 度就不是 0 电位角了, 所以需要设置 D 轴 (犯的经典错误(整整搞了一整天!!))
@@ -145,7 +148,7 @@ void FocDriver::foc_motor_calibrate() {
     vTaskDelay(pdMS_TO_TICKS(1000));
 
     // 读取编码器角度, 计算零电角度
-    zero_electric_angle_ = as5600_->read_radian_from_sensor_with_no_update() * (float) pole_pairs_ * as5600_direction_;
+    zero_electric_angle_ = encoder_->read_radian_from_sensor_with_no_update() * (float) pole_pairs_ * encoder_direction_;
     vTaskDelay(pdMS_TO_TICKS(100));
 
     // 停止电机
@@ -158,44 +161,136 @@ void FocDriver::foc_motor_calibrate() {
 }
 
 void FocDriver::set_free() {
+    if (_is_exclusive_mode()) {
+        return;
+    }
+    _request_position(Mode::None, 0);
     current_mode_ = Mode::None;
 }
 
 void FocDriver::set_dq(float Ud, float Uq) {
+    if (_is_exclusive_mode()) {
+        return;
+    }
+    _request_position(Mode::None, 0);
     current_uq_ = Uq;
     current_ud_ = Ud;
     current_mode_ = Mode::TorqueControl;
 }
 
 void FocDriver::set_velocity(float speed_rad_s, PIDController *pid_velocity) {
+    if (_is_exclusive_mode()) {
+        return;
+    }
+    _request_position(Mode::None, 0);
     target_speed_rad_s_ = speed_rad_s;
     pid_velocity_ = pid_velocity;
     current_mode_ = Mode::VelocityControl;
 }
 
-void FocDriver::set_abs_position(float position_rad, PIDController *pid_position, PIDController *pid_position_v) {
-    target_position_rad_ = position_rad;
-    pid_position_ = pid_position;
-    pid_position_velocity_ = pid_position_v;
-    current_mode_ = Mode::AbsPositionControl;
+void FocDriver::set_abs_position(float position_rad, PIDController *pid_position, PIDController *pid_velocity) {
+    if (_is_exclusive_mode()) {
+        return;
+    }
+    position_cascade_.set_loops(pid_position, pid_velocity);
+    _request_position(Mode::AbsPositionControl, position_rad);
+}
+
+void FocDriver::set_rel_position(float position_rad, PIDController *pid_position, PIDController *pid_velocity) {
+    if (_is_exclusive_mode()) {
+        return;
+    }
+    // 相对位置按最短路径走, 轨迹在累计角度坐标系下规划
+    float pos_error = std::fmod(position_rad, (float) M_TWOPI) - encoder_->get_radian();
+    if (pos_error > 0 && pos_error > M_PI) {
+        pos_error -= 2 * M_PI;
+    } else if (pos_error < 0 && pos_error < -M_PI) {
+        pos_error += 2 * M_PI;
+    }
+    position_cascade_.set_loops(pid_position, pid_velocity);
+    _request_position(Mode::RelPositionControl, encoder_->get_total_radian() + pos_error);
+}
+
+void FocDriver::set_trajectory_limits(float max_velocity, float max_acceleration, float max_jerk) {
+    // 控制任务规划时读这三个值, 和位置指令一样通过请求计数交过去
+    requested_max_velocity_.store(max_velocity, std::memory_order_relaxed);
+    requested_max_acceleration_.store(max_acceleration, std::memory_order_relaxed);
+    requested_max_jerk_.store(max_jerk, std::memory_order_relaxed);
+    limits_request_.fetch_add(1, std::memory_order_release);
+}
+
+void FocDriver::set_gain_schedule(GainSchedule *position_schedule, PIDController *pid_position,
+                                  GainSchedule *velocity_schedule, PIDController *pid_velocity) {
+    velocity_schedule_ = velocity_schedule;
+    scheduled_pid_velocity_ = pid_velocity;
+    position_cascade_.set_schedules(position_schedule, pid_position, velocity_schedule, pid_velocity);
+}
+
+void FocDriver::set_friction_compensation(bool enable) {
+    friction_compensation_ = enable;
+}
+
+void FocDriver::set_torque_friction_compensation(bool enable) {
+    torque_friction_compensation_ = enable;
 }
 
-void FocDriver::set_rel_position(float position_rad, PIDController *pid_position, PIDController *pid_position_v) {
-    target_position_rad_ = position_rad;
-    pid_position_ = pid_position;
-    pid_position_velocity_ = pid_position_v;
-    current_mode_ = Mode::RelPositionControl;
+bool FocDriver::is_trajectory_finished() const {
+    // 还没被控制任务处理的指令也算没走完
+    return trajectory_done_.load(std::memory_order_acquire) == position_request_.load(std::memory_order_acquire);
+}
+
+bool FocDriver::start_autotune(RelayAutotuner *tuner, AutotuneLoop loop, PIDController *pid_velocity) {
+    if (_is_exclusive_mode()) {
+        ESP_LOGW(TAG, "Autotune or identification already running");
+        return false;
+    }
+    if (loop == AutotuneLoop::Position && pid_velocity == nullptr) {
+        ESP_LOGE(TAG, "Position autotune needs a tuned velocity PID");
+        return false;
+    }
+    _request_position(Mode::None, 0);
+    autotuner_ = tuner;
+    autotune_loop_ = loop;
+    pid_velocity_ = pid_velocity;
+    target_position_rad_ = encoder_->get_custom_total_radian();    // 围绕当前位置振荡
+    current_mode_ = Mode::Autotune;
+    return true;
+}
+
+bool FocDriver::is_autotune_running() const {
+    return current_mode_ == Mode::Autotune;
+}
+
+void FocDriver::start_identification(SysIdExcitation *excitation, SysIdRecorder *recorder) {
+    if (_is_exclusive_mode()) {
+        ESP_LOGW(TAG, "Autotune or identification already running");
+        return;
+    }
+    _request_position(Mode::None, 0);
+    sysid_excitation_ = excitation;
+    sysid_recorder_ = recorder;
+    sysid_recorder_->begin(*excitation, FOC_CALC_PERIOD);
+    sysid_start_position_ = encoder_->get_custom_total_radian();
+    current_mode_ = Mode::Identify;
+}
+
+bool FocDriver::is_identification_running() const {
+    return current_mode_ == Mode::Identify;
 }
 
 
 // private
+bool FocDriver::_is_exclusive_mode() const {
+    return current_mode_ == Mode::Autotune || current_mode_ == Mode::Identify;
+}
+
 float FocDriver::_normalize_angle(float angle) {
     float a = fmodf(angle, 2.0f * M_PI);   //取余运算可以用于归一化，列出特殊值例子算便知
     return a >= 0 ? a : (a + 2.0f * (float) M_PI);
 }
 
 float FocDriver::_get_electrical_angle() {
-    return as5600_->read_radian_from_sensor() * (float) pole_pairs_ * as5600_direction_ - zero_electric_angle_;
+    return encoder_->read_radian_from_sensor() * (float) pole_pairs_ * encoder_direction_ - zero_electric_angle_;
 }
 
 void FocDriver::_timer_callback_static(void *args) {
@@ -213,44 +308,127 @@ void FocDriver::_foc_task_static(void *arg) {
 void FocDriver::_set_dq_out_loop() {    // 定时器循环用于控制电机
     while (true) {
         ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        int64_t tick_start_us = esp_timer_get_time();
+        float velocity = encoder_->get_velocity_filter();
+        float applied_uq = last_uq_;
+        disturbance_observer_.update(applied_uq, velocity);
+        _consume_position_request();
+        // 波形效果叠加在各模式的输出上, 独占模式下不输出也不积压
+        float effect = 0;
+        if (_is_exclusive_mode()) {
+            waveform_player_.clear();
+        } else {
+            effect = waveform_player_.next();
+        }
+        bool mode_entered = current_mode_ != loop_mode_;    // 本周期刚切换过来, 闭环从上一周期的输出接着算
+        loop_mode_ = current_mode_;
         switch (current_mode_) {
             case Mode::None:
-                _set_dq_out_exec(0, 0, _get_electrical_angle());
+                _set_uq_out(effect);
                 break;
-            case Mode::TorqueControl:
-                _set_dq_out_exec(current_ud_, as5600_direction_ * current_uq_, _get_electrical_angle());
+            case Mode::TorqueControl: {
+                _set_uq_out(current_uq_ + _torque_friction_compensation(velocity) + effect, current_ud_);
                 break;
+            }
             case Mode::VelocityControl: {
-                float error = target_speed_rad_s_ - as5600_->get_velocity_filter();
-                float Uq = as5600_direction_ * pid_velocity_->calculate(error);
-                _set_dq_out_exec(0, Uq, _get_electrical_angle());
+                if (velocity_schedule_ && pid_velocity_ == scheduled_pid_velocity_) {
+                    velocity_schedule_->apply(pid_velocity_, velocity, encoder_->get_custom_total_radian());
+                }
+                float compensation = _disturbance_compensation(velocity) + effect;
+                if (mode_entered) {
+                    pid_velocity_->track(last_uq_ - compensation, target_speed_rad_s_, velocity);
+                }
+                _set_uq_out(pid_velocity_->calculate(target_speed_rad_s_, velocity) + compensation);
                 break;
             }
             case Mode::AbsPositionControl: {
-                float pos_error = target_position_rad_ - as5600_->get_custom_total_radian();
-                float target_speed = pid_position_velocity_->calculate(pos_error);
-                float vel_error = target_speed - as5600_->get_velocity_filter();
-                float Uq = as5600_direction_ * pid_position_->calculate(vel_error);
-                _set_dq_out_exec(0, Uq, _get_electrical_angle());
+                float compensation = _disturbance_compensation(velocity) + effect;
+                if (mode_entered) {
+                    position_cascade_.track(last_uq_ - compensation);
+                }
+                float Uq = _position_loop(encoder_->get_custom_total_radian());
+                _set_uq_out(Uq + compensation);
                 break;
             }
             case Mode::RelPositionControl: {
-                float pos_error = std::fmod(target_position_rad_, (float) M_TWOPI) - as5600_->get_radian();
-                if (pos_error > 0 && pos_error > M_PI) {
-                    pos_error -= 2 * M_PI;
-                } else if (pos_error < 0 && pos_error < -M_PI) {
-                    pos_error += 2 * M_PI;
+                float compensation = _disturbance_compensation(velocity) + effect;
+                if (mode_entered) {
+                    position_cascade_.track(last_uq_ - compensation);
+                }
+                float Uq = _position_loop(encoder_->get_total_radian());
+                _set_uq_out(Uq + compensation);
+                break;
+            }
+            case Mode::Autotune: {
+                float Uq;
+                if (autotune_loop_ == AutotuneLoop::Velocity) {
+                    Uq = autotuner_->update(-encoder_->get_velocity_filter());
+                } else {
+                    float target_speed = autotuner_->update(target_position_rad_ - encoder_->get_custom_total_radian());
+                    Uq = pid_velocity_->calculate(target_speed, encoder_->get_velocity_filter());
+                }
+                if (autotuner_->is_done()) {
+                    Uq = 0;
+                    current_mode_ = Mode::None;
+                }
+                _set_uq_out(Uq);    // 整定的是不带补偿的对象
+                break;
+            }
+            case Mode::Identify: {
+                _set_uq_out(sysid_excitation_->next());
+                // 角度在 _set_uq_out 里刚读过, 与本周期的 Uq 同步
+                sysid_recorder_->record(last_uq_, encoder_->get_custom_total_radian() - sysid_start_position_,
+                                        encoder_->get_velocity_filter());
+                if (sysid_excitation_->is_done() || sysid_recorder_->is_full()) {
+                    current_mode_ = Mode::None;
                 }
-                float target_speed = pid_position_velocity_->calculate(pos_error);
-                float vel_error = target_speed - as5600_->get_velocity_filter();
-                float Uq = as5600_direction_ * pid_position_->calculate(vel_error);
-                _set_dq_out_exec(0, Uq, _get_electrical_angle());
                 break;
             }
         }
+
+        // 角度在 _set_uq_out 里刚读过, 从上次采样到这次采样之间作用的是上一周期的 Uq
+        uint32_t estimator_start = esp_cpu_get_cycle_count();
+        state_estimator_.update(applied_uq,
+                                disturbance_observer_.friction_compensation(state_estimator_.get_velocity()),
+                                encoder_->get_position());
+        uint32_t estimator_cycles = esp_cpu_get_cycle_count() - estimator_start;
+        estimator_cycles_.store(estimator_cycles, std::memory_order_relaxed);
+        // 读取的任务在 load 和 store 之间清零时, 存进去的是清零之后这一次的值, 仍然是清零以来的最大值
+        if (estimator_cycles > estimator_max_cycles_.load(std::memory_order_relaxed)) {
+            estimator_max_cycles_.store(estimator_cycles, std::memory_order_relaxed);
+        }
+
+        // 本周期的角度采样和输出已经完成, 剩余时间交给编码器做低优先级的总线读取
+        encoder_->service_idle_slot(int32_t(FOC_CALC_PERIOD - (esp_timer_get_time() - tick_start_us)));
     }
 }
 
+void FocDriver::_set_uq_out(float Uq, float Ud) {
+    last_uq_ = _constrain(Uq, -FOC_MCPWM_OUTPUT_LIMIT, FOC_MCPWM_OUTPUT_LIMIT);
+    _set_dq_out_exec(Ud, encoder_direction_ * last_uq_, _get_electrical_angle());
+}
+
+float FocDriver::_disturbance_compensation(float velocity) {
+    if (!friction_compensation_) {
+        return 0;
+    }
+    // 电机自己在转, 没有外力时观测值基本就是摩擦, 用来更新摩擦模型
+    if (std::fabs(velocity) > FOC_FRICTION_VELOCITY_DEADBAND) {
+        disturbance_observer_.adapt_friction(velocity);
+    }
+    float disturbance = disturbance_observer_.get_disturbance();
+    return _constrain(disturbance, -FOC_DOB_LIMIT, FOC_DOB_LIMIT);
+}
+
+float FocDriver::_torque_friction_compensation(float velocity) {
+    // 手指的力矩也会进入观测值, 只在电机自己转 (飞轮滑行 / 吸附 / 回位) 时拟合, 状态估计器用的摩擦模型冷机热机都准
+    disturbance_observer_.adapt_friction_unattended(velocity, state_estimator_.get_external_torque());
+    if (!torque_friction_compensation_) {
+        return 0;
+    }
+    return disturbance_observer_.friction_compensation(velocity, FOC_TORQUE_FRICTION_RAMP);
+}
+
 void FocDriver::_set_dq_out_exec(float Ud, float Uq, float e_theta_rad) {
     dq_out_.d = _constrain(Ud, -FOC_MCPWM_OUTPUT_LIMIT, FOC_MCPWM_OUTPUT_LIMIT);    // 限制Ud的范围
     dq_out_.q = _constrain(Uq, -FOC_MCPWM_OUTPUT_LIMIT, FOC_MCPWM_OUTPUT_LIMIT);    // 限制Uq的范围
@@ -266,4 +444,78 @@ void FocDriver::_set_dq_out_exec(float Ud, float Uq, float e_theta_rad) {
 
     // 使能PWM
     ESP_ERROR_CHECK(svpwm_inverter_set_duty(inverter_, uvw_duty_[0], uvw_duty_[1], uvw_duty_[2]));
-}
\ No newline at end of file
+}
+
+void FocDriver::_request_position(Mode mode, float target_position) {
+    requested_position_.store(target_position, std::memory_order_relaxed);
+    requested_position_mode_.store(mode, std::memory_order_relaxed);
+    position_request_.fetch_add(1, std::memory_order_release);
+}
+
+void FocDriver::_consume_position_request() {
+    uint32_t request = position_request_.load(std::memory_order_acquire);
+    if (request == position_handled_) {
+        return;
+    }
+    Mode mode = requested_position_mode_.load(std::memory_order_relaxed);
+    float target = requested_position_.load(std::memory_order_relaxed);
+    if (position_request_.load(std::memory_order_acquire) != request) {
+        return;     // 读的时候又提交了新指令, 模式和目标可能不是同一次的, 下个周期再处理
+    }
+    position_handled_ = request;
+    if (mode == Mode::None) {
+        trajectory_done_.store(request, std::memory_order_release);    // 撤销, 没有轨迹要走
+        return;
+    }
+    float measured = mode == Mode::AbsPositionControl ? encoder_->get_custom_total_radian()
+                                                      : encoder_->get_total_radian();
+    _plan_trajectory(mode, measured, target);
+}
+
+void FocDriver::_plan_trajectory(Mode mode, float measured_position, float target_position) {
+    bool tracking = current_mode_ == mode;
+    if (tracking && trajectory_.get_target() == target_position) {
+        return;     // 目标没变, 继续走当前轨迹
+    }
+
+    // 同一种位置模式下从当前参考点接着规划, 速度连续; 否则从实际位置和转速开始
+    float start_position = measured_position;
+    float start_velocity = encoder_->get_velocity_filter();
+    if (tracking) {
+        TrajectoryPoint ref = trajectory_.current();
+        start_position = ref.position;
+        start_velocity = ref.velocity;
+    }
+
+    _consume_limits_request();
+    trajectory_.plan(start_position, start_velocity, target_position);
+    target_position_rad_ = target_position;
+    current_mode_ = mode;
+}
+
+void FocDriver::_consume_limits_request() {
+    uint32_t request = limits_request_.load(std::memory_order_acquire);
+    while (request != limits_handled_) {
+        float max_velocity = requested_max_velocity_.load(std::memory_order_relaxed);
+        float max_acceleration = requested_max_acceleration_.load(std::memory_order_relaxed);
+        float max_jerk = requested_max_jerk_.load(std::memory_order_relaxed);
+        uint32_t again = limits_request_.load(std::memory_order_acquire);
+        if (again != request) {
+            request = again;    // 读的时候又提交了新限制, 三个值可能不是同一次的, 重读 (规划只在收到指令时做一次, 不能推迟)
+            continue;
+        }
+        limits_handled_ = request;
+        trajectory_.set_limits(max_velocity, max_acceleration, max_jerk);
+    }
+}
+
+float FocDriver::_position_loop(float measured_position) {
+    // 轨迹给出位置/速度/加速度参考, 速度参考前馈到速度环, 速度和加速度参考前馈到输出 (反电动势 + 惯量)
+    TrajectoryPoint ref = trajectory_.step();
+    if (trajectory_.is_finished()) {
+        trajectory_done_.store(position_handled_, std::memory_order_release);
+    }
+    float feedforward = FOC_FEEDFORWARD_VELOCITY * ref.velocity + FOC_FEEDFORWARD_ACCEL * ref.acceleration;
+    return position_cascade_.update(ref.position, measured_position, ref.velocity, encoder_->get_velocity_filter(),
+                                    feedforward);
+}
@@ -0,0 +1,85 @@
+#include "ballistic_mapper.h"
+
+#include <cmath>
+
+#define _constrain(amt, low, high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+void BallisticCurve::make_flat() {
+    points = 1;
+    velocity[0] = 0;
+    gain[0] = 1;
+}
+
+void BallisticCurve::make_accelerating(float slow_velocity, float fast_velocity, float max_gain, float exponent) {
+    if (!(fast_velocity > slow_velocity) || !(max_gain > 1)) {
+        make_flat();
+        return;
+    }
+    // 第一个点在 slow_velocity, 之后的点均匀分到 fast_velocity
+    points = max_points;
+    for (int i = 0; i < points; i++) {
+        float s = float(i) / float(points - 1);
+        velocity[i] = slow_velocity + s * (fast_velocity - slow_velocity);
+        gain[i] = 1 + (max_gain - 1) * std::pow(s, exponent);
+    }
+}
+
+
+BallisticMapper::BallisticMapper() {
+    curve_.make_flat();
+}
+
+bool BallisticMapper::set_curve(const BallisticCurve &curve) {
+    if (curve.points < 1 || curve.points > BallisticCurve::max_points) {
+        return false;
+    }
+    for (int i = 0; i < curve.points; i++) {
+        if (!std::isfinite(curve.velocity[i]) || !std::isfinite(curve.gain[i]) || curve.gain[i] < 0 ||
+            (i > 0 && !(curve.velocity[i] > curve.velocity[i - 1]))) {
+            return false;
+        }
+    }
+    curve_ = curve;
+    return true;
+}
+
+void BallisticMapper::set_range(float min_value, float max_value, float step) {
+    min_value_ = min_value;
+    max_value_ = max_value > min_value ? max_value : min_value;
+    step_ = step > 0 ? step : 1;
+    value_ = _constrain(value_, min_value_, max_value_);
+}
+
+void BallisticMapper::reset(float value) {
+    value_ = _constrain(value, min_value_, max_value_);
+    remainder_ = 0;
+}
+
+float BallisticMapper::on_detent(int direction, float velocity) {
+    if (direction == 0) {
+        return value_;
+    }
+    if ((remainder_ > 0 && direction < 0) || (remainder_ < 0 && direction > 0)) {
+        remainder_ = 0;     // 换方向
+    }
+    remainder_ += float(direction) * gain(velocity);
+    float steps = std::trunc(remainder_);
+    remainder_ -= steps;
+    value_ = _constrain(value_ + steps * step_, min_value_, max_value_);
+    return value_;
+}
+
+float BallisticMapper::gain(float velocity) const {
+    const BallisticCurve &c = curve_;
+    float speed = std::fabs(velocity);
+    if (speed <= c.velocity[0]) {
+        return c.gain[0];
+    }
+    for (int i = 1; i < c.points; i++) {
+        if (speed < c.velocity[i]) {
+            float s = (speed - c.velocity[i - 1]) / (c.velocity[i] - c.velocity[i - 1]);
+            return c.gain[i - 1] + s * (c.gain[i] - c.gain[i - 1]);
+        }
+    }
+    return c.gain[c.points - 1];
+}
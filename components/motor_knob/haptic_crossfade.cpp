@@ -0,0 +1,16 @@
+#include "haptic_crossfade.h"
+
+void HapticCrossfade::start(int ticks) {
+    tick_ = 0;
+    ticks_ = ticks < 0 ? 0 : ticks;
+}
+
+float HapticCrossfade::blend(float incoming, float outgoing) {
+    if (!fading()) {
+        return incoming;
+    }
+    tick_++;
+    float s = float(tick_) / float(ticks_);
+    float w = s * s * (3 - 2 * s);
+    return w * incoming + (1 - w) * outgoing;
+}
@@ -0,0 +1,251 @@
+#include "haptic_profile.h"
+
+#include <cmath>
+
+#define _constrain(amt, low, high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+static constexpr int points_per_detent = 32;    // 每个吸附点间距内的点数, 中间的力矩反向只占一个点距
+
+static inline int _floor_to_int(float x) {     // 向下取整, 不调用 floorf (Xtensa 上是库函数)
+    int i = int(x);
+    return float(i) > x ? i - 1 : i;
+}
+
+void HapticProfile::make_detents(int count, float stiffness, float limit) {
+    count = count < 1 ? 1 : count;
+    points = points_per_detent;
+    periodic = true;
+    span = float(M_TWOPI) / float(count);
+    start = -span / 2;
+    wall_stiffness = 0;
+    damping = 0;
+    damping_deadband = 0;
+    torque_limit = limit;
+    detent_origin = 0;
+    detent_spacing = span;
+    detent_count = 0;
+    float step = span / float(points);
+    for (int i = 0; i < points; i++) {
+        float offset = start + float(i) * step;     // 相对吸附点的位置
+        torque[i] = _constrain(-stiffness * offset, -limit, limit);
+    }
+}
+
+void HapticProfile::make_bounded_detents(int count, float left, float right, float stiffness, float limit) {
+    count = count < 1 ? 1 : count;
+    int wanted = count * points_per_detent + 1;
+    points = wanted < max_points ? wanted : max_points;
+    periodic = false;
+    start = left;
+    span = right - left;
+    wall_stiffness = stiffness;
+    damping = 0;
+    damping_deadband = 0;
+    torque_limit = limit;
+    detent_origin = left;
+    detent_spacing = span / float(count);
+    detent_count = count;
+    float step = span / float(points - 1);
+    for (int i = 0; i < points; i++) {
+        float offset = float(i) * step;
+        float target = std::round(offset / detent_spacing) * detent_spacing;
+        torque[i] = _constrain(stiffness * (target - offset), -limit, limit);
+    }
+}
+
+void HapticProfile::make_damping(float gain, float limit) {
+    points = 2;
+    periodic = true;
+    start = 0;
+    span = float(M_TWOPI);
+    wall_stiffness = 0;
+    damping = gain;
+    damping_deadband = 0.1f;
+    torque_limit = limit;
+    detent_origin = 0;
+    detent_spacing = 0;
+    detent_count = 0;
+    torque[0] = torque[1] = 0;
+}
+
+void HapticProfile::make_bounded_damping(float gain, float left, float right, float stiffness, float limit) {
+    make_damping(gain, limit);
+    periodic = false;
+    start = left;
+    span = right - left;
+    wall_stiffness = stiffness;
+}
+
+
+template<int tables>
+BasicHapticProfileEngine<tables>::BasicHapticProfileEngine() {
+    edit();
+    commit();
+    acquire();
+}
+
+template<int tables>
+void BasicHapticProfileEngine<tables>::acquire() {
+    if constexpr (tables == 1) {
+        return;     // 只有一张表, 修改的时候不会有人在读
+    }
+    // 先公布要读的表再确认它仍然是最新的: 确认之后 edit() 一定能看到 reading_, 不会拿它当草稿
+    int table = active_;
+    while (true) {
+        reading_ = table;
+        int latest = active_;
+        if (latest == table) {
+            return;
+        }
+        table = latest;
+    }
+}
+
+template<int tables>
+float BasicHapticProfileEngine<tables>::evaluate(float position, float velocity, float stiffness_scale, float extra_damping) const {
+    int table = reading_.load(std::memory_order_relaxed);
+    const HapticProfile &p = profiles_[table];
+
+    float spring;
+    if (p.periodic) {
+        float phase = (position - p.start) * inv_step_[table];
+        float u = (phase - float(_floor_to_int(phase))) * float(p.points);
+        int i = int(u) < p.points ? int(u) : p.points - 1;
+        int j = i + 1 < p.points ? i + 1 : 0;
+        spring = p.torque[i] + (u - float(i)) * (p.torque[j] - p.torque[i]);
+    } else {
+        float u = (position - p.start) * inv_step_[table];
+        int last = p.points - 1;
+        if (u <= 0) {
+            spring = p.torque[0] + p.wall_stiffness * (p.start - position);
+        } else if (u >= float(last)) {
+            spring = p.torque[last] - p.wall_stiffness * (position - (p.start + p.span));
+        } else {
+            int i = int(u);
+            spring = p.torque[i] + (u - float(i)) * (p.torque[i + 1] - p.torque[i]);
+        }
+    }
+
+    float damping = std::fabs(velocity) < p.damping_deadband ? 0 : p.damping;
+    float torque = stiffness_scale * spring - (damping + extra_damping) * velocity;
+    return _constrain(torque, -p.torque_limit, p.torque_limit);
+}
+
+template<int tables>
+int BasicHapticProfileEngine<tables>::detent_index(float position) const {
+    int table = reading_.load(std::memory_order_relaxed);
+    const HapticProfile &p = profiles_[table];
+    if (p.detent_spacing <= 0 && p.detent_count <= 0) {
+        return 0;
+    }
+    if (p.detent_spacing > 0) {
+        int index = _floor_to_int((position - p.detent_origin) * inv_spacing_[table] + 0.5f);
+        return p.periodic ? index : _constrain(index, 0, p.detent_count);
+    }
+    if (p.periodic) {
+        float phase = (position - p.start) * inv_step_[table];
+        int turns = _floor_to_int(phase);
+        int i = int((phase - float(turns)) * float(p.points) + 0.5f);
+        if (i >= p.points) {
+            i = 0;
+            turns++;
+        }
+        return turns * p.detent_count + p.detent_of_point[i];
+    }
+    int i = int((position - p.start) * inv_step_[table] + 0.5f);
+    return p.detent_of_point[_constrain(i, 0, p.points - 1)];
+}
+
+template<int tables>
+int BasicHapticProfileEngine<tables>::boundary(float position) const {
+    const HapticProfile &p = profiles_[reading_.load(std::memory_order_relaxed)];
+    if (p.periodic) {
+        return 0;
+    }
+    if (position < p.start) {
+        return -1;
+    }
+    return position > p.start + p.span ? 1 : 0;
+}
+
+template<int tables>
+float BasicHapticProfileEngine<tables>::nearest_rest(float position) const {
+    const HapticProfile &p = profiles_[active_];
+    if (!p.periodic && (position < p.start || position > p.start + p.span)) {
+        // 有界表范围外是手把旋钮压在墙里, 不是停着: 不平移, 边界相同的墙接着用同样的力顶住, 不会松一下再重新顶上
+        return position;
+    }
+    float step = p.periodic ? p.span / float(p.points) : p.span / float(p.points - 1);
+    int pairs = p.periodic ? p.points : p.points - 1;
+    float rest = position;
+    float best = -1;
+    for (int i = -1; i < pairs; i++) {
+        float x;
+        if (i < 0) {
+            // 有界表的左端点: 力矩为 0, 右边推向端点, 左边是墙, 也是平衡点 (例如开关的关位置)
+            if (p.periodic || !(p.torque[0] == 0 && p.torque[1] < 0)) {
+                continue;
+            }
+            x = p.start;
+        } else {
+            int j = i + 1 < p.points ? i + 1 : 0;
+            float t0 = p.torque[i], t1 = p.torque[j];
+            if (!(t0 > 0 && t1 <= 0)) {
+                continue;
+            }
+            x = p.start + (float(i) + t0 / (t0 - t1)) * step;
+        }
+        float d = x - position;
+        if (p.periodic) {
+            d -= p.span * std::round(d / p.span);
+        }
+        if (best < 0 || std::fabs(d) < best) {
+            best = std::fabs(d);
+            rest = position + d;
+        }
+    }
+
+    // 最多平移半个吸附点间距, 表里漏掉平衡点时零点也不会整格错位
+    float spacing = p.detent_spacing > 0 ? p.detent_spacing : (p.detent_count > 0 ? p.span / float(p.detent_count) : 0);
+    if (spacing > 0) {
+        rest = _constrain(rest, position - spacing / 2, position + spacing / 2);
+    }
+    return rest;
+}
+
+template<int tables>
+HapticProfile &BasicHapticProfileEngine<tables>::edit() {
+    if constexpr (tables == 1) {
+        return profiles_[0];
+    }
+    int active = active_, reading = reading_;
+    int draft = 0;
+    while (draft == active || draft == reading) {   // 三份里总有一份既不是最新的, 也不是定时器在读的
+        draft++;
+    }
+    draft_ = draft;
+    profiles_[draft] = profiles_[active];
+    return profiles_[draft];
+}
+
+template<int tables>
+bool BasicHapticProfileEngine<tables>::commit() {
+    int draft = draft_;
+    HapticProfile &p = profiles_[draft];
+    if (p.points < 2 || p.points > HapticProfile::max_points || !(p.span > 0) || p.torque_limit < 0 ||
+        p.detent_spacing < 0) {
+        if constexpr (tables == 1) {
+            p.make_damping(0, 0);   // 表已经改了一半, 换成力矩为 0 的表
+            inv_step_[draft] = 1.0f / p.span;
+            inv_spacing_[draft] = 0;
+        }
+        return false;
+    }
+    inv_step_[draft] = p.periodic ? 1.0f / p.span : float(p.points - 1) / p.span;
+    inv_spacing_[draft] = p.detent_spacing > 0 ? 1.0f / p.detent_spacing : 0;
+    active_ = draft;
+    return true;
+}
+
+template class BasicHapticProfileEngine<1>;
+template class BasicHapticProfileEngine<3>;
@@ -0,0 +1,192 @@
+#include "haptic_profile_library.h"
+
+#include <cmath>
+#include <cstring>
+
+#define _constrain(amt, low, high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+static inline bool _finite_not_negative(float x) {
+    return std::isfinite(x) && x >= 0;
+}
+
+bool HapticProfileLibrary::load(const void *data, size_t size) {
+    data_ = nullptr;
+    count_ = 0;
+    const auto *bytes = static_cast<const uint8_t *>(data);
+    // 记录里直接按 float 读取, 要求 4 字节对齐 (分区映射的地址是 64KB 对齐的)
+    if (!bytes || reinterpret_cast<uintptr_t>(bytes) % 4 != 0 || size < sizeof(HapticProfileFileHeader)) {
+        return false;
+    }
+    const auto *header = reinterpret_cast<const HapticProfileFileHeader *>(bytes);
+    if (header->magic != haptic_profile_magic || header->version != haptic_profile_version ||
+        header->size < sizeof(HapticProfileFileHeader) || header->size > size) {
+        return false;
+    }
+    if (crc32(bytes + sizeof(HapticProfileFileHeader), header->size - sizeof(HapticProfileFileHeader)) != header->crc32) {
+        return false;
+    }
+
+    size_t offset = sizeof(HapticProfileFileHeader);
+    for (int i = 0; i < header->profile_count; i++) {
+        if (offset + sizeof(HapticProfileRecord) > header->size) {
+            return false;
+        }
+        const auto *record = reinterpret_cast<const HapticProfileRecord *>(bytes + offset);
+        size_t record_size = _record_size(record);
+        if (offset + record_size > header->size || !_check_record(record)) {
+            return false;
+        }
+        offset += record_size;
+    }
+    if (offset != header->size) {
+        return false;
+    }
+    data_ = bytes;
+    count_ = header->profile_count;
+    return true;
+}
+
+const HapticProfileRecord *HapticProfileLibrary::get(int index) const {
+    if (index < 0 || index >= count_) {
+        return nullptr;
+    }
+    size_t offset = sizeof(HapticProfileFileHeader);
+    const auto *record = reinterpret_cast<const HapticProfileRecord *>(data_ + offset);
+    for (int i = 0; i < index; i++) {
+        offset += _record_size(record);
+        record = reinterpret_cast<const HapticProfileRecord *>(data_ + offset);
+    }
+    return record;
+}
+
+const HapticProfileRecord *HapticProfileLibrary::find(const char *name) const {
+    for (int i = 0; i < count_; i++) {
+        const HapticProfileRecord *record = get(i);
+        if (strncmp(record->name, name, haptic_profile_name_size) == 0) {
+            return record;
+        }
+    }
+    return nullptr;
+}
+
+const HapticDetentRecord *HapticProfileLibrary::get_detents(const HapticProfileRecord *record) {
+    return reinterpret_cast<const HapticDetentRecord *>(record + 1);
+}
+
+const HapticSpringRecord *HapticProfileLibrary::get_springs(const HapticProfileRecord *record) {
+    return reinterpret_cast<const HapticSpringRecord *>(get_detents(record) + record->detent_count);
+}
+
+void HapticProfileLibrary::compile(const HapticProfileRecord *record, HapticProfile &profile) {
+    bool bounded = record->flags & haptic_profile_flag_bounded;
+    const HapticDetentRecord *detents = get_detents(record);
+    const HapticSpringRecord *springs = get_springs(record);
+    int detent_count = record->detent_count;
+    float limit = record->torque_limit;
+    auto period = float(M_TWOPI);
+
+    profile.points = HapticProfile::max_points;
+    profile.periodic = !bounded;
+    profile.start = bounded ? record->left_rad : 0;
+    profile.span = bounded ? record->right_rad - record->left_rad : period;
+    profile.wall_stiffness = bounded ? record->end_stop_stiffness : 0;
+    profile.damping = record->damping;
+    profile.damping_deadband = record->damping > 0 ? 0.1f : 0;
+    profile.torque_limit = limit;
+    profile.detent_origin = 0;
+    profile.detent_spacing = 0;     // 吸附点间距不均匀, 下标查 detent_of_point
+    profile.detent_count = detent_count;
+
+    float step = bounded ? profile.span / float(profile.points - 1) : profile.span / float(profile.points);
+    float tie = step * 1e-3f;
+    for (int i = 0; i < profile.points; i++) {
+        float x = profile.start + float(i) * step;
+        float torque = 0;
+        for (int s = 0; s < record->spring_count; s++) {
+            float d = springs[s].center_rad - x;
+            if (!bounded) {
+                d -= period * std::round(d / period);    // 最近的一圈
+            }
+            torque += springs[s].stiffness * d;
+        }
+
+        // 最近的吸附点, 周期曲线跨过 0 点时下标记为上一圈 (-1) 或下一圈 (detent_count)
+        int nearest = 0;
+        float nearest_d = 0;
+        for (int k = 0; k < detent_count; k++) {
+            float d = detents[k].position_rad - x;
+            int index = k;
+            if (!bounded && d > period / 2) {
+                d -= period;
+                index = k - detent_count;
+            } else if (!bounded && d < -period / 2) {
+                d += period;
+                index = k + detent_count;
+            }
+            // 正好在两个吸附点中间时取前方 (角度增大方向) 的吸附点, 与 make_detents() 一致
+            float closer = std::fabs(nearest_d) - std::fabs(d);
+            if (k == 0 || closer > tie || (closer > -tie && d > nearest_d)) {
+                nearest = index;
+                nearest_d = d;
+            }
+        }
+        if (detent_count > 0) {
+            int k = (nearest + detent_count) % detent_count;
+            torque += detents[k].stiffness * nearest_d;
+        }
+
+        profile.torque[i] = _constrain(torque, -limit, limit);
+        profile.detent_of_point[i] = int16_t(nearest);
+    }
+}
+
+uint32_t HapticProfileLibrary::crc32(const void *data, size_t size, uint32_t crc) {
+    // 按位计算, 只在开机校验时用一次, 不需要查表
+    const auto *bytes = static_cast<const uint8_t *>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= bytes[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+
+// private
+size_t HapticProfileLibrary::_record_size(const HapticProfileRecord *record) {
+    return sizeof(HapticProfileRecord) + record->detent_count * sizeof(HapticDetentRecord) +
+           record->spring_count * sizeof(HapticSpringRecord);
+}
+
+bool HapticProfileLibrary::_check_record(const HapticProfileRecord *record) {
+    if (memchr(record->name, '\0', haptic_profile_name_size) == nullptr || record->name[0] == '\0') {
+        return false;
+    }
+    bool bounded = record->flags & haptic_profile_flag_bounded;
+    float left = bounded ? record->left_rad : 0;
+    float right = bounded ? record->right_rad : float(M_TWOPI);
+    if (!std::isfinite(left) || !std::isfinite(right) || !(left < right) ||
+        !_finite_not_negative(record->end_stop_stiffness) || !_finite_not_negative(record->damping) ||
+        !std::isfinite(record->torque_limit) || !(record->torque_limit > 0)) {
+        return false;
+    }
+
+    const HapticDetentRecord *detents = get_detents(record);
+    for (int k = 0; k < record->detent_count; k++) {
+        float position = detents[k].position_rad;
+        bool in_range = bounded ? position >= left && position <= right : position >= left && position < right;
+        if (!std::isfinite(position) || !in_range || !_finite_not_negative(detents[k].stiffness) ||
+            (k > 0 && !(position > detents[k - 1].position_rad))) {
+            return false;
+        }
+    }
+    const HapticSpringRecord *springs = get_springs(record);
+    for (int s = 0; s < record->spring_count; s++) {
+        if (!std::isfinite(springs[s].center_rad) || !_finite_not_negative(springs[s].stiffness)) {
+            return false;
+        }
+    }
+    return true;
+}
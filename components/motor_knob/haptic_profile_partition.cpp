@@ -0,0 +1,30 @@
+#include "haptic_profile_library.h"
+#include "esp_partition.h"
+#include "esp_log.h"
+
+static const char *TAG = "HapticProfile";
+
+bool HapticProfileLibrary::map_partition(const char *label) {
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                                                label);
+    if (partition == nullptr) {
+        ESP_LOGW(TAG, "Partition '%s' not found", label);
+        return false;
+    }
+
+    // 映射后一直保留, 曲线记录直接从 flash cache 读取, 不占 RAM
+    const void *data = nullptr;
+    esp_partition_mmap_handle_t handle;
+    esp_err_t ret = esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &data, &handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to map partition '%s': %s", label, esp_err_to_name(ret));
+        return false;
+    }
+    if (!load(data, partition->size)) {
+        ESP_LOGW(TAG, "No valid profiles in partition '%s', using built-in modes", label);
+        esp_partition_munmap(handle);
+        return false;
+    }
+    ESP_LOGI(TAG, "Loaded %d profiles from partition '%s'", count_, label);
+    return true;
+}
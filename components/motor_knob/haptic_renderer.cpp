@@ -0,0 +1,161 @@
+#include "haptic_renderer.h"
+#include "project_conf.h"
+
+#define _constrain(amt, low, high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+static constexpr float spring_torque_limit = FOC_MCPWM_OUTPUT_LIMIT / 3.0f;
+static constexpr float rebound_stiffness = 150.0f;  // 有界吸附点和纯比例墙的刚度, 纯比例墙再硬就会颤振
+
+HapticRenderer::HapticRenderer()
+        : flywheel_(KNOB_FLYWHEEL_STIFFNESS, KNOB_FLYWHEEL_DAMPING_RATIO, spring_torque_limit,
+                    FOC_CALC_PERIOD * 1e-6f),
+          left_wall_(KNOB_WALL_DAMPING, KNOB_WALL_TORQUE_LIMIT),
+          right_wall_(KNOB_WALL_DAMPING, KNOB_WALL_TORQUE_LIMIT),
+          texture_(FOC_CALC_PERIOD * 1e-6f),
+          servo_(KNOB_SERVO_STIFFNESS, KNOB_SERVO_DAMPING_RATIO, FOC_FEEDFORWARD_ACCEL, FOC_FEEDFORWARD_VELOCITY,
+                 KNOB_SERVO_TORQUE_LIMIT, FOC_CALC_PERIOD * 1e-6f) {
+    servo_.set_limits(KNOB_SERVO_MAX_VELOCITY, KNOB_SERVO_MAX_ACCEL, KNOB_SERVO_MAX_JERK);
+    servo_.set_friction(KNOB_SERVO_FRICTION);
+    servo_.set_grab_detection(KNOB_SERVO_GRAB_TORQUE, KNOB_SERVO_GRAB_IMPULSE, KNOB_SERVO_GRAB_VELOCITY,
+                              KNOB_SERVO_GRAB_ERROR);
+}
+
+void HapticRenderer::set_mode(HapticMode mode) {
+    _build_profile(mode);
+    left_wall_.reset();
+    right_wall_.reset();
+    servo_.cancel();
+    mode_ = mode;
+}
+
+void HapticRenderer::set_flywheel(float inertia, float coulomb, float viscous, float position) {
+    flywheel_.set_friction_law(inertia, coulomb, viscous);
+    flywheel_.reset(position);
+}
+
+float HapticRenderer::render(const HapticInput &input) {
+    switch (mode_) {
+        case HapticMode::None: {
+            return 0;
+        }
+        case HapticMode::Flywheel: {
+            // 用状态估计器的转速, 比编码器低通滤波的转速延迟小、噪声低
+            float torque = flywheel_.update(input.position, input.estimated_velocity);
+            // 电压驱动下转子有反电动势阻尼, 按飞轮转速前馈抵消, 松手后飞轮才能带着转子一起转
+            torque += FOC_FEEDFORWARD_VELOCITY * flywheel_.get_velocity();
+            return _constrain(torque, -FOC_MCPWM_OUTPUT_LIMIT / 2.0f, FOC_MCPWM_OUTPUT_LIMIT / 2.0f);
+        }
+        default: {
+            profile_engine_.acquire();  // 这个周期里查表都用同一张表
+            float stiffness_scale = 1, extra_damping = 0;
+            if (gain_schedule_) {
+                PidGains gains = gain_schedule_->evaluate(input.velocity, input.position);
+                stiffness_scale = gains.kp;
+                extra_damping = gains.kd;
+            }
+            attractor_current_pos_ = profile_engine_.detent_index(input.position);
+            damping_current_pos_ = input.position;
+            boundary_current_ = profile_engine_.boundary(input.position);
+
+            float servo_torque;
+            // 用状态估计器的转速, 跟踪阻尼和抓住检测都需要延迟小的转速
+            if (servo_.update(input.position, input.estimated_velocity, input.external_torque, servo_torque)) {
+                left_wall_.reset();     // 伺服期间墙不工作, 交回时能量观测器重新开始
+                right_wall_.reset();
+                return servo_torque;
+            }
+
+            const HapticProfile &profile = profile_engine_.get_rendered_profile();
+            float detent_scale = _detent_scale(input.velocity);
+            float texture = texture_.render(input.angle, input.velocity);
+            if (!passive_walls_ || profile.periodic || profile.wall_stiffness <= 0) {
+                // 纯比例墙在表里, 顶在墙上时不减弱
+                float scale = boundary_current_ == 0 ? stiffness_scale * detent_scale : stiffness_scale;
+                float torque = profile_engine_.evaluate(input.position, input.velocity, scale, extra_damping);
+                return _constrain(torque + texture, -FOC_MCPWM_OUTPUT_LIMIT / 2.0f, FOC_MCPWM_OUTPUT_LIMIT / 2.0f);
+            }
+            // 表只算到边界为止, 墙外的部分交给无源墙
+            float left = profile.start, right = profile.start + profile.span;
+            float inside = _constrain(input.position, left, right);
+            float stiffness = stiffness_scale * profile.wall_stiffness;
+            float torque = profile_engine_.evaluate(inside, input.velocity, stiffness_scale * detent_scale,
+                                                    extra_damping) + texture;
+            torque += left_wall_.update(left - input.position, -input.velocity, stiffness);
+            torque -= right_wall_.update(input.position - right, input.velocity, stiffness);
+            float limit = profile.torque_limit > KNOB_WALL_TORQUE_LIMIT ? profile.torque_limit : KNOB_WALL_TORQUE_LIMIT;
+            return _constrain(torque, -limit, limit);
+        }
+    }
+}
+
+void HapticRenderer::servo_start(float target, const HapticInput &input) {
+    if (mode_ == HapticMode::None || mode_ == HapticMode::Flywheel) {
+        return;
+    }
+    profile_engine_.acquire();  // 旋钮定时器调用, 和 render() 读同一张表
+    const HapticProfile &profile = profile_engine_.get_rendered_profile();
+    if (!profile.periodic) {
+        target = _constrain(target, profile.start, profile.start + profile.span);
+    }
+    servo_.start(target, input.position, input.estimated_velocity);
+}
+
+float HapticRenderer::nearest_rest(float position) const {
+    if (mode_ == HapticMode::None || mode_ == HapticMode::Flywheel) {
+        return position;    // 不查表
+    }
+    return profile_engine_.nearest_rest(position);
+}
+
+void HapticRenderer::_build_profile(HapticMode mode) {
+    HapticProfile *profile = nullptr;
+    switch (mode) {
+        case HapticMode::Attractor: {
+            // 吸附点越多间距越小, 刚度随之加大, 手感上每一格的力度差不多
+            float kp = 100.0f * logf((float) attractor_number_ + 1.0f) + 100.0f;
+            if (kp > 1000.0f) kp = 1000.0f; // 饱和上限
+            profile = &profile_engine_.edit();
+            profile->make_detents(attractor_number_, kp, spring_torque_limit);
+            break;
+        }
+        case HapticMode::AttractorWithRebound: {
+            profile = &profile_engine_.edit();
+            profile->make_bounded_detents(attractor_number_, left_boundary_rad_, right_boundary_rad_,
+                                          rebound_stiffness, spring_torque_limit);
+            profile->wall_stiffness = _wall_stiffness();    // 吸附点的刚度不变, 只有墙变硬
+            break;
+        }
+        case HapticMode::Damping: {
+            profile = &profile_engine_.edit();
+            profile->make_damping(damping_gain_, spring_torque_limit);
+            break;
+        }
+        case HapticMode::DampingWithRebound: {
+            profile = &profile_engine_.edit();
+            profile->make_bounded_damping(damping_gain_, left_boundary_rad_, right_boundary_rad_,
+                                          _wall_stiffness(), spring_torque_limit);
+            break;
+        }
+        default: {
+            return;     // None / 飞轮不查表, Custom 使用已经提交的表
+        }
+    }
+    profile_engine_.commit();
+}
+
+float HapticRenderer::_wall_stiffness() const {
+    return passive_walls_ ? KNOB_WALL_STIFFNESS : rebound_stiffness;
+}
+
+float HapticRenderer::_detent_scale(float velocity) const {
+    const DetentFade &fade = detent_fade_;
+    float speed = std::fabs(velocity);
+    if (fade.min_scale >= 1 || speed <= fade.start_velocity) {
+        return 1;
+    }
+    if (speed >= fade.end_velocity) {
+        return fade.min_scale;
+    }
+    float s = (speed - fade.start_velocity) / (fade.end_velocity - fade.start_velocity);
+    return 1 - (1 - fade.min_scale) * s * s * (3 - 2 * s);
+}
@@ -0,0 +1,197 @@
+#include "haptic_texture.h"
+
+#include <cmath>
+
+#define _constrain(amt, low, high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+static constexpr int fit_points = 64;               // 参数化图案编译时的采样点数
+static constexpr int max_cycles = 4096;             // 14 bit 编码器一个周期 4 个刻度
+static constexpr float alias_pass = 0.25f;          // 每个控制周期走过的谐波周期数, 以下原样输出
+static constexpr float alias_stop = 0.45f;          // 以上不输出
+static constexpr float stiction_stiffness = 3000.0f;  // 粘滞区锚点弹簧的刚度 (Uq/rad), 60 Uq 的摩擦约 1° 后开始滑动
+static constexpr float phase_to_radian = float(M_TWOPI) / 4294967296.0f;
+
+static inline float _smoothstep(float s) {
+    return s * s * (3 - 2 * s);
+}
+
+// 谐波级数求和, step 为基波每个控制周期走过的周期数 (0 表示不做抗混叠)
+static float _series(const float *cos_coeff, const float *sin_coeff, int harmonics, float theta, float step) {
+    float c1 = cosf(theta), s1 = sinf(theta);
+    float c_prev = 1, s_prev = 0, c = c1, s = s1;
+    float sum = 0;
+    for (int h = 1; h <= harmonics; h++) {
+        float r = float(h) * step;
+        if (r >= alias_stop) {
+            break;      // 更高次的谐波也都超过了
+        }
+        float gain = r <= alias_pass ? 1 : 1 - _smoothstep((r - alias_pass) / (alias_stop - alias_pass));
+        sum += gain * (cos_coeff[h - 1] * c + sin_coeff[h - 1] * s);
+        // cos((h+1)θ) = 2cosθ·cos(hθ) - cos((h-1)θ), sin 同理
+        float c_next = 2 * c1 * c - c_prev;
+        float s_next = 2 * c1 * s - s_prev;
+        c_prev = c;
+        s_prev = s;
+        c = c_next;
+        s = s_next;
+    }
+    return sum;
+}
+
+HapticTexture::HapticTexture(float period_s) : period_s_(period_s) {}
+
+bool HapticTexture::set(const TextureSpec &spec) {
+    shape_ = TextureShape::None;
+    anchored_ = false;
+    if (spec.shape == TextureShape::None) {
+        return true;
+    }
+    bool valid = spec.cycles >= 1 && spec.cycles <= max_cycles && spec.amplitude >= 0 &&
+                 spec.duty > 0 && spec.duty < 1 && spec.rest_scale >= 0 && spec.rest_scale <= 1 &&
+                 spec.full_velocity >= 0;
+    if (!valid) {
+        return false;
+    }
+
+    float samples[fit_points];
+    switch (spec.shape) {
+        case TextureShape::Sine: {
+            harmonics_ = 1;
+            offset_ = 0;
+            cos_[0] = 0;
+            sin_[0] = 1;
+            break;
+        }
+        case TextureShape::Ridges: {
+            // 凸起的高度 (1 + cos) / 2 在周期中间, 力矩取负导数再归一化: 凸起范围内是一个整周期的 sin
+            for (int i = 0; i < fit_points; i++) {
+                float u = float(i) / float(fit_points) - 0.5f;
+                samples[i] = fabsf(u) < spec.duty / 2 ? sinf(float(M_TWOPI) * u / spec.duty) : 0;
+            }
+            _fit(samples, fit_points, max_harmonics);
+            offset_ = 0;
+            break;
+        }
+        case TextureShape::Sandpaper: {
+            uint32_t state = spec.seed ? spec.seed : 1;
+            auto next = [&state]() {     // LCG, 只要每次一样
+                state = state * 1664525u + 1013904223u;
+                return float(state >> 8) / 16777216.0f;
+            };
+            harmonics_ = max_harmonics;
+            offset_ = 0;
+            for (int h = 0; h < max_harmonics; h++) {
+                float magnitude = 0.5f + 0.5f * next();
+                float phase = float(M_TWOPI) * next();
+                cos_[h] = magnitude * cosf(phase);
+                sin_[h] = magnitude * sinf(phase);
+            }
+            break;
+        }
+        case TextureShape::Sticky: {
+            // 区域掩码, 边缘用 1/16 周期的 smoothstep 过渡, 截断谐波后不会有明显的过冲
+            const float edge = 1.0f / 16.0f;
+            for (int i = 0; i < fit_points; i++) {
+                float u = float(i) / float(fit_points);
+                float rise = _constrain((u + edge / 2) / edge, 0.0f, 1.0f);
+                float fall = _constrain((spec.duty + edge / 2 - u) / edge, 0.0f, 1.0f);
+                float wrap = _constrain((u - 1 + edge / 2) / edge, 0.0f, 1.0f);     // 下一个周期的上升沿
+                samples[i] = _smoothstep(rise < fall ? rise : fall) + _smoothstep(wrap);
+            }
+            _fit(samples, fit_points, max_harmonics);
+            break;
+        }
+        case TextureShape::Sampled: {
+            if (spec.sample_count < 2 || spec.sample_count > TextureSpec::max_samples) {
+                return false;
+            }
+            int harmonics = spec.sample_count / 2;
+            _fit(spec.samples, spec.sample_count, harmonics < max_harmonics ? harmonics : max_harmonics);
+            offset_ = 0;    // 平均值是一个恒定的力矩, 不属于纹理
+            break;
+        }
+        default: {
+            return false;
+        }
+    }
+
+    if (spec.shape != TextureShape::Sticky) {
+        // 按截断后级数的峰值归一化, amplitude 就是实际输出的峰值
+        float peak = 0;
+        for (int i = 0; i < 256; i++) {
+            float value = fabsf(_series(cos_, sin_, harmonics_, float(M_TWOPI) * float(i) / 256.0f, 0));
+            peak = value > peak ? value : peak;
+        }
+        if (peak < 1e-6f) {
+            return false;
+        }
+        for (int h = 0; h < harmonics_; h++) {
+            cos_[h] /= peak;
+            sin_[h] /= peak;
+        }
+    }
+
+    cycles_ = spec.cycles;
+    amplitude_ = spec.amplitude;
+    rest_scale_ = spec.rest_scale;
+    full_velocity_ = spec.full_velocity;
+    shape_ = spec.shape;
+    return true;
+}
+
+float HapticTexture::render(encoder_angle_t angle, float velocity) {
+    if (shape_ == TextureShape::None) {
+        return 0;
+    }
+    float speed = fabsf(velocity);
+    float scale = amplitude_;
+    if (speed < full_velocity_) {
+        scale *= rest_scale_ + (1 - rest_scale_) * _smoothstep(speed / full_velocity_);
+    }
+
+    encoder_angle_t phase = angle * cycles_;    // 圈内角度 × 周期数, 回绕后就是周期内的相位
+    float step = float(cycles_) * speed * period_s_ / float(M_TWOPI);
+    float value = offset_ + _series(cos_, sin_, harmonics_, float(phase) * phase_to_radian, step);
+    if (shape_ == TextureShape::Sticky) {
+        // 锚点 + 弹簧 (Dahl 摩擦模型): 弹簧力超过摩擦力时锚点跟着滑, 只看位置, 不会跟着转速的噪声抖
+        float limit = scale * _constrain(value, 0.0f, 1.0f);
+        if (!anchored_) {
+            anchor_ = angle;
+            anchored_ = true;
+        }
+        float stretch = float(encoder_angle_delta(angle, anchor_)) * ENCODER_RADIAN_PER_LSB;
+        float slip = limit / stiction_stiffness;
+        if (stretch > slip || stretch < -slip) {
+            stretch = stretch > 0 ? slip : -slip;
+            anchor_ = angle - encoder_angle_t(int32_t(stretch * ENCODER_LSB_PER_RADIAN));
+        }
+        return -stiction_stiffness * stretch;
+    }
+    return scale * value;
+}
+
+float HapticTexture::get_fade_velocity() const {
+    return alias_pass * float(M_TWOPI) / (float(cycles_) * period_s_);
+}
+
+
+// private
+void HapticTexture::_fit(const float *samples, int count, int harmonics) {
+    float sum = 0;
+    for (int i = 0; i < count; i++) {
+        sum += samples[i];
+    }
+    offset_ = sum / float(count);
+    harmonics_ = harmonics;
+    for (int h = 1; h <= harmonics; h++) {
+        float a = 0, b = 0;
+        for (int i = 0; i < count; i++) {
+            float theta = float(M_TWOPI) * float(h * i) / float(count);
+            a += samples[i] * cosf(theta);
+            b += samples[i] * sinf(theta);
+        }
+        float norm = 2 * h == count ? 1.0f / float(count) : 2.0f / float(count);    // 正好是采样的 Nyquist 时只有一半
+        cos_[h - 1] = a * norm;
+        sin_[h - 1] = b * norm;
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef FOCKNOB_BALLISTIC_MAPPER_H
+#define FOCKNOB_BALLISTIC_MAPPER_H
+
+#include <cstdint>
+
+/*
+ * @brief 加速曲线: 越过一个吸附点时数值变化的步数 gain, 随 |转速| 分段线性插值, 超出范围取端点
+ *        velocity 递增, gain ≥ 0; 例如 {0, 1} {4, 1} {16, 20}: 4 rad/s 以下一格一步, 16 rad/s 以上一格 20 步
+ */
+struct BallisticCurve {
+    static constexpr int max_points = 6;
+
+    uint8_t points = 1;
+    float velocity[max_points]{};   // rad/s
+    float gain[max_points]{1};      // 每个吸附点的步数
+
+    // 一格一步, 不加速
+    void make_flat();
+
+    // 低于 slow_velocity 一格一步, 到 fast_velocity 按 ((v - slow) / (fast - slow))^exponent 增长到 max_gain
+    void make_accelerating(float slow_velocity, float fast_velocity, float max_gain, float exponent);
+};
+
+/*
+ * @brief 吸附点 → 应用数值的加速映射 (类似鼠标指针加速), 纯 C++, 不依赖 IDF
+ *        每越过一个吸附点 (KnobEventType::DetentCrossed), 数值变化 gain(|转速|) 个 step:
+ *        慢慢拧一格一步, 可以精确微调; 甩一下一格跳很多步, 很快走完大范围
+ *        gain 的小数部分累计到下一格, 换方向时清零, 来回拧不会慢慢漂移; 数值限制在 [min, max]
+ */
+class BallisticMapper {
+public:
+    BallisticMapper();
+
+    bool set_curve(const BallisticCurve &curve);    // 点数或顺序不合法时返回 false, 曲线不变
+
+    void set_range(float min_value, float max_value, float step);   // 数值范围和一步的大小, 同时把当前值限制到范围内
+
+    void reset(float value);    // 设置当前值, 清掉累计的小数部分
+
+    float on_detent(int direction, float velocity);    // 越过一个吸附点 (direction 为 ±1, velocity 为 rad/s), 返回新的数值
+
+    [[nodiscard]] float gain(float velocity) const;    // 当前曲线在该转速下的步数
+
+    [[nodiscard]] float get_value() const { return value_; }
+
+private:
+    BallisticCurve curve_;
+    float min_value_ = -1e9f;
+    float max_value_ = 1e9f;
+    float step_ = 1;
+
+    float value_ = 0;
+    float remainder_ = 0;   // 还没有凑够一步的部分, 带符号
+};
+
+
+#endif //FOCKNOB_BALLISTIC_MAPPER_H
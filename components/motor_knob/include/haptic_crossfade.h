@@ -0,0 +1,27 @@
+#ifndef FOCKNOB_HAPTIC_CROSSFADE_H
+#define FOCKNOB_HAPTIC_CROSSFADE_H
+
+/*
+ * @brief 切换力矩规律时的交叉淡化权重, 纯 C++, 不依赖 IDF
+ *
+ *        新旧两个规律每个周期都计算, 输出 = w·新 + (1 - w)·旧, w 在 ticks 个周期内按 smoothstep 从 0 走到 1:
+ *            s = tick / ticks,  w = s²·(3 - 2s)
+ *        开始和结束时 w 的变化率都是 0, 中间最大 1.5 / ticks, 所以每个周期力矩的变化最多比两个规律自己的变化
+ *        多出 1.5·|新 - 旧| / ticks, 不会一步跳变. 淡化途中再次切换时调用方直接替换新规律, 权重接着走
+ */
+class HapticCrossfade {
+public:
+    void start(int ticks);  // 开始淡化, ticks 为 0 表示立即切换
+
+    [[nodiscard]] bool fading() const { return tick_ < ticks_; }
+
+    // 淡化期间每个周期调用一次, 返回混合后的力矩
+    float blend(float incoming, float outgoing);
+
+private:
+    int tick_ = 0;
+    int ticks_ = 0;
+};
+
+
+#endif //FOCKNOB_HAPTIC_CROSSFADE_H
@@ -0,0 +1,103 @@
+#ifndef FOCKNOB_HAPTIC_PROFILE_H
+#define FOCKNOB_HAPTIC_PROFILE_H
+
+#include <atomic>
+#include <cstdint>
+
+/*
+ * @brief 力反馈曲线: 力矩-角度表 + 转速阻尼
+ *
+ *        位置轴均匀分布 points 个点, 从 start 开始覆盖 span:
+ *          - 周期表: 一个周期 span 内 points 个点, 最后一个点和第一个点之间也插值 (例如一个棘轮间距)
+ *          - 有界表: 首尾两个点正好在 start 和 start + span, 超出范围后从端点的力矩按 wall_stiffness 继续线性增长 (墙)
+ *        阻尼: |转速| 超过 damping_deadband 时加上 -damping * 转速
+ *        吸附点: detent_spacing > 0 时按 detent_origin 和间距给出当前最近的吸附点下标, 有界表限制在 [0, detent_count]
+ *                间距不均匀时 (detent_spacing 为 0, detent_count > 0) 查 detent_of_point, 周期表每转一圈下标加 detent_count
+ *
+ *        力矩单位与 Uq 相同, 正值推向角度增大的方向
+ */
+struct HapticProfile {
+    static constexpr int max_points = 256;
+
+    uint16_t points = 2;
+    bool periodic = true;
+    float start = 0;                // 第一个点的位置 (rad)
+    float span = 1.0f;              // 周期表为周期, 有界表为首尾两点的距离 (rad)
+    float wall_stiffness = 0;       // 有界表范围外的刚度 (Uq/rad)
+    float damping = 0;              // 粘性阻尼 (Uq/(rad/s))
+    float damping_deadband = 0;     // 低于该转速不加阻尼, 避免静止时跟着噪声抖 (rad/s)
+    float torque_limit = 0;         // 输出限幅 (Uq)
+    float detent_origin = 0;        // 吸附点下标为 0 的位置 (rad)
+    float detent_spacing = 0;       // 吸附点间距 (rad), 0 表示没有吸附点
+    int detent_count = 0;           // 有界表最大的吸附点下标
+    float torque[max_points]{};
+    int16_t detent_of_point[max_points]{};  // 每个点最近的吸附点下标, 周期表可以是 -1 (上一圈) 或 detent_count (下一圈)
+
+    // 一圈 count 个吸附点, 每个吸附点是刚度 stiffness 的弹簧, 两个吸附点中间力矩反向
+    void make_detents(int count, float stiffness, float limit);
+
+    // [left, right] 内 count 个间隔 (count + 1 个吸附点), 范围外是刚度 stiffness 的墙
+    void make_bounded_detents(int count, float left, float right, float stiffness, float limit);
+
+    // 到处都只有阻尼
+    void make_damping(float gain, float limit);
+
+    // [left, right] 内只有阻尼, 范围外是刚度 stiffness 的墙
+    void make_bounded_damping(float gain, float left, float right, float stiffness, float limit);
+};
+
+/*
+ * @brief 力反馈曲线引擎, tables 份表, 每个周期只有一次查表插值, 新的手感只是换一张表, 运行时没有额外计算
+ *
+ *        tables = 3 (HapticProfileEngine): 三缓冲, 可以在旋钮定时器渲染的同时修改
+ *          旋钮定时器读 acquire() 固定下来的表, 其他任务在第三份上修改, commit() 时原子切换
+ *          草稿不会是定时器正在读的表, 连续两次 commit() 也不会改到定时器这个周期还在用的表
+ *        tables = 1 (HapticProfileTable): 只有一张表, edit() 直接改它, 只能在没有人渲染的时候修改
+ *          RotaryKnob 的力矩规律槽位已经整个按三缓冲交接, 设置任务改的槽位定时器不会读, 每个槽位一张表就够了
+ *          commit() 不合法时换成力矩为 0 的表, 不会留下改了一半的表
+ *
+ *        旋钮定时器: 每个周期先调用 acquire(), 之后 evaluate / detent_index / boundary / get_rendered_profile 都用这张表
+ *        修改曲线的任务: edit() / commit(), get_profile() 和 nearest_rest() 读最近一次提交的表
+ */
+template<int tables>
+class BasicHapticProfileEngine {
+    static_assert(tables == 1 || tables == 3, "single table, or triple buffered");
+
+public:
+    BasicHapticProfileEngine();
+
+    void acquire();     // 旋钮定时器调用, 取最近一次提交的表, 直到下一次 acquire() 之前不会被修改
+
+    // 旋钮定时器调用, 返回已限幅的力矩; stiffness_scale 乘在查表的力矩上, extra_damping 叠加在阻尼上 (增益调度用)
+    [[nodiscard]] float evaluate(float position, float velocity, float stiffness_scale = 1, float extra_damping = 0) const;
+
+    [[nodiscard]] int detent_index(float position) const;   // 当前最近的吸附点下标
+
+    [[nodiscard]] int boundary(float position) const;   // 有界表: -1 左边界外, +1 右边界外, 其他情况为 0
+
+    // 离 position 最近的稳定平衡点 (力矩由正变负的位置, 例如吸附点, 包括有界表力矩为 0 的端点),
+    // 没有平衡点或者 position 在有界表的范围外 (压在墙里) 时返回 position; 有吸附点时离 position 最多半个间距
+    [[nodiscard]] float nearest_rest(float position) const;
+
+    [[nodiscard]] const HapticProfile &get_profile() const { return profiles_[active_]; }  // 最近一次提交的表
+
+    [[nodiscard]] const HapticProfile &get_rendered_profile() const { return profiles_[reading_]; }   // 定时器正在用的表
+
+    HapticProfile &edit();  // 复制当前的表作为草稿并返回 (单表时就是当前的表), 修改后调用 commit()
+
+    bool commit();  // 检查草稿并切换, 点数或范围不合法时返回 false, 三缓冲时当前的表不变
+
+private:
+    HapticProfile profiles_[tables]{};
+    float inv_step_[tables]{};      // 周期表为 1 / span, 有界表为 1 / 相邻两点间距
+    float inv_spacing_[tables]{};   // 吸附点间距的倒数
+    std::atomic<int> active_{0};    // 最近一次提交的表
+    std::atomic<int> reading_{0};   // 定时器正在读的表, 只有 acquire() 修改
+    int draft_ = 0;                 // 修改曲线的任务独占
+};
+
+using HapticProfileEngine = BasicHapticProfileEngine<3>;
+using HapticProfileTable = BasicHapticProfileEngine<1>;
+
+
+#endif //FOCKNOB_HAPTIC_PROFILE_H
@@ -0,0 +1,99 @@
+#ifndef FOCKNOB_HAPTIC_PROFILE_LIBRARY_H
+#define FOCKNOB_HAPTIC_PROFILE_LIBRARY_H
+
+#include <cstddef>
+#include <cstdint>
+#include "haptic_profile.h"
+
+/*
+ * @brief 力反馈曲线的二进制格式 (小端, 4 字节对齐), 由 tools/haptic_profile.py 从 JSON 生成, 烧写到 haptic 分区
+ *
+ *        文件头 HapticProfileFileHeader
+ *        profile_count 条曲线, 每条依次为:
+ *          HapticProfileRecord
+ *          detent_count 个 HapticDetentRecord   (按位置升序)
+ *          spring_count 个 HapticSpringRecord
+ *
+ *        周期曲线覆盖一圈 [0, 2π), 吸附点位置在这个范围内; 有界曲线覆盖 [left_rad, right_rad], 范围外是刚度
+ *        end_stop_stiffness 的墙. 每个吸附点是独立刚度的弹簧, 作用范围到与相邻吸附点的中点; 弹簧中心在整个范围内
+ *        都起作用 (周期曲线按最近的一圈计算). 力矩单位与 Uq 相同
+ */
+static constexpr uint32_t haptic_profile_magic = 0x46525048;   // "HPRF"
+static constexpr uint16_t haptic_profile_version = 1;
+static constexpr size_t haptic_profile_name_size = 16;
+
+struct HapticProfileFileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t profile_count;
+    uint32_t size;      // 包括文件头的总字节数
+    uint32_t crc32;     // 文件头之后所有字节的 CRC-32 (与 zlib.crc32 相同)
+};
+
+struct HapticProfileRecord {
+    char name[haptic_profile_name_size];    // 以 '\0' 结尾
+    uint8_t flags;                          // bit0: 有界
+    uint8_t detent_count;
+    uint8_t spring_count;
+    uint8_t reserved;
+    float left_rad;
+    float right_rad;
+    float end_stop_stiffness;   // 墙的刚度 (Uq/rad)
+    float damping;              // 粘性阻尼 (Uq/(rad/s))
+    float torque_limit;         // 输出限幅 (Uq)
+};
+
+struct HapticDetentRecord {
+    float position_rad;
+    float stiffness;    // Uq/rad
+};
+
+struct HapticSpringRecord {
+    float center_rad;
+    float stiffness;    // Uq/rad
+};
+
+static_assert(sizeof(HapticProfileFileHeader) == 16);
+static_assert(sizeof(HapticProfileRecord) == 40);
+static_assert(sizeof(HapticDetentRecord) == 8);
+static_assert(sizeof(HapticSpringRecord) == 8);
+
+static constexpr uint8_t haptic_profile_flag_bounded = 0x01;
+
+/*
+ * @brief 力反馈曲线库, 纯 C++, 不依赖 IDF
+ *        load() 只校验并引用一块只读内存 (开机时映射的 flash 分区), 不复制; 进入模式时 compile() 生成 HapticProfile 力矩表
+ *        新的产品手感只需要重新烧写 haptic 分区, 不用重新编译固件
+ */
+class HapticProfileLibrary {
+public:
+    bool load(const void *data, size_t size);   // 校验文件头、CRC 和每条曲线, 不合法时返回 false, 库为空
+
+    bool map_partition(const char *label);      // 映射 flash 分区后 load(), 只在固件里实现
+
+    [[nodiscard]] int get_count() const { return count_; }
+
+    [[nodiscard]] const HapticProfileRecord *get(int index) const;    // 第 index 条曲线, 越界返回 nullptr
+
+    [[nodiscard]] const HapticProfileRecord *find(const char *name) const;    // 按名字查找, 没有返回 nullptr
+
+    [[nodiscard]] static const HapticDetentRecord *get_detents(const HapticProfileRecord *record);
+
+    [[nodiscard]] static const HapticSpringRecord *get_springs(const HapticProfileRecord *record);
+
+    // 生成力矩表, 每个点的力矩 = 所有弹簧 + 最近吸附点的弹簧, 限幅到 torque_limit
+    static void compile(const HapticProfileRecord *record, HapticProfile &profile);
+
+    static uint32_t crc32(const void *data, size_t size, uint32_t crc = 0);
+
+private:
+    const uint8_t *data_{};
+    int count_ = 0;
+
+    static size_t _record_size(const HapticProfileRecord *record);
+
+    static bool _check_record(const HapticProfileRecord *record);
+};
+
+
+#endif //FOCKNOB_HAPTIC_PROFILE_LIBRARY_H
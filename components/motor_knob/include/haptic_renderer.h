@@ -0,0 +1,145 @@
+#ifndef FOCKNOB_HAPTIC_RENDERER_H
+#define FOCKNOB_HAPTIC_RENDERER_H
+
+#include <cmath>
+#include "motor_gain_schedule.h"
+#include "haptic_profile.h"
+#include "virtual_flywheel.h"
+#include "passive_wall.h"
+#include "haptic_texture.h"
+#include "knob_servo.h"
+
+enum class HapticMode {
+    None,
+    Attractor,              // 棘轮吸附模式
+    AttractorWithRebound,   // 棘轮吸附模式，超出边界后反弹
+    Damping,                // 阻尼模式
+    DampingWithRebound,     // 阻尼模式，超出边界后反弹
+    Flywheel,               // 虚拟飞轮模式
+    Custom,                 // 自定义力矩表, 通过 edit_profile() / commit_profile() 设置
+};
+
+struct HapticInput {
+    float position;             // 相对自定义零点的累计角度 (rad)
+    float velocity;             // 编码器低通滤波后的转速 (rad/s)
+    float estimated_velocity;   // 状态估计器的转速 (rad/s), 飞轮模式使用
+    encoder_angle_t angle;      // 相对自定义零点的圈内角度 (定点), 纹理使用
+    float external_torque;      // 状态估计器的外部 (手指) 力矩 (Uq), 回位伺服检测手抓住旋钮
+};
+
+/*
+ * @brief 吸附点随转速减弱: |转速| 低于 start_velocity 时不变, 到 end_velocity 按 smoothstep 减到 min_scale 倍
+ *        快速甩动时吸附点不拖慢手指, 慢慢拧的时候还是一格一格的; 墙不受影响. min_scale 为 1 表示不减弱
+ */
+struct DetentFade {
+    float start_velocity = 0;   // rad/s
+    float end_velocity = 0;     // rad/s
+    float min_scale = 1;
+};
+
+/*
+ * @brief 旋钮力反馈的力矩规律, 纯 C++, 不依赖 IDF
+ *        RotaryKnob 在定时器里调用 render() 输出力矩, 主机上的 tools/haptic_bench 用同一份代码对着电机模型跑指标
+ *        输出力矩单位与 Uq 相同 (旋钮坐标系, 已限幅)
+ *
+ *        除飞轮以外的模式都是一张力矩表 (HapticProfile), 在 set_mode() 时按参数生成, render() 每个周期只查一次表;
+ *        飞轮有自己的状态, 单独计算
+ *        每个实例只有一张表 (HapticProfileTable): set_mode() / edit_profile() 只能在没有人 render() 的时候调用,
+ *        RotaryKnob 在定时器不读的槽位上修改, 四个槽位各一张表, 比每个槽位三缓冲省两张表 (约 3 KB)
+ *        有界表的墙默认由 PassiveWall 计算 (能量有界, 可以用高得多的刚度), 表只负责边界以内的部分
+ *        纹理 (HapticTexture) 叠加在表上, 跟着模式一起切换和淡化, 飞轮模式没有纹理
+ *        回位伺服 (KnobServo) 运动期间代替表输出, 到达或者被手抓住后立即交回给表
+ */
+class HapticRenderer {
+public:
+    HapticRenderer();
+
+    void set_mode(HapticMode mode);    // 按当前参数生成力矩表后切换模式, Custom 使用已经提交的表
+
+    void set_attractor(int attractor_num) { attractor_number_ = attractor_num < 1 ? 1 : attractor_num; }  // 吸附点个数 (一圈 / 边界内的间隔数)
+
+    void set_boundaries(float left_rad, float right_rad) {
+        left_boundary_rad_ = left_rad;
+        right_boundary_rad_ = right_rad;
+    }
+
+    void set_damping(float damping_gain) { damping_gain_ = damping_gain; }
+
+    // true: 墙用 PassiveWall, 内置模式的墙刚度为 KNOB_WALL_STIFFNESS; false: 墙是表里的纯比例弹簧 (旧的手感)
+    // 在 set_mode() 之前调用
+    void set_passive_walls(bool enable) { passive_walls_ = enable; }
+
+    void set_flywheel(float inertia, float coulomb, float viscous, float position);   // 设置飞轮参数, 并与旋钮对齐
+
+    void set_detent_fade(const DetentFade &fade) { detent_fade_ = fade; }
+
+    void set_texture(const HapticTexture &texture) { texture_ = texture; }     // 复制已经编译好的纹理
+
+    // 回位伺服: 旋钮自己转到 target (自定义坐标系, 有界表限制在边界内), 运动中再调用则从当前参考点重新规划
+    // None / 飞轮模式下忽略; set_mode() 会取消正在进行的伺服
+    void servo_start(float target, const HapticInput &input);
+
+    void servo_cancel() { servo_.cancel(); }
+
+    // 增益调度: kp 为力矩表的倍率, kd 为额外阻尼, 按转速和位置插值
+    void set_gain_schedule(GainSchedule *schedule) { gain_schedule_ = schedule; }
+
+    HapticProfile &edit_profile() { return profile_engine_.edit(); }    // 自定义力矩表的草稿
+
+    bool commit_profile() { return profile_engine_.commit(); }     // 不合法时返回 false, 表换成力矩为 0 的表
+
+    float render(const HapticInput &input);     // 每个周期调用一次, None 模式返回 0
+
+    [[nodiscard]] HapticMode get_mode() const { return mode_; }
+
+    [[nodiscard]] int get_attractor_pos() const { return attractor_current_pos_; }
+
+    [[nodiscard]] float get_damping_pos() const { return damping_current_pos_; }
+
+    [[nodiscard]] int get_boundary() const { return boundary_current_; }   // -1 / +1 顶在左 / 右边界外, 0 在范围内
+
+    [[nodiscard]] float get_wall_stiffness() const { return profile_engine_.get_profile().wall_stiffness; }
+
+    [[nodiscard]] float nearest_rest(float position) const;    // 当前力矩表里离 position 最近的平衡点, 用于切换模式时重新对齐
+
+    [[nodiscard]] const VirtualFlywheel &get_flywheel() const { return flywheel_; }
+
+    [[nodiscard]] ServoState get_servo_state() const { return servo_.get_state(); }
+
+private:
+    HapticMode mode_ = HapticMode::None;
+    GainSchedule *gain_schedule_{};
+    DetentFade detent_fade_{};
+
+    // 棘轮吸附模式参数 (当前角度为0度，顺时针 pos 增加
+    int attractor_number_ = 8;
+    int attractor_current_pos_ = 0;
+    // 阻尼模式参数
+    float damping_gain_ = 20;
+    float damping_current_pos_ = 0.0f;
+    int boundary_current_ = 0;
+    // 超出边界后反弹参数 (当前电机角度为0度来设置
+    float left_boundary_rad_ = -M_PI / 2;
+    float right_boundary_rad_ = M_PI / 2;
+    // 飞轮模式参数
+    VirtualFlywheel flywheel_;
+    // 边界 (墙)
+    bool passive_walls_ = true;
+    PassiveWall left_wall_;
+    PassiveWall right_wall_;
+    // 空间纹理
+    HapticTexture texture_;
+    // 回位伺服
+    KnobServo servo_;
+
+    HapticProfileTable profile_engine_;
+
+    void _build_profile(HapticMode mode);   // 按模式和参数生成力矩表并提交
+
+    [[nodiscard]] float _wall_stiffness() const;    // 内置模式的墙刚度
+
+    [[nodiscard]] float _detent_scale(float velocity) const;   // 吸附点随转速减弱的倍率
+};
+
+
+#endif //FOCKNOB_HAPTIC_RENDERER_H
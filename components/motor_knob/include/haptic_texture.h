@@ -0,0 +1,96 @@
+#ifndef FOCKNOB_HAPTIC_TEXTURE_H
+#define FOCKNOB_HAPTIC_TEXTURE_H
+
+#include <cstdint>
+#include "encoder_position.h"
+
+enum class TextureShape : uint8_t {
+    None,
+    Sine,       // 正弦起伏
+    Ridges,     // 细棱: 每个周期一道窄的升余弦凸起, 宽度占周期的 duty, 力矩是高度的负导数 (爬上去顶手, 翻过去推手)
+    Sandpaper,  // 砂纸: 各次谐波随机幅值和相位 (seed 固定, 每次一样), 周期内没有规律
+    Sticky,     // 粘滞区: 每个周期开头 duty 比例的区域内有库仑摩擦 (锚点 + 弹簧), 只阻碍转动, 不会推动旋钮
+    Sampled,    // 采样表: 一个周期内均匀分布的 sample_count 个力矩, 按峰值归一化
+};
+
+/*
+ * @brief 纹理参数, 设置任务填好后交给 HapticTexture::set() 编译
+ */
+struct TextureSpec {
+    static constexpr int max_samples = 64;
+
+    TextureShape shape = TextureShape::None;
+    uint16_t cycles = 1;            // 每圈的周期数 (空间频率); 整数保证转完一圈纹路首尾相接
+    float amplitude = 0;            // 力矩峰值 (Uq), Sticky 为摩擦力矩
+    float duty = 0.25f;             // Ridges 凸起宽度 / Sticky 粘滞区宽度, 占一个周期的比例
+    float rest_scale = 1;           // 静止时的幅度倍率, 到 full_velocity 按 smoothstep 升到 1
+    float full_velocity = 0;        // rad/s; rest_scale < 1 时, 慢慢拧不会被细纹卡在纹路里, 转起来才有质感
+    uint32_t seed = 1;              // Sandpaper
+    uint8_t sample_count = 0;       // Sampled, [2, max_samples]
+    float samples[max_samples]{};
+};
+
+/*
+ * @brief 空间纹理: 周期远小于吸附点间距的力矩图案 (细棱 / 砂纸 / 粘滞区), 叠加在力矩表上, 纯 C++, 不依赖 IDF
+ *
+ *        - 图案在 set() 时编译成傅里叶级数 (最多 max_harmonics 次谐波), render() 每个周期只算一次 sin/cos,
+ *          高次谐波用递推, 没有查表插值的折线
+ *        - 相位用编码器的 Q32.32 定点圈内角度直接乘 cycles, uint32 自然回绕就是周期内的相位, 没有舍入,
+ *          转了多少圈都一样精确 (float 弧度的分辨率随累计圈数变差, 乘上几百的 cycles 后相位误差会很明显)
+ *        - 抗混叠: 第 h 次谐波每个控制周期走过 r = h · cycles · |v| · Ts / 2π 个周期, r 到 0.25 以前原样输出,
+ *          从 0.25 按 smoothstep 衰减到 0.45 处为 0, Nyquist (0.5) 以上的谐波一律不输出.
+ *          不滤掉的话, 超过 Nyquist 的纹路在输出里变成低频的 "拍", 手上感觉是慢慢起伏的大疙瘩, 而不是细纹.
+ *          手转得越快保留的谐波越少, 细纹平滑地淡出, 和摸真实表面时高频纹理变得模糊的感觉一致
+ *
+ *        空间频率上限 (基波不衰减, r ≤ 0.25): cycles ≤ π / (2 · |v| · Ts), 另外一个周期至少要有 4 个编码器刻度:
+ *
+ *              控制周期            1 rad/s     3 rad/s     10 rad/s    30 rad/s    (周期数 / 圈)
+ *              2 ms (当前)          785         262          79          26
+ *              1 ms                1571         524         157          52
+ *              250 us              6283        2094         628         209
+ *              100 us             15708        5236        1571         524
+ *
+ *              编码器刻度上限: AS5600 (4096) 1024, SPI 14 bit (16384) 4096
+ *
+ *        当前 2 ms 周期下 1° 周期的纹路 (360 / 圈) 只能保持到约 2.2 rad/s, 细棱这样谐波多的图案更早开始变圆;
+ *        除了几乎不动 (< 0.8 rad/s) 的时候, 上限都来自控制频率; 周期缩短到 250 us 后, 3 rad/s 以下才轮到
+ *        AS5600 的分辨率限制. 旋钮定时器的输出在下一个 FOC 周期才生效,
+ *        r = 0.25 时这一个周期的延迟相当于基波滞后 90°, 这也是通带不放到 Nyquist 附近的原因
+ */
+class HapticTexture {
+public:
+    static constexpr int max_harmonics = 16;
+
+    explicit HapticTexture(float period_s);   // period_s: 控制周期 (s)
+
+    bool set(const TextureSpec &spec);  // 编译图案, 参数不合法时返回 false 并关闭纹理; 不要在旋钮定时器里调用
+
+    void clear() { shape_ = TextureShape::None; }
+
+    // angle: 纹理坐标系 (模式的零点) 下的圈内角度; velocity: rad/s; 返回力矩 (Uq); 只有 Sticky 有状态 (锚点)
+    float render(encoder_angle_t angle, float velocity);
+
+    [[nodiscard]] bool is_enabled() const { return shape_ != TextureShape::None; }
+
+    [[nodiscard]] float get_fade_velocity() const;  // 基波开始衰减的转速 (rad/s)
+
+private:
+    float period_s_;
+    TextureShape shape_ = TextureShape::None;
+    uint16_t cycles_ = 1;
+    int harmonics_ = 0;
+    float amplitude_ = 0;
+    float rest_scale_ = 1;
+    float full_velocity_ = 0;
+    float offset_ = 0;                  // 直流分量, 只有 Sticky 的区域掩码有
+    float cos_[max_harmonics]{};        // 第 h + 1 次谐波的系数
+    float sin_[max_harmonics]{};
+    encoder_angle_t anchor_ = 0;        // Sticky 摩擦弹簧的锚点
+    bool anchored_ = false;
+
+    // 按 N 点采样做离散傅里叶变换, 取前 harmonics 次谐波
+    void _fit(const float *samples, int count, int harmonics);
+};
+
+
+#endif //FOCKNOB_HAPTIC_TEXTURE_H
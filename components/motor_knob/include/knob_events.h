@@ -0,0 +1,82 @@
+#ifndef FOCKNOB_KNOB_EVENTS_H
+#define FOCKNOB_KNOB_EVENTS_H
+
+#include <atomic>
+#include <cstdint>
+
+enum class KnobEventType : uint8_t {
+    DetentCrossed,      // 越过吸附点间的中点, 进入新的吸附点, direction 为 ±1
+    BoundaryHit,        // 顶到边界 (墙), direction: -1 左边界, +1 右边界
+    BoundaryReleased,   // 离开边界回到范围内
+    VelocityAbove,      // |转速| 超过阈值, direction 为转动方向
+    VelocityBelow,      // |转速| 回落到阈值减回差以下
+    ServoArrived,       // 回位伺服到达目标, direction 为 0
+    ServoGrabbed,       // 回位伺服运动中被手抓住, 交回给力矩规律, direction 为 0
+};
+
+struct KnobEvent {
+    int64_t time_us;        // esp_timer_get_time()
+    KnobEventType type;
+    int8_t direction;
+    int32_t detent;         // 事件发生后的吸附点下标
+    float position;         // 相对自定义零点的累计角度 (rad)
+    float velocity;         // rad/s
+};
+
+struct KnobEventReader {
+    uint32_t cursor = 0;    // 下一个要读的事件序号
+    uint32_t dropped = 0;   // 读得太慢被覆盖掉的事件数
+};
+
+/*
+ * @brief 旋钮事件环形缓冲区, 单生产者 / 多消费者, 无锁, 纯 C++
+ *
+ *        - 生产者 (旋钮定时器) 只有 publish(), 从不等待消费者, 满了就覆盖最旧的事件
+ *        - 每个消费者有自己的 KnobEventReader, 互不影响, 都能读到全部事件 (广播), 不需要修改缓冲区
+ *        - 每个槽带序号 (seqlock): 读的过程中被覆盖会被发现, 算作丢失而不是读到半个事件
+ */
+class KnobEventRing {
+public:
+    static constexpr uint32_t capacity = 64;    // 必须是 2 的幂
+
+    void publish(const KnobEvent &event);   // 只能在一个上下文里调用
+
+    void subscribe(KnobEventReader &reader) const;  // 从下一个事件开始读
+
+    bool read(KnobEventReader &reader, KnobEvent &event) const;     // 没有新事件返回 false
+
+    [[nodiscard]] uint32_t get_published() const { return head_.load(std::memory_order_acquire); }
+
+private:
+    struct Slot {
+        std::atomic<uint32_t> stamp{0};     // 序号 + 1, 0 表示正在写
+        KnobEvent event{};
+    };
+
+    Slot slots_[capacity];
+    std::atomic<uint32_t> head_{0};     // 已经发布的事件数
+};
+
+/*
+ * @brief 从旋钮每个周期的状态里检测事件, 在旋钮定时器里调用
+ */
+class KnobEventDetector {
+public:
+    KnobEventDetector(float velocity_threshold, float velocity_hysteresis);
+
+    // 切换模式 / 重置零点后调用, 用当前状态作为起点, 不产生事件
+    void rearm(int detent, int boundary, float velocity);
+
+    // boundary: -1 左边界外, 0 范围内, +1 右边界外; 返回本周期发布的事件数
+    int update(int64_t time_us, int detent, int boundary, float position, float velocity, KnobEventRing &ring);
+
+private:
+    float velocity_threshold_;
+    float velocity_release_;
+    int detent_ = 0;
+    int boundary_ = 0;
+    bool fast_ = false;
+};
+
+
+#endif //FOCKNOB_KNOB_EVENTS_H
@@ -0,0 +1,81 @@
+#ifndef FOCKNOB_KNOB_SERVO_H
+#define FOCKNOB_KNOB_SERVO_H
+
+#include <cstdint>
+#include "scurve_trajectory.h"
+
+enum class ServoState : uint8_t {
+    Idle,       // 没有在伺服
+    Moving,     // 正在按轨迹运动到目标
+    Arrived,    // 到达目标, 交回给力矩规律
+    Grabbed,    // 运动中被手抓住, 交回给力矩规律
+};
+
+/*
+ * @brief 电动推子式的回位伺服: 外部改了数值 (例如别处调了音量) 时, 旋钮自己转到对应的位置, 纯 C++, 不依赖 IDF
+ *
+ *        - 目标按 S 曲线轨迹 (SCurveTrajectory) 平滑过去, 运动中改目标从当前参考点重新规划, 不会突变
+ *        - 力矩 = 轨迹前馈 (J·a + B·v) + 弹簧阻尼跟踪 k·(θ_ref - θ) + c·(ω_ref - ω) + 摩擦前馈, 限幅较小, 抓住时不会硌手.
+ *          摩擦前馈 Fc·sat(ω_ref / 0.5 + (θ_ref - θ) / 0.02): 运动中顺着参考转速, 轨迹走完后顺着剩下的误差;
+ *          力矩模式默认不补偿摩擦, 只靠弹簧的话会停在离目标 Fc / k 的地方 (约 0.06 rad), 等到超时才算到达
+ *        - 抓住检测, 两个条件任一满足:
+ *            1. 卡尔曼估计的外部力矩 τ_ext 与模型不符: 空转时模型能解释全部运动, τ_ext 只有噪声 (均值 ≈ 0),
+ *               手指一碰就是持续同号的力矩. 双边 CUSUM 累计超过 grab_torque 的部分:
+ *                   g+ = max(0, g+ + (τ_ext - grab_torque)·Ts),  g- 同理取反
+ *               τ_ext 先限幅到 ±2·grab_torque, g± 超过 grab_impulse 即为抓住; 单个周期的噪声尖峰
+ *               (起步时的静摩擦, 轨迹换段时的模型失配) 累计不起来, 手的力矩越大发现得越快
+ *            2. 转速和位置都跟不上参考: |ω_ref - ω| 超过 grab_velocity 且 |θ_ref - θ| 超过 grab_error (兜底)
+ *          抓住后立即停止输出, 下一个周期就由力矩规律 (吸附点) 接管, 直到下一次 start()
+ *        - 轨迹走完且停在目标附近 (或者走完 0.25 s 后还没停稳, 例如被吸附点拉着) 算到达
+ *        力矩单位与 Uq 相同, 角度和转速在旋钮的自定义坐标系下
+ */
+class KnobServo {
+public:
+    KnobServo(float stiffness, float damping_ratio, float inertia, float back_emf, float torque_limit,
+              float sample_period_s);
+
+    void set_limits(float max_velocity, float max_acceleration, float max_jerk);  // 下一次 start() 生效
+
+    void set_friction(float coulomb) { friction_ = coulomb; }   // 摩擦前馈 (Uq), 0 表示不加
+
+    // grab_torque: Uq, grab_impulse: Uq·s, grab_velocity: rad/s, grab_error: rad
+    void set_grab_detection(float grab_torque, float grab_impulse, float grab_velocity, float grab_error);
+
+    // 开始运动到 target; 正在运动时从当前参考点重新规划, 否则从旋钮当前的位置和转速开始
+    void start(float target, float position, float velocity);
+
+    void cancel() { state_ = ServoState::Idle; }
+
+    // 每个周期调用一次; 正在伺服时返回 true 并输出力矩, 否则 (空闲 / 刚到达 / 刚被抓住) 返回 false, 由力矩规律输出
+    bool update(float position, float velocity, float external_torque, float &torque);
+
+    [[nodiscard]] ServoState get_state() const { return state_; }
+
+    [[nodiscard]] bool is_moving() const { return state_ == ServoState::Moving; }
+
+    [[nodiscard]] float get_target() const { return trajectory_.get_target(); }
+
+private:
+    float stiffness_;
+    float damping_;         // 由阻尼比和惯量换算
+    float inertia_;
+    float back_emf_;
+    float torque_limit_;
+    float Ts_;
+    float friction_ = 0;
+
+    float grab_torque_ = 0;
+    float grab_impulse_ = 0;
+    float grab_velocity_ = 0;
+    float grab_error_ = 0;
+
+    SCurveTrajectory trajectory_;
+    TrajectoryPoint reference_{};
+    ServoState state_ = ServoState::Idle;
+    float grab_high_ = 0;   // CUSUM, 正向 / 反向的外部力矩
+    float grab_low_ = 0;
+    int settle_count_ = 0;
+};
+
+
+#endif //FOCKNOB_KNOB_SERVO_H
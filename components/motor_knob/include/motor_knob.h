@@ -2,50 +2,120 @@
 #define FOCKNOB_ROTARY_KNOB_H
 
 #include "motor_foc_driver.h"
+#include "haptic_renderer.h"
+#include "haptic_crossfade.h"
+#include "haptic_profile_library.h"
+#include "knob_events.h"
+#include "project_conf.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <atomic>
 #include <functional>
 
 class RotaryKnob {
 public:
-    explicit RotaryKnob(FocDriver *focDriver, AS5600 *as5600);
+    explicit RotaryKnob(FocDriver *focDriver, FocEncoder *encoder);
 
+    /*
+     * 切换模式时新旧两个力矩规律同时计算, 在 transition_ticks 个周期内按 smoothstep 交叉淡化, 力矩不会一步跳变;
+     * stop() 淡出到 0 后才释放电机. 各模式的设置函数只能在同一个任务里调用 (LogicManager)
+     */
     void stop();    // 停止旋钮
     void attractor(int attractor_num, bool reset_custom_pos, float current_radian);  // 设置棘轮吸附模式
     void attractor_with_rebound(int attractor_num, float left_rad, float right_rad, bool reset_custom_pos, float current_radian); // 设置棘轮吸附模式，超出边界后反弹
     void damping(float damping_gain, bool reset_custom_pos, float current_radian);   // 设置阻尼模式 damping_gain 阻尼系数
     void damping_with_rebound(float damping_gain, float left_rad, float right_rad, bool reset_custom_pos, float current_radian); // 设置阻尼模式，超出边界后反弹
+    // 设置飞轮模式: 旋钮带一个虚拟惯量, 甩一下松手后继续转, 按 库仑 + 粘性 摩擦减速, 用手按住就停
+    // inertia 单位 Uq / (rad/s²) (旋钮本身约 0.6), coulomb 单位 Uq, viscous 单位 Uq / (rad/s)
+    void flywheel(float inertia, float coulomb, float viscous, bool reset_custom_pos, float current_radian);
+    // 弹簧力矩增益调度: kp 为吸附/边界刚度的倍率 (1 为默认刚度), kd 为额外阻尼 (Uq / (rad/s)), ki 不使用
+    // 例如低速时加大刚度顶住手指, 快速拨动时减小刚度避免抖动; nullptr 表示使用默认刚度
+    void set_gain_schedule(GainSchedule *schedule);
+    // 吸附点随转速减弱 (快速甩动时不拖手), 在下一次设置模式时生效, 默认按 KNOB_DETENT_FADE_*
+    void set_detent_fade(const DetentFade &fade) { detent_fade_ = fade; }
+    // 空间纹理 (细棱 / 砂纸 / 粘滞区 / 采样图案), 叠加在吸附点和阻尼上, 在下一次设置模式时生效, 一直保留到再次设置
+    // 不用纹理的模式传 TextureShape::None; 参数不合法时返回 false, 纹理关闭. 空间频率上限见 haptic_texture.h
+    // 可以在任意任务里调用 (例如调试控制台)
+    bool set_texture(const TextureSpec &spec);
+    // 模式切换的淡化周期数 (0 为立即切换); reanchor 为 true 时, 不重置零点的切换会把零点平移到新规律里最近的平衡点,
+    // 旋钮停在吸附点之间时不会被拉到远处的吸附点, 代价是显示的角度最多偏移半个吸附点间距; 压在墙里时不平移
+    void set_transition(int ticks, bool reanchor);
+    // 力反馈曲线库 (开机时映射的 haptic 分区), nullptr 表示只用内置的模式
+    void set_profile_library(const HapticProfileLibrary *library) { profile_library_ = library; }
+    [[nodiscard]] const HapticProfileRecord *find_profile(const char *name) const;   // 曲线库里没有返回 nullptr
+    // 按名字加载曲线库里的力反馈曲线, 有界曲线重置时指向 left_rad; 曲线不存在时返回 false, 当前模式不变
+    bool profile(const char *name, bool reset_custom_pos, float current_radian);
+    // 回位伺服 (电动推子): 外部改了数值时旋钮自己平滑地转到 target_rad (自定义坐标系), 运动中可以随时改目标;
+    // 检测到手抓住旋钮后立即交回给当前模式的力矩规律. 到达 / 被抓住时发布 ServoArrived / ServoGrabbed 事件,
+    // 伺服带着旋钮越过的吸附点不发布 DetentCrossed. 在下一个旋钮周期生效, None / 飞轮模式下忽略, 切换模式会取消
+    void servo_to(float target_rad);
+    void servo_cancel();
+    [[nodiscard]] ServoState servo_get_state() const;   // 上一个旋钮周期的状态, 可以在任何任务里调用
     [[nodiscard]] int attractor_get_pos() const;
     [[nodiscard]] float damping_get_pos() const;
+    [[nodiscard]] float flywheel_get_pos() const;      // 飞轮角度 (rad), 上层按它翻动列表
+    [[nodiscard]] float flywheel_get_velocity() const;
     [[nodiscard]] float get_current_radian() const;
 
+    // 旋钮事件 (越过吸附点 / 顶到边界 / 离开边界 / 转速阈值), 带时间戳, 由旋钮定时器发布, 多个消费者各自独立读取
+    // wake_on_event 为 true 时登记调用的任务, 有新事件时用任务通知 (通知值) 唤醒它, 用于 wait_event()
+    void subscribe_events(KnobEventReader &reader, bool wake_on_event);
+    void unsubscribe_events();  // 取消登记调用的任务
+    bool read_event(KnobEventReader &reader, KnobEvent &event) const;   // 不阻塞, 没有新事件返回 false
+    bool wait_event(KnobEventReader &reader, KnobEvent &event, TickType_t timeout) const;   // 阻塞到有事件或超时
+
 
 private:
-    enum class Mode {
-        None,
-        Attractor,              // 棘轮吸附模式
-        AttractorWithRebound,   // 棘轮吸附模式，超出边界后反弹
-        Damping,                // 阻尼模式
-        DampingWithRebound      // 阻尼模式，超出边界后反弹
-    };
-
-    Mode current_mode_ = Mode::None;
     FocDriver *foc_driver_;
-    AS5600 *as5600_;
+    FocEncoder *encoder_;
 
     static void _timer_callback_static(void *args);
 
     void _knob_loop();
 
+    [[nodiscard]] HapticInput _input(int slot) const;
+
+    // 设置零点 (重置到 reset_radian, 或者沿用 current_radian 并按 next 的平衡点重新对齐), 记录到正在设置的槽位
+    void _set_frame(const HapticRenderer &next, bool reset_custom_pos, float reset_radian, float current_radian);
+
+    void _publish();    // 把设置好的槽位交给旋钮定时器
+
+    void _notify_event_waiters();
+
     esp_timer_handle_t knob_timer_{};
 
-    // 棘轮吸附模式参数 (当前角度为0度，顺时针 pos 增加
-    int attractor_number_ = 8;
-    int attractor_current_pos_ = 0;
-    // 阻尼模式参数
-    float damping_gain_ = 20;
-    float damping_current_pos_ = 0.0f;
-    // 超出边界后反弹参数 (当前电机角度为0度来设置
-    float left_boundary_rad_ = -M_PI / 2;
-    float right_boundary_rad_ = M_PI / 2;
+    /*
+     * 四个力矩规律槽位, 三缓冲交接, 不加锁:
+     *   设置任务只写 back_, 写完与 pending_ 交换 (带 slot_fresh 标志)
+     *   旋钮定时器只读 incoming_ / outgoing_, 发现 pending_ 有新的槽位就换进来, 把不再使用的槽位还给 pending_
+     */
+    static constexpr int slot_count = 4;
+    static constexpr int slot_mask = 3;
+    static constexpr int slot_fresh = 4;
+    HapticRenderer renderers_[slot_count];
+    encoder_position_t slot_origin_[slot_count]{};  // 每个槽位的自定义零点 (编码器累计位置)
+    int back_ = 3;                      // 设置任务
+    DetentFade detent_fade_{KNOB_DETENT_FADE_START, KNOB_DETENT_FADE_END, KNOB_DETENT_FADE_MIN};    // 设置任务
+    HapticTexture texture_{FOC_CALC_PERIOD * 1e-6f};  // 设置任务和 set_texture() 的调用者, 由 texture_lock_ 保护
+    portMUX_TYPE texture_lock_ = portMUX_INITIALIZER_UNLOCKED;
+    std::atomic<int> pending_{2};       // 交接
+    std::atomic<int> incoming_{1};      // 旋钮定时器, 当前 (淡入) 的规律
+    int outgoing_ = 0;                  // 旋钮定时器, 淡出的规律
+    HapticCrossfade crossfade_;         // 旋钮定时器
+    bool driving_ = false;              // 旋钮定时器是否在输出力矩
+    std::atomic<int> transition_ticks_{KNOB_TRANSITION_TICKS};
+    std::atomic<bool> reanchor_{true};
+    const HapticProfileLibrary *profile_library_{};
+
+    std::atomic<float> servo_target_{0};        // NaN 表示取消
+    std::atomic<uint32_t> servo_request_{0};    // 设置任务每次请求加一
+    uint32_t servo_handled_ = 0;                // 旋钮定时器
+    std::atomic<ServoState> servo_state_{ServoState::Idle};    // 旋钮定时器写, 上一个周期的伺服状态, 其它任务读
+
+    KnobEventRing events_;
+    KnobEventDetector event_detector_{KNOB_EVENT_VELOCITY_THRESHOLD, KNOB_EVENT_VELOCITY_HYSTERESIS};
+    bool events_rearm_ = true;
+    std::atomic<TaskHandle_t> event_waiters_[KNOB_EVENT_MAX_WAITERS]{};
 };
 
-#endif // FOCKNOB_ROTARY_KNOB_H
\ No newline at end of file
+#endif // FOCKNOB_ROTARY_KNOB_H
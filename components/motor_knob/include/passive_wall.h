@@ -0,0 +1,41 @@
+#ifndef FOCKNOB_PASSIVE_WALL_H
+#define FOCKNOB_PASSIVE_WALL_H
+
+/*
+ * @brief 无源虚拟墙 (能量观测器 + 能量限制), 纯 C++, 不依赖 IDF
+ *
+ *        坐标沿着压进墙的方向: depth > 0 表示越过边界的深度. 墙是单向的 弹簧 + 阻尼:
+ *            f = k·depth + b·depth'        f ≥ 0, 只往墙外推, 不会把旋钮吸进墙里
+ *        离散控制时力是按旧的位置算的 (零阶保持 + 旋钮定时器到 FOC 任务一个周期的延迟), 弹出来时推得比压进去时多,
+ *        墙在往手里注入能量, 刚度一大就来回弹 (颤振). 能量观测器记录墙吸收的能量:
+ *            E += f_applied·(depth_n - depth_{n-1})     f_applied 是这段位移期间电机实际输出的力 (两次调用之前的输出)
+ *        往外退的时候限制推力, 按线性弹簧释放剩下的能量正好把 E 用完:
+ *            f ≤ 2·E / depth
+ *        理想情况下 E = k·depth²/2, 限制不起作用; 延迟让墙少吸收了能量时, 退出来的刚度相应变软, 墙不会输出比吸收的更多的能量
+ *        不需要转速, 不受转速滤波的延迟和噪声影响. 输出的能量超过吸收的部分 (E < 0) 留到下一次接触扣除
+ *        力的单位与 Uq 相同
+ */
+class PassiveWall {
+public:
+    PassiveWall(float damping, float torque_limit);
+
+    void reset();   // 切换模式时调用
+
+    // depth: 越过边界的深度 (rad), 没碰到墙时为负; velocity: depth 的变化率 (rad/s); stiffness: 刚度 (Uq/rad)
+    // 每个周期调用一次, 返回往墙外推的力 (≥ 0, 已限幅)
+    float update(float depth, float velocity, float stiffness);
+
+    [[nodiscard]] float get_energy() const { return energy_; }     // 本次接触墙吸收的能量 (Uq·rad)
+
+private:
+    float damping_;
+    float torque_limit_;
+
+    float energy_ = 0;
+    float last_depth_ = 0;
+    bool has_depth_ = false;
+    float output_[2]{};     // 最近两次的输出, [1] 是正在电机上生效的那个
+};
+
+
+#endif //FOCKNOB_PASSIVE_WALL_H
@@ -0,0 +1,48 @@
+#ifndef FOCKNOB_VIRTUAL_FLYWHEEL_H
+#define FOCKNOB_VIRTUAL_FLYWHEEL_H
+
+/*
+ * @brief 虚拟飞轮, 纯 C++, 不依赖 IDF, 可以在主机上和电机模型一起跑
+ *
+ *        飞轮通过一个弹簧 + 阻尼 (虚拟耦合) 连在旋钮上:
+ *            τ_knob = k·(θ_v - θ) + c·(ω_v - ω)      输出给旋钮的力矩
+ *            J_v·ω_v' = -τ_knob - 摩擦(ω_v)            飞轮受到反作用力矩
+ *        手拧的时候感觉到的是 旋钮 + 飞轮 的惯量, 甩一下松手后飞轮带着旋钮继续转, 按摩擦规律减速
+ *        摩擦规律: 库仑 Fc·sign(ω_v) + 粘性 Bv·ω_v, 库仑摩擦按 "不会让转速反向" 的方式离散, 停下来就停住
+ *
+ *        耦合阻尼 c = 2ζ·√(k·J_v) 按飞轮惯量换算, 抓住旋钮时飞轮相对旋钮的振荡很快衰减, 松手不会反弹
+ *        耦合力矩饱和时 (用手按住旋钮) 弹簧不再继续拉长, 飞轮被拖着走
+ *        所有力矩单位与 Uq 相同, 惯量单位 Uq / (rad/s²)
+ */
+class VirtualFlywheel {
+public:
+    VirtualFlywheel(float stiffness, float damping_ratio, float torque_limit, float sample_period_s);
+
+    // inertia: 飞轮惯量, coulomb: 库仑摩擦 (Uq), viscous: 粘性摩擦 (Uq / (rad/s))
+    void set_friction_law(float inertia, float coulomb, float viscous);
+
+    void reset(float position, float velocity = 0);   // 飞轮与旋钮对齐
+
+    // 每个周期调用一次, 返回输出给旋钮的力矩
+    float update(float knob_position, float knob_velocity);
+
+    [[nodiscard]] float get_position() const { return position_; }  // 飞轮角度 (rad), 供上层快速翻动长列表
+
+    [[nodiscard]] float get_velocity() const { return velocity_; }
+
+private:
+    float stiffness_;
+    float damping_ratio_;
+    float damping_ = 0;     // 由阻尼比和飞轮惯量换算
+    float torque_limit_;
+    float Ts_;
+    float inertia_ = 1.0f;
+    float coulomb_ = 0;
+    float viscous_ = 0;
+
+    float position_ = 0;
+    float velocity_ = 0;
+};
+
+
+#endif //FOCKNOB_VIRTUAL_FLYWHEEL_H
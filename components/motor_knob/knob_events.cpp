@@ -0,0 +1,97 @@
+#include "knob_events.h"
+
+#include <cmath>
+
+static_assert((KnobEventRing::capacity & (KnobEventRing::capacity - 1)) == 0);
+
+void KnobEventRing::publish(const KnobEvent &event) {
+    uint32_t sequence = head_.load(std::memory_order_relaxed);
+    Slot &slot = slots_[sequence & (capacity - 1)];
+    slot.stamp.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.event = event;
+    slot.stamp.store(sequence + 1, std::memory_order_release);
+    head_.store(sequence + 1, std::memory_order_release);
+}
+
+void KnobEventRing::subscribe(KnobEventReader &reader) const {
+    reader.cursor = head_.load(std::memory_order_acquire);
+    reader.dropped = 0;
+}
+
+bool KnobEventRing::read(KnobEventReader &reader, KnobEvent &event) const {
+    while (true) {
+        uint32_t head = head_.load(std::memory_order_acquire);
+        if (reader.cursor == head) {
+            return false;
+        }
+        if (head - reader.cursor > capacity) {      // 被套圈, 跳到最旧的还在缓冲区里的事件
+            reader.dropped += head - reader.cursor - capacity;
+            reader.cursor = head - capacity;
+        }
+        const Slot &slot = slots_[reader.cursor & (capacity - 1)];
+        uint32_t stamp = slot.stamp.load(std::memory_order_acquire);
+        if (stamp == reader.cursor + 1) {
+            event = slot.event;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.stamp.load(std::memory_order_relaxed) == stamp) {
+                reader.cursor++;
+                return true;
+            }
+        }
+        // 这个槽正在被新的事件覆盖, 算作丢失, 不等生产者写完 (生产者可能优先级更低)
+        reader.dropped++;
+        reader.cursor++;
+    }
+}
+
+
+KnobEventDetector::KnobEventDetector(float velocity_threshold, float velocity_hysteresis)
+        : velocity_threshold_(velocity_threshold), velocity_release_(velocity_threshold - velocity_hysteresis) {}
+
+void KnobEventDetector::rearm(int detent, int boundary, float velocity) {
+    detent_ = detent;
+    boundary_ = boundary;
+    fast_ = std::fabs(velocity) > velocity_threshold_;
+}
+
+int KnobEventDetector::update(int64_t time_us, int detent, int boundary, float position, float velocity,
+                              KnobEventRing &ring) {
+    int count = 0;
+    auto emit = [&](KnobEventType type, int direction) {
+        ring.publish({time_us, type, int8_t(direction), detent, position, velocity});
+        count++;
+    };
+
+    // 一个周期跨过多个吸附点时 (甩得很快) 每个都发一个事件, 消费者按个数计数不会少
+    // 跳变太大只可能是换了零点但没有 rearm, 直接对齐
+    if (detent - detent_ > int(KnobEventRing::capacity) || detent_ - detent > int(KnobEventRing::capacity)) {
+        detent_ = detent;
+    }
+    while (detent_ != detent) {
+        int direction = detent > detent_ ? 1 : -1;
+        detent_ += direction;
+        ring.publish({time_us, KnobEventType::DetentCrossed, int8_t(direction), detent_, position, velocity});
+        count++;
+    }
+
+    if (boundary != boundary_) {
+        if (boundary_ != 0) {
+            emit(KnobEventType::BoundaryReleased, boundary_);
+        }
+        if (boundary != 0) {
+            emit(KnobEventType::BoundaryHit, boundary);
+        }
+        boundary_ = boundary;
+    }
+
+    float speed = std::fabs(velocity);
+    if (!fast_ && speed > velocity_threshold_) {
+        fast_ = true;
+        emit(KnobEventType::VelocityAbove, velocity > 0 ? 1 : -1);
+    } else if (fast_ && speed < velocity_release_) {
+        fast_ = false;
+        emit(KnobEventType::VelocityBelow, velocity > 0 ? 1 : -1);
+    }
+    return count;
+}
@@ -0,0 +1,75 @@
+#include "knob_servo.h"
+
+#include <cmath>
+
+#define _constrain(amt, low, high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+static constexpr float arrive_error = 0.02f;        // 离目标多近算到达 (rad)
+static constexpr float arrive_velocity = 0.5f;      // 并且转速低于该值 (rad/s)
+static constexpr float settle_time = 0.25f;         // 轨迹走完后最多等多久 (s), 之后不管停没停稳都交回给力矩规律
+
+KnobServo::KnobServo(float stiffness, float damping_ratio, float inertia, float back_emf, float torque_limit,
+                     float sample_period_s)
+        : stiffness_(stiffness), damping_(2 * damping_ratio * std::sqrt(stiffness * inertia)), inertia_(inertia),
+          back_emf_(back_emf), torque_limit_(torque_limit), Ts_(sample_period_s),
+          trajectory_(1, 1, 1, sample_period_s) {}
+
+void KnobServo::set_limits(float max_velocity, float max_acceleration, float max_jerk) {
+    trajectory_.set_limits(max_velocity, max_acceleration, max_jerk);
+}
+
+void KnobServo::set_grab_detection(float grab_torque, float grab_impulse, float grab_velocity, float grab_error) {
+    grab_torque_ = grab_torque;
+    grab_impulse_ = grab_impulse;
+    grab_velocity_ = grab_velocity;
+    grab_error_ = grab_error;
+}
+
+void KnobServo::start(float target, float position, float velocity) {
+    if (state_ == ServoState::Moving) {
+        trajectory_.plan(reference_.position, reference_.velocity, target);
+    } else {
+        trajectory_.plan(position, velocity, target);
+    }
+    reference_ = trajectory_.current();
+    state_ = ServoState::Moving;
+    grab_high_ = grab_low_ = 0;
+    settle_count_ = 0;
+}
+
+bool KnobServo::update(float position, float velocity, float external_torque, float &torque) {
+    if (state_ != ServoState::Moving) {
+        return false;
+    }
+
+    // 先检查上一个周期的输出之后手有没有抓住旋钮, 抓住了这个周期就不再输出
+    float error = reference_.position - position;
+    float velocity_error = reference_.velocity - velocity;
+    // 单个周期最多按 2 倍阈值累计, 轨迹换段时模型失配的尖峰不会一下子冲过 grab_impulse
+    float clipped = _constrain(external_torque, -2 * grab_torque_, 2 * grab_torque_);
+    grab_high_ = _constrain(grab_high_ + (clipped - grab_torque_) * Ts_, 0.0f, grab_impulse_);
+    grab_low_ = _constrain(grab_low_ + (-clipped - grab_torque_) * Ts_, 0.0f, grab_impulse_);
+    bool stalled = std::fabs(velocity_error) > grab_velocity_ && std::fabs(error) > grab_error_;
+    if (grab_high_ >= grab_impulse_ || grab_low_ >= grab_impulse_ || stalled) {
+        state_ = ServoState::Grabbed;
+        return false;
+    }
+
+    if (trajectory_.is_finished()) {
+        bool settled = std::fabs(trajectory_.get_target() - position) < arrive_error &&
+                       std::fabs(velocity) < arrive_velocity;
+        if (settled || float(++settle_count_) * Ts_ >= settle_time) {
+            state_ = ServoState::Arrived;
+            return false;
+        }
+    }
+
+    reference_ = trajectory_.step();
+    error = reference_.position - position;
+    velocity_error = reference_.velocity - velocity;
+    float friction_drive = reference_.velocity / arrive_velocity + error / arrive_error;
+    torque = inertia_ * reference_.acceleration + back_emf_ * reference_.velocity +
+             stiffness_ * error + damping_ * velocity_error + friction_ * _constrain(friction_drive, -1.0f, 1.0f);
+    torque = _constrain(torque, -torque_limit_, torque_limit_);
+    return true;
+}
@@ -1,12 +1,10 @@
 #include "motor_knob.h"
 #include "project_conf.h" // 包含项目配置, 例如 FOC_CALC_PERIOD
-
+#include "esp_log.h"
 #include <cmath>
 
-#define _constrain(amt, low, high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
-
-RotaryKnob::RotaryKnob(FocDriver *focDriver, AS5600 *as5600)
-    : foc_driver_(focDriver), as5600_(as5600) {
+RotaryKnob::RotaryKnob(FocDriver *focDriver, FocEncoder *encoder)
+    : foc_driver_(focDriver), encoder_(encoder) {
     const esp_timer_create_args_t timer_args = {
         .callback = &RotaryKnob::_timer_callback_static,
         .arg = this,
@@ -17,19 +15,19 @@ RotaryKnob::RotaryKnob(FocDriver *focDriver, AS5600 *as5600)
 }
 
 void RotaryKnob::stop() {
-    current_mode_ = Mode::None;
-    foc_driver_->set_dq(0, 0);
+    HapticRenderer &next = renderers_[back_];
+    next.set_mode(HapticMode::None);
+    slot_origin_[back_] = encoder_->get_custom_offset();
+    _publish();     // 旋钮定时器淡出后输出 0 并释放电机
 }
 
 // 如果不重置，使用current_radian
 void RotaryKnob::attractor(int attractor_num, bool reset_custom_pos, float current_radian) {
-    attractor_number_ = (attractor_num < 1) ? 1 : attractor_num;
-    if (reset_custom_pos) {
-        as5600_->reset_custom_total_radian(); // 重置自定义总弧度
-    } else {
-        as5600_->set_custom_total_radian(current_radian);
-    }
-    current_mode_ = Mode::Attractor;
+    HapticRenderer &next = renderers_[back_];
+    next.set_attractor(attractor_num);
+    next.set_mode(HapticMode::Attractor);
+    _set_frame(next, reset_custom_pos, 0, current_radian);
+    _publish();
 }
 
 /*
@@ -37,53 +35,149 @@ void RotaryKnob::attractor(int attractor_num, bool reset_custom_pos, float curre
  */
 void RotaryKnob::attractor_with_rebound(int attractor_num, float left_rad, float right_rad, bool reset_custom_pos,
                                         float current_radian) {
-    attractor_number_ = (attractor_num < 1) ? 1 : attractor_num - 1;
-    left_boundary_rad_ = left_rad;
-    right_boundary_rad_ = right_rad;
-
-    if (reset_custom_pos) {
-        as5600_->set_custom_total_radian(left_rad); // 重置自定义总弧度
-    } else {
-        as5600_->set_custom_total_radian(current_radian);
-    }
-    current_mode_ = Mode::AttractorWithRebound;
+    HapticRenderer &next = renderers_[back_];
+    next.set_attractor(attractor_num - 1);
+    next.set_boundaries(left_rad, right_rad);
+    next.set_mode(HapticMode::AttractorWithRebound);
+    _set_frame(next, reset_custom_pos, left_rad, current_radian);
+    _publish();
 }
 
 void RotaryKnob::damping(float damping_gain, bool reset_custom_pos, float current_radian) {
-    damping_gain_ = damping_gain;
-
-    if (reset_custom_pos) {
-        as5600_->reset_custom_total_radian(); // 重置自定义总弧度
-    } else {
-        as5600_->set_custom_total_radian(current_radian);
-    }
-    current_mode_ = Mode::Damping;
+    HapticRenderer &next = renderers_[back_];
+    next.set_damping(damping_gain);
+    next.set_mode(HapticMode::Damping);
+    _set_frame(next, reset_custom_pos, 0, current_radian);
+    _publish();
 }
 
 void RotaryKnob::damping_with_rebound(float damping_gain, float left_rad, float right_rad, bool reset_custom_pos,
                                       float current_radian) {
-    damping_gain_ = damping_gain;
-    left_boundary_rad_ = left_rad;
-    right_boundary_rad_ = right_rad;
+    HapticRenderer &next = renderers_[back_];
+    next.set_damping(damping_gain);
+    next.set_boundaries(left_rad, right_rad);
+    next.set_mode(HapticMode::DampingWithRebound);
+    _set_frame(next, reset_custom_pos, left_rad, current_radian);
+    _publish();
+}
 
-    if (reset_custom_pos) {
-        as5600_->set_custom_total_radian(left_rad); // 重置自定义总弧度
-    } else {
-        as5600_->set_custom_total_radian(current_radian);
+void RotaryKnob::flywheel(float inertia, float coulomb, float viscous, bool reset_custom_pos, float current_radian) {
+    HapticRenderer &next = renderers_[back_];
+    next.set_mode(HapticMode::None);
+    _set_frame(next, reset_custom_pos, 0, current_radian);
+    next.set_flywheel(inertia, coulomb, viscous, encoder_position_to_radian(encoder_->get_position() - slot_origin_[back_]));
+    next.set_mode(HapticMode::Flywheel);
+    _publish();
+}
+
+void RotaryKnob::set_gain_schedule(GainSchedule *schedule) {
+    for (HapticRenderer &renderer : renderers_) {
+        renderer.set_gain_schedule(schedule);
+    }
+}
+
+bool RotaryKnob::set_texture(const TextureSpec &spec) {
+    HapticTexture texture(FOC_CALC_PERIOD * 1e-6f);
+    bool ok = texture.set(spec);    // 编译要做傅里叶变换, 不放在临界区里
+    portENTER_CRITICAL(&texture_lock_);
+    texture_ = texture;
+    portEXIT_CRITICAL(&texture_lock_);
+    return ok;
+}
+
+void RotaryKnob::set_transition(int ticks, bool reanchor) {
+    transition_ticks_ = ticks < 0 ? 0 : ticks;
+    reanchor_ = reanchor;
+}
+
+const HapticProfileRecord *RotaryKnob::find_profile(const char *name) const {
+    return profile_library_ ? profile_library_->find(name) : nullptr;
+}
+
+bool RotaryKnob::profile(const char *name, bool reset_custom_pos, float current_radian) {
+    const HapticProfileRecord *record = find_profile(name);
+    if (record == nullptr) {
+        return false;
     }
-    current_mode_ = Mode::DampingWithRebound;
+    HapticRenderer &next = renderers_[back_];
+    HapticProfileLibrary::compile(record, next.edit_profile());
+    if (!next.commit_profile()) {
+        return false;
+    }
+    next.set_mode(HapticMode::Custom);
+    bool bounded = record->flags & haptic_profile_flag_bounded;
+    _set_frame(next, reset_custom_pos, bounded ? record->left_rad : 0, current_radian);
+    _publish();
+    return true;
+}
+
+void RotaryKnob::servo_to(float target_rad) {
+    servo_target_.store(target_rad, std::memory_order_relaxed);
+    servo_request_.fetch_add(1, std::memory_order_release);
+}
+
+void RotaryKnob::servo_cancel() {
+    servo_to(NAN);
+}
+
+ServoState RotaryKnob::servo_get_state() const {
+    return servo_state_.load(std::memory_order_relaxed);
 }
 
 int RotaryKnob::attractor_get_pos() const {
-    return attractor_current_pos_;
+    return renderers_[incoming_].get_attractor_pos();
 }
 
 float RotaryKnob::damping_get_pos() const {
-    return damping_current_pos_;
+    return renderers_[incoming_].get_damping_pos();
+}
+
+float RotaryKnob::flywheel_get_pos() const {
+    return renderers_[incoming_].get_flywheel().get_position();
+}
+
+float RotaryKnob::flywheel_get_velocity() const {
+    return renderers_[incoming_].get_flywheel().get_velocity();
+}
+
+void RotaryKnob::subscribe_events(KnobEventReader &reader, bool wake_on_event) {
+    events_.subscribe(reader);
+    if (!wake_on_event) {
+        return;
+    }
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    for (auto &waiter : event_waiters_) {
+        TaskHandle_t expected = nullptr;
+        if (waiter.load() == task || waiter.compare_exchange_strong(expected, task)) {
+            return;
+        }
+    }
+    ESP_LOGW("RotaryKnob", "Too many event waiters, wait_event() will only time out");
+}
+
+void RotaryKnob::unsubscribe_events() {
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    for (auto &waiter : event_waiters_) {
+        TaskHandle_t expected = task;
+        waiter.compare_exchange_strong(expected, nullptr);
+    }
+}
+
+bool RotaryKnob::read_event(KnobEventReader &reader, KnobEvent &event) const {
+    return events_.read(reader, event);
+}
+
+bool RotaryKnob::wait_event(KnobEventReader &reader, KnobEvent &event, TickType_t timeout) const {
+    if (events_.read(reader, event)) {
+        return true;
+    }
+    // 读完之后才发布的事件会留下通知, 不会错过
+    ulTaskNotifyTake(pdTRUE, timeout);
+    return events_.read(reader, event);
 }
 
 float RotaryKnob::get_current_radian() const {
-    return as5600_->get_custom_total_radian();
+    return encoder_->get_custom_total_radian();
 }
 
 
@@ -94,82 +188,114 @@ void RotaryKnob::_timer_callback_static(void *args) {
 }
 
 void RotaryKnob::_knob_loop() {
-    float current_rad = as5600_->get_custom_total_radian();
-
-    switch (current_mode_) {
-        case Mode::Attractor: {
-            // 棘轮吸附模式
-            // 计算一个简单的kp, 并做饱和处理
-            float kp = 100.0f * logf((float) attractor_number_ + 1.0f) + 100.0f;
-            if (kp > 1000.0f) kp = 1000.0f; // 饱和上限
-
-            float attractor_distance = float(M_TWOPI) / float(attractor_number_);
-            // 找到最近的吸附点(可简单用 round())
-            float target = std::round(current_rad / attractor_distance) * attractor_distance;
-            // 更新当前吸附点
-            attractor_current_pos_ = int(target / attractor_distance);
-            float error = target - current_rad;
-
-            // 设置力矩： dq_out(0, kp*error)
-            float Uq = _constrain(kp * error, -FOC_MCPWM_OUTPUT_LIMIT / 3.0f, FOC_MCPWM_OUTPUT_LIMIT / 3.0f);
-            foc_driver_->set_dq(0, Uq);
-            break;
+    // 取走设置任务交过来的新模式; 正在淡入时直接替换淡入的模式, 权重接着走, 否则当前模式变成淡出的一方
+    if (pending_.load(std::memory_order_acquire) & slot_fresh) {
+        bool fading = crossfade_.fading();
+        int released = fading ? incoming_.load() : outgoing_;
+        if (!fading) {
+            outgoing_ = incoming_;
+            crossfade_.start(transition_ticks_);
         }
-        case Mode::AttractorWithRebound: {
-            // 棘轮吸附模式，超出边界后反弹
-            // 计算吸附位置
-            float range_rad = right_boundary_rad_ - left_boundary_rad_;
-            float attractor_distance = range_rad / float(attractor_number_);
-            int attractor_index = static_cast<int>(roundf((current_rad - left_boundary_rad_) / attractor_distance));
-            // 限制吸附点索引
-            attractor_index = _constrain(attractor_index, 0, attractor_number_);
-            // 计算目标位置
-            float target_rad = left_boundary_rad_ + float(attractor_index) * attractor_distance;
-            // 更新当前吸附位置
-            attractor_current_pos_ = attractor_index;
-            // 计算误差和控制力矩
-            float error = target_rad - current_rad;
-            float kp = 150.0f;
-            float torque = _constrain(kp * error, -FOC_MCPWM_OUTPUT_LIMIT / 3.0f, FOC_MCPWM_OUTPUT_LIMIT / 3.0f);
-            foc_driver_->set_dq(0, torque);
-            break;
+        incoming_ = pending_.exchange(released, std::memory_order_acq_rel) & slot_mask;
+        events_rearm_ = true;
+    }
+
+    int incoming = incoming_;
+    uint32_t servo_request = servo_request_.load(std::memory_order_acquire);
+    if (servo_request != servo_handled_) {
+        servo_handled_ = servo_request;
+        float target = servo_target_.load(std::memory_order_relaxed);
+        if (std::isnan(target)) {
+            renderers_[incoming].servo_cancel();
+        } else {
+            renderers_[incoming].servo_start(target, _input(incoming));
         }
-        case Mode::Damping: {
-            damping_current_pos_ = current_rad;
-            float velocity = as5600_->get_velocity_filter();
-            if (std::fabs(velocity) < 0.1f) {
-                velocity = 0.0f;
-            }
-            float torque = -damping_gain_ * velocity;
-            torque = _constrain(torque, -FOC_MCPWM_OUTPUT_LIMIT / 3.0f, FOC_MCPWM_OUTPUT_LIMIT / 3.0f);
-            foc_driver_->set_dq(0, torque);
-            break;
+    }
+
+    if (!crossfade_.fading() && renderers_[incoming].get_mode() == HapticMode::None) {
+        if (driving_) {     // 淡出结束, 释放电机
+            foc_driver_->set_dq(0, 0);
+            driving_ = false;
         }
-        case Mode::DampingWithRebound: {
-            if (current_rad < left_boundary_rad_ || current_rad > right_boundary_rad_) {
-                float error = 0.0f;
-                if (current_rad < left_boundary_rad_) {
-                    error = left_boundary_rad_ - current_rad;
-                } else if (current_rad > right_boundary_rad_) {
-                    error = right_boundary_rad_ - current_rad;
-                }
-                float kp = 150.0f; // 自行调参
-                float torque = _constrain(kp * error, -FOC_MCPWM_OUTPUT_LIMIT / 3.0f, FOC_MCPWM_OUTPUT_LIMIT / 3.0f);
-                foc_driver_->set_dq(0, torque);
-            } else {
-                damping_current_pos_ = current_rad;
-                float velocity = as5600_->get_velocity_filter();
-                if (std::fabs(velocity) < 0.1f) {
-                    velocity = 0.0f;
-                }
-                float torque = -damping_gain_ * velocity;
-                torque = _constrain(torque, -FOC_MCPWM_OUTPUT_LIMIT / 3.0f, FOC_MCPWM_OUTPUT_LIMIT / 3.0f);
-                foc_driver_->set_dq(0, torque);
-            }
-            break;
+        servo_state_.store(ServoState::Idle, std::memory_order_relaxed);
+        return;
+    }
+
+    HapticInput input = _input(incoming);
+    float torque = renderers_[incoming].render(input);
+    if (crossfade_.fading()) {
+        torque = crossfade_.blend(torque, renderers_[outgoing_].render(_input(outgoing_)));
+    }
+    foc_driver_->set_dq(0, torque);
+    driving_ = true;
+
+    const HapticRenderer &renderer = renderers_[incoming];
+    int detent = renderer.get_attractor_pos();
+    int boundary = renderer.get_boundary();
+    ServoState servo = renderer.get_servo_state();
+    ServoState last_servo = servo_state_.load(std::memory_order_relaxed);
+    if (servo != last_servo) {
+        bool ended = last_servo == ServoState::Moving &&
+                     (servo == ServoState::Arrived || servo == ServoState::Grabbed);
+        servo_state_.store(servo, std::memory_order_relaxed);
+        if (ended) {
+            KnobEventType type = servo == ServoState::Arrived ? KnobEventType::ServoArrived
+                                                              : KnobEventType::ServoGrabbed;
+            events_.publish({esp_timer_get_time(), type, 0, detent, input.position, input.velocity});
+            _notify_event_waiters();
         }
-        case Mode::None: {
-            break;
+    }
+    if (servo == ServoState::Moving) {
+        events_rearm_ = true;   // 伺服带着旋钮转, 不是手拧的, 结束后从停下的位置重新开始检测
+    }
+
+    if (events_rearm_) {
+        events_rearm_ = false;  // 新的模式 / 零点, 事件检测从当前状态重新开始
+        event_detector_.rearm(detent, boundary, input.velocity);
+    } else if (event_detector_.update(esp_timer_get_time(), detent, boundary, input.position, input.velocity,
+                                      events_) > 0) {
+        _notify_event_waiters();
+    }
+}
+
+void RotaryKnob::_notify_event_waiters() {
+    for (auto &waiter : event_waiters_) {
+        TaskHandle_t task = waiter.load(std::memory_order_relaxed);
+        if (task) {
+            xTaskNotifyGive(task);
         }
     }
 }
+
+HapticInput RotaryKnob::_input(int slot) const {
+    // 每个模式在自己设置时的零点下计算, 淡出的模式不受新模式重置零点的影响
+    encoder_position_t position = encoder_->get_position() - slot_origin_[slot];
+    return HapticInput{
+            .position = encoder_position_to_radian(position),
+            .velocity = encoder_->get_velocity_filter(),
+            .estimated_velocity = foc_driver_->get_state_estimator().get_velocity(),
+            .angle = encoder_position_angle(position),
+            .external_torque = foc_driver_->get_state_estimator().get_external_torque(),
+    };
+}
+
+void RotaryKnob::_set_frame(const HapticRenderer &next, bool reset_custom_pos, float reset_radian,
+                            float current_radian) {
+    // 新零点在 FOC 任务下一次采样时生效, 这个模式直接用提交的零点, 不用等
+    if (reset_custom_pos) {
+        slot_origin_[back_] = encoder_->set_custom_total_radian(reset_radian); // 重置自定义总弧度
+    } else if (reanchor_) {
+        // 零点平移到最近的平衡点, 旋钮停在原地, 不会被拉到远处的吸附点
+        slot_origin_[back_] = encoder_->set_custom_total_radian(next.nearest_rest(current_radian));
+    } else {
+        slot_origin_[back_] = encoder_->set_custom_total_radian(current_radian);
+    }
+}
+
+void RotaryKnob::_publish() {
+    renderers_[back_].set_detent_fade(detent_fade_);
+    portENTER_CRITICAL(&texture_lock_);
+    renderers_[back_].set_texture(texture_);
+    portEXIT_CRITICAL(&texture_lock_);
+    back_ = pending_.exchange(back_ | slot_fresh, std::memory_order_acq_rel) & slot_mask;
+}
@@ -0,0 +1,39 @@
+#include "passive_wall.h"
+
+#define _constrain(amt, low, high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+PassiveWall::PassiveWall(float damping, float torque_limit) : damping_(damping), torque_limit_(torque_limit) {}
+
+void PassiveWall::reset() {
+    energy_ = 0;
+    last_depth_ = 0;
+    has_depth_ = false;
+    output_[0] = output_[1] = 0;
+}
+
+float PassiveWall::update(float depth, float velocity, float stiffness) {
+    // 上一段位移期间实际输出的力做的功, 压进墙为正 (墙吸收), 退出来为负 (墙释放)
+    float step = has_depth_ ? depth - last_depth_ : 0;
+    energy_ += output_[1] * step;
+    if (!has_depth_ && depth > 0) {
+        energy_ = 0.5f * stiffness * depth * depth;    // 一开始就在墙里 (例如压着墙切换模式), 按理想弹簧已经吸收的能量算
+    }
+    last_depth_ = depth;
+    has_depth_ = true;
+
+    float force = 0;
+    if (depth > 0) {
+        force = stiffness * depth + damping_ * velocity;
+        if (step < 0) {
+            float budget = energy_ > 0 ? 2 * energy_ / depth : 0;
+            force = force < budget ? force : budget;
+        }
+        force = _constrain(force, 0, torque_limit_);
+    } else if (output_[0] == 0 && output_[1] == 0 && energy_ > 0) {
+        energy_ = 0;    // 离开墙, 延迟的输出也已经结束; 多吸收的能量已经被阻尼耗掉, 欠下的留着
+    }
+
+    output_[1] = output_[0];
+    output_[0] = force;
+    return force;
+}
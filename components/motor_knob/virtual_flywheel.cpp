@@ -0,0 +1,44 @@
+#include "virtual_flywheel.h"
+
+#include <cmath>
+
+#define _constrain(amt, low, high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+VirtualFlywheel::VirtualFlywheel(float stiffness, float damping_ratio, float torque_limit, float sample_period_s)
+        : stiffness_(stiffness), damping_ratio_(damping_ratio), torque_limit_(torque_limit), Ts_(sample_period_s) {
+    set_friction_law(inertia_, coulomb_, viscous_);
+}
+
+void VirtualFlywheel::set_friction_law(float inertia, float coulomb, float viscous) {
+    inertia_ = inertia > 1e-3f ? inertia : 1e-3f;
+    coulomb_ = coulomb > 0 ? coulomb : 0;
+    viscous_ = viscous > 0 ? viscous : 0;
+    damping_ = 2 * damping_ratio_ * std::sqrt(stiffness_ * inertia_);
+}
+
+void VirtualFlywheel::reset(float position, float velocity) {
+    position_ = position;
+    velocity_ = velocity;
+}
+
+float VirtualFlywheel::update(float knob_position, float knob_velocity) {
+    // 弹簧拉长超过力矩限幅对应的长度时, 飞轮被旋钮拖着走 (打滑), 不再储存能量
+    float max_stretch = torque_limit_ / stiffness_;
+    float stretch = _constrain(position_ - knob_position, -max_stretch, max_stretch);
+    position_ = knob_position + stretch;
+
+    float torque = stiffness_ * stretch + damping_ * (velocity_ - knob_velocity);
+    torque = _constrain(torque, -torque_limit_, torque_limit_);
+
+    // 半隐式欧拉: 先更新转速再更新角度; 库仑摩擦最多把转速减到 0, 不会反向
+    float velocity = velocity_ + (-torque - viscous_ * velocity_) * (Ts_ / inertia_);
+    float coulomb_dv = coulomb_ * (Ts_ / inertia_);
+    if (std::fabs(velocity) <= coulomb_dv) {
+        velocity = 0;
+    } else {
+        velocity -= std::copysign(coulomb_dv, velocity);
+    }
+    velocity_ = velocity;
+    position_ += velocity_ * Ts_;
+    return torque;
+}
@@ -0,0 +1,81 @@
+#include "disturbance_observer.h"
+#include <cmath>
+
+DisturbanceObserver::DisturbanceObserver(float inertia, float back_emf, float bandwidth, float sample_period_s,
+                                         float adapt_time_s, float velocity_deadband, float initial_coulomb,
+                                         float initial_viscous)
+        : inertia_(inertia), back_emf_(back_emf), bandwidth_(bandwidth),
+          alpha_(bandwidth * sample_period_s / (1 + bandwidth * sample_period_s)),
+          adapt_gain_(sample_period_s / adapt_time_s), velocity_deadband_(velocity_deadband),
+          coulomb_(initial_coulomb), viscous_(initial_viscous), initial_coulomb_(initial_coulomb),
+          sample_period_s_(sample_period_s) {}
+
+float DisturbanceObserver::update(float uq_applied, float velocity) {
+    drive_filter_ += alpha_ * (uq_applied - back_emf_ * velocity - drive_filter_);
+    velocity_filter_ += alpha_ * (velocity - velocity_filter_);
+    disturbance_ = drive_filter_ - inertia_ * bandwidth_ * (velocity - velocity_filter_);
+    return disturbance_;
+}
+
+void DisturbanceObserver::adapt_friction(float velocity) {
+    // NLMS: 回归量 [sat(ω/ω0), ω], 按回归量能量归一化, 步长与转速范围无关
+    float phi_c = _sat_sign(velocity);
+    float phi_v = velocity;
+    float error = disturbance_ - (coulomb_ * phi_c + viscous_ * phi_v);
+    float norm = phi_c * phi_c + phi_v * phi_v + 1e-3f;
+    coulomb_ = fmaxf(coulomb_ + adapt_gain_ * error * phi_c / norm, 0.0f);
+    viscous_ = fmaxf(viscous_ + adapt_gain_ * error * phi_v / norm, 0.0f);
+}
+
+void DisturbanceObserver::adapt_friction_unattended(float velocity, float external_torque) {
+    hand_filter_ += hand_alpha_ * (external_torque - hand_filter_);
+    // 拟合偏小时阈值也不会跟着变得太小, 否则再也进不来
+    float coulomb = fmaxf(coulomb_, initial_coulomb_ / 2);
+    if (fabsf(hand_filter_) >= hand_ratio_ * coulomb) {
+        unattended_ticks_ = 0;
+        return;
+    }
+    if (unattended_ticks_ < hold_ticks_) {
+        unattended_ticks_++;
+        return;
+    }
+    if (fabsf(velocity) > min_velocity_) {
+        adapt_friction(velocity);
+    }
+}
+
+void DisturbanceObserver::set_unattended_detection(float hand_ratio, float filter_s, float hold_s, float min_velocity) {
+    hand_ratio_ = hand_ratio;
+    hand_alpha_ = sample_period_s_ / (filter_s + sample_period_s_);
+    hold_ticks_ = int(hold_s / sample_period_s_);
+    min_velocity_ = min_velocity;
+}
+
+float DisturbanceObserver::friction_compensation(float velocity) const {
+    return coulomb_ * _sat_sign(velocity) + viscous_ * velocity;
+}
+
+float DisturbanceObserver::friction_compensation(float velocity, float velocity_ramp) const {
+    float x = velocity / velocity_ramp;
+    return coulomb_ * (x > 1 ? 1 : (x < -1 ? -1 : x)) + viscous_ * velocity;
+}
+
+void DisturbanceObserver::set_friction(float coulomb, float viscous) {
+    coulomb_ = coulomb;
+    viscous_ = viscous;
+}
+
+void DisturbanceObserver::reset() {
+    drive_filter_ = 0;
+    velocity_filter_ = 0;
+    disturbance_ = 0;
+    hand_filter_ = 0;
+    unattended_ticks_ = 0;
+}
+
+
+// private
+float DisturbanceObserver::_sat_sign(float velocity) const {
+    float x = velocity / velocity_deadband_;
+    return x > 1 ? 1 : (x < -1 ? -1 : x);
+}
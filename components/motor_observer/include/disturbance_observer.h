@@ -0,0 +1,84 @@
+#ifndef FOCKNOB_DISTURBANCE_OBSERVER_H
+#define FOCKNOB_DISTURBANCE_OBSERVER_H
+
+/*
+ * @brief 扰动观测器 (DOB), 单位全部折算成 Uq
+ *
+ *        电机模型: J·α = Uq - Ke·ω - d, d 为摩擦 + 负载等集总扰动
+ *        d̂ = Q·(Uq - Ke·ω) - J·s·Q·ω, Q = g / (s + g) 为一阶低通, J·s·Q·ω = J·g·(ω - Q·ω), 不需要对转速求导
+ *
+ *        另外用 d̂ 在线拟合摩擦模型 Fc·sat(ω / ω0) + b·ω (NLMS, 时间常数为秒级), 跟踪轴承温度带来的慢变化
+ *        闭环模式可以直接抵消 d̂; 力矩模式下手指的力矩也会进入 d̂, 只能在没有手的时候拟合, 只能抵消拟合出的摩擦模型
+ */
+class DisturbanceObserver {
+public:
+    /*
+     * @param inertia           转动惯量, 单位 Uq / (rad/s²)
+     * @param back_emf          反电动势系数, 单位 Uq / (rad/s)
+     * @param bandwidth         观测器带宽 g (rad/s)
+     * @param adapt_time_s      摩擦模型拟合的时间常数 (秒)
+     * @param velocity_deadband 摩擦模型 sat(ω / ω0) 的线性区 ω0 (rad/s), 零速附近不会过补偿
+     */
+    DisturbanceObserver(float inertia, float back_emf, float bandwidth, float sample_period_s, float adapt_time_s,
+                        float velocity_deadband, float initial_coulomb = 0, float initial_viscous = 0);
+
+    float update(float uq_applied, float velocity);  // 每个周期调用, uq_applied 为上一周期实际输出的 Uq, 返回 d̂
+
+    void adapt_friction(float velocity);  // 用当前的 d̂ 更新摩擦模型, 只应在没有外力 (电机自己运动) 时调用
+
+    /*
+     * @brief 力矩模式用的拟合: 手指的力矩也在 d̂ 里, 只在没有手的时候调用 adapt_friction()
+     *        external_torque 为状态估计器的外部力矩 (已经减去了摩擦模型), 没有手时只剩模型误差, 手拨动旋钮时
+     *        至少有一个摩擦力矩. 低通 (filter_s) 后 |外部力矩| 持续 hold_s 低于 hand_ratio × 库仑摩擦, 且
+     *        |转速| 超过 min_velocity 时才拟合; 不低通直接判断会挑出 d̂ 恰好接近模型的样本, 拟合就不动了,
+     *        松手后等 hold_s 是让 d̂ 从手的力矩里恢复过来
+     */
+    void adapt_friction_unattended(float velocity, float external_torque);
+
+    void set_unattended_detection(float hand_ratio, float filter_s, float hold_s, float min_velocity);
+
+    [[nodiscard]] float get_disturbance() const { return disturbance_; }
+
+    [[nodiscard]] float friction_compensation(float velocity) const;   // 摩擦模型在该转速下的摩擦 (Uq)
+
+    // 同上, 但库仑项按更宽的线性区 velocity_ramp 过渡; 用作力矩模式的输出时, 零速附近的负阻尼 Fc / velocity_ramp 更小,
+    // 不会把编码器转速噪声放大成静止时的力矩抖动
+    [[nodiscard]] float friction_compensation(float velocity, float velocity_ramp) const;
+
+    [[nodiscard]] float get_coulomb() const { return coulomb_; }
+
+    [[nodiscard]] float get_viscous() const { return viscous_; }
+
+    void set_friction(float coulomb, float viscous);
+
+    void reset();
+
+private:
+    float inertia_;
+    float back_emf_;
+    float bandwidth_;
+    float alpha_;           // Q 的离散系数 g·Ts / (1 + g·Ts)
+    float adapt_gain_;      // NLMS 步长
+    float velocity_deadband_;
+
+    float drive_filter_ = 0;    // Q·(Uq - Ke·ω)
+    float velocity_filter_ = 0; // Q·ω
+    float disturbance_ = 0;
+
+    float coulomb_;
+    float viscous_;
+    float initial_coulomb_;
+
+    float sample_period_s_;
+    float hand_ratio_ = 0.5f;
+    float hand_alpha_ = 1;      // 外部力矩低通的离散系数
+    int hold_ticks_ = 0;
+    float min_velocity_ = 0;
+    float hand_filter_ = 0;
+    int unattended_ticks_ = 0;
+
+    [[nodiscard]] float _sat_sign(float velocity) const;
+};
+
+
+#endif //FOCKNOB_DISTURBANCE_OBSERVER_H
@@ -0,0 +1,58 @@
+#ifndef FOCKNOB_KALMAN_ESTIMATOR_H
+#define FOCKNOB_KALMAN_ESTIMATOR_H
+
+#include "encoder_position.h"
+#include "small_matrix.h"
+
+/*
+ * @brief 角度 / 转速 / 外部力矩 卡尔曼滤波器, 力矩单位与 Uq 相同
+ *
+ *        状态 x = [θ, ω, τ_ext], 模型 (与 DisturbanceObserver 相同的参数):
+ *            θ' = ω
+ *            J·ω' = Uq - B·ω - 摩擦 + τ_ext
+ *            τ_ext' = 白噪声 (随机游走)
+ *        量测只有编码器角度, H = [1 0 0], 新息是标量, 不需要求逆, 每个周期固定是 3×3 的矩阵运算
+ *
+ *        τ_ext 是摩擦模型以外的所有力矩, 空转时约为 0, 用手拧/按住时就是手指的力矩 (正值推向正方向)
+ *        θ 相对于一个整圈的基准位置保存, 超过一圈时整圈平移基准, 转多少圈 float 精度都不变
+ */
+class KalmanEstimator {
+public:
+    /*
+     * @param inertia           J, 单位 Uq / (rad/s²)
+     * @param damping           B (反电动势 + 粘性摩擦), 单位 Uq / (rad/s)
+     * @param angle_noise       角度量测噪声标准差 (rad)
+     * @param velocity_noise    转速过程噪声谱密度 (rad/s / √s), 模型误差
+     * @param torque_noise      外部力矩过程噪声谱密度 (Uq / √s), 越大力矩估计越快、噪声越大
+     */
+    KalmanEstimator(float inertia, float damping, float sample_period_s, float angle_noise, float velocity_noise,
+                    float torque_noise);
+
+    void reset(encoder_position_t position);
+
+    // 每个控制周期调用一次: uq_applied 为上一周期实际输出的 Uq, friction 为摩擦模型的力矩, measured 为本周期的编码器位置
+    void update(float uq_applied, float friction, encoder_position_t measured);
+
+    [[nodiscard]] float get_angle() const;  // 估计的累计角度 (rad)
+
+    [[nodiscard]] float get_velocity() const { return x_(1, 0); }
+
+    [[nodiscard]] float get_external_torque() const { return x_(2, 0); }
+
+    [[nodiscard]] float get_innovation() const { return innovation_; }     // 最近一次的量测残差 (rad)
+
+private:
+    SmallMatrix<3, 3> F_;   // 状态转移
+    SmallMatrix<3, 1> G_;   // 输入 (Uq - 摩擦)
+    SmallMatrix<3, 3> Q_;
+    float r_;               // 角度量测噪声方差
+
+    SmallMatrix<3, 1> x_;
+    SmallMatrix<3, 3> P_;
+    encoder_position_t base_ = 0;   // θ 的整圈基准
+    bool initialized_ = false;
+    float innovation_ = 0;
+};
+
+
+#endif //FOCKNOB_KALMAN_ESTIMATOR_H
@@ -0,0 +1,62 @@
+#ifndef FOCKNOB_SMALL_MATRIX_H
+#define FOCKNOB_SMALL_MATRIX_H
+
+/*
+ * @brief 编译期固定大小的小矩阵, 行主序, 没有动态内存, 循环次数都是常量, 编译器会完全展开
+ *        只实现状态估计需要的运算
+ */
+template<int R, int C>
+struct SmallMatrix {
+    float m[R][C]{};
+
+    float &operator()(int r, int c) { return m[r][c]; }
+
+    float operator()(int r, int c) const { return m[r][c]; }
+
+    static SmallMatrix identity() {
+        static_assert(R == C, "identity needs a square matrix");
+        SmallMatrix result;
+        for (int i = 0; i < R; i++) {
+            result.m[i][i] = 1;
+        }
+        return result;
+    }
+
+    template<int K>
+    SmallMatrix<R, K> operator*(const SmallMatrix<C, K> &o) const {
+        SmallMatrix<R, K> result;
+        for (int r = 0; r < R; r++) {
+            for (int k = 0; k < K; k++) {
+                float sum = 0;
+                for (int c = 0; c < C; c++) {
+                    sum += m[r][c] * o.m[c][k];
+                }
+                result.m[r][k] = sum;
+            }
+        }
+        return result;
+    }
+
+    SmallMatrix operator+(const SmallMatrix &o) const {
+        SmallMatrix result;
+        for (int r = 0; r < R; r++) {
+            for (int c = 0; c < C; c++) {
+                result.m[r][c] = m[r][c] + o.m[r][c];
+            }
+        }
+        return result;
+    }
+
+    [[nodiscard]] SmallMatrix<C, R> transpose() const {
+        SmallMatrix<C, R> result;
+        for (int r = 0; r < R; r++) {
+            for (int c = 0; c < C; c++) {
+                result.m[c][r] = m[r][c];
+            }
+        }
+        return result;
+    }
+};
+
+
+#endif //FOCKNOB_SMALL_MATRIX_H
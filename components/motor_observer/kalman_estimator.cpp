@@ -0,0 +1,63 @@
+#include "kalman_estimator.h"
+
+KalmanEstimator::KalmanEstimator(float inertia, float damping, float sample_period_s, float angle_noise,
+                                 float velocity_noise, float torque_noise)
+        : r_(angle_noise * angle_noise) {
+    float Ts = sample_period_s;
+    // 离散化: 角度用二阶泰勒展开, 转速和力矩一阶
+    F_ = SmallMatrix<3, 3>::identity();
+    F_(0, 1) = Ts;
+    F_(0, 2) = Ts * Ts / (2 * inertia);
+    F_(1, 1) = 1 - damping * Ts / inertia;
+    F_(1, 2) = Ts / inertia;
+    G_(0, 0) = Ts * Ts / (2 * inertia);
+    G_(1, 0) = Ts / inertia;
+    Q_(1, 1) = velocity_noise * velocity_noise * Ts;
+    Q_(2, 2) = torque_noise * torque_noise * Ts;
+}
+
+void KalmanEstimator::reset(encoder_position_t position) {
+    base_ = position;
+    x_ = {};
+    P_ = SmallMatrix<3, 3>::identity();
+    P_(0, 0) = r_;
+    P_(2, 2) = 100.0f * 100.0f;     // 初始外部力矩未知
+    initialized_ = true;
+}
+
+void KalmanEstimator::update(float uq_applied, float friction, encoder_position_t measured) {
+    if (!initialized_) {
+        reset(measured);
+        return;
+    }
+
+    // 预测
+    SmallMatrix<3, 1> input;
+    input(0, 0) = G_(0, 0) * (uq_applied - friction);
+    input(1, 0) = G_(1, 0) * (uq_applied - friction);
+    x_ = F_ * x_ + input;
+    P_ = F_ * P_ * F_.transpose() + Q_;
+
+    // 更新, H = [1 0 0]: S = P00 + R, K = P(:,0) / S
+    innovation_ = float(measured - base_) * ENCODER_RADIAN_PER_LSB - x_(0, 0);
+    float s_inv = 1.0f / (P_(0, 0) + r_);
+    float k[3] = {P_(0, 0) * s_inv, P_(1, 0) * s_inv, P_(2, 0) * s_inv};
+    float p_row0[3] = {P_(0, 0), P_(0, 1), P_(0, 2)};
+    for (int i = 0; i < 3; i++) {
+        x_(i, 0) += k[i] * innovation_;
+        for (int j = 0; j < 3; j++) {
+            P_(i, j) -= k[i] * p_row0[j];
+        }
+    }
+
+    // 超过一圈时整圈平移基准
+    if (x_(0, 0) > float(M_TWOPI) || x_(0, 0) < -float(M_TWOPI)) {
+        auto turns = int32_t(x_(0, 0) / float(M_TWOPI));
+        base_ += encoder_position_t(turns) * ENCODER_POSITION_ONE_TURN;
+        x_(0, 0) -= float(turns) * float(M_TWOPI);
+    }
+}
+
+float KalmanEstimator::get_angle() const {
+    return encoder_position_to_radian(base_) + x_(0, 0);
+}
@@ -0,0 +1,72 @@
+#ifndef FOCKNOB_MOTOR_CASCADE_CONTROLLER_H
+#define FOCKNOB_MOTOR_CASCADE_CONTROLLER_H
+
+#include <atomic>
+#include <cstdint>
+#include "motor_pid_controller.h"
+#include "motor_gain_schedule.h"
+
+/*
+ * @brief 位置 → 速度 串级控制器
+ *
+ *        外环: 位置误差 → 速度修正量, 每 outer_divider 个周期运行一次, 中间保持上一次的输出
+ *        内环: 速度误差 → Uq, 每个周期运行
+ *        速度前馈 (轨迹速度) 每个周期直接加到速度指令上, 输出前馈 (反电动势/惯量) 直接加到 Uq 上, 不受外环分频影响
+ *        速度指令和输出各自限幅
+ *        set_loops / set_outer_divider 可以在其他任务里调用, 只记下新配置, 下一次 update() 开始时由控制任务复位 PID 并生效
+ *        外环/内环用的是绑定了增益调度表的 PID 时, 每次运行前按当前转速和位置从表中插值出参数 (覆盖 PID 自身的参数),
+ *        调用方传入的其他 PID 保持自己的参数
+ *        从别的模式切换过来时先调用 track(), 内环积分从当前输出开始, 输出不跳变
+ */
+class CascadeController {
+public:
+    CascadeController(int outer_divider, float velocity_limit, float output_limit);
+
+    void set_loops(PIDController *pid_position, PIDController *pid_velocity);   // 切换外环/内环的 PID, PID 变化时复位外环 (下一次 update() 生效)
+
+    // 调度表拥有 pid_position / pid_velocity 的参数, nullptr 表示不调度
+    void set_schedules(GainSchedule *position_schedule, PIDController *pid_position, GainSchedule *velocity_schedule,
+                       PIDController *pid_velocity);
+
+    void set_outer_divider(int outer_divider);    // 下一次 update() 生效
+
+    void set_limits(float velocity_limit, float output_limit);
+
+    void track(float output);   // 控制任务调用, 下一次 update() 从 output (含输出前馈的 Uq) 接着算
+
+    // 每个控制周期调用一次, 返回 Uq; 还没有设置 PID 时返回 0
+    float update(float position_ref, float position, float velocity_ff, float velocity, float output_ff = 0);
+
+    [[nodiscard]] float get_velocity_command() const { return velocity_command_; }   // 最近一次的速度指令 (含前馈)
+
+    [[nodiscard]] int get_outer_divider() const { return requested_outer_divider_; }
+
+private:
+    PIDController *pid_position_{};
+    PIDController *pid_velocity_{};
+    GainSchedule *position_schedule_{};
+    GainSchedule *velocity_schedule_{};
+    PIDController *scheduled_pid_position_{};   // 调度表绑定的 PID
+    PIDController *scheduled_pid_velocity_{};
+    int outer_divider_;
+    float velocity_limit_;
+    float output_limit_;
+
+    // 其他任务提交的配置, 控制任务在 update() 开始时取走
+    std::atomic<PIDController *> requested_pid_position_{};
+    std::atomic<PIDController *> requested_pid_velocity_{};
+    std::atomic<int> requested_outer_divider_;
+    std::atomic<uint32_t> config_request_{0};   // 每次提交加 1
+    uint32_t config_handled_ = 0;
+
+    uint32_t tick_ = 0;
+    float velocity_correction_ = 0;     // 外环输出, 在两次外环更新之间保持
+    float velocity_command_ = 0;
+    float track_output_ = 0;
+    bool track_pending_ = false;
+
+    void _apply_config();   // 控制任务调用, 应用新提交的 PID 和分频
+};
+
+
+#endif //FOCKNOB_MOTOR_CASCADE_CONTROLLER_H
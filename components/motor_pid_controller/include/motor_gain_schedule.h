@@ -0,0 +1,62 @@
+#ifndef FOCKNOB_MOTOR_GAIN_SCHEDULE_H
+#define FOCKNOB_MOTOR_GAIN_SCHEDULE_H
+
+#include <atomic>
+#include <cstdint>
+#include "motor_pid_controller.h"
+
+/*
+ * @brief 增益调度表
+ *
+ *        速度轴: |转速| 在 [0, max_velocity] 上均匀分布 velocity_points 个点, 超出范围取端点
+ *        位置轴: 位置对 position_period 取模后在一个周期内均匀分布 position_points 个点 (首尾相接),
+ *                例如周期设为棘轮间距, 就可以区分 "卡在吸附点上" 和 "在两个吸附点之间"; position_points 为 1 表示不按位置调度
+ *        点均匀分布, 查表直接算下标, 双线性插值, 每个周期的计算量固定
+ */
+struct GainTable {
+    static constexpr int max_velocity_points = 6;
+    static constexpr int max_position_points = 4;
+
+    uint8_t velocity_points = 1;
+    uint8_t position_points = 1;
+    float max_velocity = 20.0f;     // 速度轴最后一个点对应的转速 (rad/s)
+    float position_period = 0;      // 位置轴周期 (rad)
+    PidGains gains[max_position_points][max_velocity_points]{};     // [位置点][速度点]
+};
+
+/*
+ * @brief 增益调度器, 三缓冲: 控制任务每次 evaluate() 先固定最近一次提交的表, 控制台在第三份上修改, commit() 时原子切换
+ *        草稿不会是控制任务正在读的表, 连续两次 commit() 也不会改到正在插值的表
+ *        evaluate() / apply() 只能在一个任务里调用 (FOC 任务或者旋钮定时器), 其他任务用 get_table() 读最近一次提交的表
+ *
+ *        调度表拥有所绑定 PID 的参数: apply() 每个周期都会覆盖 PID 自身的参数, 修改参数要改表 (fill / edit + commit)
+ */
+class GainSchedule {
+public:
+    explicit GainSchedule(const PidGains &gains);  // 所有点都是同一组参数 (等于不调度)
+
+    [[nodiscard]] PidGains evaluate(float velocity, float position = 0) const;   // 控制周期调用
+
+    void apply(PIDController *pid, float velocity, float position = 0) const;   // 插值后写入 PID, 覆盖 PID 自身的参数
+
+    [[nodiscard]] const GainTable &get_table() const { return tables_[active_]; }
+
+    GainTable &edit();  // 复制当前的表作为草稿并返回, 修改后调用 commit()
+
+    bool commit();  // 检查草稿并切换, 点数不合法时返回 false, 当前的表不变
+
+    void fill(const PidGains &gains);   // 所有点设为同一组参数并立即生效
+
+private:
+    GainTable tables_[3]{};
+    float inv_velocity_step_[3]{};  // (velocity_points - 1) / max_velocity
+    float inv_position_period_[3]{};
+    std::atomic<int> active_{0};            // 最近一次提交的表
+    mutable std::atomic<int> reading_{0};   // 控制任务正在读的表, 只有 evaluate() 修改
+    int draft_ = 1;                         // 修改调度表的任务独占
+
+    [[nodiscard]] int _acquire() const;
+};
+
+
+#endif //FOCKNOB_MOTOR_GAIN_SCHEDULE_H
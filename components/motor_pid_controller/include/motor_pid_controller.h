@@ -5,14 +5,44 @@
 #ifndef FOCKNOB_MOTOR_PID_CONTROLLER_H
 #define FOCKNOB_MOTOR_PID_CONTROLLER_H
 
+#include "project_conf.h"
 
+
+struct PidGains {
+    float kp;
+    float ki;
+    float kd;
+};
+
+/*
+ * @brief PID 控制器
+ *
+ *        - 微分作用在测量值上, 并经过一阶低通 (时间常数 d_filter_tau), 设定值阶跃不会产生微分冲击
+ *        - 反算抗饱和: 输出限幅时积分项按 (限幅后 - 限幅前) × Ki / Kp 回退, integral_limit 只作为最后的保护
+ *        - 静摩擦补偿在 |u| < friction_deadband 内线性过渡, 零点附近不会在 ±static_friction_torque 之间来回跳
+ *        - 无扰切换: 修改增益时调整积分项, 当前输出不变; 其他控制器接管输出期间调用 track(), 切回来时输出不跳变
+ *          没有积分作用 (Ki = 0) 时积分项保持为 0, 增益修改直接生效
+ */
 class PIDController {
 public:
-    PIDController(float kp, float ki, float kd, float output_limit, float integral_limit, float static_friction_torque);
+    PIDController(float kp, float ki, float kd, float output_limit, float integral_limit, float static_friction_torque,
+                  float friction_deadband = FOC_PID_FRICTION_DEADBAND, float d_filter_tau = FOC_PID_D_FILTER_TAU);
+
+    void setPID(float kp, float ki, float kd);  // 无扰修改增益, 会改积分项: 在控制任务里调用, 或者 PID 没有在运行时调用
+
+    [[nodiscard]] PidGains getPID() const;
+
+    void setSamplePeriod(float sample_period_s);   // 调用周期不是 FOC_CALC_PERIOD 时设置 (例如分频运行的外环)
+
+    void setDerivativeFilter(float d_filter_tau);   // 微分低通时间常数(秒), 0 表示不滤波
+
+    void reset();   // 清空积分和微分历史
 
-    void setPID(float kp, float ki, float kd);
+    // 每个周期调用一次; feedforward 直接加到输出上, 一起参与限幅和抗饱和
+    float calculate(float setpoint, float measurement, float feedforward = 0);
 
-    float calculate(float error);
+    // 输出由别的控制器决定时调用 (手动模式 / 切换模式前), 积分项跟踪实际输出 output, 下一次 calculate() 从这里接着算
+    void track(float output, float setpoint, float measurement, float feedforward = 0);
 
 private:
     float kp_{};
@@ -21,12 +51,20 @@ private:
     float output_limit_{};  // 输出限幅
     float integral_limit_{};    // 积分限幅
     float static_friction_torque_{};
+    float friction_deadband_{};
+    float d_filter_tau_{};
+    float sample_period_s_{};   // 采样周期, 单位: 秒
+    float d_alpha_{};           // 微分低通系数 Ts / (tau + Ts)
 
-    float proportional_{};
     float integral_{};
-    float derivative_{};
+    float d_rate_{};            // 低通后的 -dy/dt
+    float previous_measurement_{};
+    bool has_previous_ = false;
+    float previous_error_{};    // 上一次 calculate() 的误差, 修改增益时用来保持输出
 
-    float previousError_{};
+    void _update_filter();
+    [[nodiscard]] float _friction(float u) const;
+    [[nodiscard]] float _clamp_integral(float integral) const;
 };
 
 
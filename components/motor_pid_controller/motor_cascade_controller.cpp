@@ -0,0 +1,92 @@
+#include "motor_cascade_controller.h"
+#include "project_conf.h"
+
+#define _constrain(amt, low, high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+CascadeController::CascadeController(int outer_divider, float velocity_limit, float output_limit)
+        : outer_divider_(outer_divider > 0 ? outer_divider : 1), velocity_limit_(velocity_limit),
+          output_limit_(output_limit), requested_outer_divider_(outer_divider_) {}
+
+void CascadeController::set_loops(PIDController *pid_position, PIDController *pid_velocity) {
+    // PID 可能正在控制任务里运行, 复位和修改采样周期都交给控制任务做
+    requested_pid_position_.store(pid_position, std::memory_order_relaxed);
+    requested_pid_velocity_.store(pid_velocity, std::memory_order_relaxed);
+    config_request_.fetch_add(1, std::memory_order_release);
+}
+
+void CascadeController::set_schedules(GainSchedule *position_schedule, PIDController *pid_position,
+                                      GainSchedule *velocity_schedule, PIDController *pid_velocity) {
+    position_schedule_ = position_schedule;
+    scheduled_pid_position_ = pid_position;
+    velocity_schedule_ = velocity_schedule;
+    scheduled_pid_velocity_ = pid_velocity;
+}
+
+void CascadeController::set_outer_divider(int outer_divider) {
+    requested_outer_divider_.store(outer_divider > 0 ? outer_divider : 1, std::memory_order_relaxed);
+    config_request_.fetch_add(1, std::memory_order_release);
+}
+
+void CascadeController::track(float output) {
+    track_output_ = output;
+    track_pending_ = true;
+}
+
+void CascadeController::set_limits(float velocity_limit, float output_limit) {
+    velocity_limit_ = velocity_limit;
+    output_limit_ = output_limit;
+}
+
+float CascadeController::update(float position_ref, float position, float velocity_ff, float velocity,
+                                 float output_ff) {
+    _apply_config();
+    if (pid_position_ == nullptr || pid_velocity_ == nullptr) {
+        return 0;
+    }
+    if (tick_ % outer_divider_ == 0) {  // 外环
+        if (position_schedule_ && pid_position_ == scheduled_pid_position_) {
+            position_schedule_->apply(pid_position_, velocity, position);
+        }
+        velocity_correction_ = pid_position_->calculate(position_ref, position);
+    }
+    tick_++;
+
+    // 内环
+    velocity_command_ = _constrain(velocity_ff + velocity_correction_, -velocity_limit_, velocity_limit_);
+    if (velocity_schedule_ && pid_velocity_ == scheduled_pid_velocity_) {
+        velocity_schedule_->apply(pid_velocity_, velocity, position);
+    }
+    if (track_pending_) {   // 从别的模式切过来, 内环从当前输出接着算
+        pid_velocity_->track(track_output_, velocity_command_, velocity, output_ff);
+        track_pending_ = false;
+    }
+    float u = pid_velocity_->calculate(velocity_command_, velocity, output_ff);
+    return _constrain(u, -output_limit_, output_limit_);
+}
+
+void CascadeController::_apply_config() {
+    uint32_t request = config_request_.load(std::memory_order_acquire);
+    if (request == config_handled_) {
+        return;
+    }
+    PIDController *pid_position = requested_pid_position_.load(std::memory_order_relaxed);
+    PIDController *pid_velocity = requested_pid_velocity_.load(std::memory_order_relaxed);
+    int outer_divider = requested_outer_divider_.load(std::memory_order_relaxed);
+    if (config_request_.load(std::memory_order_acquire) != request) {
+        return;     // 读的时候又提交了新配置, 外环和内环可能不是同一次的, 下个周期再处理
+    }
+    config_handled_ = request;
+
+    if (pid_position == pid_position_ && pid_velocity == pid_velocity_ && outer_divider == outer_divider_) {
+        return;
+    }
+    pid_position_ = pid_position;
+    pid_velocity_ = pid_velocity;
+    outer_divider_ = outer_divider;
+    if (pid_position_) {
+        pid_position_->setSamplePeriod(float(outer_divider_) * FOC_CALC_PERIOD * 1e-6f);   // 外环按分频后的周期积分/微分
+        pid_position_->reset();
+    }
+    tick_ = 0;
+    velocity_correction_ = 0;
+}
@@ -0,0 +1,92 @@
+#include "motor_gain_schedule.h"
+#include <cmath>
+
+GainSchedule::GainSchedule(const PidGains &gains) {
+    fill(gains);
+}
+
+PidGains GainSchedule::evaluate(float velocity, float position) const {
+    int table = _acquire();
+    const GainTable &t = tables_[table];
+
+    // 速度轴, 超出范围取端点
+    int iv0 = 0, iv1 = 0;
+    float wv = 0;
+    if (t.velocity_points > 1) {
+        float fv = fminf(fabsf(velocity) * inv_velocity_step_[table], float(t.velocity_points - 1));
+        iv0 = int(fv);
+        iv1 = iv0 + 1 < t.velocity_points ? iv0 + 1 : iv0;
+        wv = fv - float(iv0);
+    }
+
+    // 位置轴, 周期性, 最后一个点和第一个点之间也插值
+    int ip0 = 0, ip1 = 0;
+    float wp = 0;
+    if (t.position_points > 1) {
+        float phase = position * inv_position_period_[table];
+        float fp = (phase - floorf(phase)) * float(t.position_points);
+        ip0 = int(fp) < t.position_points ? int(fp) : t.position_points - 1;
+        ip1 = ip0 + 1 < t.position_points ? ip0 + 1 : 0;
+        wp = fp - float(ip0);
+    }
+
+    const PidGains &g00 = t.gains[ip0][iv0], &g01 = t.gains[ip0][iv1];
+    const PidGains &g10 = t.gains[ip1][iv0], &g11 = t.gains[ip1][iv1];
+    float w00 = (1 - wp) * (1 - wv), w01 = (1 - wp) * wv, w10 = wp * (1 - wv), w11 = wp * wv;
+    return {w00 * g00.kp + w01 * g01.kp + w10 * g10.kp + w11 * g11.kp,
+            w00 * g00.ki + w01 * g01.ki + w10 * g10.ki + w11 * g11.ki,
+            w00 * g00.kd + w01 * g01.kd + w10 * g10.kd + w11 * g11.kd};
+}
+
+void GainSchedule::apply(PIDController *pid, float velocity, float position) const {
+    PidGains gains = evaluate(velocity, position);
+    pid->setPID(gains.kp, gains.ki, gains.kd);
+}
+
+GainTable &GainSchedule::edit() {
+    int active = active_, reading = reading_;
+    int draft = 0;
+    while (draft == active || draft == reading) {   // 三份里总有一份既不是最新的, 也不是控制任务在读的
+        draft++;
+    }
+    draft_ = draft;
+    tables_[draft] = tables_[active];
+    return tables_[draft];
+}
+
+bool GainSchedule::commit() {
+    int draft = draft_;
+    GainTable &t = tables_[draft];
+    if (t.velocity_points < 1 || t.velocity_points > GainTable::max_velocity_points ||
+        t.position_points < 1 || t.position_points > GainTable::max_position_points ||
+        (t.velocity_points > 1 && t.max_velocity <= 0) || (t.position_points > 1 && t.position_period <= 0)) {
+        return false;
+    }
+    inv_velocity_step_[draft] = t.velocity_points > 1 ? float(t.velocity_points - 1) / t.max_velocity : 0;
+    inv_position_period_[draft] = t.position_points > 1 ? 1.0f / t.position_period : 0;
+    active_ = draft;
+    return true;
+}
+
+int GainSchedule::_acquire() const {
+    // 先公布要读的表再确认它仍然是最新的: 确认之后 edit() 一定能看到 reading_, 不会拿它当草稿
+    int table = active_;
+    while (true) {
+        reading_ = table;
+        int latest = active_;
+        if (latest == table) {
+            return table;
+        }
+        table = latest;
+    }
+}
+
+void GainSchedule::fill(const PidGains &gains) {
+    GainTable &t = edit();
+    for (auto &row: t.gains) {
+        for (auto &g: row) {
+            g = gains;
+        }
+    }
+    commit();
+}
@@ -3,43 +3,102 @@
 //
 
 #include "motor_pid_controller.h"
-#include "project_conf.h"
 
 #define _constrain(amt, low, high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
 
 PIDController::PIDController(float kp, float ki, float kd, float output_limit, float integral_limit,
-                             float static_friction_torque)
+                             float static_friction_torque, float friction_deadband, float d_filter_tau)
         : kp_(kp), ki_(ki), kd_(kd), output_limit_(output_limit), integral_limit_(integral_limit),
-          static_friction_torque_(static_friction_torque) {}
+          static_friction_torque_(static_friction_torque), friction_deadband_(friction_deadband),
+          d_filter_tau_(d_filter_tau), sample_period_s_(FOC_CALC_PERIOD * 1e-6f) {
+    _update_filter();
+}
+
+float PIDController::calculate(float setpoint, float measurement, float feedforward) {
+    float Ts = sample_period_s_; // 单位: 秒
+    float error = setpoint - measurement;
 
-float PIDController::calculate(float error) {
-    float Ts = FOC_CALC_PERIOD * 1e-6f; // 单位: 秒
+    // 微分作用在测量值上, 第一次调用没有历史, 不算微分
+    float delta = has_previous_ ? previous_measurement_ - measurement : 0;
+    previous_measurement_ = measurement;
+    has_previous_ = true;
+    d_rate_ += d_alpha_ * (delta / Ts - d_rate_);
 
     // 计算 P 、 I 、 D 项
-    proportional_ = kp_ * error;
-    integral_ += ki_ * error * Ts;
-    integral_ = _constrain(integral_, -integral_limit_, integral_limit_);
-    derivative_ = kd_ * (error - previousError_) / Ts;
-    previousError_ = error;
-
-    // 计算未修正的控制输出
-    float u = proportional_ + integral_ + derivative_;
-
-    // 加入静摩擦力补偿
-    if (u != 0) {
-        u += (u > 0) ? static_friction_torque_ : -static_friction_torque_;
+    float proportional = kp_ * error;
+    if (ki_ != 0) {
+        integral_ = _clamp_integral(integral_ + ki_ * error * Ts);
     }
+    float derivative = kd_ * d_rate_;
+    previous_error_ = error;
 
-    // 限制输出范围
-    u = _constrain(u, -output_limit_, output_limit_);
+    // 计算未修正的控制输出, 加入静摩擦力补偿后限幅
+    float u_unsat = proportional + integral_ + derivative + feedforward;
+    u_unsat += _friction(u_unsat);
+    float u = _constrain(u_unsat, -output_limit_, output_limit_);
 
+    // 反算抗饱和: 跟踪时间常数取积分时间 Kp / Ki, 没有 P 时每个周期直接退回限幅以内
+    if (ki_ != 0 && u != u_unsat) {
+        float kb_ts = kp_ > 0 ? ki_ / kp_ * Ts : 1.0f;
+        integral_ = _clamp_integral(integral_ + _constrain(kb_ts, 0.0f, 1.0f) * (u - u_unsat));
+    }
     return u;
 }
 
+void PIDController::track(float output, float setpoint, float measurement, float feedforward) {
+    float error = setpoint - measurement;
+    previous_measurement_ = measurement;
+    has_previous_ = true;
+    d_rate_ = 0;
+    previous_error_ = error;
+    // 下一次 calculate() 的误差不变时输出等于 output
+    integral_ = ki_ != 0 ? _clamp_integral(output - _friction(output) - kp_ * error - feedforward) : 0;
+}
+
 void PIDController::setPID(float kp, float ki, float kd) {
+    // P 和 D 的变化量由积分项吸收, 当前输出不变
+    if (ki != 0) {
+        integral_ = _clamp_integral(integral_ + (kp_ - kp) * previous_error_ + (kd_ - kd) * d_rate_);
+    } else {
+        integral_ = 0;
+    }
     kp_ = kp;
     ki_ = ki;
     kd_ = kd;
 }
 
+PidGains PIDController::getPID() const {
+    return {kp_, ki_, kd_};
+}
 
+void PIDController::setSamplePeriod(float sample_period_s) {
+    sample_period_s_ = sample_period_s;
+    _update_filter();
+}
+
+void PIDController::setDerivativeFilter(float d_filter_tau) {
+    d_filter_tau_ = d_filter_tau;
+    _update_filter();
+}
+
+void PIDController::reset() {
+    integral_ = 0;
+    d_rate_ = 0;
+    has_previous_ = false;
+    previous_error_ = 0;
+}
+
+void PIDController::_update_filter() {
+    d_alpha_ = d_filter_tau_ > 0 ? sample_period_s_ / (d_filter_tau_ + sample_period_s_) : 1.0f;
+}
+
+float PIDController::_friction(float u) const {
+    if (friction_deadband_ <= 0) {
+        return u > 0 ? static_friction_torque_ : (u < 0 ? -static_friction_torque_ : 0);
+    }
+    return static_friction_torque_ * _constrain(u / friction_deadband_, -1.0f, 1.0f);
+}
+
+float PIDController::_clamp_integral(float integral) const {
+    return _constrain(integral, -integral_limit_, integral_limit_);
+}
@@ -0,0 +1,93 @@
+#ifndef FOCKNOB_MOTOR_SIM_H
+#define FOCKNOB_MOTOR_SIM_H
+
+#include <cmath>
+#include "sim_encoder.h"
+
+/*
+ * @brief 旋钮电机模型参数, 力矩输入单位与 FocDriver::set_dq 的 Uq 相同 (PWM 计数, 最大 FOC_MCPWM_OUTPUT_LIMIT)
+ *        默认值按 2204 云台电机 + 旋钮帽估计
+ */
+struct KnobPlantParams {
+    float inertia = 3e-5f;              // 转动惯量 (kg·m²)
+    float torque_per_uq = 5e-5f;        // 每单位 Uq 产生的力矩 (N·m), 999 约 0.05N·m
+    float back_emf_per_rad_s = 6.6f;    // 反电动势, 折算成 Uq 单位 / (rad/s), 决定空载最高转速
+    float viscous = 1e-5f;              // 粘性摩擦 (N·m / (rad/s))
+    float coulomb = 1.2e-3f;            // 库仑摩擦 (N·m)
+    float electrical_tau = 5e-4f;       // 电流环时间常数 L/R (秒), 0 表示忽略
+};
+
+/*
+ * @brief 旋钮电机仿真模型, 纯 C++, 不依赖 IDF, 可以在主机上跑
+ *        step() 内部按固定小步长积分, 并把转子角度写入 SimEncoder
+ */
+class KnobPlant {
+public:
+    explicit KnobPlant(SimEncoder *encoder, const KnobPlantParams &params = KnobPlantParams()) :
+            encoder_(encoder), params_(params) {}
+
+    void set_external_torque(float torque_nm) { external_torque_ = torque_nm; }   // 外部力矩 (例如手指), N·m
+
+    // 以 Uq 驱动 dt 秒 (零阶保持)
+    void step(float uq, float dt) {
+        int substeps = int(ceilf(dt / max_substep));
+        float h = dt / float(substeps);
+        for (int i = 0; i < substeps; i++) {
+            float drive = uq - params_.back_emf_per_rad_s * velocity_;
+            if (params_.electrical_tau > 0) {
+                effective_uq_ += (drive - effective_uq_) * (h / (params_.electrical_tau + h));
+            } else {
+                effective_uq_ = drive;
+            }
+            float torque = effective_uq_ * params_.torque_per_uq + external_torque_ - params_.viscous * velocity_;
+            last_torque_ = torque;
+
+            // 库仑摩擦: 静止时如果驱动力矩不足以克服摩擦则保持静止
+            if (fabsf(velocity_) < 1e-4f && fabsf(torque) <= params_.coulomb) {
+                velocity_ = 0;
+                continue;
+            }
+            float friction = velocity_ != 0 ? copysignf(params_.coulomb, velocity_) : copysignf(params_.coulomb, torque);
+            float new_velocity = velocity_ + (torque - friction) / params_.inertia * h;
+            if (velocity_ != 0 && (new_velocity > 0) != (velocity_ > 0)) {
+                new_velocity = 0;   // 摩擦不会让转速反向
+            }
+            velocity_ = new_velocity;
+            position_ += velocity_ * h;
+        }
+        if (encoder_) {
+            encoder_->set_mechanical_radian(position_);
+        }
+    }
+
+    [[nodiscard]] float get_position() const { return position_; }  // 真实位置 (rad)
+
+    [[nodiscard]] float get_velocity() const { return velocity_; }  // 真实转速 (rad/s)
+
+    [[nodiscard]] float get_motor_torque() const { return last_torque_; }   // 最近一次的合力矩 (不含摩擦)
+
+    [[nodiscard]] const KnobPlantParams &get_params() const { return params_; }
+
+    void reset(float position = 0) {
+        position_ = position;
+        velocity_ = 0;
+        effective_uq_ = 0;
+        if (encoder_) {
+            encoder_->set_mechanical_radian(position_);
+        }
+    }
+
+private:
+    static constexpr float max_substep = 1e-4f;
+
+    SimEncoder *encoder_;
+    KnobPlantParams params_;
+    float position_ = 0;
+    float velocity_ = 0;
+    float effective_uq_ = 0;
+    float external_torque_ = 0;
+    float last_torque_ = 0;
+};
+
+
+#endif //FOCKNOB_MOTOR_SIM_H
@@ -0,0 +1,54 @@
+#ifndef FOCKNOB_SYSID_EXCITATION_H
+#define FOCKNOB_SYSID_EXCITATION_H
+
+#include <cstdint>
+
+enum class SysIdSignal : uint8_t {
+    Chirp = 0,  // 对数扫频正弦
+    Prbs = 1,   // 伪随机二进制序列 (最长序列 LFSR)
+};
+
+/*
+ * @brief 系统辨识激励信号, 每个控制周期调用一次 next(), 返回 Uq
+ *
+ *        Chirp: 频率从 f0 按对数扫到 f1, 每个倍频程停留的时间相同, 低频和高频的信息量均衡
+ *        PRBS:  11 位 LFSR (周期 2047), 每个码元保持 hold_ticks 个周期, ±amplitude, 频谱平坦到 1 / (2·hold·Ts)
+ */
+class SysIdExcitation {
+public:
+    static SysIdExcitation chirp(float amplitude, float f0_hz, float f1_hz, float duration_s, float sample_period_s);
+
+    static SysIdExcitation prbs(float amplitude, int hold_ticks, float duration_s, float sample_period_s);
+
+    float next();
+
+    [[nodiscard]] bool is_done() const { return tick_ >= total_ticks_; }
+
+    [[nodiscard]] uint32_t get_total_ticks() const { return total_ticks_; }
+
+    [[nodiscard]] SysIdSignal get_signal() const { return signal_; }
+
+    [[nodiscard]] float get_amplitude() const { return amplitude_; }
+
+    [[nodiscard]] float get_param1() const { return param1_; }   // Chirp: f0, PRBS: 码元保持周期数
+
+    [[nodiscard]] float get_param2() const { return param2_; }   // Chirp: f1, PRBS: 0
+
+private:
+    SysIdExcitation(SysIdSignal signal, float amplitude, float param1, float param2, float duration_s,
+                    float sample_period_s);
+
+    SysIdSignal signal_;
+    float amplitude_;
+    float param1_;
+    float param2_;
+    float sample_period_s_;
+    uint32_t total_ticks_;
+    uint32_t tick_ = 0;
+
+    double phase_ = 0;          // Chirp 相位 (周)
+    uint16_t lfsr_ = 0x7FF;     // PRBS 移位寄存器
+};
+
+
+#endif //FOCKNOB_SYSID_EXCITATION_H
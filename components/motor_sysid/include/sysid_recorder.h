@@ -0,0 +1,61 @@
+#ifndef FOCKNOB_SYSID_RECORDER_H
+#define FOCKNOB_SYSID_RECORDER_H
+
+#include <cstdint>
+#include <cstdio>
+#include "sysid_excitation.h"
+
+#define SYSID_DUMP_MAGIC    0x4449534Bu     // "KSID", 小端
+#define SYSID_DUMP_VERSION  1
+
+// 一个控制周期的同步采样, 全部是旋钮坐标系
+struct SysIdSample {
+    float uq;           // 本周期输出的 Uq
+    float position;     // 本周期读到的角度 (rad, 相对辨识开始时)
+    float velocity;     // 编码器滤波后的转速 (rad/s)
+};
+static_assert(sizeof(SysIdSample) == 12, "SysIdSample must stay packed for the dump format");
+
+// 导出数据的文件头, 后面紧跟 count 个 SysIdSample, 全部为小端
+struct SysIdDumpHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t sample_size;
+    uint32_t sample_period_us;
+    uint32_t count;
+    uint8_t signal;         // SysIdSignal
+    uint8_t reserved[3];
+    float amplitude;
+    float param1;
+    float param2;
+};
+static_assert(sizeof(SysIdDumpHeader) == 32, "SysIdDumpHeader must stay packed for the dump format");
+
+/*
+ * @brief 系统辨识采样记录, 缓冲区由调用方提供
+ *        控制任务里调用 record(), 结束后 dump() 以 base64 输出 (文件头 + 采样), 控制台串口会改写换行符, 不能直接输出二进制
+ *        主机端用 tools/sysid_fit.py 解析和拟合
+ */
+class SysIdRecorder {
+public:
+    SysIdRecorder(SysIdSample *buffer, uint32_t capacity);
+
+    void begin(const SysIdExcitation &excitation, uint32_t sample_period_us);   // 清空并记录激励参数
+
+    bool record(float uq, float position, float velocity);  // 缓冲区满时返回 false
+
+    [[nodiscard]] uint32_t get_count() const { return count_; }
+
+    [[nodiscard]] bool is_full() const { return count_ >= capacity_; }
+
+    void dump(FILE *out) const;     // -----BEGIN FOCKNOB SYSID----- ... -----END FOCKNOB SYSID-----
+
+private:
+    SysIdSample *buffer_;
+    uint32_t capacity_;
+    uint32_t count_ = 0;
+    SysIdDumpHeader header_{};
+};
+
+
+#endif //FOCKNOB_SYSID_RECORDER_H
@@ -0,0 +1,40 @@
+#include "sysid_excitation.h"
+#include <cmath>
+
+SysIdExcitation::SysIdExcitation(SysIdSignal signal, float amplitude, float param1, float param2, float duration_s,
+                                 float sample_period_s)
+        : signal_(signal), amplitude_(amplitude), param1_(param1), param2_(param2),
+          sample_period_s_(sample_period_s), total_ticks_(uint32_t(duration_s / sample_period_s)) {}
+
+SysIdExcitation SysIdExcitation::chirp(float amplitude, float f0_hz, float f1_hz, float duration_s,
+                                       float sample_period_s) {
+    return {SysIdSignal::Chirp, amplitude, f0_hz, f1_hz, duration_s, sample_period_s};
+}
+
+SysIdExcitation SysIdExcitation::prbs(float amplitude, int hold_ticks, float duration_s, float sample_period_s) {
+    return {SysIdSignal::Prbs, amplitude, float(hold_ticks < 1 ? 1 : hold_ticks), 0, duration_s, sample_period_s};
+}
+
+float SysIdExcitation::next() {
+    if (is_done()) {
+        return 0;
+    }
+    uint32_t tick = tick_++;
+
+    if (signal_ == SysIdSignal::Chirp) {
+        // 对数扫频: f(t) = f0 · (f1/f0)^(t/T), 相位按瞬时频率累加, 频率变化时相位连续
+        float progress = float(tick) / float(total_ticks_);
+        double frequency = param1_ * pow(double(param2_) / param1_, progress);
+        float value = amplitude_ * float(sin(2 * M_PI * phase_));
+        phase_ += frequency * sample_period_s_;
+        phase_ -= floor(phase_);
+        return value;
+    }
+
+    // PRBS: x^11 + x^9 + 1
+    if (tick % uint32_t(param1_) == 0 && tick != 0) {
+        uint16_t bit = ((lfsr_ >> 10) ^ (lfsr_ >> 8)) & 1u;
+        lfsr_ = uint16_t(((lfsr_ << 1) | bit) & 0x7FF);
+    }
+    return (lfsr_ & 1u) ? amplitude_ : -amplitude_;
+}
@@ -0,0 +1,87 @@
+#include "sysid_recorder.h"
+
+static const char base64_table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/*
+ * @brief 流式 base64 编码, 每 57 字节输出一行 76 个字符
+ */
+class Base64Writer {
+public:
+    explicit Base64Writer(FILE *out) : out_(out) {}
+
+    void write(const void *data, uint32_t size) {
+        auto *bytes = static_cast<const uint8_t *>(data);
+        for (uint32_t i = 0; i < size; i++) {
+            group_[group_size_++] = bytes[i];
+            if (group_size_ == 3) {
+                _flush_group();
+            }
+        }
+    }
+
+    void finish() {
+        if (group_size_ > 0) {
+            _flush_group();
+        }
+        if (line_size_ > 0) {
+            fputc('\n', out_);
+        }
+    }
+
+private:
+    FILE *out_;
+    uint8_t group_[3]{};
+    int group_size_ = 0;
+    int line_size_ = 0;
+
+    void _flush_group() {
+        uint32_t v = (uint32_t(group_[0]) << 16) | (uint32_t(group_[1]) << 8) | group_[2];
+        char chars[4] = {base64_table[(v >> 18) & 0x3F], base64_table[(v >> 12) & 0x3F],
+                         group_size_ > 1 ? base64_table[(v >> 6) & 0x3F] : '=',
+                         group_size_ > 2 ? base64_table[v & 0x3F] : '='};
+        fwrite(chars, 1, 4, out_);
+        group_[0] = group_[1] = group_[2] = 0;
+        group_size_ = 0;
+        line_size_ += 4;
+        if (line_size_ >= 76) {
+            fputc('\n', out_);
+            line_size_ = 0;
+        }
+    }
+};
+
+SysIdRecorder::SysIdRecorder(SysIdSample *buffer, uint32_t capacity) : buffer_(buffer), capacity_(capacity) {}
+
+void SysIdRecorder::begin(const SysIdExcitation &excitation, uint32_t sample_period_us) {
+    count_ = 0;
+    header_ = {};
+    header_.magic = SYSID_DUMP_MAGIC;
+    header_.version = SYSID_DUMP_VERSION;
+    header_.sample_size = sizeof(SysIdSample);
+    header_.sample_period_us = sample_period_us;
+    header_.signal = uint8_t(excitation.get_signal());
+    header_.amplitude = excitation.get_amplitude();
+    header_.param1 = excitation.get_param1();
+    header_.param2 = excitation.get_param2();
+}
+
+bool SysIdRecorder::record(float uq, float position, float velocity) {
+    if (is_full()) {
+        return false;
+    }
+    buffer_[count_++] = {uq, position, velocity};
+    return true;
+}
+
+void SysIdRecorder::dump(FILE *out) const {
+    SysIdDumpHeader header = header_;
+    header.count = count_;
+
+    fprintf(out, "-----BEGIN FOCKNOB SYSID-----\n");
+    Base64Writer writer(out);
+    writer.write(&header, sizeof(header));
+    writer.write(buffer_, count_ * sizeof(SysIdSample));
+    writer.finish();
+    fprintf(out, "-----END FOCKNOB SYSID-----\n");
+    fflush(out);
+}
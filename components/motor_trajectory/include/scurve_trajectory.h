@@ -0,0 +1,87 @@
+#ifndef FOCKNOB_SCURVE_TRAJECTORY_H
+#define FOCKNOB_SCURVE_TRAJECTORY_H
+
+#include <cstdint>
+
+struct TrajectoryPoint {
+    float position;     // 位置参考 (rad)
+    float velocity;     // 速度参考 (rad/s)
+    float acceleration; // 加速度参考 (rad/s²)
+};
+
+/*
+ * @brief 加加速度受限的 S 曲线轨迹 (双 S 速度曲线, Biagiotti & Melchiorri)
+ *
+ *        从 (起点位置, 起点速度) 运动到目标位置并停下, 速度、加速度、加加速度都不超过限制, 终点没有超调
+ *        起点速度与运动方向相反, 或者太快已经来不及在目标前停下时, 先平滑刹车到零再反向运动
+ *        plan() 只在规划时做一次开方, sample() / step() 只有多项式求值, 可以在控制周期里调用
+ */
+class SCurveTrajectory {
+public:
+    SCurveTrajectory(float max_velocity, float max_acceleration, float max_jerk, float sample_period_s);
+
+    void set_limits(float max_velocity, float max_acceleration, float max_jerk);
+
+    void plan(float start_position, float start_velocity, float target_position);   // 规划一条新轨迹, 时间从 0 开始
+
+    [[nodiscard]] TrajectoryPoint sample(float t) const;   // 轨迹在 t 秒时的参考点, t 超过总时长时停在终点
+
+    TrajectoryPoint step();     // 前进一个采样周期并返回参考点 (控制周期调用)
+
+    [[nodiscard]] TrajectoryPoint current() const { return sample(float(tick_) * sample_period_s_); }
+
+    [[nodiscard]] bool is_finished() const { return float(tick_) * sample_period_s_ >= get_duration(); }
+
+    [[nodiscard]] float get_duration() const { return brake_.duration + move_.duration; }   // 总时长 (秒)
+
+    [[nodiscard]] float get_target() const { return target_; }
+
+private:
+    // 一段同向的 "加速 - 匀速 - 减速" 曲线, 归一化到正方向, 终点速度为 0
+    struct Profile {
+        float start = 0;    // 起点位置 (实际坐标)
+        float sign = 1;     // 运动方向
+        float v0 = 0;       // 起点速度 (归一化后 >= 0)
+        float tj1 = 0, ta = 0, tv = 0, tj2 = 0, td = 0;
+        float v_lim = 0;    // 匀速段速度
+        float distance = 0; // 位移 (归一化后 >= 0)
+        float duration = 0;
+    };
+
+    // 只有刹车段的曲线: 从 v0 平滑减到 0
+    struct Brake {
+        float start = 0;
+        float sign = 1;
+        float v0 = 0;
+        float tj = 0, ta = 0;
+        float distance = 0;
+        float duration = 0;
+    };
+
+    float max_velocity_;
+    float max_acceleration_;
+    float max_jerk_;
+    float sample_period_s_;
+
+    Brake brake_{};
+    Profile move_{};
+    float target_ = 0;
+    uint32_t tick_ = 0;
+
+    void _plan_brake(float start_position, float velocity);
+
+    void _plan_move(float start_position, float start_velocity, float target_position);
+
+    [[nodiscard]] TrajectoryPoint _sample_brake(float t) const;
+
+    [[nodiscard]] TrajectoryPoint _sample_move(float t) const;
+
+    // 速度从 v0 以加加速度 ±jerk 平滑变到 v_lim 的一段 (加速段模板), 位置从 0 开始
+    static TrajectoryPoint _ramp(float v0, float v_lim, float tj, float ta, float jerk, float t);
+
+    // 速度从 0 变化 dv (> 0) 所需的 Tj 和总时间
+    void _ramp_time(float dv, float max_acceleration, float &tj, float &ta) const;
+};
+
+
+#endif //FOCKNOB_SCURVE_TRAJECTORY_H
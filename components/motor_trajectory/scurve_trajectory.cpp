@@ -0,0 +1,166 @@
+#include "scurve_trajectory.h"
+#include <cmath>
+
+SCurveTrajectory::SCurveTrajectory(float max_velocity, float max_acceleration, float max_jerk, float sample_period_s)
+        : max_velocity_(max_velocity), max_acceleration_(max_acceleration), max_jerk_(max_jerk),
+          sample_period_s_(sample_period_s) {}
+
+void SCurveTrajectory::set_limits(float max_velocity, float max_acceleration, float max_jerk) {
+    max_velocity_ = max_velocity;
+    max_acceleration_ = max_acceleration;
+    max_jerk_ = max_jerk;
+}
+
+void SCurveTrajectory::plan(float start_position, float start_velocity, float target_position) {
+    target_ = target_position;
+    tick_ = 0;
+    brake_ = {};
+
+    // 朝目标方向的起点速度, 以及以该速度平滑刹停所需的距离
+    float h = target_position - start_position;
+    float v_toward = h >= 0 ? start_velocity : -start_velocity;
+    float stop_distance = 0;
+    if (v_toward > 0) {
+        float tj, ta;
+        _ramp_time(v_toward, max_acceleration_, tj, ta);
+        stop_distance = v_toward * ta / 2;
+    }
+
+    if (start_velocity != 0 && (v_toward < 0 || stop_distance > fabsf(h))) {
+        // 反向运动, 或者来不及在目标前停下: 先刹车, 再从停止点规划
+        _plan_brake(start_position, start_velocity);
+        _plan_move(start_position + brake_.sign * brake_.distance, 0, target_position);
+    } else {
+        _plan_move(start_position, start_velocity, target_position);
+    }
+}
+
+TrajectoryPoint SCurveTrajectory::sample(float t) const {
+    if (t < brake_.duration) {
+        return _sample_brake(t);
+    }
+    return _sample_move(t - brake_.duration);
+}
+
+TrajectoryPoint SCurveTrajectory::step() {
+    TrajectoryPoint point = current();
+    if (!is_finished()) {
+        tick_++;
+    }
+    return point;
+}
+
+
+// private
+void SCurveTrajectory::_plan_brake(float start_position, float velocity) {
+    brake_.start = start_position;
+    brake_.sign = velocity >= 0 ? 1.0f : -1.0f;
+    brake_.v0 = fabsf(velocity);
+    _ramp_time(brake_.v0, max_acceleration_, brake_.tj, brake_.ta);
+    brake_.distance = brake_.v0 * brake_.ta / 2;
+    brake_.duration = brake_.ta;
+}
+
+void SCurveTrajectory::_plan_move(float start_position, float start_velocity, float target_position) {
+    float h = target_position - start_position;
+    move_ = {};
+    move_.start = start_position;
+    move_.sign = h >= 0 ? 1.0f : -1.0f;
+    move_.distance = fabsf(h);
+    // 调用方保证速度朝向目标且来得及停下, 超过速度限制的部分直接截断
+    move_.v0 = fminf(fmaxf(move_.sign * start_velocity, 0.0f), max_velocity_);
+    if (move_.distance == 0 && move_.v0 == 0) {
+        return;
+    }
+
+    float j = max_jerk_;
+    float v0 = move_.v0;
+    float h_abs = move_.distance;
+
+    // 情况 1: 能达到最大速度, 中间有匀速段
+    _ramp_time(max_velocity_ - v0, max_acceleration_, move_.tj1, move_.ta);
+    _ramp_time(max_velocity_, max_acceleration_, move_.tj2, move_.td);
+    move_.tv = h_abs / max_velocity_ - move_.ta / 2 * (1 + v0 / max_velocity_) - move_.td / 2;
+
+    if (move_.tv < 0) {
+        // 情况 2: 达不到最大速度, 没有匀速段; 达不到最大加速度时逐步降低加速度上限重新计算
+        move_.tv = 0;
+        float a = max_acceleration_;
+        for (int i = 0; i < 200; i++) {
+            float tj = a / j;
+            float delta = a * a * a * a / (j * j) + 2 * v0 * v0 + a * (4 * h_abs - 2 * a / j * v0);
+            float sqrt_delta = sqrtf(delta);
+            move_.tj1 = move_.tj2 = tj;
+            move_.ta = (a * a / j - 2 * v0 + sqrt_delta) / (2 * a);
+            move_.td = (a * a / j + sqrt_delta) / (2 * a);
+            if (move_.ta < 0) {     // 起点速度已经足够, 只需要减速段
+                move_.ta = 0;
+                move_.tj1 = 0;
+                move_.td = 2 * h_abs / v0;
+                move_.tj2 = (j * h_abs - sqrtf(fmaxf(j * (j * h_abs * h_abs - v0 * v0 * v0), 0.0f))) / (j * v0);
+                break;
+            }
+            if (move_.ta >= 2 * tj && move_.td >= 2 * tj) {
+                break;
+            }
+            a *= 0.95f;
+        }
+    }
+
+    move_.v_lim = v0 + (move_.ta - move_.tj1) * j * move_.tj1;
+    move_.duration = move_.ta + move_.tv + move_.td;
+}
+
+TrajectoryPoint SCurveTrajectory::_sample_brake(float t) const {
+    TrajectoryPoint r = _ramp(brake_.v0, 0, brake_.tj, brake_.ta, -max_jerk_, t);
+    return {brake_.start + brake_.sign * r.position, brake_.sign * r.velocity, brake_.sign * r.acceleration};
+}
+
+TrajectoryPoint SCurveTrajectory::_sample_move(float t) const {
+    if (t >= move_.duration) {
+        return {target_, 0, 0};
+    }
+    TrajectoryPoint r{};
+    if (t < move_.ta) {     // 加速段
+        r = _ramp(move_.v0, move_.v_lim, move_.tj1, move_.ta, max_jerk_, t);
+    } else if (t < move_.ta + move_.tv) {   // 匀速段
+        r.position = (move_.v_lim + move_.v0) * move_.ta / 2 + move_.v_lim * (t - move_.ta);
+        r.velocity = move_.v_lim;
+        r.acceleration = 0;
+    } else {    // 减速段, 等于从终点倒着走的加速段
+        TrajectoryPoint back = _ramp(0, move_.v_lim, move_.tj2, move_.td, max_jerk_, move_.duration - t);
+        r.position = move_.distance - back.position;
+        r.velocity = back.velocity;
+        r.acceleration = -back.acceleration;
+    }
+    return {move_.start + move_.sign * r.position, move_.sign * r.velocity, move_.sign * r.acceleration};
+}
+
+TrajectoryPoint SCurveTrajectory::_ramp(float v0, float v_lim, float tj, float ta, float jerk, float t) {
+    float a_lim = jerk * tj;
+    if (t < tj) {   // 加速度线性增加
+        return {v0 * t + jerk * t * t * t / 6, v0 + jerk * t * t / 2, jerk * t};
+    }
+    if (t < ta - tj) {  // 恒加速度
+        return {v0 * t + a_lim / 6 * (3 * t * t - 3 * tj * t + tj * tj), v0 + a_lim * (t - tj / 2), a_lim};
+    }
+    if (t < ta) {   // 加速度线性减小到 0
+        float tau = ta - t;
+        return {(v_lim + v0) * ta / 2 - v_lim * tau + jerk * tau * tau * tau / 6, v_lim - jerk * tau * tau / 2,
+                jerk * tau};
+    }
+    return {(v_lim + v0) * ta / 2 + v_lim * (t - ta), v_lim, 0};
+}
+
+void SCurveTrajectory::_ramp_time(float dv, float max_acceleration, float &tj, float &ta) const {
+    if (dv <= 0) {
+        tj = 0;
+        ta = 0;
+    } else if (dv * max_jerk_ < max_acceleration * max_acceleration) {    // 达不到最大加速度
+        tj = sqrtf(dv / max_jerk_);
+        ta = 2 * tj;
+    } else {
+        tj = max_acceleration / max_jerk_;
+        ta = tj + dv / max_acceleration;
+    }
+}
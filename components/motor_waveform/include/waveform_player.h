@@ -0,0 +1,67 @@
+#ifndef FOCKNOB_WAVEFORM_PLAYER_H
+#define FOCKNOB_WAVEFORM_PLAYER_H
+
+#include <atomic>
+#include <cstdint>
+
+enum class HapticEffect : uint8_t {
+    Click = 0,  // 按键: 一推一拉, 6 ms
+    Tick = 1,   // 轻的单下, 4 ms
+    Bump = 2,   // 半个正弦的顶一下, 20 ms
+    Buzz = 3,   // 250 Hz 方波振动, 40 ms, 末尾渐弱
+};
+
+/*
+ * @brief 力矩波形播放器, 在 FOC 周期里播放预先采样好的短促力矩包络 (点击 / 振动 / 顶一下)
+ *
+ *        - 每个 FOC 周期调用一次 next(), 输出的 Uq 叠加在当前的力矩 / 位置环输出上, 触发后下一个周期开始播放
+ *        - 采样率就是 FOC 的控制频率 (每个采样点一个周期), 与任务调度无关, 包络的时间是精确的
+ *        - play() 可以在任意任务 / 定时器里调用, 通过无锁有界队列 (每个槽带序号, 多生产者) 交给 FOC 任务, 不阻塞
+ *        - 最多 voice_count 个效果同时播放, 相加后输出; 没有空闲的声部时丢弃最早开始的那个
+ */
+class WaveformPlayer {
+public:
+    static constexpr int queue_size = 8;    // 必须是 2 的幂
+    static constexpr int voice_count = 4;
+
+    WaveformPlayer();
+
+    bool play(HapticEffect effect, float strength);     // strength 为峰值力矩 (Uq), 队列满时返回 false
+
+    float next();   // FOC 任务每个周期调用一次, 返回本周期所有效果的力矩之和
+
+    void clear();   // 停止所有效果并丢弃队列里的触发, 只能在 FOC 任务里调用
+
+    [[nodiscard]] bool is_playing() const;
+
+    [[nodiscard]] static int get_length(HapticEffect effect);  // 效果的采样点数
+
+private:
+    friend struct WaveformQueueProbe;   // 主机上的并发压力测试 (tools/lockfree_stress) 直接从队列里取触发
+
+    struct Trigger {
+        std::atomic<uint32_t> sequence;
+        HapticEffect effect;
+        float strength;
+    };
+
+    struct Voice {
+        const float *samples = nullptr;
+        int length = 0;
+        int position = 0;
+        float strength = 0;
+    };
+
+    Trigger queue_[queue_size];
+    std::atomic<uint32_t> enqueue_pos_{0};
+    uint32_t dequeue_pos_ = 0;     // 只有 FOC 任务读写
+
+    Voice voices_[voice_count];
+
+    bool _pop(HapticEffect &effect, float &strength);
+
+    void _start(HapticEffect effect, float strength);
+};
+
+
+#endif //FOCKNOB_WAVEFORM_PLAYER_H
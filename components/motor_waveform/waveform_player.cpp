@@ -0,0 +1,131 @@
+#include "waveform_player.h"
+
+#include <iterator>
+
+// 包络按 FOC 周期 (2 ms) 采样, 峰值归一化到 1
+static constexpr float click_samples[] = {1.0f, -1.0f, -0.3f};
+static constexpr float tick_samples[] = {0.6f, -0.3f};
+static constexpr float bump_samples[] = {0.282f, 0.541f, 0.756f, 0.910f, 0.990f, 0.990f, 0.910f, 0.756f, 0.541f,
+                                         0.282f};
+static constexpr float buzz_samples[] = {1, -1, 1, -1, 1, -1, 1, -1, 1, -1, 1, -1, 1, -1, 1, -1,
+                                         0.8f, -0.6f, 0.4f, -0.2f};
+
+struct Waveform {
+    const float *samples;
+    int length;
+};
+
+// 与 HapticEffect 的顺序一致
+static constexpr Waveform waveforms[] = {
+        {click_samples, int(std::size(click_samples))},
+        {tick_samples, int(std::size(tick_samples))},
+        {bump_samples, int(std::size(bump_samples))},
+        {buzz_samples, int(std::size(buzz_samples))},
+};
+
+static_assert((WaveformPlayer::queue_size & (WaveformPlayer::queue_size - 1)) == 0);
+
+WaveformPlayer::WaveformPlayer() {
+    for (uint32_t i = 0; i < queue_size; i++) {
+        queue_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+bool WaveformPlayer::play(HapticEffect effect, float strength) {
+    if (static_cast<size_t>(effect) >= std::size(waveforms)) {
+        return false;
+    }
+    // 抢占一个槽: 槽的序号等于写入位置时才能写, 写完把序号加 1 交给 FOC 任务
+    uint32_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    Trigger *slot;
+    while (true) {
+        slot = &queue_[pos & (queue_size - 1)];
+        uint32_t sequence = slot->sequence.load(std::memory_order_acquire);
+        auto diff = int32_t(sequence - pos);
+        if (diff == 0) {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;   // 队列满, FOC 任务没在运行
+        } else {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+    slot->effect = effect;
+    slot->strength = strength;
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+float WaveformPlayer::next() {
+    HapticEffect effect;
+    float strength;
+    while (_pop(effect, strength)) {
+        _start(effect, strength);
+    }
+
+    float torque = 0;
+    for (Voice &voice : voices_) {
+        if (voice.position < voice.length) {
+            torque += voice.strength * voice.samples[voice.position++];
+        }
+    }
+    return torque;
+}
+
+void WaveformPlayer::clear() {
+    HapticEffect effect;
+    float strength;
+    while (_pop(effect, strength)) {}
+    for (Voice &voice : voices_) {
+        voice.position = voice.length;
+    }
+}
+
+bool WaveformPlayer::is_playing() const {
+    for (const Voice &voice : voices_) {
+        if (voice.position < voice.length) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int WaveformPlayer::get_length(HapticEffect effect) {
+    auto index = static_cast<size_t>(effect);
+    return index < std::size(waveforms) ? waveforms[index].length : 0;
+}
+
+
+// private
+bool WaveformPlayer::_pop(HapticEffect &effect, float &strength) {
+    Trigger &slot = queue_[dequeue_pos_ & (queue_size - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != dequeue_pos_ + 1) {
+        return false;   // 空, 或者生产者还没写完
+    }
+    effect = slot.effect;
+    strength = slot.strength;
+    slot.sequence.store(dequeue_pos_ + queue_size, std::memory_order_release);
+    dequeue_pos_++;
+    return true;
+}
+
+void WaveformPlayer::_start(HapticEffect effect, float strength) {
+    // 优先用空闲的声部, 都在播放时替换播放得最久的那个
+    Voice *target = &voices_[0];
+    for (Voice &voice : voices_) {
+        if (voice.position >= voice.length) {
+            target = &voice;
+            break;
+        }
+        if (voice.position > target->position) {
+            target = &voice;
+        }
+    }
+    const Waveform &waveform = waveforms[static_cast<size_t>(effect)];
+    target->samples = waveform.samples;
+    target->length = waveform.length;
+    target->position = 0;
+    target->strength = strength;
+}
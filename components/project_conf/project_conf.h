@@ -10,10 +10,35 @@
 #define IIC_MASTER_FREQ_HZ              100000            // IIC master clock frequency
 #define IIC_MASTER_SDA_IO               GPIO_NUM_15
 #define IIC_MASTER_SCL_IO               GPIO_NUM_16
+#define IIC_ARBITER_OVERHEAD_US         150                 // 一次 I2C 事务除了位时间以外的驱动开销估计, 单位(us)
+#define IIC_ARBITER_GUARD_US            100                 // 后台事务必须在下一个控制时隙之前至少这么多时间结束
+#define IIC_ARBITER_CONTROL_SPIN_US     200                 // 控制读取发现总线被占用时忙等的最长时间, 超过就放弃本周期的读取, 单位(us)
 
 #define IIC_AS5600_ADDR                 0x36
 #define IIC_AS5600_RAW_ANGLE_REG        0x0C
+#define IIC_AS5600_STATUS_REG           0x0B                // MD / ML / MH 磁铁状态
+#define IIC_AS5600_AGC_REG              0x1A                // AGC, 后面紧跟 MAGNITUDE(0x1B, 0x1C)
 #define IIC_AS5600_RESOLUTION           4096
+#define IIC_AS5600_TIMEOUT_MS           1                   // 单次读取超时, 单位(ms), 100kHz 下一次读取约 0.5ms
+#define IIC_AS5600_DIAG_INTERVAL        25                  // 每隔多少个控制周期做一次诊断寄存器读取
+#define IIC_AS5600_READ_MODE            1                   // 0: 完整读取, 1: 复用地址指针(只读事务)
+
+#define FOC_ENCODER_AS5600              0                   // I2C AS5600 (12 bit)
+#define FOC_ENCODER_SPI                 1                   // SPI 磁编码器, AS5047P 协议 (14 bit)
+#define FOC_ENCODER_SIM                 2                   // 仿真编码器 (无硬件)
+#define FOC_ENCODER_TYPE                FOC_ENCODER_AS5600  // 当前使用的编码器
+
+#define SPI_ENCODER_HOST                SPI3_HOST           // SPI2_HOST 已经给 LCD 使用
+#define SPI_ENCODER_FREQ_HZ             10000000
+#define SPI_ENCODER_SCLK_IO             GPIO_NUM_38
+#define SPI_ENCODER_MISO_IO             GPIO_NUM_39
+#define SPI_ENCODER_MOSI_IO             GPIO_NUM_40
+#define SPI_ENCODER_CS_IO               GPIO_NUM_41
+#define SPI_ENCODER_RESOLUTION          16384
+
+#define ENCODER_MAX_VELOCITY_RAD_S      150.0f              // 物理上可能的最大转速, 相对预测的跳变超过一个周期的该转速视为毛刺
+#define ENCODER_EXTRAPOLATE_SAMPLES     5                   // 连续无效采样时最多按转速外推的次数, 之后保持不动
+#define ENCODER_RESYNC_SAMPLES          10                  // 连续无效采样超过该次数后, 无条件接受新的有效读数
 
 #define FOC_MOTOR_POLE_PAIRS            7
 #define FOC_DRV_EN_GPIO                 GPIO_NUM_4
@@ -25,8 +50,56 @@
 #define FOC_MCPWM_PERIOD                2000                // 最大力矩为 FOC_MCPWM_PERIOD / 2
 #define FOC_MCPWM_OUTPUT_LIMIT          (FOC_MCPWM_PERIOD / 2.0 - 1)
 #define FOC_MCPWM_CALIBRATE_VOLTAGE     (FOC_MCPWM_PERIOD / 20.0)
-#define FOC_MCPWM_STATIC_FRIC_TORQUE    28.0                // 电机启动静摩擦力矩
+#define FOC_MCPWM_STATIC_FRIC_TORQUE    28.0                // 电机启动静摩擦力矩, 作为摩擦模型在线拟合的初始值
 #define FOC_LOW_PASS_FILTER_ALPHA       0.3
+#define FOC_TRAJECTORY_MAX_VELOCITY     20.0f               // 位置指令轨迹的最大速度, 单位(rad/s)
+#define FOC_TRAJECTORY_MAX_ACCEL        400.0f              // 最大加速度, 单位(rad/s²)
+#define FOC_TRAJECTORY_MAX_JERK         20000.0f            // 最大加加速度, 单位(rad/s³)
+#define FOC_FEEDFORWARD_VELOCITY        6.6f                // 速度前馈, 抵消反电动势, 单位(Uq / (rad/s))
+#define FOC_FEEDFORWARD_ACCEL           0.6f                // 加速度前馈, 转动惯量 / 力矩系数, 单位(Uq / (rad/s²))
+#define FOC_DOB_BANDWIDTH               40.0f               // 扰动观测器带宽, 单位(rad/s)
+#define FOC_DOB_LIMIT                   (FOC_MCPWM_OUTPUT_LIMIT / 4.0f)     // 闭环模式下扰动补偿的限幅
+#define FOC_FRICTION_ADAPT_TIME         2.0f                // 摩擦模型在线拟合的时间常数, 单位(s)
+#define FOC_FRICTION_VELOCITY_DEADBAND  0.5f                // 摩擦补偿在该转速以内线性过渡, 零速附近不过补偿, 单位(rad/s)
+#define FOC_FRICTION_ADAPT_HAND_RATIO   0.5f                // 力矩模式下 |外部力矩估计| 低于 库仑摩擦 × 该值 (没有手) 时才拟合摩擦模型
+#define FOC_FRICTION_ADAPT_HAND_FILTER  0.05f               // 判断有没有手之前外部力矩估计的低通时间常数, 单位(s)
+#define FOC_FRICTION_ADAPT_HAND_HOLD    0.1f                // 没有手持续该时间后才开始拟合, 单位(s)
+#define FOC_FRICTION_ADAPT_MIN_VELOCITY 1.0f                // 力矩模式下转速超过该值才拟合, 单位(rad/s)
+#define FOC_TORQUE_FRICTION_COMPENSATION 0                  // 力矩模式是否抵消拟合的摩擦模型, 0: 关闭 (手感完全由旋钮的力矩规律决定)
+#define FOC_TORQUE_FRICTION_RAMP        4.0f                // 力矩模式摩擦补偿的线性区, 零速附近相当于 Fc / 该值 的负阻尼, 单位(rad/s)
+#define FOC_POSITION_LOOP_DIVIDER       4                   // 位置外环每隔多少个控制周期运行一次, 速度内环每个周期运行
+#define FOC_POSITION_VELOCITY_LIMIT     40.0f               // 位置环输出的速度指令限幅(含前馈), 单位(rad/s)
+#define FOC_PID_D_FILTER_TAU            0.004f              // PID 微分项的一阶低通时间常数, 单位(s)
+#define FOC_PID_FRICTION_DEADBAND       20.0f               // PID 静摩擦补偿在 |u| 小于该值时线性过渡, 零点附近不来回跳, 单位(Uq)
+#define FOC_KALMAN_ANGLE_NOISE          1e-3f               // 状态估计器的角度量测噪声标准差 (AS5600 量化 + 非线性), 单位(rad)
+#define FOC_KALMAN_VELOCITY_NOISE       2.0f                // 转速过程噪声谱密度, 模型误差, 单位(rad/s/√s)
+#define FOC_KALMAN_TORQUE_NOISE         300.0f              // 外部力矩过程噪声谱密度, 越大力矩估计越快、噪声越大, 单位(Uq/√s)
+
+#define KNOB_FLYWHEEL_STIFFNESS         150.0f              // 旋钮与虚拟飞轮之间的耦合刚度, 单位(Uq/rad)
+#define KNOB_FLYWHEEL_DAMPING_RATIO     0.7f                // 耦合阻尼比, 阻尼按飞轮惯量换算, 抓住旋钮时飞轮不会来回弹
+#define KNOB_WALL_STIFFNESS             16000.0f            // 无源墙的刚度 (AttractorWithRebound / DampingWithRebound), 单位(Uq/rad)
+                                                            // 纯比例墙在 haptic_bench 里 1 lsb 噪声下最多约 9600~13000 就颤振, 无源墙约 22000
+#define KNOB_WALL_DAMPING               1.0f                // 无源墙自带的阻尼, 单位(Uq/(rad/s))
+#define KNOB_WALL_TORQUE_LIMIT          (FOC_MCPWM_OUTPUT_LIMIT / 2.0f)     // 顶住墙时的力矩上限
+#define KNOB_DETENT_FADE_START          4.0f                // 吸附点从该转速开始随转速减弱, 单位(rad/s)
+#define KNOB_DETENT_FADE_END            12.0f               // 到该转速减到最弱, 单位(rad/s)
+#define KNOB_DETENT_FADE_MIN            0.2f                // 最弱时吸附点力矩的倍率, 1 表示不减弱
+#define KNOB_TRANSITION_TICKS           40                  // 切换模式时新旧力矩规律交叉淡化的周期数 (80 ms)
+#define KNOB_SERVO_STIFFNESS            300.0f              // 回位伺服的跟踪刚度, 单位(Uq/rad)
+#define KNOB_SERVO_DAMPING_RATIO        0.8f                // 跟踪阻尼比, 按旋钮惯量换算阻尼
+#define KNOB_SERVO_TORQUE_LIMIT         (FOC_MCPWM_OUTPUT_LIMIT / 4.0f)     // 回位伺服的力矩上限, 手一抓就能按住
+// 回位伺服的库仑摩擦前馈, 单位(Uq); FOC 已经在补偿摩擦时不再重复
+#define KNOB_SERVO_FRICTION             (FOC_TORQUE_FRICTION_COMPENSATION ? 0.0f : float(FOC_MCPWM_STATIC_FRIC_TORQUE))
+#define KNOB_SERVO_MAX_VELOCITY         12.0f               // 回位轨迹的最大速度, 单位(rad/s)
+#define KNOB_SERVO_MAX_ACCEL            150.0f              // 最大加速度, 单位(rad/s²)
+#define KNOB_SERVO_MAX_JERK             3000.0f             // 最大加加速度, 单位(rad/s³)
+#define KNOB_SERVO_GRAB_TORQUE          60.0f               // 外部力矩估计超过该值的部分累计起来检测手抓住旋钮, 单位(Uq)
+#define KNOB_SERVO_GRAB_IMPULSE         0.6f                // 累计超过该值即为抓住 (至少 5 个周期, 编码器噪声 3 lsb 时还有余量), 单位(Uq·s)
+#define KNOB_SERVO_GRAB_VELOCITY        4.0f                // 或者转速落后参考超过该值, 单位(rad/s)
+#define KNOB_SERVO_GRAB_ERROR           0.15f               // 同时位置落后参考超过该值, 单位(rad)
+#define KNOB_EVENT_VELOCITY_THRESHOLD   10.0f               // 转速超过该值时发出 VelocityAbove 事件, 单位(rad/s)
+#define KNOB_EVENT_VELOCITY_HYSTERESIS  3.0f                // 回落到 阈值 - 回差 以下才发出 VelocityBelow, 单位(rad/s)
+#define KNOB_EVENT_MAX_WAITERS          4                   // 最多几个任务可以阻塞等待旋钮事件
 
 #define SPI_LCD_HOST                    SPI2_HOST           // 或者 SPI3_HOST，根据具体使用的 SPI 总线
 #define SPI_LCD_H_RES                   240                 // 根据你的 LCD 分辨率定义
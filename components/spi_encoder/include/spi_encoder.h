@@ -0,0 +1,31 @@
+#ifndef FOCKNOB_SPI_ENCODER_H
+#define FOCKNOB_SPI_ENCODER_H
+
+#include "driver/spi_master.h"
+#include "esp_log.h"
+#include "esp_err.h"
+#include "motor_encoder.h"
+#include "project_conf.h"
+
+/*
+ * @brief SPI 磁编码器 (AS5047P 协议, MT6701/AS5047 一类 14 bit 编码器, SPI 时钟最高约 10MHz)
+ *        每个采样只有一次 16 bit 读帧, 远快于 AS5600 的 I2C 读取
+ */
+class SpiEncoder : public MotorEncoder<SpiEncoder, SPI_ENCODER_RESOLUTION> {
+public:
+    SpiEncoder(spi_host_device_t host, gpio_num_t sclk_io, gpio_num_t miso_io, gpio_num_t mosi_io, gpio_num_t cs_io);
+
+private:
+    friend class MotorEncoder<SpiEncoder, SPI_ENCODER_RESOLUTION>;
+
+    spi_device_handle_t dev_handle_{};  // SPI设备句柄
+
+    EncoderReadStatus _read_raw(uint16_t &raw);
+
+    static uint16_t _add_parity(uint16_t frame);  // 在 bit15 添加偶校验位
+
+    static bool _check_parity(uint16_t frame);
+};
+
+
+#endif //FOCKNOB_SPI_ENCODER_H
@@ -0,0 +1,78 @@
+#include "spi_encoder.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "SpiEncoder";
+
+#define AS5047_REG_ANGLECOM     0x3FFF  // 带动态角度误差补偿的角度寄存器
+#define AS5047_CMD_READ         0x4000  // bit14 = 1 表示读
+#define AS5047_FRAME_EF         0x4000  // 返回帧 bit14: 错误标志
+#define AS5047_DATA_MASK        0x3FFF
+
+SpiEncoder::SpiEncoder(spi_host_device_t host, gpio_num_t sclk_io, gpio_num_t miso_io, gpio_num_t mosi_io,
+                       gpio_num_t cs_io) {
+    spi_bus_config_t bus_config = {
+            .mosi_io_num = mosi_io,
+            .miso_io_num = miso_io,
+            .sclk_io_num = sclk_io,
+            .quadwp_io_num = -1,
+            .quadhd_io_num = -1,
+            .max_transfer_sz = 4,
+    };
+    esp_err_t ret = spi_bus_initialize(host, &bus_config, SPI_DMA_DISABLED);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize SPI bus: %s", esp_err_to_name(ret));
+        return;
+    }
+
+    // AS5047P 使用 SPI mode 1
+    spi_device_interface_config_t dev_config = {
+            .mode = 1,
+            .clock_speed_hz = SPI_ENCODER_FREQ_HZ,
+            .spics_io_num = cs_io,
+            .queue_size = 1,
+    };
+    ret = spi_bus_add_device(host, &dev_config, &dev_handle_);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to add SPI device: %s", esp_err_to_name(ret));
+        return;
+    }
+
+    // 独占总线, 采样时不再需要每次申请总线
+    ESP_ERROR_CHECK(spi_device_acquire_bus(dev_handle_, portMAX_DELAY));
+}
+
+/*
+ * @brief 每帧都发送读 ANGLECOM 命令, 返回的是上一帧命令的结果 (流水线方式), 所以每个采样只需要一帧
+ */
+EncoderReadStatus SpiEncoder::_read_raw(uint16_t &raw) {
+    spi_transaction_t t = {};
+    t.flags = SPI_TRANS_USE_TXDATA | SPI_TRANS_USE_RXDATA;
+    t.length = 16;
+    uint16_t cmd = _add_parity(AS5047_CMD_READ | AS5047_REG_ANGLECOM);
+    t.tx_data[0] = cmd >> 8;
+    t.tx_data[1] = cmd & 0xFF;
+
+    esp_err_t ret = spi_device_polling_transmit(dev_handle_, &t);
+    if (ret == ESP_ERR_TIMEOUT) {
+        return EncoderReadStatus::Timeout;
+    } else if (ret != ESP_OK) {
+        return EncoderReadStatus::Error;
+    }
+
+    uint16_t frame = ((uint16_t) t.rx_data[0] << 8) | t.rx_data[1];
+    if (!_check_parity(frame) || (frame & AS5047_FRAME_EF)) {
+        return EncoderReadStatus::Error;
+    }
+
+    raw = frame & AS5047_DATA_MASK;
+    return EncoderReadStatus::Ok;
+}
+
+uint16_t SpiEncoder::_add_parity(uint16_t frame) {
+    frame &= 0x7FFF;
+    return __builtin_parity(frame) ? (frame | 0x8000) : frame;
+}
+
+bool SpiEncoder::_check_parity(uint16_t frame) {
+    return __builtin_parity(frame) == 0;
+}
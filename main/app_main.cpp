@@ -1,11 +1,13 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "nvs_flash.h"
 
 #include "debug_console.h"
 #include "logic_manager.h"
 #include "logic_mode.h"
 #include "pressure_sensor.h"
+#include "pid_gain_store.h"
 
 void activity_monitor(void *arg) {
     /*
@@ -34,17 +36,70 @@ void activity_monitor(void *arg) {
     }
 }
 
+/*
+ * @brief 读取 NVS 中保存的整定结果, 没有保存过或者数据损坏就保持默认参数
+ *        必须在用这些 PID 初始化增益调度表之前调用, 调度表运行时会覆盖 PID 自身的参数
+ */
+static void load_pid_gains(const char *key, PIDController *pid) {
+    PidGains gains{};
+    esp_err_t ret = PidGainStore::load(key, &gains);
+    if (ret == ESP_OK) {
+        pid->setPID(gains.kp, gains.ki, gains.kd);
+        ESP_LOGI("app_main", "Loaded %s gains kp: %f, ki: %f, kd: %f", key, gains.kp, gains.ki, gains.kd);
+    } else {
+        gains = pid->getPID();
+        ESP_LOGI("app_main", "No saved %s gains (%s), using kp: %f, ki: %f, kd: %f", key, esp_err_to_name(ret),
+                 gains.kp, gains.ki, gains.kd);
+    }
+}
+
 extern "C" void app_main() {
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(ret);
+
+#if FOC_ENCODER_TYPE == FOC_ENCODER_AS5600
     auto *iic_master = new IICMaster(IIC_MASTER_NUM, IIC_MASTER_SDA_IO, IIC_MASTER_SCL_IO);
-    auto *as5600 = new AS5600(iic_master->iic_master_get_bus_handle(), IIC_AS5600_ADDR);
+    auto *iic_arbiter = new IICBusArbiter(iic_master, FOC_CALC_PERIOD);
+    auto *encoder = new AS5600(iic_arbiter, IIC_AS5600_ADDR);
+#elif FOC_ENCODER_TYPE == FOC_ENCODER_SPI
+    auto *encoder = new SpiEncoder(SPI_ENCODER_HOST, SPI_ENCODER_SCLK_IO, SPI_ENCODER_MISO_IO,
+                                   SPI_ENCODER_MOSI_IO, SPI_ENCODER_CS_IO);
+#else
+    auto *encoder = new SimEncoder();
+#endif
     auto *foc_driver = new FocDriver(FOC_MCPWM_U_GPIO,
                                      FOC_MCPWM_V_GPIO,
                                      FOC_MCPWM_W_GPIO,
                                      FOC_DRV_EN_GPIO,
-                                     as5600,
+                                     encoder,
                                      FOC_MOTOR_POLE_PAIRS
     );
-    auto *rotary_knob = new RotaryKnob(foc_driver, as5600);
+    auto *rotary_knob = new RotaryKnob(foc_driver, encoder);
+
+    // 速度环和位置外环, 参数可以用 autotune 命令整定后保存
+    auto *pid_velocity = new PIDController(40, 400, 0, FOC_MCPWM_OUTPUT_LIMIT, FOC_MCPWM_OUTPUT_LIMIT, 0);
+    auto *pid_position = new PIDController(35, 0, 0.5, 40, 40, 0);
+    load_pid_gains("velocity", pid_velocity);
+    load_pid_gains("position", pid_position);
+
+    // 增益调度表, 开机时每个点都是同一组参数, 可以用 gains 命令按转速/位置分段修改
+    // 调度表从此拥有这两个 PID 的参数, 之后改参数要改表 (autotune 命令会同时写入 PID 和整张表)
+    auto *position_schedule = new GainSchedule(pid_position->getPID());
+    auto *velocity_schedule = new GainSchedule(pid_velocity->getPID());
+    auto *knob_schedule = new GainSchedule({1, 0, 0});
+    foc_driver->set_gain_schedule(position_schedule, pid_position, velocity_schedule, pid_velocity);
+    rotary_knob->set_gain_schedule(knob_schedule);
+
+    // 力反馈曲线库, 分区里没有合法的曲线时各模式使用内置参数; 用 tools/haptic_profile.py 生成和烧写
+    auto *haptic_profiles = new HapticProfileLibrary();
+    if (haptic_profiles->map_partition("haptic")) {
+        rotary_knob->set_profile_library(haptic_profiles);
+    }
+
     auto *physical_display = new PhysicalDisplay();
     auto *pressure_sensor = new PressureSensor(HX711_DOUT_GPIO, HX711_SCK_GPIO);
     auto *logic_manager = new LogicManager(pressure_sensor, foc_driver);
@@ -57,9 +112,23 @@ extern "C" void app_main() {
     logic_manager->register_mode("BoundedMode", new BoundedMode(rotary_knob, physical_display));
     logic_manager->register_mode("SwitchMode", new SwitchMode(rotary_knob, physical_display));
     logic_manager->register_mode("AttractorMode", new AttractorMode(rotary_knob, physical_display));
+    logic_manager->register_mode("FlywheelMode", new FlywheelMode(rotary_knob, physical_display));
 
     logic_manager->set_mode_by_name("UnboundedMode");
 
+    static float debug_params[5] = {};
+    auto *debug_console = new DebugConsole(debug_params);
+    debug_console->register_autotune_cmd(foc_driver, pid_velocity, pid_position);
+    debug_console->register_sysid_cmd(foc_driver);
+    debug_console->register_estimator_cmd(foc_driver);
+    debug_console->register_effect_cmd(foc_driver);
+    debug_console->register_events_cmd(rotary_knob);
+    debug_console->register_servo_cmd(rotary_knob);
+    debug_console->register_texture_cmd(rotary_knob);
+    debug_console->register_gain_schedule("position", position_schedule);
+    debug_console->register_gain_schedule("velocity", velocity_schedule);
+    debug_console->register_gain_schedule("knob", knob_schedule);
+
     // xTaskCreatePinnedToCore(activity_monitor, "activity_monitor", 4096, nullptr, 1, nullptr, 1);
 }
 
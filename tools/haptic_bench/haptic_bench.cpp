@@ -0,0 +1,2086 @@
+/*
+ * @brief 力反馈保真度基准, 在主机上运行
+ *
+ *        用 RotaryKnob 实际使用的 HapticRenderer 对着仿真的 电机 + 编码器 + 手 跑固定的场景, 输出每个模式的指标:
+ *          - 静止噪声: 不碰旋钮时转子角度的抖动 (mrad rms) 和输出力矩的抖动 (Uq rms)
+ *          - 棘轮: 手指匀速拖过吸附点时感觉到的峰值力矩 (Uq) 和吸附点中心的刚度 (Uq/rad, 越大越 "脆")
+ *          - 边界: 按调度表倍率逐级加大墙的刚度, 手指顶住墙不动, 转速抖动超过阈值即为颤振, 输出颤振前的最大刚度
+ *                  带 /P 的是纯比例墙 (set_passive_walls(false)), 用来和无源墙对比
+ *          - 无源性: 手带着旋钮做周期运动, 每个周期手做的净功 (mJ), 负值表示旋钮在往手里注入能量
+ *        表后是不需要比较的检查 (check), 任何一项失败时返回值非 0:
+ *          - 有界表两端的平衡点 (切换模式重新对齐零点用)
+ *          - 单表 (旋钮槽位用) 与三缓冲引擎查表结果相同; 提交不合法的表时单表换成力矩为 0 的表, 三缓冲保留原来的表
+ *          - 力矩模式的摩擦模型拟合: 没有手时收敛到仿真电机的摩擦, 有手时不被带偏
+ *          - 编码器毛刺: 匀速转动时注入总线位翻转 / 超时 / 长时间错误, 跳变被拒绝并计数, 角度和转速不受影响, 之后重新同步
+ *          - 飞轮: 按飞轮惯量和采样延迟扫一遍, 松手后 旋钮 + 飞轮 + 耦合弹簧 的能量只减不增
+ *          - 吸附点随转速减弱: 不同转速拖过棘轮时手上力矩的起伏, 与不减弱时之比按 KNOB_DETENT_FADE_* 变化
+ *          - 拖动中切换模式: 交叉淡化期间输出的变化与拖动本身相当, 旧规律保持自己的零点, 重新对齐最多半个吸附点间距,
+ *            压在墙里时不平移, 新规律的墙一开始就在墙里也能顶住
+ *          - 加速映射 (BallisticMapper): 小数步数跨格累计, 换方向时清零, 数值限制在范围内, 不合法的曲线被拒绝
+ *          - 回位伺服: 没有手时按规划的时长到达目标, 外部力矩的 CUSUM 离抓住阈值有余量 (编码器噪声 1 ~ 3 lsb);
+ *            运动中被手抓住时很快交回给力矩规律
+ *          - 纹理抗混叠: 开环匀速转过细纹, 通带内幅度不变, Nyquist 以上为 0; 闭环拖动时手上没有混叠出来的低频拍
+ *          - PID: 与改进前的实现对比饱和阶跃的超调、位置阶跃的微分冲击、静摩擦补偿过零的跳变、改增益和切换模式的输出跳变,
+ *            并报告每次 calculate() 的耗时
+ *          - 自整定: 继电振荡得到的临界增益 / 周期与线性化模型的理论值相符 (速度环和位置环), 整定出的参数闭环后阶跃响应合格
+ *          - 位置指令轨迹: 速度 / 加速度 / 加加速度不越限、不过冲, 时长与闭式解相同; 接上串级后按时到达
+ *          - 力反馈曲线库: tools/haptic_profile.py 编码的镜像被 load() 读回来与 JSON 相同, compile() 的表与内置模式相同;
+ *            CRC 错误、截断、数量越界、擦除过的分区都被拒绝, 并且不会读出映射范围
+ *          - 串级分频: 位置外环每 1 / 2 / 4 / 8 个周期运行一次时的阶跃带宽和超调, 默认分频不比全速运行慢,
+ *            并报告 CascadeController::update() 每个周期的耗时
+ *
+ *        仿真内容: KnobPlant 电机模型, AS5600 量化和读数噪声, 采样到输出之间的 I2C 延迟, 控制周期抖动,
+ *                 力矩模式下 FocDriver 的摩擦模型拟合 / 摩擦补偿 (按 FOC_TORQUE_FRICTION_COMPENSATION) 和卡尔曼转速估计,
+ *                 旋钮定时器与 FOC 任务之间一个周期的延迟
+ *        手指用 刚度 + 阻尼 的阻抗模型, 目标位置按场景给定
+ *
+ *        用法: haptic_bench [--latency <us>] [--jitter <us>] [--noise <lsb>] [--seed <n>] [--csv]
+ *        改过力矩规律或参数后跑一遍, 与之前的输出对比, 手感的退化就变成了数字
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "motor_sim.h"
+#include "disturbance_observer.h"
+#include "kalman_estimator.h"
+#include "haptic_renderer.h"
+#include "haptic_crossfade.h"
+#include "haptic_profile_library.h"
+#include "ballistic_mapper.h"
+#include "scurve_trajectory.h"
+#include "relay_autotuner.h"
+#include "motor_cascade_controller.h"
+#include "project_conf.h"
+
+namespace {
+
+constexpr float Ts = FOC_CALC_PERIOD * 1e-6f;
+constexpr float hand_substep = 2.5e-4f;     // 手指力矩的更新步长 (s), 手指很硬, 需要比控制周期细
+constexpr float chatter_velocity_rms = 0.5f;    // 顶住墙时转速抖动超过该值 (rad/s) 视为颤振
+
+struct BenchConfig {
+    float latency_us = 500;     // 编码器采样到 PWM 更新的延迟 (100kHz I2C 读一次约 0.5ms)
+    float jitter_us = 100;      // 控制周期抖动 (均匀分布 ±)
+    float noise_lsb = 1;        // 编码器读数噪声标准差 (刻度)
+    uint32_t seed = 1;
+    bool csv = false;
+};
+
+struct Hand {
+    bool engaged = false;
+    float stiffness = 2000;     // Uq / rad
+    float damping = 10;         // Uq / (rad/s)
+    std::function<float(float)> target;     // 目标位置 (rad), 参数为时间 (s)
+};
+
+/*
+ * @brief 一个仿真的旋钮: 电机 + 编码器 + FOC 力矩模式 + 旋钮力矩规律 + 手
+ */
+class SimKnob {
+public:
+    SimKnob(const BenchConfig &config, HapticRenderer *renderer, float start_position = 0,
+            const KnobPlantParams &plant = KnobPlantParams())
+            : config_(config), renderer_(renderer), plant_(&encoder_, plant), rng_(config.seed),
+              jitter_(-config.jitter_us * 1e-6f, config.jitter_us * 1e-6f),
+              noise_(0, config.noise_lsb * float(M_TWOPI) / float(SimEncoder::resolution)) {
+        plant_.reset(0);
+        (void) encoder_.read_radian_from_sensor();
+        origin_ = encoder_.reset_custom_total_radian();
+        plant_.reset(start_position);   // 自定义零点在 0, 从 start_position 开始
+        observer_.set_unattended_detection(FOC_FRICTION_ADAPT_HAND_RATIO, FOC_FRICTION_ADAPT_HAND_FILTER,
+                                           FOC_FRICTION_ADAPT_HAND_HOLD, FOC_FRICTION_ADAPT_MIN_VELOCITY);
+    }
+
+    Hand &hand() { return hand_; }
+
+    void tick() {   // 一个 FOC 周期
+        float period = Ts + jitter_(rng_);
+        float latency = config_.latency_us * 1e-6f;
+
+        // FOC 任务: 读角度, 力矩模式 = 旋钮的指令 + 摩擦补偿, 与 FocDriver::_torque_friction_compensation 一致
+        encoder_.set_mechanical_radian(plant_.get_position() + noise_(rng_));
+        (void) encoder_.read_radian_from_sensor();
+        float velocity = encoder_.get_velocity_filter();
+        float applied_uq = last_uq_;
+        observer_.update(applied_uq, velocity);
+        observer_.adapt_friction_unattended(velocity, estimator_.get_external_torque());
+        float uq = knob_uq_;
+        if (FOC_TORQUE_FRICTION_COMPENSATION) {
+            uq += observer_.friction_compensation(velocity, FOC_TORQUE_FRICTION_RAMP);
+        }
+        uq = uq > FOC_MCPWM_OUTPUT_LIMIT ? FOC_MCPWM_OUTPUT_LIMIT : (uq < -FOC_MCPWM_OUTPUT_LIMIT ? -FOC_MCPWM_OUTPUT_LIMIT : uq);
+        estimator_.update(applied_uq, observer_.friction_compensation(estimator_.get_velocity()),
+                          encoder_.get_position());
+
+        // 总线读取期间还是上一个周期的输出
+        _advance(last_uq_, latency);
+        _advance(uq, period - latency);
+        last_uq_ = uq;
+
+        // 旋钮定时器: 结果在下一个 FOC 周期生效, 切换模式期间与 RotaryKnob 一样交叉淡化
+        input_ = _input(origin_);
+        knob_uq_ = renderer_->render(input_);
+        if (crossfade_.fading()) {
+            knob_uq_ = crossfade_.blend(knob_uq_, outgoing_->render(_input(outgoing_origin_)));
+        }
+    }
+
+    // 与 RotaryKnob 的模式设置函数相同: 零点重置到 reset_radian, 或者沿用当前角度 (reanchor 时平移到 next 最近的平衡点),
+    // 旧规律保持自己的零点, 在 ticks 个周期内淡化到 next. 返回零点平移的距离 (rad)
+    float switch_to(HapticRenderer *next, bool reset_custom_pos, float reset_radian, bool reanchor, int ticks) {
+        float current_radian = input_.position;
+        float frame = reset_custom_pos ? reset_radian : (reanchor ? next->nearest_rest(current_radian) : current_radian);
+        if (!crossfade_.fading()) {
+            outgoing_ = renderer_;
+            outgoing_origin_ = origin_;
+            crossfade_.start(ticks);
+        }
+        renderer_ = next;
+        origin_ = encoder_.set_custom_total_radian(frame);
+        return frame - current_radian;
+    }
+
+    [[nodiscard]] bool switching() const { return crossfade_.fading(); }
+
+    void run(float seconds, const std::function<void()> &on_tick = nullptr) {
+        int ticks = int(seconds / Ts);
+        for (int i = 0; i < ticks; i++) {
+            tick();
+            if (on_tick) {
+                on_tick();
+            }
+        }
+    }
+
+    [[nodiscard]] float time() const { return time_; }
+
+    [[nodiscard]] float position() const { return plant_.get_position(); }     // 真实角度
+
+    [[nodiscard]] float velocity() const { return plant_.get_velocity(); }
+
+    [[nodiscard]] float output_uq() const { return last_uq_; }
+
+    [[nodiscard]] float hand_torque() const { return hand_torque_; }   // 手指施加的力矩 (Uq), 即手感觉到的阻力
+
+    [[nodiscard]] float hand_work() const { return hand_work_; }   // 手做的累计功 (Uq·rad)
+
+    [[nodiscard]] const HapticInput &input() const { return input_; }  // 上一个旋钮周期给力矩规律的输入
+
+    [[nodiscard]] float hand_impulse() const { return hand_impulse_; }     // 手力矩的累计冲量 (Uq·s), 求一个周期内的平均力矩用
+
+    // 在线拟合的摩擦模型在该转速下的摩擦 (Uq)
+    [[nodiscard]] float fitted_friction(float velocity) const { return observer_.friction_compensation(velocity); }
+
+private:
+    BenchConfig config_;
+    HapticRenderer *renderer_;
+    SimEncoder encoder_;
+    KnobPlant plant_;
+    DisturbanceObserver observer_{FOC_FEEDFORWARD_ACCEL, FOC_FEEDFORWARD_VELOCITY, FOC_DOB_BANDWIDTH, Ts,
+                                  FOC_FRICTION_ADAPT_TIME, FOC_FRICTION_VELOCITY_DEADBAND,
+                                  FOC_MCPWM_STATIC_FRIC_TORQUE};
+    KalmanEstimator estimator_{FOC_FEEDFORWARD_ACCEL, FOC_FEEDFORWARD_VELOCITY, Ts, FOC_KALMAN_ANGLE_NOISE,
+                               FOC_KALMAN_VELOCITY_NOISE, FOC_KALMAN_TORQUE_NOISE};
+    Hand hand_;
+    std::mt19937 rng_;
+    std::uniform_real_distribution<float> jitter_;
+    std::normal_distribution<float> noise_;
+
+    float time_ = 0;
+    float last_uq_ = 0;
+    float knob_uq_ = 0;
+    HapticInput input_{};
+    encoder_position_t origin_{};           // 当前规律的零点 (编码器累计位置)
+    HapticRenderer *outgoing_{};            // 正在淡出的规律和它的零点
+    encoder_position_t outgoing_origin_{};
+    HapticCrossfade crossfade_;
+    float hand_torque_ = 0;
+    float hand_work_ = 0;
+    float hand_impulse_ = 0;
+
+    [[nodiscard]] HapticInput _input(encoder_position_t origin) const {
+        encoder_position_t position = encoder_.get_position() - origin;
+        return HapticInput{
+                .position = encoder_position_to_radian(position),
+                .velocity = encoder_.get_velocity_filter(),
+                .estimated_velocity = estimator_.get_velocity(),
+                .angle = encoder_position_angle(position),
+                .external_torque = estimator_.get_external_torque(),
+        };
+    }
+
+    void _advance(float uq, float dt) {
+        while (dt > 1e-7f) {
+            float h = dt < hand_substep ? dt : hand_substep;
+            hand_torque_ = 0;
+            if (hand_.engaged) {
+                float target = hand_.target(time_);
+                float target_velocity = (hand_.target(time_ + 1e-4f) - target) / 1e-4f;
+                hand_torque_ = hand_.stiffness * (target - plant_.get_position()) +
+                               hand_.damping * (target_velocity - plant_.get_velocity());
+            }
+            plant_.set_external_torque(hand_torque_ * plant_.get_params().torque_per_uq);
+            float before = plant_.get_position();
+            plant_.step(uq, h);
+            hand_work_ += hand_torque_ * (plant_.get_position() - before);
+            hand_impulse_ += hand_torque_ * h;
+            time_ += h;
+            dt -= h;
+        }
+    }
+};
+
+/*
+ * @brief 仿真的闭环电机: 电机 + 编码器 + 采样延迟 + 控制周期抖动, 没有手
+ *        代替 FocDriver 的闭环模式 (速度 / 位置 / 自整定), 每个周期 sample() 读编码器, 调用方算出 Uq 后 apply()
+ */
+class SimMotor {
+public:
+    explicit SimMotor(const BenchConfig &config, const KnobPlantParams &plant = KnobPlantParams())
+            : config_(config), plant_(&encoder_, plant), rng_(config.seed),
+              jitter_(-config.jitter_us * 1e-6f, config.jitter_us * 1e-6f),
+              noise_(0, config.noise_lsb * float(M_TWOPI) / float(SimEncoder::resolution)) {
+        plant_.reset(0);
+        (void) encoder_.read_radian_from_sensor();
+    }
+
+    void sample() {
+        encoder_.set_mechanical_radian(plant_.get_position() + noise_(rng_));
+        (void) encoder_.read_radian_from_sensor();
+    }
+
+    void apply(float uq) {  // 总线读取期间还是上一个周期的输出, 之后换成 uq 直到下一次采样
+        uq = uq > FOC_MCPWM_OUTPUT_LIMIT ? FOC_MCPWM_OUTPUT_LIMIT : (uq < -FOC_MCPWM_OUTPUT_LIMIT ? -FOC_MCPWM_OUTPUT_LIMIT : uq);
+        float period = Ts + jitter_(rng_);
+        float latency = config_.latency_us * 1e-6f;
+        plant_.step(last_uq_, latency);
+        plant_.step(uq, period - latency);
+        last_uq_ = uq;
+        time_ += period;
+    }
+
+    [[nodiscard]] const SimEncoder &encoder() const { return encoder_; }
+
+    [[nodiscard]] float measured_position() const { return encoder_.get_total_radian(); }
+
+    [[nodiscard]] float measured_velocity() const { return encoder_.get_velocity_filter(); }
+
+    [[nodiscard]] float position() const { return plant_.get_position(); }     // 真实角度
+
+    [[nodiscard]] float velocity() const { return plant_.get_velocity(); }
+
+    [[nodiscard]] float output_uq() const { return last_uq_; }
+
+    [[nodiscard]] float time() const { return time_; }
+
+private:
+    BenchConfig config_;
+    SimEncoder encoder_;
+    KnobPlant plant_;
+    std::mt19937 rng_;
+    std::uniform_real_distribution<float> jitter_;
+    std::normal_distribution<float> noise_;
+    float last_uq_ = 0;
+    float time_ = 0;
+};
+
+struct ModeSetup {
+    const char *name;
+    std::function<void(HapticRenderer &)> configure;
+    bool has_detents;
+    bool has_walls;
+    float detent_span;      // 吸附点间距 (rad)
+    float detent_origin;    // 其中一个吸附点的位置 (rad)
+    float sweep_from;       // 拖动测试的范围 (rad)
+    float sweep_to;
+    float right_wall;       // 右边界 (rad)
+    float cycle_center;     // 无源性测试的周期运动
+    float cycle_amplitude;
+    float cycle_hz;
+};
+
+struct ModeResult {
+    float rest_noise_mrad = NAN;
+    float rest_uq_rms = NAN;
+    float detent_peak = NAN;
+    float detent_stiffness = NAN;
+    float max_wall_stiffness = NAN;
+    float hand_work_mj = NAN;
+};
+
+float uq_rad_to_mj(float work) {    // Uq·rad → mJ
+    return work * KnobPlantParams().torque_per_uq * 1e3f;
+}
+
+// 不碰旋钮, 从偏离吸附点的位置松手, 1 秒后统计 2 秒的角度抖动和输出抖动
+void measure_rest(const BenchConfig &config, const ModeSetup &setup, ModeResult &result) {
+    HapticRenderer renderer;
+    setup.configure(renderer);
+    SimKnob knob(config, &renderer, 0.1f);
+    knob.run(1.0f);
+
+    double sum = 0, sum_sq = 0, uq_sq = 0;
+    int n = 0;
+    knob.run(2.0f, [&] {
+        sum += knob.position();
+        sum_sq += double(knob.position()) * knob.position();
+        uq_sq += double(knob.output_uq()) * knob.output_uq();
+        n++;
+    });
+    double mean = sum / n;
+    result.rest_noise_mrad = float(std::sqrt(std::fmax(0.0, sum_sq / n - mean * mean)) * 1e3);
+    result.rest_uq_rms = float(std::sqrt(uq_sq / n));
+}
+
+// 手指以 0.5 rad/s 匀速拖过吸附点, 记录手感觉到的力矩随角度的变化
+void measure_detents(const BenchConfig &config, const ModeSetup &setup, ModeResult &result) {
+    HapticRenderer renderer;
+    setup.configure(renderer);
+    SimKnob knob(config, &renderer);
+    const float speed = 0.5f;
+    float from = setup.sweep_from, to = setup.sweep_to;
+    knob.hand().engaged = true;
+    knob.hand().target = [=](float t) { return t < 0.5f ? from * t / 0.5f : std::fmin(from + speed * (t - 0.5f), to); };
+    knob.run(0.5f);
+
+    std::vector<std::pair<float, float>> curve;     // (角度, 手的力矩)
+    knob.run((to - from) / speed, [&] { curve.emplace_back(knob.position(), knob.hand_torque()); });
+
+    float peak = 0;     // 拖动方向上的最大阻力, 越过峰值后吸过去的那一下不算
+    for (auto &[position, torque]: curve) {
+        peak = std::fmax(peak, torque);
+    }
+    // 每个吸附点中心 ±10% 间距内做线性拟合, 斜率就是手感觉到的中心刚度
+    double stiffness_sum = 0;
+    int stiffness_count = 0;
+    float window = 0.1f * setup.detent_span;
+    float first = setup.detent_origin + std::ceil((from - setup.detent_origin) / setup.detent_span) * setup.detent_span;
+    for (float center = first; center <= to; center += setup.detent_span) {
+        double sx = 0, sy = 0, sxx = 0, sxy = 0;
+        int n = 0;
+        for (auto &[position, torque]: curve) {
+            float x = position - center;
+            if (std::fabs(x) <= window) {
+                sx += x;
+                sy += torque;
+                sxx += double(x) * x;
+                sxy += double(x) * torque;
+                n++;
+            }
+        }
+        double denominator = n * sxx - sx * sx;
+        if (n >= 5 && denominator > 0) {
+            stiffness_sum += (n * sxy - sx * sy) / denominator;
+            stiffness_count++;
+        }
+    }
+    result.detent_peak = peak;
+    result.detent_stiffness = stiffness_count > 0 ? float(stiffness_sum / stiffness_count) : NAN;
+}
+
+// 按调度表倍率把墙的刚度从 75 Uq/rad 逐级加倍, 手指顶住右边界 (约 150 Uq), 转速抖动超过阈值即为颤振
+void measure_wall(const BenchConfig &config, const ModeSetup &setup, ModeResult &result) {
+    float best = NAN;
+    for (float stiffness = 75.0f; stiffness <= 76800.0f; stiffness *= 2) {
+        HapticRenderer renderer;
+        setup.configure(renderer);
+        GainSchedule schedule({stiffness / renderer.get_wall_stiffness(), 0, 0});
+        renderer.set_gain_schedule(&schedule);
+        SimKnob knob(config, &renderer);
+        float wall = setup.right_wall;
+        knob.hand().engaged = true;
+        knob.hand().stiffness = 1500;
+        knob.hand().target = [=](float t) { return std::fmin(t / 0.5f, 1.0f) * (wall + 0.1f); };
+        knob.run(1.0f);
+
+        double velocity_sq = 0;
+        int n = 0;
+        knob.run(1.0f, [&] {
+            velocity_sq += double(knob.velocity()) * knob.velocity();
+            n++;
+        });
+        if (std::sqrt(velocity_sq / n) > chatter_velocity_rms) {
+            break;
+        }
+        best = stiffness;
+    }
+    result.max_wall_stiffness = best;
+}
+
+// 手带着旋钮做正弦运动, 统计后 4 个整周期手做的净功
+void measure_passivity(const BenchConfig &config, const ModeSetup &setup, ModeResult &result) {
+    HapticRenderer renderer;
+    setup.configure(renderer);
+    SimKnob knob(config, &renderer);
+    float center = setup.cycle_center, amplitude = setup.cycle_amplitude, hz = setup.cycle_hz;
+    knob.hand().engaged = true;
+    knob.hand().target = [=](float t) {
+        float ramp = std::fmin(t, 1.0f);
+        return ramp * center + amplitude * std::sin(float(M_TWOPI) * hz * t);
+    };
+    knob.run(1.0f + 2.0f / hz);
+    float work_start = knob.hand_work();
+    const int cycles = 4;
+    knob.run(cycles / hz);
+    result.hand_work_mj = uq_rad_to_mj(knob.hand_work() - work_start) / cycles;
+}
+
+int check_failures = 0;
+
+void report_check(bool ok, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    printf("check  %-4s  ", ok ? "ok" : "FAIL");
+    vprintf(format, args);
+    printf("\n");
+    va_end(args);
+    check_failures += ok ? 0 : 1;
+}
+
+// 有界吸附表的两个端点 (力矩为 0, 外侧是墙) 都是平衡点, 停在端点附近重新对齐时不能跳到隔壁的吸附点;
+// 越过端点压在墙里时不平移
+void check_nearest_rest() {
+    const struct {
+        int count;
+        float left, right;
+    } tables[] = {{1, -float(M_PI / 6.0), float(M_PI / 6.0)}, {2, -0.5236f, 0.5236f}, {4, -1, 1}};
+    for (const auto &table: tables) {
+        HapticProfileEngine engine;
+        engine.edit().make_bounded_detents(table.count, table.left, table.right, 150, 333);
+        engine.commit();
+        float worst = 0, worst_at = 0, worst_rest = 0;
+        for (float end: {table.left, table.right}) {
+            float inward = end < 0 ? 1.0f : -1.0f;
+            for (float offset: {0.0f, 0.05f, -0.05f}) {
+                float position = end + inward * offset;
+                float expected = offset < 0 ? position : end;
+                float rest = engine.nearest_rest(position);
+                if (std::fabs(rest - expected) >= worst) {
+                    worst = std::fabs(rest - expected);
+                    worst_at = position;
+                    worst_rest = rest;
+                }
+            }
+        }
+        report_check(worst < 1e-3f, "nearest_rest  %d detents [%+.4f, %+.4f] ends ±0.05: worst %+.4f -> %+.4f",
+                     table.count, table.left, table.right, worst_at, worst_rest);
+    }
+}
+
+// 旋钮每个槽位只有一张表: 查表结果与三缓冲引擎相同, 提交不合法的表时不能留下改了一半的表
+void check_profile_table() {
+    HapticProfileTable table;
+    HapticProfileEngine engine;
+    table.edit().make_bounded_detents(4, -1, 1, 150, 333);
+    engine.edit().make_bounded_detents(4, -1, 1, 150, 333);
+    bool committed = table.commit() && engine.commit();
+    table.acquire();
+    engine.acquire();
+    float worst = 0;
+    for (int i = 0; i <= 200; i++) {
+        float position = -1.2f + 2.4f * float(i) / 200, velocity = 3.0f * std::sin(float(i));
+        worst = std::max(worst, std::fabs(table.evaluate(position, velocity) - engine.evaluate(position, velocity)));
+    }
+    report_check(committed && worst == 0, "profile table  single vs triple buffered: worst difference %.6f", worst);
+
+    table.edit().points = 1;
+    engine.edit().points = 1;
+    bool rejected = !table.commit() && !engine.commit();
+    table.acquire();
+    engine.acquire();
+    float single = 0;
+    for (float position: {-1.1f, -0.3f, 0.2f, 0.9f}) {
+        single = std::max(single, std::fabs(table.evaluate(position, 2.0f)));
+    }
+    bool kept = engine.get_rendered_profile().points > 1 && std::fabs(engine.evaluate(-0.3f, 0)) > 0;
+    report_check(rejected && single == 0 && table.get_profile().points >= 2 && kept,
+                 "profile table  invalid commit: single table torque %.4f, triple buffered keeps previous %s",
+                 single, kept ? "yes" : "no");
+}
+
+// 力矩模式的摩擦模型拟合: 飞轮带着电机自己滑行时收敛到仿真电机的摩擦 (冷机 / 热机), 手一直拨动旋钮时不被手的力矩带偏
+void check_friction_fit(const BenchConfig &config) {
+    const float probe_velocity = 5.0f;
+    for (float plant_coulomb: {16.0f, 24.0f, 36.0f}) {
+        KnobPlantParams params;
+        params.coulomb = plant_coulomb * params.torque_per_uq;
+        float plant_friction = plant_coulomb + params.viscous / params.torque_per_uq * probe_velocity;
+        HapticRenderer renderer;
+        renderer.set_flywheel(3.0f, 20.0f, 0.3f, 0);
+        renderer.set_mode(HapticMode::Flywheel);
+        SimKnob knob(config, &renderer, 0, params);
+        // 每 2 秒甩一下: 手 0.2 秒内以 10 rad/s 带着旋钮转, 然后松开让飞轮滑行
+        float flick_start = 0, flick_from = 0;
+        knob.hand().target = [&](float t) { return flick_from + 10.0f * (t - flick_start); };
+        knob.run(90.0f, [&] {
+            bool flicking = std::fmod(knob.time(), 2.0f) < 0.2f;
+            if (flicking && !knob.hand().engaged) {
+                flick_start = knob.time();
+                flick_from = knob.position();
+            }
+            knob.hand().engaged = flicking;
+        });
+        float fitted = knob.fitted_friction(probe_velocity);
+        report_check(std::fabs(fitted - plant_friction) < 0.15f * plant_friction,
+                     "friction fit  flywheel coasting, plant %.1f Uq at %.0f rad/s: fitted %.1f Uq (initial %.1f)",
+                     plant_friction, probe_velocity, fitted, FOC_MCPWM_STATIC_FRIC_TORQUE);
+    }
+
+    HapticRenderer renderer;
+    renderer.set_damping(0);
+    renderer.set_mode(HapticMode::Damping);
+    SimKnob knob(config, &renderer);
+    float initial = knob.fitted_friction(probe_velocity);
+    knob.hand().engaged = true;
+    knob.hand().target = [](float t) { return 2.0f * std::sin(float(M_TWOPI) * 0.5f * t); };
+    knob.run(90.0f);
+    float fitted = knob.fitted_friction(probe_velocity);
+    report_check(std::fabs(fitted - initial) < 0.1f * initial,
+                 "friction fit  hand turning the knob for 90 s: %.1f -> %.1f Uq at %.0f rad/s",
+                 initial, fitted, probe_velocity);
+}
+
+// 编码器匀速转动, fault(tick) 在每次读取前注入故障; 返回累计角度相对真实角度的误差 (rad) 和转速的最大偏差
+// 飞轮松手后的能量: 旋钮动能 + 飞轮动能 + 耦合弹簧势能 (Uq·rad), 只靠飞轮的摩擦规律耗散, 不能增长
+// 按飞轮惯量和采样延迟扫一遍: 延迟越大耦合越容易变成有源的, 能量增长说明松手后会越转越快或者来回振荡
+void check_flywheel_energy(const BenchConfig &config) {
+    const float torque_per_uq = KnobPlantParams().torque_per_uq;
+    const float knob_inertia = KnobPlantParams().inertia / torque_per_uq;    // 换算成 Uq / (rad/s²)
+    for (float inertia: {1.0f, 3.0f, 10.0f}) {
+        for (float latency_us: {250.0f, 500.0f, 1000.0f, 1500.0f}) {
+            BenchConfig run_config = config;
+            run_config.latency_us = latency_us;
+            HapticRenderer renderer;
+            renderer.set_flywheel(inertia, 2.0f, 0.05f, 0);    // 很轻的摩擦规律, 耦合注入的能量不会被摩擦掩盖
+            renderer.set_mode(HapticMode::Flywheel);
+            SimKnob knob(run_config, &renderer);
+            // 手 0.3 秒内以 10 rad/s 带着旋钮转, 然后松开
+            knob.hand().engaged = true;
+            knob.hand().target = [](float t) { return 10.0f * t; };
+            knob.run(0.3f);
+            knob.hand().engaged = false;
+
+            const VirtualFlywheel &flywheel = renderer.get_flywheel();
+            auto energy = [&] {
+                float stretch = flywheel.get_position() - knob.position();
+                return 0.5f * knob_inertia * knob.velocity() * knob.velocity() +
+                       0.5f * inertia * flywheel.get_velocity() * flywheel.get_velocity() +
+                       0.5f * KNOB_FLYWHEEL_STIFFNESS * stretch * stretch;
+            };
+            // 与松手以来的最低能量比, 留出编码器噪声和耦合弹簧来回交换能量的余量
+            const float release = energy();
+            float lowest = release, growth = 0;
+            knob.run(4.0f, [&] {
+                float e = energy();
+                growth = std::fmax(growth, e - lowest);
+                lowest = std::fmin(lowest, e);
+            });
+            float final = energy();
+            report_check(release > 0 && growth < 0.02f * release && final < 0.01f * release,
+                         "flywheel energy  inertia %4.1f, latency %4.0f us: %.2f mJ at release, largest rise %.3f mJ, "
+                         "%.3f mJ after 4 s", inertia, latency_us, release * torque_per_uq * 1e3f,
+                         growth * torque_per_uq * 1e3f, final * torque_per_uq * 1e3f);
+        }
+    }
+}
+
+struct EncoderRun {
+    float max_position_error = 0;
+    float final_position_error = 0;
+    float max_velocity_error = 0;
+    EncoderStats stats{};
+};
+
+EncoderRun run_encoder(float velocity, int ticks, const std::function<void(SimEncoder &, int)> &fault) {
+    SimEncoder encoder;
+    EncoderRun result;
+    const int warmup = 200;     // 转速滤波稳定之后再统计
+    for (int i = -warmup; i < ticks; i++) {
+        float truth = velocity * float(i + warmup) * Ts;
+        encoder.set_mechanical_radian(truth);
+        if (i == 0) {
+            encoder.reset_stats();
+        }
+        if (i >= 0) {
+            fault(encoder, i);
+        }
+        (void) encoder.read_radian_from_sensor();
+        if (i >= 0) {
+            result.final_position_error = std::fabs(encoder.get_total_radian() - truth);
+            result.max_position_error = std::fmax(result.max_position_error, result.final_position_error);
+            result.max_velocity_error = std::fmax(result.max_velocity_error,
+                                                  std::fabs(encoder.get_velocity_filter() - velocity));
+        }
+    }
+    result.stats = encoder.get_stats();
+    return result;
+}
+
+// 编码器毛刺拒绝: 物理上不可能的跳变不进入角度和转速, 故障期间按转速外推, 长时间故障后重新同步
+void check_encoder_glitches() {
+    const float lsb = float(M_TWOPI) / float(SimEncoder::resolution);
+    const float velocity = 5.0f;
+    const int ticks = 1000;
+    EncoderRun clean = run_encoder(velocity, ticks, [](SimEncoder &, int) {});
+
+    // 每 50 个周期一次位翻转, 大小和方向轮换; 都远大于一个周期内可能的转动 (ENCODER_MAX_VELOCITY_RAD_S)
+    const int32_t offsets[] = {512, -1024, 2048, -2047, 1500};
+    int injected = 0;
+    EncoderRun glitched = run_encoder(velocity, ticks, [&](SimEncoder &encoder, int tick) {
+        if (tick % 50 == 25) {
+            encoder.inject_glitch(offsets[injected++ % 5]);
+        }
+    });
+    report_check(glitched.stats.glitches == uint32_t(injected) && glitched.stats.resyncs == 0 &&
+                 glitched.max_position_error <= clean.max_position_error + lsb &&
+                 glitched.max_velocity_error <= clean.max_velocity_error + 0.1f,
+                 "encoder glitch  %d bit flips at %.0f rad/s: rejected %u, angle error %.1f lsb (%.1f clean), "
+                 "velocity error %.2f rad/s (%.2f clean)", injected, velocity, glitched.stats.glitches,
+                 glitched.max_position_error / lsb, clean.max_position_error / lsb, glitched.max_velocity_error,
+                 clean.max_velocity_error);
+
+    // 短时间超时: 按转速外推, 角度不掉队
+    EncoderRun timeout = run_encoder(velocity, ticks, [](SimEncoder &encoder, int tick) {
+        if (tick == 300) {
+            encoder.inject_fault(EncoderReadStatus::Timeout, ENCODER_EXTRAPOLATE_SAMPLES);
+        }
+    });
+    report_check(timeout.stats.timeouts == ENCODER_EXTRAPOLATE_SAMPLES && timeout.stats.resyncs == 0 &&
+                 timeout.max_position_error <= clean.max_position_error + lsb,
+                 "encoder glitch  %d timeouts at %.0f rad/s: counted %u, angle error %.1f lsb (%.1f clean)",
+                 ENCODER_EXTRAPOLATE_SAMPLES, velocity, timeout.stats.timeouts, timeout.max_position_error / lsb,
+                 clean.max_position_error / lsb);
+
+    // 长时间错误: 外推停止后角度落后, 落后得超过跳变阈值, 恢复后重新同步一次, 最后误差回到量化误差以内
+    const int burst = 4 * ENCODER_RESYNC_SAMPLES;
+    EncoderRun resync = run_encoder(velocity, ticks, [&](SimEncoder &encoder, int tick) {
+        if (tick == 300) {
+            encoder.inject_fault(EncoderReadStatus::Error, burst);
+        }
+    });
+    report_check(resync.stats.errors == uint32_t(burst) && resync.stats.resyncs == 1 && resync.stats.glitches == 0 &&
+                 resync.stats.consecutive_bad == 0 && resync.final_position_error <= clean.max_position_error + lsb,
+                 "encoder glitch  %d errors at %.0f rad/s: counted %u, resyncs %u, angle error at the end %.1f lsb",
+                 burst, velocity, resync.stats.errors, resync.stats.resyncs, resync.final_position_error / lsb);
+}
+
+// 8 个吸附点的棘轮, 手以 velocity 匀速拖动, 返回手上力矩的起伏 (去掉均值后的 rms, 即吸附点的手感)
+float detent_ripple(const BenchConfig &config, float velocity, const DetentFade &fade) {
+    HapticRenderer renderer;
+    renderer.set_detent_fade(fade);
+    renderer.set_attractor(8);
+    renderer.set_mode(HapticMode::Attractor);
+    SimKnob knob(config, &renderer);
+    knob.hand().engaged = true;
+    knob.hand().target = [=](float t) { return velocity * t; };
+    knob.run(0.5f);     // 先跑到匀速
+    double sum = 0, sum_sq = 0;
+    int count = 0;
+    float span = float(M_TWOPI) / 8;
+    knob.run(std::fmax(4 * span / velocity, 0.5f), [&] {  // 至少 4 个吸附点
+        sum += knob.hand_torque();
+        sum_sq += double(knob.hand_torque()) * knob.hand_torque();
+        count++;
+    });
+    double mean = sum / count;
+    return float(std::sqrt(std::fmax(sum_sq / count - mean * mean, 0.0)));
+}
+
+// 吸附点随转速减弱: 同一转速下与不减弱时的起伏之比, 慢拧时不变, 甩动时减到 KNOB_DETENT_FADE_MIN 附近
+void check_detent_fade(const BenchConfig &config) {
+    const DetentFade fade{KNOB_DETENT_FADE_START, KNOB_DETENT_FADE_END, KNOB_DETENT_FADE_MIN};
+    for (float velocity: {1.0f, 2.0f, 8.0f, 12.0f, 16.0f}) {
+        float faded = detent_ripple(config, velocity, fade);
+        float full = detent_ripple(config, velocity, DetentFade{});
+        float ratio = faded / full;
+        float expected = 1;     // 与 HapticRenderer::_detent_scale 相同
+        if (velocity >= fade.end_velocity) {
+            expected = fade.min_scale;
+        } else if (velocity > fade.start_velocity) {
+            float s = (velocity - fade.start_velocity) / (fade.end_velocity - fade.start_velocity);
+            expected = 1 - (1 - fade.min_scale) * s * s * (3 - 2 * s);
+        }
+        // 拖过吸附点时转速本身有起伏, 倍率按瞬时转速算, 只要求大致吻合
+        report_check(std::fabs(ratio - expected) < 0.15f,
+                     "detent fade  8 detents dragged at %4.1f rad/s: ripple %5.1f Uq rms (%5.1f without fade), "
+                     "ratio %.2f, expect %.2f", velocity, faded, full, ratio, expected);
+    }
+}
+
+struct SwitchRun {
+    float drag_step = 0;        // 切换前和淡化结束后各 0.1 s 内, 10 ms 平均输出的最大变化 (Uq)
+    float switch_step = 0;      // 跨过切换到淡化结束 (加上旋钮定时器到 FOC 任务的延迟) 的最大变化 (Uq)
+    float shift = 0;            // 零点平移 (rad)
+    float reading = 0;          // 切换后新坐标系下的角度 (rad)
+};
+
+// 手拖着旋钮经过 switch_at 时切换到 next, 与 LogicManager 一样传入当前的自定义角度
+// 墙的能量限制会对编码器噪声做出单个周期的尖峰, 所以比较前后各 10 ms 的平均输出, 而不是相邻两个周期
+SwitchRun run_mode_switch(const BenchConfig &config, const std::function<void(HapticRenderer &)> &configure,
+                          const std::function<void(HapticRenderer &)> &configure_next, float from, float velocity,
+                          float switch_at, bool reset_custom_pos, int ticks) {
+    HapticRenderer renderer, next;
+    configure(renderer);
+    configure_next(next);
+    SimKnob knob(config, &renderer, from);
+    knob.hand().engaged = true;
+    knob.hand().target = [=](float t) { return from + velocity * t; };
+    SwitchRun run;
+    std::vector<float> output;
+    int switch_tick = int(switch_at / Ts);
+    const int k = int(0.01f / Ts);
+    int window = int(0.1f / Ts);
+    knob.run(switch_at + float(ticks + window + 2 * k) * Ts, [&] {
+        output.push_back(knob.output_uq());
+        if (int(output.size()) == switch_tick) {
+            run.shift = knob.switch_to(&next, reset_custom_pos, 0, true, ticks);
+            run.reading = knob.input().position + run.shift;
+        }
+    });
+
+    auto mean = [&](int from_tick) {
+        double sum = 0;
+        for (int i = from_tick; i < from_tick + k; i++) {
+            sum += output[i];
+        }
+        return float(sum / k);
+    };
+    // output[i] 是第 i + 1 个周期结束时的输出, 切换在 output[switch_tick - 1] 之后, 从 output[switch_tick + 1] 开始生效
+    int fade_end = switch_tick + ticks + 2;
+    int last = std::min(fade_end + window, int(output.size()) - k);
+    for (int i = switch_tick - window; i <= last; i++) {
+        float step = std::fabs(mean(i) - mean(i - k));
+        if (i <= switch_tick + 1 - k || i > fade_end) {
+            run.drag_step = std::fmax(run.drag_step, step);
+        } else {
+            run.switch_step = std::fmax(run.switch_step, step);
+        }
+    }
+    return run;
+}
+
+// 拖动中切换模式: 交叉淡化时 10 ms 平均输出的变化不超过拖动本身的两倍, 加上瞬间切换跳变的 1/4
+// (smoothstep 的斜率最大 1.5 / KNOB_TRANSITION_TICKS, 10 ms 内最多走 19%);
+// 旧规律在淡出期间保持自己的零点 (重置零点的切换也不跳); 不重置零点时平移到新规律最近的平衡点, 最多半个吸附点间距,
+// 压在墙里时不平移, 边界相同的墙接着顶住
+void check_mode_switch(const BenchConfig &config) {
+    auto attractor = [](int count) {
+        return [=](HapticRenderer &r) { r.set_attractor(count); r.set_mode(HapticMode::Attractor); };
+    };
+    auto bounded = [](int count) {
+        return [=](HapticRenderer &r) {
+            r.set_attractor(count);
+            r.set_boundaries(-1, 1);
+            r.set_mode(HapticMode::AttractorWithRebound);
+        };
+    };
+    auto damping = [](HapticRenderer &r) { r.set_damping(2); r.set_mode(HapticMode::Damping); };
+    const struct {
+        const char *name;
+        std::function<void(HapticRenderer &)> configure, configure_next;
+        float from, velocity, switch_at;
+        bool reset_custom_pos;
+        float spacing;      // 新规律的吸附点间距, 0 表示没有吸附点
+        float wall;         // 越过的边界, NAN 表示没有
+    } cases[] = {
+            {"12 detents -> damping",            attractor(12), damping,      0.1f,  1.5f,  0.37f,  false, 0,                      NAN},
+            {"damping -> 8 detents",             damping,       attractor(8), 0.1f,  1.5f,  0.3f,  false, float(M_TWOPI) / 8,     NAN},
+            {"8 detents -> 12 detents, reset",   attractor(8),  attractor(12), 0.1f, -1.0f, 0.3f,  true,  0,                      NAN},
+            {"bounded 4 -> 6 past right wall",   bounded(4),    bounded(6),   0.9f,  0.5f,  0.5f,  false, 2.0f / 6,               1},
+            {"bounded 4 -> 6 past left wall",    bounded(4),    bounded(6),  -0.9f, -0.5f,  0.5f,  false, 2.0f / 6,               -1},
+    };
+    for (const auto &c: cases) {
+        SwitchRun faded = run_mode_switch(config, c.configure, c.configure_next, c.from, c.velocity, c.switch_at,
+                                          c.reset_custom_pos, KNOB_TRANSITION_TICKS);
+        SwitchRun instant = run_mode_switch(config, c.configure, c.configure_next, c.from, c.velocity, c.switch_at,
+                                            c.reset_custom_pos, 0);
+        bool ok = faded.switch_step <= 2 * faded.drag_step + 0.25f * instant.switch_step;
+        if (c.spacing > 0) {
+            ok = ok && std::fabs(faded.shift) <= c.spacing / 2 + 1e-4f;
+        }
+        if (!std::isnan(c.wall)) {
+            ok = ok && faded.shift == 0 && c.wall * faded.reading > 1;
+        }
+        report_check(ok, "mode switch  %-32s: %5.1f Uq per 10 ms while switching (dragging %5.1f, instant switch %5.1f), "
+                         "zero shifted %+.3f rad to %+.3f", c.name, faded.switch_step, faded.drag_step,
+                     instant.switch_step, faded.shift, faded.reading);
+    }
+
+    // 压着墙切换时新规律的墙一开始就在墙里: 编码器噪声让深度退一个刻度时不能因为还没吸收能量就松开
+    PassiveWall wall(KNOB_WALL_DAMPING, KNOB_WALL_TORQUE_LIMIT);
+    const float lsb = float(M_TWOPI) / float(SimEncoder::resolution);
+    float weakest = INFINITY;
+    for (int i = 0; i < 20; i++) {
+        float depth = 0.015f - float(i % 2) * lsb;
+        weakest = std::fmin(weakest, wall.update(depth, 0, KNOB_WALL_STIFFNESS) / (KNOB_WALL_STIFFNESS * depth));
+    }
+    report_check(weakest > 0.8f, "mode switch  wall entered 15 mrad deep, ±1 lsb noise: weakest push %.0f%% of k·depth",
+                 weakest * 100);
+}
+
+// 加速映射: 数值按吸附点事件逐个喂进去, 与手算的结果比较
+void check_ballistic_mapper() {
+    BallisticCurve steep;   // 4 rad/s 以下一格一步, 16 rad/s 以上一格 20 步
+    steep.make_accelerating(4, 16, 20, 2);
+    BallisticCurve half;    // 任何转速都是一格 1.5 步
+    half.points = 1;
+    half.velocity[0] = 0;
+    half.gain[0] = 1.5f;
+
+    // 小数部分跨格累计: 1.5 步 / 格, 拧 4 格正好 6 步
+    BallisticMapper mapper;
+    mapper.set_curve(half);
+    mapper.set_range(0, 100, 1);
+    mapper.reset(10);
+    for (int i = 0; i < 4; i++) {
+        mapper.on_detent(+1, 1);
+    }
+    report_check(mapper.get_value() == 16, "ballistic  gain 1.5, 4 detents forward from 10: %.1f, expect 16",
+                 mapper.get_value());
+
+    // 换方向时丢掉累计的小数: +1 格留下 +0.5, 反向两格是 -1.5 -1.5 共 3 步 (不清零的话 0.5 会抵掉一部分, 只走 2 步)
+    mapper.reset(10);
+    mapper.on_detent(+1, 1);
+    float forward = mapper.get_value();
+    mapper.on_detent(-1, 1);
+    float back = mapper.get_value();
+    mapper.on_detent(-1, 1);
+    report_check(forward == 11 && back == 10 && mapper.get_value() == 8,
+                 "ballistic  gain 1.5, +1 -1 -1 from 10: %.1f %.1f %.1f, expect 11 10 8", forward, back,
+                 mapper.get_value());
+
+    // 快速甩到上限后慢慢往回拧一格, 立即离开上限, 不会被超出范围的部分卡住
+    mapper.set_curve(steep);
+    mapper.set_range(0, 50, 0.5f);
+    mapper.reset(45);
+    mapper.on_detent(+1, 20);
+    float top = mapper.get_value();
+    mapper.on_detent(-1, 1);
+    report_check(top == 50 && mapper.get_value() == 49.5f,
+                 "ballistic  clamp: 45 + 20 steps of 0.5 at 20 rad/s -> %.1f, one detent back -> %.1f, expect 50 49.5",
+                 top, mapper.get_value());
+
+    // 缩小范围时当前值跟着限制
+    mapper.set_range(0, 20, 1);
+    report_check(mapper.get_value() == 20, "ballistic  range shrunk to [0, 20] at 49.5: %.1f, expect 20",
+                 mapper.get_value());
+
+    // 不合法的曲线不生效, 原来的曲线不变
+    BallisticCurve bad = steep;
+    bad.velocity[2] = bad.velocity[1];
+    BallisticCurve negative = half;
+    negative.gain[0] = -1;
+    BallisticCurve nan = half;
+    nan.gain[0] = NAN;
+    bool rejected = !mapper.set_curve(bad) && !mapper.set_curve(negative) && !mapper.set_curve(nan);
+    report_check(rejected && mapper.gain(20) == 20 && mapper.gain(1) == 1,
+                 "ballistic  curves with repeated velocity / negative / NaN gain rejected: %s, gain at 1 / 20 rad/s "
+                 "%.1f / %.1f", rejected ? "yes" : "no", mapper.gain(1), mapper.gain(20));
+}
+
+struct ServoRun {
+    ServoState state = ServoState::Moving;
+    float end_time = NAN;       // 离开 Moving 的时间, 从开始 (或者手碰到旋钮) 算起 (s)
+    float final_error = 0;      // 结束后旋钮停下的位置与目标之差 (rad)
+    float grab_peak = 0;        // 外部力矩 CUSUM 的峰值, 占抓住阈值的比例
+    float travel_after_grab = 0;    // 手碰到旋钮后旋钮又转过的角度 (rad)
+    float planned = 0;          // 按伺服开始时的位置和转速规划的轨迹时长 (s)
+};
+
+// 8 个吸附点的棘轮上让伺服把旋钮转到 target; grab_at > 0 时手在 grab_at 秒按住旋钮 (阻抗刚度 hand_stiffness)
+ServoRun run_servo(const BenchConfig &config, float target, float grab_at, float hand_stiffness) {
+    HapticRenderer renderer;
+    renderer.set_attractor(8);
+    renderer.set_mode(HapticMode::Attractor);
+    SimKnob knob(config, &renderer);
+    knob.run(0.5f);     // 停稳在 0 号吸附点
+    renderer.servo_start(target, knob.input());
+
+    ServoRun result;
+    SCurveTrajectory plan(KNOB_SERVO_MAX_VELOCITY, KNOB_SERVO_MAX_ACCEL, KNOB_SERVO_MAX_JERK, Ts);
+    plan.plan(knob.input().position, knob.input().estimated_velocity, target);
+    result.planned = plan.get_duration();
+    float start = knob.time(), contact = 0, contact_position = 0;
+    // 与 KnobServo 相同的双边 CUSUM, 只看没有手时噪声累计到了多高
+    float high = 0, low = 0;
+    knob.run(3.0f, [&] {
+        float t = knob.time() - start;
+        if (result.state == ServoState::Moving && contact == 0) {
+            float clipped = std::fmax(std::fmin(knob.input().external_torque, 2 * KNOB_SERVO_GRAB_TORQUE),
+                                      -2 * KNOB_SERVO_GRAB_TORQUE);
+            high = std::fmax(high + (clipped - KNOB_SERVO_GRAB_TORQUE) * Ts, 0.0f);
+            low = std::fmax(low + (-clipped - KNOB_SERVO_GRAB_TORQUE) * Ts, 0.0f);
+            result.grab_peak = std::fmax(result.grab_peak, std::fmax(high, low) / KNOB_SERVO_GRAB_IMPULSE);
+        }
+        if (grab_at > 0 && contact == 0 && t >= grab_at) {
+            contact = t;
+            contact_position = knob.position();
+            knob.hand().engaged = true;
+            knob.hand().stiffness = hand_stiffness;
+            knob.hand().target = [=](float) { return contact_position; };
+        }
+        ServoState state = renderer.get_servo_state();
+        if (result.state == ServoState::Moving && state != ServoState::Moving) {
+            result.end_time = t - contact;
+            result.travel_after_grab = contact > 0 ? knob.position() - contact_position : 0;
+        }
+        result.state = state;
+    });
+    result.final_error = knob.position() - target;
+    return result;
+}
+
+// 回位伺服: 到达的时间, 没有手时不误判为抓住, 手按住旋钮时及时放手
+void check_servo(const BenchConfig &config) {
+    static const char *const state_names[] = {"idle", "moving", "arrived", "grabbed"};
+    const float detent = float(M_TWOPI) / 8;
+    // 编码器噪声越大 τ_ext 越抖, 2 lsb 以内要留一半的余量
+    const struct {
+        float noise_lsb;
+        float grab_peak_limit;
+    } noises[] = {{1, 0.5f}, {2, 0.5f}, {3, 0.85f}};
+    for (const auto &noise: noises) {
+        BenchConfig noisy = config;
+        noisy.noise_lsb = noise.noise_lsb;
+        for (int detents: {1, 3, 10, -5}) {
+            float target = float(detents) * detent;
+            ServoRun run = run_servo(noisy, target, 0, 0);
+            // 轨迹走完后停稳才算到达, 最多再等 0.25 s
+            bool ok = run.state == ServoState::Arrived && run.end_time >= run.planned - 2 * Ts &&
+                      run.end_time <= run.planned + 0.25f + 2 * Ts && std::fabs(run.final_error) < 0.05f &&
+                      run.grab_peak < noise.grab_peak_limit;
+            report_check(ok, "servo  %+3d detents, noise %.0f lsb: %s after %3.0f ms (planned %3.0f), error %+.3f rad, "
+                             "grab CUSUM peak %2.0f%% (limit %.0f%%)", detents, noise.noise_lsb,
+                         state_names[int(run.state)], run.end_time * 1e3f, run.planned * 1e3f,
+                         run.final_error, run.grab_peak * 100, noise.grab_peak_limit * 100);
+        }
+    }
+    // 10 格的长行程中途被按住, 抓住前旋钮最多再被带着转过半个吸附点
+    for (float grab_at: {0.1f, 0.3f}) {
+        for (float hand_stiffness: {2000.0f, 500.0f}) {
+            ServoRun run = run_servo(config, 10 * detent, grab_at, hand_stiffness);
+            bool ok = run.state == ServoState::Grabbed && run.end_time < 0.035f &&
+                      std::fabs(run.travel_after_grab) < 0.5f * detent;
+            report_check(ok, "servo  grabbed at %.1f s, hand %4.0f Uq/rad: %s after %4.1f ms, knob moved %+.3f rad",
+                         grab_at, hand_stiffness, state_names[int(run.state)], run.end_time * 1e3f,
+                         run.travel_after_grab);
+        }
+    }
+}
+
+// 纹理抗混叠 (开环): 按 AS5600 量化的角度匀速转过 360 / 圈的正弦纹理, 通带内幅度不变, Nyquist 以上输出为 0
+void check_texture_alias() {
+    TextureSpec spec;
+    spec.shape = TextureShape::Sine;
+    spec.cycles = 360;
+    spec.amplitude = 60;
+    const float expected_rms = spec.amplitude / float(M_SQRT2);
+    for (float velocity: {1.0f, 2.0f, 5.0f, 8.0f, 10.0f}) {
+        HapticTexture texture(Ts);
+        texture.set(spec);
+        SimEncoder encoder;
+        double sum = 0;
+        int ticks = int(2.0f / Ts), count = 0;
+        for (int i = 0; i < ticks; i++) {
+            encoder.set_mechanical_radian(velocity * float(i) * Ts);
+            (void) encoder.read_radian_from_sensor();
+            float uq = texture.render(encoder_position_angle(encoder.get_position()), encoder.get_velocity_filter());
+            if (i >= ticks / 2) {   // 前一秒等转速滤波稳定
+                sum += uq * uq;
+                count++;
+            }
+        }
+        float rms = float(std::sqrt(sum / count));
+        float rate = spec.cycles * velocity * Ts / float(M_TWOPI);  // 每个控制周期走过的纹理周期数
+        bool passband = rate <= 0.25f;
+        bool ok = passband ? std::fabs(rms - expected_rms) < 0.1f * expected_rms : rms < 1.0f;
+        report_check(ok, "texture alias  sine 360/rev at %4.1f rad/s (%.2f cycles/tick): %5.1f Uq rms, expect %s",
+                     velocity, rate, rms, passband ? "42.4" : "0");
+    }
+}
+
+// 纹理拍频 (闭环): 手指拖着带细棱纹理的旋钮, 手力矩低通 (40 Hz) 后的波动不能比没有纹理时明显变大.
+// 超过 Nyquist 的谐波如果没有滤掉, 会混叠成几 Hz 到几十 Hz 的 "拍", 手上是慢慢起伏的大疙瘩
+void check_texture_beat(const BenchConfig &config) {
+    TextureSpec spec;
+    spec.shape = TextureShape::Ridges;
+    spec.cycles = 180;
+    spec.amplitude = 40;
+    spec.duty = 0.25f;
+    for (float velocity: {4.0f, 8.0f, 12.0f}) {
+        float rms[2];
+        for (int textured = 0; textured < 2; textured++) {
+            HapticRenderer renderer;
+            if (textured) {
+                HapticTexture texture(Ts);
+                texture.set(spec);
+                renderer.set_texture(texture);
+            }
+            renderer.set_damping(0);
+            renderer.set_mode(HapticMode::Damping);
+            SimKnob knob(config, &renderer);
+            knob.hand().engaged = true;
+            knob.hand().target = [=](float t) { return velocity * t; };
+            // 两级一阶低通, 截止 40 Hz
+            const float alpha = 1 - std::exp(-float(M_TWOPI) * 40.0f * Ts);
+            float low1 = 0, low2 = 0, last_impulse = 0, last_time = 0;
+            double sum = 0, sum_sq = 0;
+            int count = 0;
+            knob.run(3.0f, [&] {
+                float torque = (knob.hand_impulse() - last_impulse) / (knob.time() - last_time);
+                last_impulse = knob.hand_impulse();
+                last_time = knob.time();
+                low1 += alpha * (torque - low1);
+                low2 += alpha * (low1 - low2);
+                if (knob.time() > 1.0f) {
+                    sum += low2;
+                    sum_sq += double(low2) * low2;
+                    count++;
+                }
+            });
+            double mean = sum / count;
+            rms[textured] = float(std::sqrt(std::fmax(sum_sq / count - mean * mean, 0.0)));
+        }
+        report_check(rms[1] <= rms[0] + 0.5f,
+                     "texture beat  ridges 180/rev dragged at %4.1f rad/s: hand torque below 40 Hz %.2f Uq rms "
+                     "(%.2f without texture)", velocity, rms[1], rms[0]);
+    }
+}
+
+// 改进之前的 PIDController (微分作用在误差上, 积分静态限幅, u != 0 就加满静摩擦补偿, 改增益 / 切换模式不做处理), 用来对比
+class LegacyPid {
+public:
+    LegacyPid(float kp, float ki, float kd, float output_limit, float integral_limit, float static_friction_torque)
+            : kp_(kp), ki_(ki), kd_(kd), output_limit_(output_limit), integral_limit_(integral_limit),
+              static_friction_torque_(static_friction_torque) {}
+
+    void setPID(float kp, float ki, float kd) {
+        kp_ = kp;
+        ki_ = ki;
+        kd_ = kd;
+    }
+
+    void track(float, float, float, float = 0) {}   // 没有跟踪, 积分项还是上次留下的
+
+    float calculate(float setpoint, float measurement, float feedforward = 0) {
+        float error = setpoint - measurement;
+        integral_ += ki_ * error * Ts;
+        integral_ = std::fmax(std::fmin(integral_, integral_limit_), -integral_limit_);
+        float derivative = kd_ * (error - previous_error_) / Ts;
+        previous_error_ = error;
+        float u = kp_ * error + integral_ + derivative;
+        if (u != 0) {
+            u += (u > 0) ? static_friction_torque_ : -static_friction_torque_;
+        }
+        u += feedforward;
+        return std::fmax(std::fmin(u, output_limit_), -output_limit_);
+    }
+
+private:
+    float kp_, ki_, kd_, output_limit_, integral_limit_, static_friction_torque_;
+    float integral_ = 0;
+    float previous_error_ = 0;
+};
+
+struct PidRun {
+    float overshoot = 0;        // 超调 (rad/s 或 rad)
+    float settle_time = NAN;    // 最后一次离开 ±2% 带的时间 (s)
+    float iae = 0;              // 误差绝对值积分
+    float first_output = 0;     // 设定值阶跃后第一个周期的输出
+    float max_jump = 0;         // 相邻两个周期输出之差的最大值
+    float event_jump = 0;       // 改增益 / 切换模式前后一个周期内的输出跳变
+    float rest_peak = 0;        // 设定值阶跃之前 (静止) 输出的峰值
+};
+
+// 速度环直接驱动仿真电机, 转速测量带噪声; setpoint(t) 给出设定值, on_tick(t) 可以在运行中改增益,
+// 返回 false 时这个周期的输出由 manual 决定 (模拟力矩模式), PID 只跟踪
+template<typename Pid>
+PidRun run_velocity_pid(Pid &pid, float seconds, float noise, const std::function<float(float)> &setpoint,
+                        const std::function<bool(float, Pid &)> &on_tick, float manual = 0, float event_at = NAN) {
+    KnobPlant plant(nullptr);
+    std::mt19937 rng(7);
+    std::normal_distribution<float> velocity_noise(0, noise > 0 ? noise : 1e-9f);
+    PidRun run;
+    float final = setpoint(seconds), previous_u = 0;
+    int ticks = int(seconds / Ts);
+    for (int i = 0; i < ticks; i++) {
+        float t = float(i) * Ts;
+        float measured = plant.get_velocity() + (noise > 0 ? velocity_noise(rng) : 0);
+        float u;
+        if (on_tick(t, pid)) {
+            u = pid.calculate(setpoint(t), measured);
+        } else {
+            u = manual;
+            pid.track(u, setpoint(t), measured);
+        }
+        if (i == 0) {
+            run.first_output = u;
+        } else {
+            float jump = std::fabs(u - previous_u);
+            run.max_jump = std::fmax(run.max_jump, jump);
+            if (t > event_at - 1.5f * Ts && t < event_at + 1.5f * Ts) {    // 事件前后各一个周期
+                run.event_jump = std::fmax(run.event_jump, jump);
+            }
+        }
+        previous_u = u;
+        plant.step(u, Ts);
+        float error = plant.get_velocity() - setpoint(t);
+        run.iae += std::fabs(error) * Ts;
+        run.overshoot = std::fmax(run.overshoot, plant.get_velocity() - final);
+        if (std::fabs(plant.get_velocity() - final) > 0.02f * std::fabs(final)) {
+            run.settle_time = t + Ts;
+        }
+    }
+    return run;
+}
+
+// 位置外环 (kp 35, kd 0.5, 输出为速度指令) 带着速度内环, 位置阶跃; 测量值带 AS5600 的量化和噪声
+template<typename Pid>
+PidRun run_position_pid(Pid &pid_position, Pid &pid_velocity, float step, float seconds) {
+    KnobPlant plant(nullptr);
+    std::mt19937 rng(11);
+    const float lsb = float(M_TWOPI) / float(SimEncoder::resolution);
+    std::normal_distribution<float> angle_noise(0, lsb);
+    PidRun run;
+    float previous_angle = 0, velocity = 0;
+    int ticks = int(seconds / Ts);
+    for (int i = 0; i < ticks; i++) {
+        float t = float(i) * Ts;
+        float angle = std::round((plant.get_position() + angle_noise(rng)) / lsb) * lsb;
+        velocity += FOC_LOW_PASS_FILTER_ALPHA * ((angle - previous_angle) / Ts - velocity);
+        previous_angle = angle;
+        float target = t >= 0.1f ? step : 0;
+        float command = pid_position.calculate(target, angle);
+        if (std::fabs(t - 0.1f) < 0.5f * Ts) {
+            run.first_output = command;
+        } else if (t < 0.1f) {
+            run.rest_peak = std::fmax(run.rest_peak, std::fabs(command));
+        }
+        plant.step(pid_velocity.calculate(command, velocity, FOC_FEEDFORWARD_VELOCITY * command), Ts);
+        if (t >= 0.1f) {
+            run.iae += std::fabs(plant.get_position() - step) * Ts;
+            run.overshoot = std::fmax(run.overshoot, plant.get_position() - step);
+        }
+    }
+    return run;
+}
+
+// PID: 新的 PIDController 与改进前的实现在同一个仿真电机上比较阶跃响应, 以及每次 calculate() 的耗时
+void check_pid_controller() {
+    const float limit = FOC_MCPWM_OUTPUT_LIMIT;
+    auto always = [](float, auto &) { return true; };
+
+    // 饱和的速度阶跃: 积分静态限幅时积分冲到限幅, 超调很大; 反算抗饱和的超调和调节时间都要小
+    {
+        auto step = [](float) { return 100.0f; };
+        PIDController pid(40, 400, 0, limit, limit, 0);
+        LegacyPid legacy(40, 400, 0, limit, limit, 0);
+        PidRun now = run_velocity_pid<PIDController>(pid, 1.0f, 0, step, always);
+        PidRun old = run_velocity_pid<LegacyPid>(legacy, 1.0f, 0, step, always);
+        report_check(now.overshoot < 0.5f * old.overshoot + 0.5f && now.settle_time <= old.settle_time,
+                     "pid  saturated velocity step 0 -> 100 rad/s: overshoot %.1f rad/s (old %.1f), settled in %.0f ms "
+                     "(old %.0f)", now.overshoot, old.overshoot, now.settle_time * 1e3f, old.settle_time * 1e3f);
+    }
+
+    // 位置阶跃: 微分作用在误差上时阶跃那一拍的速度指令被 kd / Ts 顶到限幅; 静止时滤波后的微分噪声更小
+    {
+        PIDController position(35, 0, 0.5f, FOC_POSITION_VELOCITY_LIMIT, FOC_POSITION_VELOCITY_LIMIT, 0);
+        PIDController velocity(40, 400, 0, limit, limit, 0);
+        LegacyPid legacy_position(35, 0, 0.5f, FOC_POSITION_VELOCITY_LIMIT, FOC_POSITION_VELOCITY_LIMIT, 0);
+        LegacyPid legacy_velocity(40, 400, 0, limit, limit, 0);
+        PidRun now = run_position_pid(position, velocity, 0.2f, 0.6f);
+        PidRun old = run_position_pid(legacy_position, legacy_velocity, 0.2f, 0.6f);
+        report_check(now.first_output < 0.5f * old.first_output && now.rest_peak < old.rest_peak &&
+                     now.iae < 1.2f * old.iae,
+                     "pid  position step 0.2 rad: first velocity command %.1f rad/s (old %.1f), at rest peak %.2f rad/s "
+                     "(old %.2f), IAE %.2f mrad·s (old %.2f)", now.first_output, old.first_output, now.rest_peak,
+                     old.rest_peak, now.iae * 1e3f, old.iae * 1e3f);
+    }
+
+    // 静摩擦补偿: 速度设定值来回过零, 补偿在 u 过零时不再一下跳 2 倍静摩擦
+    {
+        auto reverse = [](float t) { return 3.0f * std::sin(float(M_TWOPI) * 1.0f * t); };
+        const float friction = FOC_MCPWM_STATIC_FRIC_TORQUE;
+        PIDController pid(40, 400, 0, limit, limit, friction);
+        LegacyPid legacy(40, 400, 0, limit, limit, friction);
+        PidRun now = run_velocity_pid<PIDController>(pid, 2.0f, 0, reverse, always);
+        PidRun old = run_velocity_pid<LegacyPid>(legacy, 2.0f, 0, reverse, always);
+        report_check(now.max_jump < 0.7f * old.max_jump && now.iae < 1.2f * old.iae,
+                     "pid  friction %.0f Uq, setpoint reversing at ±3 rad/s: largest output step %.0f Uq (old %.0f), "
+                     "IAE %.3f rad (old %.3f)", friction, now.max_jump, old.max_jump, now.iae, old.iae);
+    }
+
+    // 无扰改增益: 加速过程中 (误差不为 0) kp 从 40 改到 120, 输出不跳
+    {
+        auto ramp = [](float t) { return std::fmin(200.0f * t, 60.0f); };
+        auto retune = [](float t, auto &pid) {
+            if (std::fabs(t - 0.15f) < 0.5f * Ts) {
+                pid.setPID(120, 400, 0);
+            }
+            return true;
+        };
+        PIDController pid(40, 400, 0, limit, limit, 0);
+        LegacyPid legacy(40, 400, 0, limit, limit, 0);
+        PidRun now = run_velocity_pid<PIDController>(pid, 0.3f, 0, ramp, retune, 0, 0.15f);
+        PidRun old = run_velocity_pid<LegacyPid>(legacy, 0.3f, 0, ramp, retune, 0, 0.15f);
+        report_check(now.event_jump < 0.2f * old.event_jump,
+                     "pid  kp 40 -> 120 while accelerating: output step %.1f Uq (old %.1f)", now.event_jump,
+                     old.event_jump);
+    }
+
+    // 无扰切换模式: 力矩模式 Uq = 300 转起来以后切到速度环, 设定值为当时的转速
+    {
+        KnobPlantParams params;
+        const float hold = (300 * params.torque_per_uq - params.coulomb) /
+                           (params.back_emf_per_rad_s * params.torque_per_uq + params.viscous);
+        auto target = [=](float) { return hold; };
+        auto torque_then_loop = [](float t, auto &) { return t >= 0.3f; };
+        PIDController pid(40, 400, 0, limit, limit, 0);
+        LegacyPid legacy(40, 400, 0, limit, limit, 0);
+        PidRun now = run_velocity_pid<PIDController>(pid, 0.5f, 0, target, torque_then_loop, 300, 0.3f);
+        PidRun old = run_velocity_pid<LegacyPid>(legacy, 0.5f, 0, target, torque_then_loop, 300, 0.3f);
+        report_check(now.event_jump < 0.1f * old.event_jump,
+                     "pid  torque mode Uq 300 -> velocity loop: output step %.1f Uq (old %.1f)", now.event_jump,
+                     old.event_jump);
+    }
+
+    // 耗时: 只报告, 主机上的数字不代表 ESP32-S3, 用来比较两种实现的相对开销
+    {
+        const int calls = 2000000;
+        PIDController pid(40, 400, 0.01f, limit, limit, FOC_MCPWM_STATIC_FRIC_TORQUE);
+        LegacyPid legacy(40, 400, 0.01f, limit, limit, FOC_MCPWM_STATIC_FRIC_TORQUE);
+        volatile float sink = 0;
+        auto time_calls = [&](auto &controller) {
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < calls; i++) {
+                sink = sink + controller.calculate(float(i & 63) * 0.1f, float(i & 31) * 0.2f);
+            }
+            return std::chrono::duration<float, std::nano>(std::chrono::steady_clock::now() - start).count() /
+                   float(calls);
+        };
+        float old_ns = time_calls(legacy), now_ns = time_calls(pid);
+        printf("info   pid  calculate(): %.1f ns per call (old %.1f ns) on this host\n", now_ns, old_ns);
+    }
+}
+
+/*
+ * @brief 速度环对象的线性化频率响应, 用来预测继电振荡
+ *        电机: kt / ((τe s + 1)(J s + c + c_f) + kt Kb), 库仑摩擦按描述函数折算成等效阻尼 c_f;
+ *        零阶保持 + 采样到输出的延迟; 测得的转速 = 相邻两次采样的角度差 / Ts, 再一阶低通
+ */
+struct VelocityLoopModel {
+    float latency;      // 采样到输出的延迟 (s)
+    KnobPlantParams plant;
+
+    // Uq → 真实转速, friction_amplitude 为真实转速的振幅 (rad/s), 用来折算库仑摩擦
+    [[nodiscard]] std::complex<float> motor(float w, float friction_amplitude) const {
+        const std::complex<float> s(0, w);
+        float friction_damping = 4 * plant.coulomb / (float(M_PI) * friction_amplitude);
+        auto hold = (1.0f - std::exp(-s * Ts)) / (s * Ts) * std::exp(-s * latency);
+        return hold * plant.torque_per_uq /
+               ((plant.electrical_tau * s + 1.0f) * (plant.inertia * s + plant.viscous + friction_damping) +
+                plant.torque_per_uq * plant.back_emf_per_rad_s);
+    }
+
+    [[nodiscard]] static std::complex<float> measurement(float w) {     // 真实转速 → 测得的转速
+        const std::complex<float> z_inv = std::exp(std::complex<float>(0, -w * Ts));
+        auto difference = (1.0f - z_inv) / std::complex<float>(0, w * Ts);
+        return difference * float(FOC_LOW_PASS_FILTER_ALPHA) / (1.0f - float(1 - FOC_LOW_PASS_FILTER_ALPHA) * z_inv);
+    }
+};
+
+/*
+ * @brief 预测继电器 (幅值 d, 滞环 ε) 与对象形成的极限环: L(jω)·N(a) = -1, N(a) = 4d / (πa)·e^(-j·asin(ε/a))
+ *        loop(w, a) 为继电器输出到继电器输入的频率响应, a 为继电器输入的振幅 (对象里有摩擦时与振幅有关)
+ *        返回 RelayAutotuner 应当给出的 (Ku, Pu) = (4d / (π·sqrt(a² - ε²)), 2π / ω)
+ */
+template<typename Loop>
+std::pair<float, float> predict_relay(const Loop &loop, float d, float hysteresis) {
+    auto amplitude = [&](float w) {     // 给定频率下自洽的振幅 a = 4d·|L| / π
+        float a = 4 * d * std::abs(loop(w, 1e6f)) / float(M_PI);
+        for (int i = 0; i < 50; i++) {
+            a = 4 * d * std::abs(loop(w, a)) / float(M_PI);
+        }
+        return a;
+    };
+    auto mismatch = [&](float w) {      // -L 的相位与 asin(ε/a) 之差, 从低频往上第一次过零处就是极限环
+        float a = amplitude(w);
+        return std::arg(-loop(w, a)) - std::asin(std::fmin(hysteresis / a, 1.0f));
+    };
+    float low = 1, high = 1;
+    for (float w = 1.02f; w < float(M_PI) / Ts; w *= 1.02f) {
+        if (mismatch(w) < 0) {
+            high = w;
+            break;
+        }
+        low = w;
+    }
+    for (int i = 0; i < 40; i++) {
+        float mid = 0.5f * (low + high);
+        (mismatch(mid) < 0 ? high : low) = mid;
+    }
+    float w = 0.5f * (low + high), a = amplitude(w);
+    return {4 * d / (float(M_PI) * std::sqrt(std::fmax(a * a - hysteresis * hysteresis, 1e-12f))),
+            float(M_TWOPI) / w};
+}
+
+// 继电反馈自整定: 与 FocDriver 的 Autotune 模式一样的接法, 返回整定结果
+// 与调试控制台 autotune 命令的默认值一致
+constexpr float relay_velocity_amplitude = 500, relay_velocity_hysteresis = 2;
+constexpr float relay_position_amplitude = 10, relay_position_hysteresis = 0.02f;
+
+// velocity_loop 为 false 时整定位置环, pid_velocity 为已经整定好的速度环
+RelayAutotuneResult run_relay(const BenchConfig &config, bool velocity_loop, PIDController *pid_velocity) {
+    RelayAutotuner tuner(velocity_loop ? relay_velocity_amplitude : relay_position_amplitude,
+                         velocity_loop ? relay_velocity_hysteresis : relay_position_hysteresis, Ts);
+    SimMotor motor(config);
+    float target = 0;
+    while (!tuner.is_done()) {
+        motor.sample();
+        float uq;
+        if (velocity_loop) {
+            uq = tuner.update(-motor.measured_velocity());
+        } else {
+            float target_speed = tuner.update(target - motor.measured_position());
+            uq = pid_velocity->calculate(target_speed, motor.measured_velocity());
+        }
+        motor.apply(tuner.is_done() ? 0 : uq);
+    }
+    return tuner.get_result();
+}
+
+// 自整定: 仿真电机上继电振荡得到的 Ku / Pu 与描述函数按线性化模型预测的相符, 按规则算出的参数闭环后阶跃响应合格
+void check_autotune(const BenchConfig &config) {
+    const VelocityLoopModel model{config.latency_us * 1e-6f, KnobPlantParams()};
+
+    // 速度环: 继电器直接驱动电机, 输入为测得的转速
+    auto velocity_loop = [&](float w, float a) {
+        std::complex<float> measurement = VelocityLoopModel::measurement(w);
+        return model.motor(w, a / std::abs(measurement)) * measurement;
+    };
+    auto [velocity_ku, velocity_pu] = predict_relay(velocity_loop, relay_velocity_amplitude,
+                                                    relay_velocity_hysteresis);
+    RelayAutotuneResult velocity = run_relay(config, true, nullptr);
+    PidGains velocity_gains = RelayAutotuner::compute_gains(velocity, TuningRule::TyreusLuyben);
+    PidGains velocity_expected = RelayAutotuner::compute_gains({true, velocity_ku, velocity_pu, 0},
+                                                               TuningRule::TyreusLuyben);
+    report_check(velocity.success && std::fabs(velocity.ultimate_gain / velocity_ku - 1) < 0.15f &&
+                 std::fabs(velocity.ultimate_period / velocity_pu - 1) < 0.15f &&
+                 std::fabs(velocity_gains.kp / velocity_expected.kp - 1) < 0.15f &&
+                 std::fabs(velocity_gains.ki / velocity_expected.ki - 1) < 0.25f,
+                 "autotune  velocity loop: Ku %.1f (model %.1f), Pu %.1f ms (model %.1f), Tyreus-Luyben kp %.1f "
+                 "ki %.0f (model %.1f / %.0f)", velocity.ultimate_gain, velocity_ku, velocity.ultimate_period * 1e3f,
+                 velocity_pu * 1e3f, velocity_gains.kp, velocity_gains.ki, velocity_expected.kp,
+                 velocity_expected.ki);
+
+    // 整定出的速度环: 20 rad/s 阶跃, 超调和调节时间
+    PIDController pid_velocity(velocity_gains.kp, velocity_gains.ki, velocity_gains.kd, FOC_MCPWM_OUTPUT_LIMIT,
+                               FOC_MCPWM_OUTPUT_LIMIT, 0);
+    {
+        SimMotor motor(config);
+        float peak = 0, settled = 0;
+        for (int i = 0; i < int(0.5f / Ts); i++) {
+            motor.sample();
+            motor.apply(pid_velocity.calculate(20, motor.measured_velocity()));
+            peak = std::fmax(peak, motor.velocity());
+            if (std::fabs(motor.velocity() - 20) > 1.0f) {
+                settled = motor.time();
+            }
+        }
+        report_check(peak < 20 * 1.25f && settled < 0.2f,
+                     "autotune  tuned velocity loop, 0 -> 20 rad/s: peak %.1f rad/s, within ±1 rad/s after %.0f ms",
+                     peak, settled * 1e3f);
+    }
+
+    // 位置环: 继电器输出目标转速给整定好的速度环, 输入为测得的角度 (采样值, 不滤波)
+    auto position_loop = [&](float w, float a) {
+        const std::complex<float> s(0, w);
+        auto pi = velocity_gains.kp + velocity_gains.ki * Ts / (1.0f - std::exp(-s * Ts));  // 先积分再输出
+        auto motor = model.motor(w, a * w);
+        return pi * motor / (1.0f + pi * motor * VelocityLoopModel::measurement(w)) / s;
+    };
+    auto [position_ku, position_pu] = predict_relay(position_loop, relay_position_amplitude,
+                                                    relay_position_hysteresis);
+    pid_velocity.reset();
+    RelayAutotuneResult position = run_relay(config, false, &pid_velocity);
+    PidGains position_gains = RelayAutotuner::compute_gains(position, TuningRule::IntegratingPD);
+    PidGains position_expected = RelayAutotuner::compute_gains({true, position_ku, position_pu, 0},
+                                                               TuningRule::IntegratingPD);
+    report_check(position.success && std::fabs(position.ultimate_gain / position_ku - 1) < 0.15f &&
+                 std::fabs(position.ultimate_period / position_pu - 1) < 0.15f &&
+                 std::fabs(position_gains.kp / position_expected.kp - 1) < 0.15f &&
+                 std::fabs(position_gains.kd / position_expected.kd - 1) < 0.25f,
+                 "autotune  position loop: Ku %.1f (model %.1f), Pu %.1f ms (model %.1f), PD kp %.2f kd %.3f "
+                 "(model %.2f / %.3f)", position.ultimate_gain, position_ku, position.ultimate_period * 1e3f,
+                 position_pu * 1e3f, position_gains.kp, position_gains.kd, position_expected.kp,
+                 position_expected.kd);
+
+    // 整定出的串级: 0.5 rad 位置阶跃 (不带轨迹), 超调和调节时间
+    {
+        PIDController pid_position(position_gains.kp, position_gains.ki, position_gains.kd,
+                                   FOC_POSITION_VELOCITY_LIMIT, FOC_POSITION_VELOCITY_LIMIT, 0);
+        pid_velocity.reset();
+        SimMotor motor(config);
+        float peak = 0, settled = 0;
+        for (int i = 0; i < int(1.0f / Ts); i++) {
+            motor.sample();
+            float command = pid_position.calculate(0.5f, motor.measured_position());
+            motor.apply(pid_velocity.calculate(command, motor.measured_velocity()));
+            peak = std::fmax(peak, motor.position());
+            if (std::fabs(motor.position() - 0.5f) > 0.01f) {
+                settled = motor.time();
+            }
+        }
+        report_check(peak < 0.5f * 1.1f && settled < 0.4f,
+                     "autotune  tuned cascade, 0 -> 0.5 rad: peak %.3f rad, within ±0.01 rad after %.0f ms", peak,
+                     settled * 1e3f);
+    }
+}
+
+struct CascadeRun {
+    float rise = 0;         // 10% → 90% 的上升时间 (s)
+    float peak = 0;         // 最大角度 (rad)
+    float settled = 0;      // 最后一次离开目标 ±5% 的时刻 (s)
+    std::vector<std::pair<float, float>> samples;   // 每个周期测得的 (角度, 转速), 用来重放计时
+};
+
+// 与 app_main 相同参数的串级, 外环每 divider 个周期运行一次, 从静止做 step 的位置阶跃 (不带轨迹)
+CascadeRun run_cascade(const BenchConfig &config, int divider, float step, float seconds) {
+    PIDController pid_position(35, 0, 0.5, FOC_POSITION_VELOCITY_LIMIT, FOC_POSITION_VELOCITY_LIMIT, 0);
+    PIDController pid_velocity(40, 400, 0, FOC_MCPWM_OUTPUT_LIMIT, FOC_MCPWM_OUTPUT_LIMIT, 0);
+    CascadeController cascade(divider, FOC_POSITION_VELOCITY_LIMIT, FOC_MCPWM_OUTPUT_LIMIT);
+    cascade.set_loops(&pid_position, &pid_velocity);
+    SimMotor motor(config);
+    CascadeRun run;
+    float rise_start = -1;
+    for (int i = 0; i < int(seconds / Ts); i++) {
+        motor.sample();
+        run.samples.emplace_back(motor.measured_position(), motor.measured_velocity());
+        motor.apply(cascade.update(step, motor.measured_position(), 0, motor.measured_velocity()));
+        float x = motor.position() / step;
+        if (rise_start < 0 && x >= 0.1f) {
+            rise_start = motor.time();
+        }
+        if (run.rise == 0 && x >= 0.9f) {
+            run.rise = motor.time() - rise_start;
+        }
+        run.peak = std::fmax(run.peak, motor.position());
+        if (std::fabs(x - 1) > 0.05f) {
+            run.settled = motor.time();
+        }
+    }
+    return run;
+}
+
+// 串级分频: 每个外环分频下的阶跃带宽 (0.35 / 上升时间) 和超调, 以及重放同一段测量值时 update() 每个周期的耗时
+void check_cascade(const BenchConfig &config) {
+    constexpr float step = 0.3f;    // 速度指令 (kp × 0.3 ≈ 10 rad/s) 不进限幅, 测的是线性带宽
+    const int dividers[] = {1, 2, 4, 8};
+    float full_rate_bandwidth = 0;
+    for (int divider: dividers) {
+        CascadeRun run = run_cascade(config, divider, step, 0.6f);
+        float bandwidth = run.rise > 0 ? 0.35f / run.rise : 0;
+        float overshoot = (run.peak - step) / step;
+        if (divider == 1) {
+            full_rate_bandwidth = bandwidth;
+        }
+
+        // 计时: 新的串级对着记录下来的测量值重放很多遍, 取最快的一轮
+        PIDController pid_position(35, 0, 0.5, FOC_POSITION_VELOCITY_LIMIT, FOC_POSITION_VELOCITY_LIMIT, 0);
+        PIDController pid_velocity(40, 400, 0, FOC_MCPWM_OUTPUT_LIMIT, FOC_MCPWM_OUTPUT_LIMIT, 0);
+        CascadeController cascade(divider, FOC_POSITION_VELOCITY_LIMIT, FOC_MCPWM_OUTPUT_LIMIT);
+        cascade.set_loops(&pid_position, &pid_velocity);
+        volatile float sink = 0;
+        double best_ns = 1e30;
+        for (int round = 0; round < 20; round++) {
+            auto start = std::chrono::steady_clock::now();
+            for (int repeat = 0; repeat < 20; repeat++) {
+                for (auto [position, velocity]: run.samples) {
+                    sink = sink + cascade.update(step, position, 0, velocity);
+                }
+            }
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            best_ns = std::fmin(best_ns, ns / (20.0 * double(run.samples.size())));
+        }
+
+        // 分频不能拖慢阶跃响应: 默认分频及以下时带宽不低于全速运行的 90%, 超调不超过 5%
+        bool ok = run.rise > 0 && run.settled < 0.3f;
+        if (divider <= FOC_POSITION_LOOP_DIVIDER) {
+            ok = ok && bandwidth >= 0.9f * full_rate_bandwidth && overshoot < 0.05f;
+        }
+        report_check(ok, "cascade  outer loop every %d ticks, %.1f rad step: bandwidth %.1f Hz (full rate %.1f), "
+                         "overshoot %.1f%%, within ±5%% after %.0f ms, %.1f ns per cycle on this host",
+                     divider, step, bandwidth, full_rate_bandwidth, overshoot * 100, run.settled * 1e3f, best_ns);
+    }
+}
+
+// 静止到静止、位移 h 的双 S 曲线的最短时间 (闭式解, 与 SCurveTrajectory 的实现无关)
+float scurve_rest_to_rest_time(float h, float v, float a, float j) {
+    if (h * j * j < 2 * a * a * a) {    // 到不了最大加速度, 也到不了最大速度
+        float tj = std::cbrt(h / (2 * j));
+        if (j * tj * tj <= v) {
+            return 4 * tj;
+        }
+    }
+    float peak = v;     // 有匀速段时的峰值速度
+    if (h < v * (v / a + a / j) || v < a * a / j) {
+        // 没有匀速段: 按加速度能否到最大分两种情况求峰值速度
+        peak = a * a / j >= v ? v : 0.5f * a * (-(a / j) + std::sqrt((a / j) * (a / j) + 4 * h / a));
+        if (peak < a * a / j) {
+            peak = std::cbrt(h * h * j / 4);    // 到不了最大加速度: h = v·2·sqrt(v/j)
+        }
+        float ramp = peak >= a * a / j ? peak / a + a / j : 2 * std::sqrt(peak / j);
+        if (h >= peak * ramp - 1e-6f) {
+            return 2 * ramp + (h - peak * ramp) / peak;
+        }
+        return 2 * ramp;
+    }
+    return h / v + v / a + a / j;
+}
+
+// 位置指令轨迹: 按 FOC_TRAJECTORY_* 限制逐周期走完, 速度 / 加速度 / 加加速度不越限、不过冲, 静止起步的时长与闭式解相同;
+// 再接上串级和前馈在仿真电机上跑, 检查到达时间和超调
+void check_trajectory(const BenchConfig &config) {
+    const float v_max = FOC_TRAJECTORY_MAX_VELOCITY, a_max = FOC_TRAJECTORY_MAX_ACCEL, j_max = FOC_TRAJECTORY_MAX_JERK;
+    const struct {
+        float start_velocity;
+        float target;
+    } moves[] = {{0, 0.01f}, {0, 0.5f}, {0, 3.0f}, {0, -1.2f}, {-10, 1.0f}, {15, 0.1f}};
+    for (auto &move: moves) {
+        SCurveTrajectory trajectory(v_max, a_max, j_max, Ts);
+        trajectory.plan(0, move.start_velocity, move.target);
+        float peak_velocity = 0, peak_acceleration = 0, peak_jerk = 0, overshoot = 0;
+        float previous_acceleration = trajectory.current().acceleration;
+        float direction = 0;    // 当前运动的方向
+        TrajectoryPoint point{};
+        int ticks = 0;
+        while (!trajectory.is_finished() && ticks < int(5.0f / Ts)) {
+            point = trajectory.step();
+            ticks++;
+            peak_velocity = std::fmax(peak_velocity, std::fabs(point.velocity));
+            peak_acceleration = std::fmax(peak_acceleration, std::fabs(point.acceleration));
+            // 加加速度按采样后的加速度差分; 切换点落在两个采样之间时差分比真实值小, 不会大
+            peak_jerk = std::fmax(peak_jerk, std::fabs(point.acceleration - previous_acceleration) / Ts);
+            previous_acceleration = point.acceleration;
+            if (point.velocity != 0 && (point.velocity > 0) != (direction > 0)) {
+                direction = point.velocity > 0 ? 1.0f : -1.0f;
+                overshoot = -INFINITY;  // 换向之前是刹车段, 只看朝目标的最后一段
+            }
+            overshoot = std::fmax(overshoot, direction * (point.position - move.target));
+        }
+        TrajectoryPoint end = trajectory.current();     // 走完之后停在终点
+        bool ok = trajectory.is_finished() && end.position == move.target && end.velocity == 0 &&
+                  peak_velocity <= std::fmax(v_max, std::fabs(move.start_velocity)) * 1.001f &&
+                  peak_acceleration <= a_max * 1.001f && peak_jerk <= j_max * 1.001f && overshoot <= 1e-5f;
+        float duration = trajectory.get_duration(), expected = NAN;
+        if (move.start_velocity == 0) {
+            expected = scurve_rest_to_rest_time(std::fabs(move.target), v_max, a_max, j_max);
+            ok = ok && std::fabs(duration - expected) < 1e-3f;
+        }
+        report_check(ok, "trajectory  0 -> %+.2f rad from %+.0f rad/s: %.1f ms (closed form %.1f), peak %.1f rad/s, "
+                         "%.0f rad/s², %.0f rad/s³, overshoot %.1e rad", move.target, move.start_velocity,
+                     duration * 1e3f, expected * 1e3f, peak_velocity, peak_acceleration, peak_jerk, overshoot);
+    }
+
+    // 闭环: 与 FocDriver 的位置模式相同, 轨迹参考进串级, 速度 / 加速度参考前馈到输出, 再加上扰动观测器的补偿
+    for (float target: {0.5f, 3.0f, -1.2f}) {
+        DisturbanceObserver observer(FOC_FEEDFORWARD_ACCEL, FOC_FEEDFORWARD_VELOCITY, FOC_DOB_BANDWIDTH, Ts,
+                                     FOC_FRICTION_ADAPT_TIME, FOC_FRICTION_VELOCITY_DEADBAND,
+                                     FOC_MCPWM_STATIC_FRIC_TORQUE);
+        PIDController pid_position(35, 0, 0.5, FOC_POSITION_VELOCITY_LIMIT, FOC_POSITION_VELOCITY_LIMIT, 0);
+        PIDController pid_velocity(40, 400, 0, FOC_MCPWM_OUTPUT_LIMIT, FOC_MCPWM_OUTPUT_LIMIT, 0);
+        CascadeController cascade(FOC_POSITION_LOOP_DIVIDER, FOC_POSITION_VELOCITY_LIMIT, FOC_MCPWM_OUTPUT_LIMIT);
+        cascade.set_loops(&pid_position, &pid_velocity);
+        SCurveTrajectory trajectory(v_max, a_max, j_max, Ts);
+        SimMotor motor(config);
+        trajectory.plan(0, 0, target);
+        float arrived = NAN, overshoot = 0, worst_lag = 0;
+        float sign = target > 0 ? 1.0f : -1.0f;
+        for (int i = 0; i < int(1.0f / Ts); i++) {
+            motor.sample();
+            float velocity = motor.measured_velocity();
+            observer.update(motor.output_uq(), velocity);
+            if (std::fabs(velocity) > FOC_FRICTION_VELOCITY_DEADBAND) {
+                observer.adapt_friction(velocity);
+            }
+            float compensation = std::fmax(std::fmin(observer.get_disturbance(), FOC_DOB_LIMIT), -FOC_DOB_LIMIT);
+            TrajectoryPoint ref = trajectory.step();
+            float feedforward = FOC_FEEDFORWARD_VELOCITY * ref.velocity + FOC_FEEDFORWARD_ACCEL * ref.acceleration;
+            motor.apply(cascade.update(ref.position, motor.measured_position(), ref.velocity, velocity, feedforward) +
+                        compensation);
+            worst_lag = std::fmax(worst_lag, std::fabs(ref.position - motor.position()));
+            overshoot = std::fmax(overshoot, sign * (motor.position() - target));
+            if (std::fabs(motor.position() - target) > 0.01f) {
+                arrived = NAN;
+            } else if (std::isnan(arrived)) {
+                arrived = motor.time();
+            }
+        }
+        float planned = trajectory.get_duration();
+        // 速度环用的是滤波后的转速, 跟不上 20ms 的加速度爬升, 轨迹走完时还落后约 0.1s;
+        // 允许 150ms 的收敛时间, 只要求准时到位且不冲过目标
+        report_check(!std::isnan(arrived) && arrived < planned + 0.15f && overshoot < 0.01f,
+                     "trajectory  closed loop 0 -> %+.1f rad: planned %.0f ms, within ±0.01 rad from %.0f ms, "
+                     "overshoot %.1f mrad, largest lag behind the reference %.1f mrad", target, planned * 1e3f,
+                     arrived * 1e3f, overshoot * 1e3f, worst_lag * 1e3f);
+    }
+}
+
+/*
+ * @brief 只读映射的镜像, 后面紧跟一页不可访问的内存: load() 只要多读一个字节就会段错误, 而不是悄悄读到别的数据
+ */
+class GuardedImage {
+public:
+    explicit GuardedImage(const std::vector<uint8_t> &bytes) {
+        size_t page = size_t(sysconf(_SC_PAGESIZE));
+        readable_ = (bytes.size() + page - 1) / page * page;
+        length_ = readable_ + page;
+        void *map = mmap(nullptr, length_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        base_ = map == MAP_FAILED ? nullptr : static_cast<uint8_t *>(map);
+        if (base_) {
+            data_ = base_ + readable_ - bytes.size();
+            memcpy(data_, bytes.data(), bytes.size());
+            mprotect(base_, readable_, PROT_READ);
+            mprotect(base_ + readable_, page, PROT_NONE);
+        }
+        size_ = bytes.size();
+    }
+
+    ~GuardedImage() {
+        if (base_) {
+            munmap(base_, length_);
+        }
+    }
+
+    GuardedImage(const GuardedImage &) = delete;
+
+    GuardedImage &operator=(const GuardedImage &) = delete;
+
+    [[nodiscard]] const uint8_t *data() const { return data_; }
+
+    [[nodiscard]] size_t size() const { return size_; }
+
+private:
+    uint8_t *base_{};
+    uint8_t *data_{};
+    size_t readable_ = 0;
+    size_t length_ = 0;
+    size_t size_ = 0;
+};
+
+std::vector<uint8_t> read_file(const char *path) {
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+std::vector<std::string> read_lines(const char *path) {
+    std::ifstream file(path);
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(file, line);) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+// 与 tools/haptic_profile.py 的 listing() 格式相同
+std::vector<std::string> profile_listing(const HapticProfileLibrary &library) {
+    std::vector<std::string> lines;
+    char line[128];
+    for (int i = 0; i < library.get_count(); i++) {
+        const HapticProfileRecord *record = library.get(i);
+        char kind[64] = "periodic";
+        if (record->flags & haptic_profile_flag_bounded) {
+            snprintf(kind, sizeof(kind), "bounded [%.4f, %.4f] wall %.1f", record->left_rad, record->right_rad,
+                     record->end_stop_stiffness);
+        }
+        snprintf(line, sizeof(line), "%-15s %s, damping %.2f, limit %.0f", record->name, kind, record->damping,
+                 record->torque_limit);
+        lines.emplace_back(line);
+        const HapticDetentRecord *detents = HapticProfileLibrary::get_detents(record);
+        for (int k = 0; k < record->detent_count; k++) {
+            snprintf(line, sizeof(line), "    detent %+8.4f  k %.1f", detents[k].position_rad, detents[k].stiffness);
+            lines.emplace_back(line);
+        }
+        const HapticSpringRecord *springs = HapticProfileLibrary::get_springs(record);
+        for (int k = 0; k < record->spring_count; k++) {
+            snprintf(line, sizeof(line), "    spring %+8.4f  k %.1f", springs[k].center_rad, springs[k].stiffness);
+            lines.emplace_back(line);
+        }
+    }
+    return lines;
+}
+
+void set_u16(std::vector<uint8_t> &image, size_t offset, uint16_t value) {
+    memcpy(image.data() + offset, &value, sizeof(value));
+}
+
+void set_u32(std::vector<uint8_t> &image, size_t offset, uint32_t value) {
+    memcpy(image.data() + offset, &value, sizeof(value));
+}
+
+// 改过文件头之后的内容时重新算 CRC, 让镜像走到 CRC 之后的检查
+void fix_crc(std::vector<uint8_t> &image) {
+    uint32_t size;
+    memcpy(&size, image.data() + offsetof(HapticProfileFileHeader, size), sizeof(size));
+    size = std::min<uint32_t>(size, uint32_t(image.size()));
+    set_u32(image, offsetof(HapticProfileFileHeader, crc32),
+            HapticProfileLibrary::crc32(image.data() + sizeof(HapticProfileFileHeader),
+                                        size - sizeof(HapticProfileFileHeader)));
+}
+
+// record 编译出的表与 reference 的最大力矩之差 (Uq), 在 reference 的表格点上比较 (两张表在这些点上都不受插值影响),
+// 有界表再加上两边墙里的点; 两个吸附点中间力矩本来就是跳变的, 跳变点附近一个表格间距内不比较
+float profile_difference(const HapticProfileRecord *record, const HapticProfile &reference) {
+    HapticProfile compiled;
+    HapticProfileLibrary::compile(record, compiled);
+    std::vector<float> jumps;
+    const HapticDetentRecord *detents = HapticProfileLibrary::get_detents(record);
+    for (int k = 0; k < record->detent_count; k++) {
+        if (k + 1 < record->detent_count) {
+            jumps.push_back(0.5f * (detents[k].position_rad + detents[k + 1].position_rad));
+        } else if (!(record->flags & haptic_profile_flag_bounded)) {
+            jumps.push_back(0.5f * (detents[k].position_rad + detents[0].position_rad + float(M_TWOPI)));
+        }
+    }
+    float compiled_step = compiled.span / float(compiled.periodic ? compiled.points : compiled.points - 1);
+
+    HapticProfileEngine engine_compiled, engine_reference;
+    engine_compiled.edit() = compiled;
+    engine_reference.edit() = reference;
+    engine_compiled.commit();
+    engine_reference.commit();
+    engine_compiled.acquire();
+    engine_reference.acquire();
+    std::vector<float> positions;
+    float step = reference.span / float(reference.periodic ? reference.points : reference.points - 1);
+    for (int i = 0; i < reference.points; i++) {
+        positions.push_back(reference.start + float(i) * step);
+    }
+    if (!reference.periodic) {
+        for (int i = 1; i <= 10; i++) {
+            positions.push_back(reference.start - 0.005f * float(i));
+            positions.push_back(reference.start + reference.span + 0.005f * float(i));
+        }
+    }
+    float worst = 0;
+    for (float x: positions) {
+        bool near_jump = false;
+        for (float jump: jumps) {
+            float d = x - jump;
+            if (reference.periodic) {
+                d -= float(M_TWOPI) * std::round(d / float(M_TWOPI));
+            }
+            near_jump = near_jump || std::fabs(d) <= compiled_step;
+        }
+        if (near_jump) {
+            continue;
+        }
+        worst = std::fmax(worst, std::fabs(engine_compiled.evaluate(x, 0) - engine_reference.evaluate(x, 0)));
+    }
+    return worst;
+}
+
+/*
+ * @brief 力反馈曲线库: tools/haptic_profile.py 从 JSON 编码的镜像 (构建时生成), 固件的 load() 读回来与 JSON 逐行相同,
+ *        compile() 出的表与内置模式相同 / 吸附点处的刚度与 JSON 相符; 损坏的镜像被拒绝, 并且不会读出映射范围
+ */
+void check_profile_library() {
+    constexpr size_t partition_size = 0x10000;  // partitions.csv 里 haptic 分区的大小
+    const struct {
+        const char *image;
+        const char *listing;
+    } sets[] = {{HAPTIC_PROFILE_IMAGE, HAPTIC_PROFILE_LISTING},
+                {HAPTIC_PROFILE_TEST_IMAGE, HAPTIC_PROFILE_TEST_LISTING}};
+    for (auto &set: sets) {
+        std::vector<uint8_t> image = read_file(set.image);
+        std::vector<std::string> expected = read_lines(set.listing);
+        // 分区里镜像后面是 0xFF 填充
+        std::vector<uint8_t> partition(partition_size, 0xFF);
+        std::copy(image.begin(), image.end(), partition.begin());
+        GuardedImage mapped(partition);
+        HapticProfileLibrary library;
+        bool loaded = library.load(mapped.data(), mapped.size());
+        std::vector<std::string> lines = profile_listing(library);
+        size_t mismatch = 0;
+        while (mismatch < lines.size() && mismatch < expected.size() && lines[mismatch] == expected[mismatch]) {
+            mismatch++;
+        }
+        bool same = loaded && lines.size() == expected.size() && mismatch == lines.size();
+        report_check(same, "profile library  %s: %d profiles, %zu bytes, %zu listing lines match the JSON%s%s",
+                     strrchr(set.image, '/') + 1, library.get_count(), image.size(), mismatch,
+                     same ? "" : ", first difference: ", same ? "" : (mismatch < lines.size() ? lines[mismatch].c_str() : "(missing)"));
+    }
+
+    // 仓库里的默认曲线与内置模式的表相同
+    {
+        std::vector<uint8_t> image = read_file(HAPTIC_PROFILE_IMAGE);
+        GuardedImage mapped(image);
+        HapticProfileLibrary library;
+        (void) library.load(mapped.data(), mapped.size());
+        const float limit = 333;
+        struct Builtin {
+            const char *name;
+            std::function<void(HapticProfile &)> make;
+        } builtins[] = {
+                {"attractor", [&](HapticProfile &p) { p.make_detents(8, 100.0f * logf(9.0f) + 100.0f, limit); }},
+                {"bounded", [&](HapticProfile &p) {
+                    p.make_bounded_damping(0, -float(M_PI_4), float(M_PI_4), KNOB_WALL_STIFFNESS, limit);
+                }},
+                {"switch", [&](HapticProfile &p) {
+                    p.make_bounded_detents(1, -float(M_PI / 6), float(M_PI / 6), 150, limit);
+                    p.wall_stiffness = KNOB_WALL_STIFFNESS;
+                }},
+        };
+        for (auto &builtin: builtins) {
+            const HapticProfileRecord *record = library.find(builtin.name);
+            float difference = NAN;
+            if (record) {
+                HapticProfile reference;
+                builtin.make(reference);
+                difference = profile_difference(record, reference);
+            }
+            report_check(record && difference < 0.01f * limit,
+                         "profile library  compile(\"%s\") vs built-in mode: torque differs by at most %.2f Uq",
+                         builtin.name, difference);
+        }
+    }
+
+    // 测试曲线: 吸附点处的刚度 = 吸附点 + 所有弹簧, 阻尼 / 墙 / 限幅原样带过去
+    {
+        std::vector<uint8_t> image = read_file(HAPTIC_PROFILE_TEST_IMAGE);
+        GuardedImage mapped(image);
+        HapticProfileLibrary library;
+        (void) library.load(mapped.data(), mapped.size());
+        for (int i = 0; i < library.get_count(); i++) {
+            const HapticProfileRecord *record = library.get(i);
+            HapticProfile compiled;
+            HapticProfileLibrary::compile(record, compiled);
+            HapticProfileEngine engine;
+            engine.edit() = compiled;
+            bool ok = engine.commit();
+            engine.acquire();
+            const HapticDetentRecord *detents = HapticProfileLibrary::get_detents(record);
+            const HapticSpringRecord *springs = HapticProfileLibrary::get_springs(record);
+            float spring_stiffness = 0;
+            for (int k = 0; k < record->spring_count; k++) {
+                spring_stiffness += springs[k].stiffness;
+            }
+            float worst = 0;
+            const float h = 0.02f;
+            bool bounded = record->flags & haptic_profile_flag_bounded;
+            for (int k = 0; k < record->detent_count; k++) {
+                if (bounded && (k == 0 || k == record->detent_count - 1)) {
+                    continue;   // 端点外是墙
+                }
+                float x = detents[k].position_rad;
+                float slope = (engine.evaluate(x - h, 0) - engine.evaluate(x + h, 0)) / (2 * h);
+                worst = std::fmax(worst, std::fabs(slope / (detents[k].stiffness + spring_stiffness) - 1));
+            }
+            ok = ok && worst < 0.05f && compiled.damping == record->damping &&
+                 compiled.torque_limit == record->torque_limit &&
+                 compiled.wall_stiffness == (bounded ? record->end_stop_stiffness : 0);
+            report_check(ok, "profile library  compile(\"%s\"): stiffness at the detents within %.1f%% of detent + springs, "
+                             "damping %.2f, wall %.0f, limit %.0f", record->name, worst * 100, compiled.damping,
+                         compiled.wall_stiffness, compiled.torque_limit);
+        }
+    }
+
+    // 损坏的镜像: 每个都放在映射范围的末尾, 被拒绝并且库为空
+    const std::vector<uint8_t> image = read_file(HAPTIC_PROFILE_IMAGE);
+    const auto *header = reinterpret_cast<const HapticProfileFileHeader *>(image.data());
+    const size_t last_record = image.size() - sizeof(HapticProfileRecord) -
+                               2 * sizeof(HapticDetentRecord);     // 默认曲线最后一条是 2 个吸附点的 switch
+    struct Corruption {
+        const char *what;
+        std::function<void(std::vector<uint8_t> &)> apply;
+    } corruptions[] = {
+            {"one flipped bit after the header", [](std::vector<uint8_t> &b) { b[sizeof(HapticProfileFileHeader) + 20] ^= 0x04; }},
+            {"header truncated to 8 bytes", [](std::vector<uint8_t> &b) { b.resize(8); }},
+            {"last record cut by 4 bytes, size and CRC updated", [](std::vector<uint8_t> &b) {
+                b.resize(b.size() - 4);
+                set_u32(b, offsetof(HapticProfileFileHeader, size), uint32_t(b.size()));
+                fix_crc(b);
+            }},
+            {"record header cut in half, size and CRC updated", [&](std::vector<uint8_t> &b) {
+                b.resize(last_record + sizeof(HapticProfileRecord) / 2);
+                set_u32(b, offsetof(HapticProfileFileHeader, size), uint32_t(b.size()));
+                fix_crc(b);
+            }},
+            {"profile count one past the records", [&](std::vector<uint8_t> &b) {
+                set_u16(b, offsetof(HapticProfileFileHeader, profile_count), uint16_t(header->profile_count + 1));
+            }},
+            {"profile count 65535", [](std::vector<uint8_t> &b) {
+                set_u16(b, offsetof(HapticProfileFileHeader, profile_count), 0xFFFF);
+            }},
+            {"detent count 255 in the last record, CRC updated", [&](std::vector<uint8_t> &b) {
+                b[last_record + offsetof(HapticProfileRecord, detent_count)] = 255;
+                fix_crc(b);
+            }},
+            {"size past the partition", [](std::vector<uint8_t> &b) {
+                b.resize(partition_size, 0xFF);
+                set_u32(b, offsetof(HapticProfileFileHeader, size), uint32_t(partition_size + 16));
+            }},
+            {"erased partition (all 0xFF)", [](std::vector<uint8_t> &b) { b.assign(partition_size, 0xFF); }},
+    };
+    int rejected = 0;
+    const int total = int(sizeof(corruptions) / sizeof(corruptions[0]));
+    for (auto &corruption: corruptions) {
+        std::vector<uint8_t> bytes = image;
+        corruption.apply(bytes);
+        GuardedImage mapped(bytes);
+        HapticProfileLibrary library;
+        bool loaded = library.load(mapped.data(), mapped.size());
+        if (!loaded && library.get_count() == 0 && library.find("attractor") == nullptr) {
+            rejected++;
+        } else {
+            printf("       %s: accepted\n", corruption.what);
+        }
+    }
+    report_check(rejected == total, "profile library  corrupted images (CRC, truncated header / record, count past the "
+                                    "records or the partition, erased): %d of %d rejected, no read past the map",
+                 rejected, total);
+}
+
+void print_value(float value, const char *format, bool csv) {
+    if (std::isnan(value)) {
+        printf(csv ? "," : "%12s", csv ? "" : "-");
+    } else {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), format, value);
+        printf(csv ? ",%s" : "%12s", buffer);
+    }
+}
+
+}   // namespace
+
+int main(int argc, char **argv) {
+    BenchConfig config;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--latency") == 0 && i + 1 < argc) {
+            config.latency_us = float(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--jitter") == 0 && i + 1 < argc) {
+            config.jitter_us = float(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--noise") == 0 && i + 1 < argc) {
+            config.noise_lsb = float(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            config.seed = uint32_t(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            config.csv = true;
+        } else {
+            fprintf(stderr, "usage: %s [--latency <us>] [--jitter <us>] [--noise <lsb>] [--seed <n>] [--csv]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (config.latency_us < 0 || config.latency_us * 1e-6f >= Ts - config.jitter_us * 1e-6f) {
+        fprintf(stderr, "latency must be shorter than the control period\n");
+        return 1;
+    }
+
+    // 与 logic_mode 中各模式的参数一致
+    const float bound = float(M_PI_4);
+    const float switch_bound = float(M_PI / 6.0);
+    const ModeSetup setups[] = {
+            {"Attractor", [](HapticRenderer &r) {
+                r.set_attractor(8);
+                r.set_mode(HapticMode::Attractor);
+            }, true, false, float(M_TWOPI) / 8, 0, -0.2f, float(M_TWOPI) * 3 / 8 + 0.2f, NAN, 0, float(M_TWOPI) / 8, 2},
+            {"AttractorWithRebound", [=](HapticRenderer &r) {
+                r.set_attractor(1);
+                r.set_boundaries(-switch_bound, switch_bound);
+                r.set_mode(HapticMode::AttractorWithRebound);
+            }, true, true, 2 * switch_bound, -switch_bound, -switch_bound - 0.2f, switch_bound + 0.2f, switch_bound,
+             switch_bound, 0.3f, 2},
+            {"Damping", [](HapticRenderer &r) {
+                r.set_damping(20);
+                r.set_mode(HapticMode::Damping);
+            }, false, false, NAN, 0, 0, 0, NAN, 0, 1.0f, 2},
+            {"DampingWithRebound", [=](HapticRenderer &r) {
+                r.set_damping(0);
+                r.set_boundaries(-bound, bound);
+                r.set_mode(HapticMode::DampingWithRebound);
+            }, false, true, NAN, 0, 0, 0, bound, bound, 0.3f, 2},
+            // 纯比例墙, 与无源墙对比
+            {"AttractorWithRebound/P", [=](HapticRenderer &r) {
+                r.set_passive_walls(false);
+                r.set_attractor(1);
+                r.set_boundaries(-switch_bound, switch_bound);
+                r.set_mode(HapticMode::AttractorWithRebound);
+            }, true, true, 2 * switch_bound, -switch_bound, -switch_bound - 0.2f, switch_bound + 0.2f, switch_bound,
+             switch_bound, 0.3f, 2},
+            {"DampingWithRebound/P", [=](HapticRenderer &r) {
+                r.set_passive_walls(false);
+                r.set_damping(0);
+                r.set_boundaries(-bound, bound);
+                r.set_mode(HapticMode::DampingWithRebound);
+            }, false, true, NAN, 0, 0, 0, bound, bound, 0.3f, 2},
+            {"Flywheel", [](HapticRenderer &r) {
+                r.set_flywheel(3.0f, 20.0f, 0.3f, 0);
+                r.set_mode(HapticMode::Flywheel);
+            }, false, false, NAN, 0, 0, 0, NAN, 0, 2.0f, 1},
+    };
+
+    if (config.csv) {
+        printf("mode,rest_noise_mrad,rest_uq_rms,detent_peak_uq,detent_stiffness_uq_rad,max_wall_stiffness_uq_rad,"
+               "hand_work_mj_per_cycle\n");
+    } else {
+        printf("latency %.0f us, jitter ±%.0f us, noise %.1f lsb, seed %u\n", config.latency_us, config.jitter_us,
+               config.noise_lsb, config.seed);
+        printf("%-22s%12s%12s%12s%12s%12s%12s\n", "mode", "rest mrad", "rest Uq", "detent Uq", "detent k",
+               "wall k max", "mJ/cycle");
+    }
+    for (const ModeSetup &setup: setups) {
+        ModeResult result;
+        measure_rest(config, setup, result);
+        if (setup.has_detents) {
+            measure_detents(config, setup, result);
+        }
+        if (setup.has_walls) {
+            measure_wall(config, setup, result);
+        }
+        measure_passivity(config, setup, result);
+
+        printf(config.csv ? "%s" : "%-22s", setup.name);
+        print_value(result.rest_noise_mrad, "%.2f", config.csv);
+        print_value(result.rest_uq_rms, "%.1f", config.csv);
+        print_value(result.detent_peak, "%.0f", config.csv);
+        print_value(result.detent_stiffness, "%.0f", config.csv);
+        print_value(result.max_wall_stiffness, "%.0f", config.csv);
+        print_value(result.hand_work_mj, "%.3f", config.csv);
+        printf("\n");
+    }
+
+    if (!config.csv) {
+        printf("\n");
+    }
+    check_nearest_rest();
+    check_profile_table();
+    check_friction_fit(config);
+    check_flywheel_energy(config);
+    check_encoder_glitches();
+    check_detent_fade(config);
+    check_mode_switch(config);
+    check_ballistic_mapper();
+    check_servo(config);
+    check_texture_alias();
+    check_texture_beat(config);
+    check_pid_controller();
+    check_autotune(config);
+    check_cascade(config);
+    check_trajectory(config);
+    check_profile_library();
+    return check_failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,294 @@
+#!/usr/bin/env python3
+"""
+FocKnob 力反馈曲线编码/校验工具, 只依赖 Python 标准库
+
+用法:
+    python3 tools/haptic_profile.py encode tools/haptic_profiles.json -o haptic.bin
+    python3 tools/haptic_profile.py dump haptic.bin
+    python3 tools/haptic_profile.py dump tools/haptic_profiles.json     # 按固件读到的 float32 值列出, 与镜像的列表逐行相同
+    parttool.py --port PORT write_partition --partition-name haptic --input haptic.bin
+
+idf.py flash 会用 tools/haptic_profiles.json 生成默认的曲线一起烧写; 换一套手感只需要重新烧写 haptic 分区.
+二进制格式见 components/motor_knob/include/haptic_profile_library.h, 固件开机时做同样的校验,
+不合法时整个分区被忽略, 各模式使用内置参数.
+
+JSON 格式 (角度单位 rad, 刚度 Uq/rad, 阻尼 Uq/(rad/s), 力矩 Uq):
+    {"profiles": [
+        {"name": "attractor",
+         "detents": {"count": 8, "stiffness": 320}},            # 一圈均匀 count 个吸附点
+        {"name": "switch",
+         "end_stops": {"left": -0.5236, "right": 0.5236, "stiffness": 16000},
+         "detents": [{"position": -0.5236, "stiffness": 150},   # 也可以逐个给出位置和刚度
+                     {"position": 0.5236, "stiffness": 150}],
+         "springs": [{"center": 0, "stiffness": 20}],
+         "damping": 0, "torque_limit": 333}
+    ]}
+    有 end_stops 的是有界曲线, 否则是一圈的周期曲线; 有界曲线均匀的吸附点包括两端, count 为吸附点个数.
+    end_stops 的刚度由固件的无源墙渲染, 可以和内置模式一样用 KNOB_WALL_STIFFNESS (16000);
+    关掉无源墙 (set_passive_walls(false)) 时是纯比例墙, 超过约 9600 就会颤振.
+    BoundedMode / SwitchMode / AttractorMode 分别查找名为 "bounded" / "switch" / "attractor" 的曲线.
+"""
+
+import argparse
+import json
+import math
+import struct
+import sys
+import zlib
+
+MAGIC = 0x46525048  # "HPRF"
+VERSION = 1
+FILE_HEADER = struct.Struct("<IHHII")
+RECORD = struct.Struct("<16sBBBBfffff")
+POINT = struct.Struct("<ff")
+FLAG_BOUNDED = 0x01
+NAME_SIZE = 16
+TABLE_POINTS = 256          # 固件里力矩表的点数 (HapticProfile::max_points)
+PARTITION_SIZE = 0x10000    # partitions.csv 里 haptic 分区的大小
+OUTPUT_LIMIT = 999          # FOC_MCPWM_OUTPUT_LIMIT
+DEFAULT_TORQUE_LIMIT = 333  # 与内置模式相同, 输出上限的 1/3
+
+
+def f32(x):
+    """按 float32 取整, 校验时和固件看到的值一致"""
+    return struct.unpack("<f", struct.pack("<f", x))[0]
+
+
+def expand_detents(spec, bounded, left, right):
+    if spec is None:
+        return []
+    if isinstance(spec, dict):
+        count = int(spec["count"])
+        k = float(spec["stiffness"])
+        if count < 1:
+            raise ValueError("detent count must be >= 1")
+        if bounded:
+            if count == 1:
+                return [(left, k)]
+            return [(left + (right - left) * i / (count - 1), k) for i in range(count)]
+        return [(2 * math.pi * i / count, k) for i in range(count)]
+    return [(float(d["position"]), float(d["stiffness"])) for d in spec]
+
+
+def normalize(profile):
+    """JSON 里的一条曲线 -> 与二进制记录一一对应的字典"""
+    name = profile["name"]
+    stops = profile.get("end_stops")
+    bounded = stops is not None
+    left = float(stops["left"]) if bounded else 0.0
+    right = float(stops["right"]) if bounded else 2 * math.pi
+    return {
+        "name": name,
+        "bounded": bounded,
+        "left": left,
+        "right": right,
+        "end_stop_stiffness": float(stops.get("stiffness", 0)) if bounded else 0.0,
+        "damping": float(profile.get("damping", 0)),
+        "torque_limit": float(profile.get("torque_limit", DEFAULT_TORQUE_LIMIT)),
+        "detents": expand_detents(profile.get("detents"), bounded, left, right),
+        "springs": [(float(s["center"]), float(s["stiffness"])) for s in profile.get("springs", [])],
+    }
+
+
+def validate(profiles):
+    """返回 (errors, warnings); errors 与固件的 _check_record 对应, 有 error 时固件会拒绝整个分区"""
+    errors, warnings = [], []
+    names = set()
+    if len(profiles) > 0xFFFF:
+        errors.append("too many profiles")
+    for p in profiles:
+        tag = "profile %r" % p["name"]
+        raw_name = p["name"].encode("ascii", errors="replace")
+        if not raw_name or len(raw_name) >= NAME_SIZE or b"\0" in raw_name:
+            errors.append("%s: name must be 1~%d ASCII characters" % (tag, NAME_SIZE - 1))
+        if p["name"] in names:
+            errors.append("%s: duplicate name" % tag)
+        names.add(p["name"])
+
+        left, right = f32(p["left"]), f32(p["right"])
+        values = [left, right, p["end_stop_stiffness"], p["damping"], p["torque_limit"]]
+        if not all(math.isfinite(v) for v in values):
+            errors.append("%s: non-finite parameter" % tag)
+            continue
+        if not left < right:
+            errors.append("%s: end stops need left < right" % tag)
+        if p["end_stop_stiffness"] < 0 or p["damping"] < 0:
+            errors.append("%s: stiffness and damping must be >= 0" % tag)
+        if not p["torque_limit"] > 0:
+            errors.append("%s: torque_limit must be > 0" % tag)
+        elif p["torque_limit"] > OUTPUT_LIMIT:
+            warnings.append("%s: torque_limit %.0f above the output limit %d" % (tag, p["torque_limit"], OUTPUT_LIMIT))
+
+        detents = p["detents"]
+        if len(detents) > 255 or len(p["springs"]) > 255:
+            errors.append("%s: at most 255 detents and 255 springs" % tag)
+        previous = None
+        for position, k in detents:
+            position = f32(position)
+            in_range = left <= position <= right if p["bounded"] else 0 <= position < f32(2 * math.pi)
+            if not math.isfinite(position) or not in_range:
+                errors.append("%s: detent at %.4f outside [%.4f, %.4f]" % (tag, position, left, right))
+            if not (math.isfinite(k) and k >= 0):
+                errors.append("%s: detent stiffness must be >= 0" % tag)
+            if previous is not None and not position > previous:
+                errors.append("%s: detents must be sorted and distinct" % tag)
+            previous = position
+        for center, k in p["springs"]:
+            if not (math.isfinite(center) and math.isfinite(k) and k >= 0):
+                errors.append("%s: spring needs a finite center and stiffness >= 0" % tag)
+
+        # 力矩表只有 256 个点, 吸附点太密时中间的力矩反向会被插值抹平
+        if len(detents) > 1 and not errors:
+            step = (right - left) / (TABLE_POINTS - 1 if p["bounded"] else TABLE_POINTS)
+            gaps = [b[0] - a[0] for a, b in zip(detents, detents[1:])]
+            if not p["bounded"]:
+                gaps.append(detents[0][0] + 2 * math.pi - detents[-1][0])
+            if min(gaps) < 8 * step:
+                warnings.append("%s: detents closer than 8 table points (%.4f rad), they will feel soft"
+                                % (tag, 8 * step))
+    return errors, warnings
+
+
+def encode(profiles):
+    body = bytearray()
+    for p in profiles:
+        flags = FLAG_BOUNDED if p["bounded"] else 0
+        body += RECORD.pack(p["name"].encode("ascii"), flags, len(p["detents"]), len(p["springs"]), 0,
+                            p["left"] if p["bounded"] else 0.0, p["right"] if p["bounded"] else 0.0,
+                            p["end_stop_stiffness"], p["damping"], p["torque_limit"])
+        for point in p["detents"] + p["springs"]:
+            body += POINT.pack(*point)
+    header = FILE_HEADER.pack(MAGIC, VERSION, len(profiles), FILE_HEADER.size + len(body), zlib.crc32(body))
+    return header + body
+
+
+def decode(data):
+    """二进制 -> 曲线列表, 与固件 load() 的检查相同"""
+    if len(data) < FILE_HEADER.size:
+        raise ValueError("file too short")
+    magic, version, count, size, crc = FILE_HEADER.unpack_from(data)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError("bad magic %08x / version %d" % (magic, version))
+    if size < FILE_HEADER.size or size > len(data):
+        raise ValueError("header size %d, file %d bytes" % (size, len(data)))
+    if zlib.crc32(data[FILE_HEADER.size:size]) != crc:
+        raise ValueError("CRC mismatch")
+    profiles = []
+    offset = FILE_HEADER.size
+    for _ in range(count):
+        if offset + RECORD.size > size:
+            raise ValueError("record header truncated")
+        name, flags, n_detents, n_springs, _, left, right, wall, damping, limit = RECORD.unpack_from(data, offset)
+        offset += RECORD.size
+        points = [POINT.unpack_from(data, offset + i * POINT.size) for i in range(n_detents + n_springs)
+                  if offset + (i + 1) * POINT.size <= size]
+        if len(points) != n_detents + n_springs:
+            raise ValueError("record %r truncated" % name)
+        offset += POINT.size * len(points)
+        if b"\0" not in name:
+            raise ValueError("name not terminated")
+        bounded = bool(flags & FLAG_BOUNDED)
+        profiles.append({
+            "name": name.split(b"\0")[0].decode("ascii", errors="replace"),
+            "bounded": bounded,
+            "left": left if bounded else 0.0,
+            "right": right if bounded else 2 * math.pi,
+            "end_stop_stiffness": wall,
+            "damping": damping,
+            "torque_limit": limit,
+            "detents": points[:n_detents],
+            "springs": points[n_detents:],
+        })
+    if offset != size:
+        raise ValueError("%d trailing bytes" % (size - offset))
+    return profiles
+
+
+def report(errors, warnings):
+    for w in warnings:
+        print("warning: " + w, file=sys.stderr)
+    for e in errors:
+        print("error: " + e, file=sys.stderr)
+    if errors:
+        raise SystemExit(1)
+
+
+def cmd_encode(args):
+    with open(args.json, encoding="utf-8") as f:
+        profiles = [normalize(p) for p in json.load(f)["profiles"]]
+    report(*validate(profiles))
+    data = encode(profiles)
+    if len(data) > PARTITION_SIZE:
+        raise SystemExit("error: %d bytes does not fit the %d byte partition" % (len(data), PARTITION_SIZE))
+    # 解码一遍, 确认编码结果能被固件按同样的规则读回
+    decoded = decode(data)
+    assert [p["name"] for p in decoded] == [p["name"] for p in profiles]
+    with open(args.output, "wb") as f:
+        f.write(data)
+    if not args.quiet:
+        print("%d profiles, %d bytes -> %s" % (len(profiles), len(data), args.output))
+
+
+def as_stored(p):
+    """数值按 float32 取整, 即固件从镜像里读到的值"""
+    return dict(p, left=f32(p["left"]) if p["bounded"] else 0.0, right=f32(p["right"]) if p["bounded"] else 2 * math.pi,
+                end_stop_stiffness=f32(p["end_stop_stiffness"]), damping=f32(p["damping"]),
+                torque_limit=f32(p["torque_limit"]),
+                detents=[(f32(x), f32(k)) for x, k in p["detents"]],
+                springs=[(f32(x), f32(k)) for x, k in p["springs"]])
+
+
+def listing(profiles):
+    """每条曲线的文字列表; haptic_bench 按同样的格式列出固件 load() 读到的内容, 逐行比较"""
+    lines = []
+    for p in profiles:
+        kind = "bounded [%.4f, %.4f] wall %.1f" % (p["left"], p["right"], p["end_stop_stiffness"]) \
+            if p["bounded"] else "periodic"
+        lines.append("%-15s %s, damping %.2f, limit %.0f" % (p["name"], kind, p["damping"], p["torque_limit"]))
+        for position, k in p["detents"]:
+            lines.append("    detent %+8.4f  k %.1f" % (position, k))
+        for center, k in p["springs"]:
+            lines.append("    spring %+8.4f  k %.1f" % (center, k))
+    return lines
+
+
+def cmd_dump(args):
+    if args.bin.endswith(".json"):
+        with open(args.bin, encoding="utf-8") as f:
+            profiles = [as_stored(normalize(p)) for p in json.load(f)["profiles"]]
+    else:
+        with open(args.bin, "rb") as f:
+            data = f.read()
+        # 从分区读出来的镜像后面是 0xFF 填充, 按文件头里的大小截取
+        try:
+            profiles = decode(data)
+        except ValueError as e:
+            raise SystemExit("error: %s" % e)
+    errors, warnings = validate(profiles)
+    text = "\n".join(listing(profiles)) + "\n"
+    if args.output:
+        with open(args.output, "w", encoding="utf-8") as f:
+            f.write(text)
+    else:
+        sys.stdout.write(text)
+    report(errors, warnings)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="FocKnob haptic profile encoder / validator")
+    sub = parser.add_subparsers(dest="command", required=True)
+    p = sub.add_parser("encode", help="validate a JSON profile set and write the partition image")
+    p.add_argument("json")
+    p.add_argument("-o", "--output", required=True)
+    p.add_argument("-q", "--quiet", action="store_true")
+    p.set_defaults(func=cmd_encode)
+    p = sub.add_parser("dump", help="validate and print a partition image or a JSON profile set")
+    p.add_argument("bin")
+    p.add_argument("-o", "--output", help="write the listing to a file instead of stdout")
+    p.set_defaults(func=cmd_dump)
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()
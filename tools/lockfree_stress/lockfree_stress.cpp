@@ -0,0 +1,332 @@
+/*
+ * @brief 无锁队列 / 环形缓冲区的并发压力测试, 在主机上运行
+ *
+ *        用固件里实际的代码, 每个角色一个线程, 全速对着跑:
+ *          - WaveformPlayer 的触发队列: 多个生产者线程同时 play() (队列满时重试), 一个消费者线程 (FOC 任务) 取出.
+ *            每个触发恰好取出一次, 同一个生产者的触发保持顺序, 槽里的 effect 和 strength 不会被拆开
+ *          - KnobEventRing: 一个发布线程 (旋钮定时器) 连续发布, 多个读者各自读取, 其中一个故意读得慢, 会被套圈.
+ *            读到的事件都是完整的 (没有半个事件), 序号递增, 读到的 + 丢失的 = 发布的, 丢失数与序号的空缺一致
+ *          - MotorEncoder 的位置快照: 一个线程 (FOC 任务) 连续采样, 一个线程提交新零点, 多个读者读位置和零点.
+ *            64 位的累计位置单调不减 (高低两半没有被撕开), 零点总是某一次提交的完整值, 提交的零点最终都生效
+ *        每个触发 / 事件的内容都由序号算出来, 读到以后按序号重新算一遍比较, 撕裂和错位都能发现
+ *
+ *        x86 主机的内存序比 Xtensa 强, 少写的 acquire / release 在这里不一定能发现, 在 ARM 主机上跑更容易暴露;
+ *        这里主要检查算法本身 (丢失 / 重复 / 乱序 / 撕裂)
+ *
+ *        用法: lockfree_stress [--plays <n>] [--producers <n>] [--events <n>] [--readers <n>] [--samples <n>]
+ *        任何一项失败时返回值非 0
+ */
+
+#include <atomic>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "waveform_player.h"
+#include "knob_events.h"
+#include "sim_encoder.h"
+
+// MotorEncoder 的友元, 直接提交构造好的零点
+struct EncoderOffsetProbe {
+    static void request(SimEncoder &encoder, encoder_position_t offset) {
+        (void) encoder._request_offset(offset);
+    }
+};
+
+// WaveformPlayer 的友元, 代替 next() 直接从队列里取触发, 这样每个触发的内容都能检查
+struct WaveformQueueProbe {
+    static bool pop(WaveformPlayer &player, HapticEffect &effect, float &strength) {
+        return player._pop(effect, strength);
+    }
+};
+
+namespace {
+
+constexpr int effect_count = 4;
+constexpr uint32_t producer_shift = 22;     // strength = 生产者 << 22 | 序号, float 在 2^24 以内是精确的
+constexpr uint32_t max_plays = 1u << producer_shift;
+
+int check_failures = 0;
+
+void report_check(bool ok, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    printf("check  %-4s  ", ok ? "ok" : "FAIL");
+    vprintf(format, args);
+    printf("\n");
+    va_end(args);
+    check_failures += ok ? 0 : 1;
+}
+
+// 多生产者 / 单消费者: 每个触发恰好取出一次, 同一个生产者的顺序不变, 内容完整
+void check_waveform_queue(int producers, uint32_t plays) {
+    WaveformPlayer player;
+    std::atomic<int> running{producers};
+    std::atomic<uint64_t> full_retries{0};
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&, p] {
+            for (uint32_t n = 0; n < plays; n++) {
+                auto effect = HapticEffect(n % effect_count);
+                auto strength = float(uint32_t(p) << producer_shift | n);
+                while (!player.play(effect, strength)) {    // 队列满, 等消费者取走
+                    full_retries.fetch_add(1, std::memory_order_relaxed);
+                    std::this_thread::yield();
+                }
+            }
+            running.fetch_sub(1);
+        });
+    }
+
+    std::vector<uint32_t> expected(producers, 0);
+    uint64_t received = 0, out_of_order = 0, torn = 0;
+    while (true) {
+        bool finished = running.load() == 0;    // 先看生产者是否都结束, 再把队列取空
+        bool popped = false;
+        HapticEffect effect;
+        float strength;
+        while (WaveformQueueProbe::pop(player, effect, strength)) {
+            popped = true;
+            auto value = uint32_t(strength);
+            uint32_t p = value >> producer_shift, n = value & (max_plays - 1);
+            if (float(value) != strength || p >= uint32_t(producers) || effect != HapticEffect(n % effect_count)) {
+                torn++;
+                continue;
+            }
+            if (n != expected[p]) {
+                out_of_order++;
+            }
+            expected[p] = n + 1;
+            received++;
+        }
+        if (finished && !popped) {
+            break;
+        }
+        if (!popped) {
+            std::this_thread::yield();  // 单核主机上不让出 CPU 的话生产者跑不起来
+        }
+    }
+    for (std::thread &thread: threads) {
+        thread.join();
+    }
+
+    uint64_t total = uint64_t(producers) * plays;
+    report_check(received == total && out_of_order == 0 && torn == 0,
+                 "waveform queue  %d producers x %u plays: received %llu / %llu, out of order %llu, torn %llu "
+                 "(queue full %llu times)", producers, plays, (unsigned long long) received,
+                 (unsigned long long) total, (unsigned long long) out_of_order, (unsigned long long) torn,
+                 (unsigned long long) full_retries.load());
+}
+
+KnobEvent make_event(uint32_t sequence) {   // 事件内容全部由序号决定
+    return {
+            .time_us = int64_t(sequence) * 2000,
+            .type = KnobEventType(sequence % 7),
+            .direction = int8_t(int(sequence % 3) - 1),
+            .detent = int32_t(sequence * 2654435761u),
+            .position = float(sequence & 0xffff),
+            .velocity = -float(sequence & 0xfff),
+    };
+}
+
+bool same_event(const KnobEvent &a, const KnobEvent &b) {
+    return a.time_us == b.time_us && a.type == b.type && a.direction == b.direction && a.detent == b.detent &&
+           a.position == b.position && a.velocity == b.velocity;
+}
+
+struct ReaderResult {
+    uint64_t received = 0;
+    uint64_t gaps = 0;          // 序号的空缺之和
+    uint64_t torn = 0;          // 内容与序号对不上
+    uint64_t backwards = 0;     // 序号没有递增
+    uint32_t dropped = 0;       // KnobEventReader 记录的丢失数
+};
+
+// 单生产者 / 多消费者广播: 每个读者都能读到完整的事件, 被套圈的部分如实计入 dropped
+void check_event_ring(int readers, uint32_t events) {
+    KnobEventRing ring;
+    std::atomic<bool> published{false};
+    std::vector<ReaderResult> results(readers);
+    std::vector<KnobEventReader> cursors(readers);
+    for (KnobEventReader &cursor: cursors) {
+        ring.subscribe(cursor);     // 从第 0 个事件开始
+    }
+
+    std::vector<std::thread> threads;
+    for (int r = 0; r < readers; r++) {
+        threads.emplace_back([&, r] {
+            ReaderResult &result = results[r];
+            KnobEventReader &cursor = cursors[r];
+            bool slow = r == readers - 1;   // 最后一个读者每读一个事件都让出 CPU, 一定会被套圈
+            int64_t next = 0;
+            while (true) {
+                bool finished = published.load();
+                bool read = false;
+                KnobEvent event{};
+                while (ring.read(cursor, event)) {
+                    read = true;
+                    int64_t sequence = event.time_us / 2000;
+                    if (sequence < 0 || !same_event(event, make_event(uint32_t(sequence)))) {
+                        result.torn++;
+                        continue;
+                    }
+                    if (sequence < next) {
+                        result.backwards++;
+                    } else {
+                        result.gaps += uint64_t(sequence - next);
+                    }
+                    next = sequence + 1;
+                    result.received++;
+                    if (slow) {
+                        std::this_thread::yield();
+                    }
+                }
+                if (finished && !read) {
+                    break;
+                }
+                if (!read) {
+                    std::this_thread::yield();
+                }
+            }
+            result.gaps += uint64_t(int64_t(events) - next);     // 最后被覆盖掉的部分
+            result.dropped = cursor.dropped;
+        });
+    }
+
+    for (uint32_t sequence = 0; sequence < events; sequence++) {
+        ring.publish(make_event(sequence));
+        if ((sequence & 15) == 15) {
+            std::this_thread::yield();  // 旋钮定时器是周期性的, 给读者一点追上的机会
+        }
+    }
+    published.store(true);
+    for (std::thread &thread: threads) {
+        thread.join();
+    }
+
+    for (int r = 0; r < readers; r++) {
+        const ReaderResult &result = results[r];
+        report_check(result.torn == 0 && result.backwards == 0 && result.received + result.dropped == events &&
+                     result.gaps == result.dropped,
+                     "event ring  reader %d/%d%s: received %llu + dropped %u of %u, gaps %llu, torn %llu, "
+                     "backwards %llu", r + 1, readers, r == readers - 1 ? " (slow)" : "",
+                     (unsigned long long) result.received, result.dropped, events,
+                     (unsigned long long) result.gaps, (unsigned long long) result.torn,
+                     (unsigned long long) result.backwards);
+    }
+}
+
+// 单写者 (FOC 任务采样) + 一个提交零点的线程 + 多个读者: 读到的位置和零点都是完整的
+void check_encoder_snapshot(int readers, uint32_t samples) {
+    SimEncoder encoder;
+    const float step = 0.2f;    // 每次采样转过的角度 (rad), 约 100 rad/s, 低于跳变拒绝的门限
+    const uint32_t offsets = 2000;
+    auto offset_value = [](uint32_t k) {    // 高低两半都随 k 变化, 拼错了就对不上
+        return encoder_position_t(k) * (ENCODER_POSITION_ONE_TURN + 1);
+    };
+    std::atomic<bool> sampled{false};
+    std::atomic<uint32_t> offsets_requested{0};
+
+    std::vector<std::thread> threads;
+    std::vector<uint64_t> backwards(readers, 0), torn_offsets(readers, 0), reads(readers, 0);
+    for (int r = 0; r < readers; r++) {
+        threads.emplace_back([&, r] {
+            encoder_position_t last = 0;
+            uint32_t n = 0;
+            while (!sampled.load()) {
+                encoder_position_t position = encoder.get_position();
+                encoder_position_t offset = encoder.get_custom_offset();
+                if (position < last) {
+                    backwards[r]++;
+                }
+                last = position;
+                auto k = uint32_t(offset >> 32);
+                if (offset != offset_value(k) || k > offsets_requested.load()) {
+                    torn_offsets[r]++;
+                }
+                reads[r]++;
+                if ((++n & 255) == 0) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    // 提交零点的线程 (旋钮任务): 只用 set_custom_total_radian 的返回值算出来的值太难检查, 这里直接提交构造的值
+    threads.emplace_back([&] {
+        for (uint32_t k = 1; k <= offsets && !sampled.load(); k++) {
+            offsets_requested.store(k);
+            EncoderOffsetProbe::request(encoder, offset_value(k));
+            std::this_thread::yield();
+        }
+    });
+
+    double angle = 0;
+    for (uint32_t i = 0; i < samples; i++) {
+        angle += step;
+        encoder.set_mechanical_radian(float(std::fmod(angle, M_TWOPI)));
+        (void) encoder.read_radian_from_sensor();
+        if ((i & 63) == 63) {
+            std::this_thread::yield();
+        }
+    }
+    (void) encoder.read_radian_from_sensor();    // 最后提交的零点在这次采样生效
+    sampled.store(true);
+    for (std::thread &thread: threads) {
+        thread.join();
+    }
+    (void) encoder.read_radian_from_sensor();
+    bool final_offset = encoder.get_custom_offset() == offset_value(offsets_requested.load());
+
+    uint64_t total_backwards = 0, total_torn = 0, total_reads = 0;
+    for (int r = 0; r < readers; r++) {
+        total_backwards += backwards[r];
+        total_torn += torn_offsets[r];
+        total_reads += reads[r];
+    }
+    float expected_turns = float(samples) * step / float(M_TWOPI);
+    float turns = float(encoder.get_position()) / float(ENCODER_POSITION_ONE_TURN);
+    report_check(total_backwards == 0 && total_torn == 0 && final_offset && std::fabs(turns - expected_turns) < 1,
+                 "encoder snapshot  %u samples (%.0f turns), %d readers x %llu reads, %u offsets: position went "
+                 "backwards %llu, torn offsets %llu, last offset applied %s", samples, turns, readers,
+                 (unsigned long long) (total_reads / uint64_t(readers)), offsets_requested.load(),
+                 (unsigned long long) total_backwards, (unsigned long long) total_torn, final_offset ? "yes" : "no");
+}
+
+}   // namespace
+
+int main(int argc, char **argv) {
+    uint32_t plays = 200000, events = 300000, samples = 2000000;
+    int producers = 4, readers = 3;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--plays") == 0 && i + 1 < argc) {
+            plays = uint32_t(atol(argv[++i]));
+        } else if (strcmp(argv[i], "--producers") == 0 && i + 1 < argc) {
+            producers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--events") == 0 && i + 1 < argc) {
+            events = uint32_t(atol(argv[++i]));
+        } else if (strcmp(argv[i], "--readers") == 0 && i + 1 < argc) {
+            readers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            samples = uint32_t(atol(argv[++i]));
+        } else {
+            fprintf(stderr, "usage: %s [--plays <n>] [--producers <n>] [--events <n>] [--readers <n>] "
+                            "[--samples <n>]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (plays == 0 || plays > max_plays || producers < 1 || producers > 4 || readers < 1 || events == 0 ||
+        samples == 0) {
+        fprintf(stderr, "plays must be in [1, %u], producers in [1, 4], readers, events and samples at least 1\n",
+                max_plays);
+        return 1;
+    }
+
+    check_waveform_queue(producers, plays);
+    check_event_ring(readers, events);
+    check_encoder_snapshot(readers, samples);
+    return check_failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,194 @@
+#!/usr/bin/env python3
+"""
+FocKnob 系统辨识数据拟合工具, 只依赖 Python 标准库, 可以离线运行
+
+用法:
+    1. 串口执行 `sysid chirp` (或 `sysid prbs`), 把串口日志保存成文件
+    2. python3 tools/sysid_fit.py log.txt [--csv samples.csv]
+
+从日志里找到最后一段 -----BEGIN FOCKNOB SYSID----- ... -----END FOCKNOB SYSID-----,
+解码后用最小二乘拟合 Uq -> 转速 的二阶模型 (带库仑摩擦):
+
+    v[k] = a1·v[k-1] + a2·v[k-2] + b1·u[k-1] + b2·u[k-2] + c·sign(v[k-1])
+
+转速由角度差分得到 (不使用固件里滤波后的转速, 避免滤波器相位混进模型),
+再换算成连续时间参数 J·dω/dt = Uq - B·ω - Fc·sign(ω), 以及一个电气/延迟极点, 最后打印 Bode 表
+"""
+
+import argparse
+import base64
+import cmath
+import math
+import struct
+import sys
+
+BEGIN = "-----BEGIN FOCKNOB SYSID-----"
+END = "-----END FOCKNOB SYSID-----"
+MAGIC = 0x4449534B
+HEADER = struct.Struct("<IHHIIB3xfff")
+SIGNALS = {0: "chirp", 1: "prbs"}
+
+
+def load_dump(path):
+    text = sys.stdin.read() if path == "-" else open(path, encoding="utf-8", errors="replace").read()
+    start = text.rfind(BEGIN)
+    end = text.find(END, start)
+    if start < 0 or end < 0:
+        raise SystemExit("no sysid dump found in %s" % path)
+    payload = "".join(line.strip() for line in text[start + len(BEGIN):end].splitlines())
+    data = base64.b64decode(payload)
+
+    magic, version, sample_size, period_us, count, signal, amplitude, p1, p2 = HEADER.unpack_from(data)
+    if magic != MAGIC or version != 1 or sample_size != 12:
+        raise SystemExit("unsupported dump (magic %08x, version %d, sample size %d)" % (magic, version, sample_size))
+    body = data[HEADER.size:HEADER.size + count * sample_size]
+    if len(body) != count * sample_size:
+        raise SystemExit("dump truncated: %d of %d samples" % (len(body) // sample_size, count))
+    samples = list(struct.iter_unpack("<fff", body))
+    meta = {"period": period_us * 1e-6, "signal": SIGNALS.get(signal, "?"), "amplitude": amplitude,
+            "param1": p1, "param2": p2}
+    return meta, samples
+
+
+def solve(a, b):
+    """高斯消元 (部分主元), a 为 n×n, b 为 n"""
+    n = len(b)
+    m = [row[:] + [b[i]] for i, row in enumerate(a)]
+    for col in range(n):
+        pivot = max(range(col, n), key=lambda r: abs(m[r][col]))
+        if abs(m[pivot][col]) < 1e-12:
+            raise SystemExit("regression is singular, excitation too weak?")
+        m[col], m[pivot] = m[pivot], m[col]
+        for r in range(n):
+            if r != col:
+                f = m[r][col] / m[col][col]
+                for c in range(col, n + 1):
+                    m[r][c] -= f * m[col][c]
+    return [m[i][n] / m[i][i] for i in range(n)]
+
+
+def sign(x, deadband):
+    return 0.0 if abs(x) < deadband else math.copysign(1.0, x)
+
+
+def fit_arx(u, v, deadband):
+    rows, targets = [], []
+    for k in range(2, len(v)):
+        rows.append((v[k - 1], v[k - 2], u[k - 1], u[k - 2], sign(v[k - 1], deadband)))
+        targets.append(v[k])
+    n = 5
+    ata = [[sum(r[i] * r[j] for r in rows) for j in range(n)] for i in range(n)]
+    atb = [sum(r[i] * t for r, t in zip(rows, targets)) for i in range(n)]
+    theta = solve(ata, atb)
+    residual = [t - sum(c * x for c, x in zip(theta, r)) for r, t in zip(rows, targets)]
+    rms = math.sqrt(sum(e * e for e in residual) / len(residual))
+    spread = math.sqrt(sum(t * t for t in targets) / len(targets))
+    return theta, 1 - rms / spread if spread > 0 else 0.0
+
+
+def continuous_params(theta, ts):
+    a1, a2, b1, b2, c = theta
+    dc_gain = (b1 + b2) / (1 - a1 - a2)     # ω / Uq
+    disc = a1 * a1 + 4 * a2
+    roots = [(a1 + cmath.sqrt(disc)) / 2, (a1 - cmath.sqrt(disc)) / 2]
+    poles = sorted((cmath.log(z) / ts if abs(z) > 1e-9 else complex(-1e9) for z in roots), key=lambda s: abs(s))
+    mech = -poles[0].real
+    other = poles[1]
+    damping_b = 1 / dc_gain
+    return {
+        "B": damping_b,                        # Uq / (rad/s), 反电动势 + 粘性摩擦
+        "J": damping_b / mech if mech > 0 else float("nan"),     # Uq / (rad/s²)
+        "mech_pole_hz": mech / (2 * math.pi),
+        "fast_pole": other,
+        "Fc": -c / (b1 + b2),                  # Uq
+        "dc_gain": dc_gain,
+    }
+
+
+def model_response(theta, f, ts):
+    a1, a2, b1, b2, _ = theta
+    z1 = cmath.exp(-2j * math.pi * f * ts)
+    return (b1 * z1 + b2 * z1 * z1) / (1 - a1 * z1 - a2 * z1 * z1)
+
+
+def measured_response(u, v, f, ts, segment=512):
+    """Welch 平均的互谱 / 自谱, 只在需要的频点上算 DFT"""
+    n = len(u)
+    segment = min(segment, n)
+    step = segment // 2
+    window = [0.5 - 0.5 * math.cos(2 * math.pi * i / (segment - 1)) for i in range(segment)]
+    w = -2j * math.pi * f * ts
+    basis = [cmath.exp(w * i) * window[i] for i in range(segment)]
+    suv, suu, svv = 0j, 0.0, 0.0
+    for start in range(0, n - segment + 1, step):
+        uf = sum(basis[i] * u[start + i] for i in range(segment))
+        vf = sum(basis[i] * v[start + i] for i in range(segment))
+        suv += vf * uf.conjugate()
+        suu += abs(uf) ** 2
+        svv += abs(vf) ** 2
+    if suu == 0:
+        return None, 0.0
+    coherence = abs(suv) ** 2 / (suu * svv) if svv > 0 else 0.0
+    return suv / suu, coherence
+
+
+def db(x):
+    return 20 * math.log10(max(abs(x), 1e-12))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("log", help="串口日志文件, - 表示标准输入")
+    parser.add_argument("--csv", help="同时导出采样为 CSV")
+    parser.add_argument("--deadband", type=float, default=0.3, help="库仑摩擦 sign() 的死区 (rad/s)")
+    parser.add_argument("--points", type=int, default=24, help="Bode 表频点数")
+    args = parser.parse_args()
+
+    meta, samples = load_dump(args.log)
+    ts = meta["period"]
+    u = [s[0] for s in samples]
+    pos = [s[1] for s in samples]
+    v = [0.0] + [(pos[k] - pos[k - 1]) / ts for k in range(1, len(pos))]
+    print("%s excitation, amplitude %.1f Uq, %d samples at %.0f Hz" %
+          (meta["signal"], meta["amplitude"], len(samples), 1 / ts))
+
+    if args.csv:
+        with open(args.csv, "w") as f:
+            f.write("t,uq,position,velocity_fw,velocity_diff\n")
+            for k, s in enumerate(samples):
+                f.write("%.6f,%.3f,%.6f,%.4f,%.4f\n" % (k * ts, s[0], s[1], s[2], v[k]))
+
+    theta, fit = fit_arx(u, v, args.deadband)
+    p = continuous_params(theta, ts)
+    print("\nARX: v[k] = %.5f v[k-1] + %.5f v[k-2] + %.6f u[k-1] + %.6f u[k-2] + %.5f sign(v[k-1])" % tuple(theta))
+    print("fit (1 - rms(residual) / rms(v)): %.3f" % fit)
+    print("\ncontinuous model  J·dω/dt = Uq - B·ω - Fc·sign(ω), plus one fast pole")
+    print("  J  (inertia / Kt)          %10.4f Uq/(rad/s²)   -> FOC_FEEDFORWARD_ACCEL" % p["J"])
+    print("  B  (back-EMF + viscous)    %10.4f Uq/(rad/s)    -> FOC_FEEDFORWARD_VELOCITY" % p["B"])
+    print("  Fc (Coulomb friction)      %10.2f Uq            -> FOC_MCPWM_STATIC_FRIC_TORQUE" % p["Fc"])
+    print("  no-load speed at full Uq   %10.1f rad/s" % (999 / p["B"]))
+    print("  mechanical pole            %10.2f Hz" % p["mech_pole_hz"])
+    fast = p["fast_pole"]
+    if abs(fast.imag) < 1e-6 and fast.real < 0:
+        print("  electrical / delay pole    %10.2f Hz (tau %.2f ms)" % (-fast.real / (2 * math.pi), -1000 / fast.real))
+    else:
+        print("  electrical / delay pole    not resolvable at this sample rate (discrete pole on the negative axis)")
+
+    nyquist = 0.5 / ts
+    f_lo, f_hi = 0.5, nyquist * 0.8
+    if meta["signal"] == "chirp":
+        f_lo, f_hi = max(meta["param1"], 0.1), min(meta["param2"], f_hi)
+    print("\nBode, Uq -> velocity (dB re 1 rad/s per Uq; position = velocity / jω)")
+    print("%9s  %10s %9s  %10s %9s  %6s" % ("f (Hz)", "meas dB", "meas deg", "model dB", "model deg", "coh"))
+    for i in range(args.points):
+        f = f_lo * (f_hi / f_lo) ** (i / (args.points - 1))
+        hm = model_response(theta, f, ts)
+        h, coherence = measured_response(u, v, f, ts)
+        if h is None:
+            continue
+        print("%9.2f  %10.2f %9.1f  %10.2f %9.1f  %6.2f" % (
+            f, db(h), math.degrees(cmath.phase(h)), db(hm), math.degrees(cmath.phase(hm)), coherence))
+
+
+if __name__ == "__main__":
+    main()